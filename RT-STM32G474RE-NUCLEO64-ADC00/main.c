@@ -89,7 +89,7 @@ static const ADCConversionGroup adcgrpcfg1 = {
 
 /*
  * ADC conversion group.
- * Mode:        Continuous, 2 channels, HW triggered by GPT4-TRGO.
+ * Mode:        Continuous, 2 channels, HW triggered by GPT1-TRGO.
  * Channels:    IN1, IN2.
  */
 static const ADCConversionGroup adcgrpcfg2 = {
@@ -98,7 +98,7 @@ static const ADCConversionGroup adcgrpcfg2 = {
 		  .end_cb       = adccallback,
 		  .error_cb     = adcerrorcallback,
 		  .cfgr         = ADC_CFGR_EXTEN_RISING |
-		                  ADC_CFGR_EXTSEL_SRC(12),  /* TIM4_TRGO */
+		                  ADC_CFGR_EXTSEL_SRC(9),   /* TIM1_TRGO */
 		  .cfgr2        = 0U,
 		  .tr1          = ADC_TR_DISABLED,
 		  .tr2          = ADC_TR_DISABLED,
@@ -138,9 +138,11 @@ int main(void) {
   chSysInit();
 
   /*
-   * Setting up analog inputs used by the demo.
+   * Setting up analog inputs used by the demo:
+   *    PORTA PIN 0 -> ADC1_IN1
+   *    PORTA PIN 1 -> ADC1_IN2
    */
-  palSetGroupMode(GPIOC, PAL_PORT_BIT(1) | PAL_PORT_BIT(2),
+  palSetGroupMode(GPIOA, PAL_PORT_BIT(0) | PAL_PORT_BIT(1),
                   0, PAL_MODE_INPUT_ANALOG);
 
   /*
@@ -170,12 +172,6 @@ int main(void) {
   adcStartConversion(&ADCD1, &adcgrpcfg2,samples2, ADC_GRP2_BUF_DEPTH);
   gptStartContinuous(&GPTD1, 100U);
 
-
-  /*
-   * Starts an ADC continuous conversion.
-   */
-  adcStartConversion(&ADCD1, &adcgrpcfg2, samples2, ADC_GRP2_BUF_DEPTH);
-
   /*
    * Normal main() thread activity, in this demo it does nothing.
    */
@@ -0,0 +1,258 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Threshold monitoring on the ADC analog watchdogs. The monitored channels
+ * are converted in circular mode with the watchdog windows armed and no
+ * end callback, the CPU is not involved until a watchdog fires. The HAL
+ * stops the conversion on a watchdog event, the service thread then takes
+ * one fresh sample set, updates the zones, broadcasts the changes and
+ * restarts the conversion with the windows of the new zones: outside a
+ * window is armed to catch the return, hyst counts past the threshold.
+ */
+
+#include "adcawd.h"
+
+#include <string.h>
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static ADCAwdDriver *awdOf(ADCDriver *adcp) {
+
+  return (ADCAwdDriver *)(void *)((uint8_t *)adcp->grpp -
+                                  offsetof(ADCAwdDriver, grp));
+}
+
+static uint16_t mv2counts(uint16_t mv) {
+  uint32_t counts = (uint32_t)mv * 4096U / ADCAWD_VDDA_MV;
+
+  return counts > 4095U ? 4095U : (uint16_t)counts;
+}
+
+static void awderrcb(ADCDriver *adcp, adcerror_t err) {
+  ADCAwdDriver *awdp = awdOf(adcp);
+
+  if ((err & ~(adcerror_t)(ADC_ERR_AWD1 | ADC_ERR_AWD2 | ADC_ERR_AWD3)) != 0U) {
+    awdp->errors++;
+  }
+
+  chSysLockFromISR();
+  if (awdp->config->errp != NULL) {
+    (void) adcerrReportI(awdp->config->errp, err);
+  }
+  chBSemSignalI(&awdp->sem);
+  chSysUnlockFromISR();
+}
+
+/* Sequence and sampling time of the monitored channels. */
+static void buildGroup(ADCConversionGroup *grpp, const ADCAwdConfig *config) {
+
+  memset(grpp, 0, sizeof(*grpp));
+  grpp->num_channels = (adc_channels_num_t)config->num_windows;
+  grpp->tr1 = ADC_TR_DISABLED;
+  grpp->tr2 = ADC_TR_DISABLED;
+  grpp->tr3 = ADC_TR_DISABLED;
+  for (unsigned i = 0; i < config->num_windows; i++) {
+    uint32_t ch = config->windows[i].channel;
+
+    grpp->smpr[ch / 10U] |= config->smp << (3U * (ch % 10U));
+    grpp->sqr[0] |= ch << (6U * (i + 1U));
+  }
+}
+
+static adcawd_zone_t classify(ADCAwdDriver *awdp, unsigned i, adcsample_t v) {
+  uint16_t low = awdp->low[i], high = awdp->high[i], hyst = awdp->hyst[i];
+
+  switch (awdp->zone[i]) {
+  case ADCAWD_ABOVE:
+    if (v + hyst >= high) {
+      return ADCAWD_ABOVE;
+    }
+    break;
+  case ADCAWD_BELOW:
+    if (v <= low + hyst) {
+      return ADCAWD_BELOW;
+    }
+    break;
+  default:
+    break;
+  }
+  if (v > high) {
+    return ADCAWD_ABOVE;
+  }
+  if (v < low) {
+    return ADCAWD_BELOW;
+  }
+  return ADCAWD_INSIDE;
+}
+
+/* Loads the watchdog windows of the current zones. */
+static void arm(ADCAwdDriver *awdp) {
+  uint32_t tr[ADCAWD_MAX_WINDOWS] = {ADC_TR_DISABLED, ADC_TR_DISABLED,
+                                     ADC_TR_DISABLED};
+
+  for (unsigned i = 0; i < awdp->config->num_windows; i++) {
+    uint32_t lt, ht;
+
+    switch (awdp->zone[i]) {
+    case ADCAWD_ABOVE:
+      lt = awdp->high[i] > awdp->hyst[i] ?
+           (uint32_t)awdp->high[i] - awdp->hyst[i] : 0U;
+      ht = 4095U;
+      break;
+    case ADCAWD_BELOW:
+      lt = 0U;
+      ht = (uint32_t)awdp->low[i] + awdp->hyst[i];
+      ht = ht > 4095U ? 4095U : ht;
+      break;
+    default:
+      lt = awdp->low[i];
+      ht = awdp->high[i];
+      break;
+    }
+    tr[i] = (i == 0U) ? ADC_TR(lt, ht) : ADC_TR(lt >> 4, ht >> 4);
+  }
+
+  awdp->grp.tr1 = tr[0];
+  awdp->grp.tr2 = tr[1];
+  awdp->grp.tr3 = tr[2];
+}
+
+/* Samples all the channels once, returns the zone change flags. */
+static eventflags_t update(ADCAwdDriver *awdp) {
+  adcsample_t v[ADCAWD_MAX_WINDOWS];
+  eventflags_t flags = 0U;
+
+  if (adcConvert(awdp->config->adcp, &awdp->probe, v, 1) != MSG_OK) {
+    awdp->errors++;
+    return 0U;
+  }
+
+  for (unsigned i = 0; i < awdp->config->num_windows; i++) {
+    adcawd_zone_t z = classify(awdp, i, v[i]);
+
+    awdp->last[i] = v[i];
+    if (z != awdp->zone[i]) {
+      awdp->zone[i] = z;
+      awdp->crossings++;
+      flags |= (z == ADCAWD_INSIDE) ? ADCAWD_FLAG_ENTER(i) :
+               (z == ADCAWD_ABOVE)  ? ADCAWD_FLAG_ABOVE(i) :
+                                      ADCAWD_FLAG_BELOW(i);
+    }
+  }
+  return flags;
+}
+
+static THD_FUNCTION(awdThread, p) {
+  ADCAwdDriver *awdp = (ADCAwdDriver *)p;
+
+  chRegSetThreadName("adcawd");
+
+  while (true) {
+    eventflags_t flags;
+
+    chBSemWait(&awdp->sem);
+    if (chThdShouldTerminateX()) {
+      break;
+    }
+
+    flags = update(awdp);
+    arm(awdp);
+    adcStartConversion(awdp->config->adcp, &awdp->grp, awdp->buf,
+                       ADCAWD_BUF_DEPTH);
+    if (flags != 0U) {
+      chEvtBroadcastFlags(&awdp->es, flags);
+    }
+  }
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+void adcawdObjectInit(ADCAwdDriver *awdp) {
+
+  awdp->state = ADCAWD_STOP;
+  awdp->config = NULL;
+  awdp->thd = NULL;
+  chBSemObjectInit(&awdp->sem, true);
+  chEvtObjectInit(&awdp->es);
+}
+
+/*
+ * Takes an initial sample set to set the zones without broadcasting, then
+ * arms the watchdogs. The ADC driver must be started.
+ */
+void adcawdStart(ADCAwdDriver *awdp, const ADCAwdConfig *config) {
+  const adcawd_window_t *wp = config->windows;
+  unsigned n = config->num_windows;
+
+  osalDbgCheck((n >= 1U) && (n <= ADCAWD_MAX_WINDOWS));
+  osalDbgAssert(awdp->state == ADCAWD_STOP, "invalid state");
+
+  awdp->config = config;
+  awdp->crossings = 0U;
+  awdp->errors = 0U;
+  for (unsigned i = 0; i < n; i++) {
+    awdp->low[i] = mv2counts(wp[i].low_mv);
+    awdp->high[i] = mv2counts(wp[i].high_mv);
+    awdp->hyst[i] = mv2counts(wp[i].hyst_mv);
+    awdp->zone[i] = ADCAWD_INSIDE;
+  }
+
+  buildGroup(&awdp->probe, config);
+
+  buildGroup(&awdp->grp, config);
+  awdp->grp.circular = true;
+  awdp->grp.error_cb = awderrcb;
+  awdp->grp.cfgr = (config->trigger != 0U ? config->trigger : ADC_CFGR_CONT) |
+                   ADC_CFGR_AWD1EN | ADC_CFGR_AWD1SGL |
+                   ((uint32_t)wp[0].channel << ADC_CFGR_AWD1CH_Pos);
+  awdp->grp.awd2cr = n > 1U ? (1U << wp[1].channel) : 0U;
+  awdp->grp.awd3cr = n > 2U ? (1U << wp[2].channel) : 0U;
+
+  (void)update(awdp);
+  arm(awdp);
+
+  chBSemReset(&awdp->sem, true);
+  awdp->thd = chThdCreateStatic(awdp->wa, sizeof(awdp->wa), config->prio,
+                                awdThread, awdp);
+  awdp->state = ADCAWD_ACTIVE;
+
+  adcStartConversion(config->adcp, &awdp->grp, awdp->buf, ADCAWD_BUF_DEPTH);
+  if (config->gptp != NULL) {
+    gptStartContinuous(config->gptp, config->interval);
+  }
+}
+
+void adcawdStop(ADCAwdDriver *awdp) {
+  const ADCAwdConfig *config = awdp->config;
+
+  if (awdp->state != ADCAWD_ACTIVE) {
+    return;
+  }
+
+  chThdTerminate(awdp->thd);
+  chBSemSignal(&awdp->sem);
+  chThdWait(awdp->thd);
+  awdp->thd = NULL;
+
+  if (config->gptp != NULL) {
+    gptStopTimer(config->gptp);
+  }
+  adcStopConversion(config->adcp);
+  awdp->state = ADCAWD_STOP;
+}
@@ -0,0 +1,160 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef __ADCAWD_H__
+#define __ADCAWD_H__
+
+#include "ch.h"
+#include "hal.h"
+
+#include "adcerr.h"
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Analog supply used to convert the windows from mV, in mV.
+ */
+#if !defined(ADCAWD_VDDA_MV)
+#define ADCAWD_VDDA_MV                  3300
+#endif
+
+/**
+ * @brief   Depth of the monitoring buffer, in sample sets.
+ * @note    The DMA interrupts twice per buffer, a deeper buffer means
+ *          fewer interrupts while nothing crosses a threshold.
+ */
+#if !defined(ADCAWD_BUF_DEPTH)
+#define ADCAWD_BUF_DEPTH                64
+#endif
+
+/**
+ * @brief   Stack size of the service thread.
+ */
+#if !defined(ADCAWD_THREAD_WA_SIZE)
+#define ADCAWD_THREAD_WA_SIZE           256
+#endif
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if !HAL_USE_ADC
+#error "ADC watchdog service requires HAL_USE_ADC"
+#endif
+
+#if !ADC_USE_WAIT
+#error "ADC watchdog service requires ADC_USE_WAIT"
+#endif
+
+#if !CH_CFG_USE_EVENTS || !CH_CFG_USE_SEMAPHORES
+#error "ADC watchdog service requires CH_CFG_USE_EVENTS and CH_CFG_USE_SEMAPHORES"
+#endif
+
+/* One window per hardware watchdog: AWD1 has 12-bit thresholds, AWD2 and
+   AWD3 compare the 8 MSBs of the result only.*/
+#define ADCAWD_MAX_WINDOWS              3
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+typedef enum {
+    ADCAWD_UNINIT = 0,
+    ADCAWD_STOP = 1,
+    ADCAWD_ACTIVE = 2
+} adcawd_state_t;
+
+typedef enum {
+    ADCAWD_INSIDE = 0,
+    ADCAWD_ABOVE = 1,
+    ADCAWD_BELOW = 2
+} adcawd_zone_t;
+
+/*
+ * A value leaving [low_mv, high_mv] moves the channel above or below, it
+ * comes back inside only once it is hyst_mv past the threshold it crossed.
+ */
+typedef struct {
+    uint8_t channel;
+    uint16_t low_mv;
+    uint16_t high_mv;
+    uint16_t hyst_mv;
+} adcawd_window_t;
+
+typedef struct {
+    ADCDriver *adcp;
+    const adcawd_window_t *windows;
+    unsigned num_windows;
+    /* ADC_SMPR_SMP_xxx used for all the monitored channels. */
+    uint32_t smp;
+    /* CFGR EXTEN/EXTSEL bits, 0 converts continuously. */
+    uint32_t trigger;
+    /* Optional trigger timer, already started, and its period in ticks. */
+    GPTDriver *gptp;
+    gptcnt_t interval;
+    tprio_t prio;
+    /* Optional error accounting, NULL if unused. */
+    adcerr_t *errp;
+} ADCAwdConfig;
+
+typedef struct {
+    adcawd_state_t state;
+    const ADCAwdConfig *config;
+    ADCConversionGroup grp;
+    ADCConversionGroup probe;
+    adcawd_zone_t zone[ADCAWD_MAX_WINDOWS];
+    uint16_t low[ADCAWD_MAX_WINDOWS];
+    uint16_t high[ADCAWD_MAX_WINDOWS];
+    uint16_t hyst[ADCAWD_MAX_WINDOWS];
+    adcsample_t last[ADCAWD_MAX_WINDOWS];
+    adcsample_t buf[ADCAWD_MAX_WINDOWS * ADCAWD_BUF_DEPTH];
+    uint32_t crossings;
+    uint32_t errors;
+    binary_semaphore_t sem;
+    event_source_t es;
+    thread_t *thd;
+    THD_WORKING_AREA(wa, ADCAWD_THREAD_WA_SIZE);
+} ADCAwdDriver;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/* Event flags broadcast for window i. */
+#define ADCAWD_FLAG_ENTER(i)            ((eventflags_t)1U << (4U * (i)))
+#define ADCAWD_FLAG_ABOVE(i)            ((eventflags_t)2U << (4U * (i)))
+#define ADCAWD_FLAG_BELOW(i)            ((eventflags_t)4U << (4U * (i)))
+
+#define adcawdGetEventSource(awdp)      (&(awdp)->es)
+#define adcawdGetZone(awdp, i)          ((awdp)->zone[i])
+/* Value that caused the last zone update of window i, in counts. */
+#define adcawdGetLast(awdp, i)          ((awdp)->last[i])
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void adcawdObjectInit(ADCAwdDriver *awdp);
+  void adcawdStart(ADCAwdDriver *awdp, const ADCAwdConfig *config);
+  void adcawdStop(ADCAwdDriver *awdp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADCAWD_H__ */
@@ -0,0 +1,150 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "adccal.h"
+#include "adcgrp.h"
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/*
+ * VREFINT and temperature sensor, both need several microseconds of
+ * sampling: 640.5 cycles are 15 us at the default ADC clock.
+ */
+#define CAL_SEQ         ADCGRP_CH(ADCCAL_VREFINT_CHANNEL, ADC_SMPR_SMP_640P5), \
+                        ADCGRP_CH(ADCCAL_TS_CHANNEL, ADC_SMPR_SMP_640P5)
+
+static const ADCConversionGroup calgrp = {
+  .circular     = false,
+  ADCGRP_SEQUENCE(CAL_SEQ),
+  .end_cb       = NULL,
+  .error_cb     = NULL,
+  .cfgr         = ADCGRP_CONTINUOUS,
+  .cfgr2        = 0U,
+  .tr1          = ADC_TR_DISABLED,
+  .tr2          = ADC_TR_DISABLED,
+  .tr3          = ADC_TR_DISABLED,
+  .awd2cr       = 0U,
+  .awd3cr       = 0U
+};
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static uint16_t factory(uint32_t addr) {
+
+  return *(const volatile uint16_t *)addr;
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+void adccalObjectInit(adccal_t *cp) {
+
+  cp->adcp = NULL;
+  cp->vrefcal = factory(ADCCAL_VREFINT_CAL_ADDR);
+  cp->tscal1 = factory(ADCCAL_TS_CAL1_ADDR);
+  cp->tscal2 = factory(ADCCAL_TS_CAL2_ADDR);
+  cp->calfact = 0U;
+  cp->updates = 0U;
+
+  /* Scales for the default VDDA, VREFINT as the factory would read it.*/
+  cp->vrefraw = (uint16_t)(cp->vrefcal * ADCCAL_CAL_VDDA_MV /
+                           ADCCAL_DEFAULT_VDDA_MV);
+  cp->tsraw = 0U;
+  chSysLock();
+  adccalUpdateI(cp, cp->vrefraw, 0U);
+  chSysUnlock();
+  cp->updates = 0U;
+}
+
+/*
+ * Starts the ADC, the ADCv3 driver runs the self-calibration whenever it
+ * leaves the stopped state, so a running ADC is stopped first. Then the
+ * internal channels are enabled and a first measurement is taken.
+ */
+void adccalStart(adccal_t *cp, ADCDriver *adcp, const ADCConfig *config) {
+
+  osalDbgCheck((cp != NULL) && (adcp != NULL));
+
+  cp->adcp = adcp;
+  adcStop(adcp);
+  adcStart(adcp, config);
+  cp->calfact = adcp->adcm->CALFACT;
+
+  adcSTM32EnableVREF(adcp);
+  adcSTM32EnableTS(adcp);
+  (void) adccalMeasure(cp);
+}
+
+/*
+ * One software conversion of VREFINT and of the temperature sensor, the
+ * caller owns the ADC and no conversion is running.
+ */
+msg_t adccalMeasure(adccal_t *cp) {
+  adcsample_t buf[2U * ADCCAL_MEASURE_SETS];
+  uint32_t vref = 0U, ts = 0U;
+  msg_t msg;
+
+  msg = adcConvert(cp->adcp, &calgrp, buf, ADCCAL_MEASURE_SETS);
+  if (msg != MSG_OK) {
+    return msg;
+  }
+  for (unsigned i = 0; i < ADCCAL_MEASURE_SETS; i++) {
+    vref += buf[2U * i];
+    ts += buf[2U * i + 1U];
+  }
+  adccalUpdate(cp, (adcsample_t)(vref / ADCCAL_MEASURE_SETS),
+               (adcsample_t)(ts / ADCCAL_MEASURE_SETS));
+  return MSG_OK;
+}
+
+/*
+ * Publishes the scales for a VREFINT and a temperature sensor reading,
+ * a ts of 0 keeps the previous one. Called from a lock zone.
+ *   VDDA = 3000 mV * VREFINT_CAL / vref
+ *   T = 30 + 100 * (ts * VDDA / 3000 - TS_CAL1) / (TS_CAL2 - TS_CAL1)
+ */
+void adccalUpdateI(adccal_t *cp, adcsample_t vref, adcsample_t ts) {
+  uint64_t num = (uint64_t)ADCCAL_CAL_VDDA_MV * cp->vrefcal;
+  int32_t span = (int32_t)cp->tscal2 - (int32_t)cp->tscal1;
+
+  if (vref == 0U) {
+    return;
+  }
+
+  cp->vrefraw = vref;
+  cp->vdda = (uint32_t)(num / vref);
+  cp->mvscale = (uint32_t)((num << 16) / ((uint64_t)vref * ADCCAL_FULL_SCALE));
+  if (span > 0) {
+    cp->tscale = (int32_t)(((int64_t)cp->vrefcal * 100 * 100 * 65536) /
+                           ((int64_t)vref * span));
+    cp->toffset = ADCCAL_TS_CAL1_DEG * 100 - (int32_t)cp->tscal1 * 100 *
+                  (ADCCAL_TS_CAL2_DEG - ADCCAL_TS_CAL1_DEG) / span;
+  }
+  if (ts != 0U) {
+    cp->tsraw = ts;
+  }
+  cp->updates++;
+}
+
+void adccalUpdate(adccal_t *cp, adcsample_t vref, adcsample_t ts) {
+
+  chSysLock();
+  adccalUpdateI(cp, vref, ts);
+  chSysUnlock();
+}
@@ -0,0 +1,132 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Calibrated integer conversions for ADC1. The factory VREFINT and
+ * temperature sensor values are read from the system memory, each VREFINT
+ * measurement gives the actual VDDA and the service publishes the scales
+ * derived from it: a conversion to millivolts or degrees is then a single
+ * multiply and shift, with no float and no fixed 3.3 V assumption.
+ * Results are for 12-bit right aligned samples.
+ */
+
+#ifndef __ADCCAL_H__
+#define __ADCCAL_H__
+
+#include "ch.h"
+#include "hal.h"
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/* Factory data in system memory, RM0440 and DS12288. */
+#define ADCCAL_VREFINT_CAL_ADDR         0x1FFF75AAU
+#define ADCCAL_TS_CAL1_ADDR             0x1FFF75A8U
+#define ADCCAL_TS_CAL2_ADDR             0x1FFF75CAU
+
+/* Conditions of the factory measurements. */
+#define ADCCAL_CAL_VDDA_MV              3000U
+#define ADCCAL_TS_CAL1_DEG              30
+#define ADCCAL_TS_CAL2_DEG              130
+
+/* Internal channels of ADC1. */
+#define ADCCAL_TS_CHANNEL               ADC_CHANNEL_IN16
+#define ADCCAL_VBAT_CHANNEL             ADC_CHANNEL_IN17
+#define ADCCAL_VREFINT_CHANNEL          ADC_CHANNEL_IN18
+
+#define ADCCAL_FULL_SCALE               4095U
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   VDDA assumed until the first VREFINT measurement, in mV.
+ */
+#if !defined(ADCCAL_DEFAULT_VDDA_MV)
+#define ADCCAL_DEFAULT_VDDA_MV          3300U
+#endif
+
+/**
+ * @brief   Sample sets averaged by adccalMeasure().
+ */
+#if !defined(ADCCAL_MEASURE_SETS)
+#define ADCCAL_MEASURE_SETS             8U
+#endif
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if !HAL_USE_ADC
+#error "ADC calibration requires HAL_USE_ADC"
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+typedef struct {
+    ADCDriver *adcp;
+    /* Factory data. */
+    uint16_t vrefcal;
+    uint16_t tscal1;
+    uint16_t tscal2;
+    /* Last raw measurements, averaged. */
+    uint16_t vrefraw;
+    uint16_t tsraw;
+    /* Published figures, each one a single word. */
+    uint32_t vdda;
+    /* mV per count, Q16. */
+    uint32_t mvscale;
+    /* Hundredths of degree per count, Q16, and at count 0. */
+    int32_t tscale;
+    int32_t toffset;
+    /* Self-calibration factors read back after the start. */
+    uint32_t calfact;
+    uint32_t updates;
+} adccal_t;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/* Millivolts of a sample, one multiply and shift. */
+#define adccalToMillivolts(cp, raw)                                         \
+  (((uint32_t)(raw) * (cp)->mvscale) >> 16)
+
+/* Hundredths of degree of a temperature sensor sample. */
+#define adccalToCentidegrees(cp, raw)                                       \
+  ((int32_t)(((int64_t)(raw) * (cp)->tscale) >> 16) + (cp)->toffset)
+
+#define adccalGetVdda(cp)               ((cp)->vdda)
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void adccalObjectInit(adccal_t *cp);
+  void adccalStart(adccal_t *cp, ADCDriver *adcp, const ADCConfig *config);
+  msg_t adccalMeasure(adccal_t *cp);
+  void adccalUpdateI(adccal_t *cp, adcsample_t vref, adcsample_t ts);
+  void adccalUpdate(adccal_t *cp, adcsample_t vref, adcsample_t ts);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADCCAL_H__ */
@@ -0,0 +1,370 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Everything but adccapForce() runs in the thread that reads the stream.
+ */
+
+#include "adccap.h"
+
+#include <string.h>
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static void reverse(adcsample_t *p, size_t n) {
+  adcsample_t *q = p + n;
+
+  while (p + 1 < q) {
+    adcsample_t t = *p;
+
+    *p++ = *--q;
+    *q = t;
+  }
+}
+
+/* Copies sets [i, i + k) of the block into the ring. */
+static void ringWrite(adccap_t *cp, const adcsample_t *p, size_t i,
+                      size_t k) {
+  unsigned nch = cp->config->nch;
+
+  p += i * nch;
+  while (k > 0U) {
+    size_t m = cp->len - cp->wr;
+
+    if (m > k) {
+      m = k;
+    }
+    memcpy(&cp->config->buf[cp->wr * nch], p, m * nch * sizeof(adcsample_t));
+    p += m * nch;
+    k -= m;
+    cp->wr += m;
+    if (cp->wr == cp->len) {
+      cp->wr = 0U;
+    }
+  }
+}
+
+/* Refills the pre-trigger sets, and the slope history, for at least sets. */
+static void fill(adccap_t *cp, uint64_t sets) {
+  const adccap_config_t *cfg = cp->config;
+  uint64_t min = cfg->pre;
+
+  if ((cfg->trigger == ADCCAP_SLOPE) && (cfg->span > min)) {
+    min = cfg->span;
+  }
+  cp->state = ADCCAP_FILL;
+  cp->count = sets > min ? sets : min;
+}
+
+static void arm(adccap_t *cp) {
+
+  cp->state = ADCCAP_ARMED;
+  cp->waited = 0U;
+  cp->lowarm = false;
+  cp->higharm = false;
+}
+
+/* Trigger channel value span sets before block set j, scanned from i. */
+static int32_t history(const adccap_t *cp, const adcsample_t *p, size_t i,
+                       size_t j, size_t span) {
+  const adccap_config_t *cfg = cp->config;
+  size_t back;
+
+  if (j >= span) {
+    return p[(j - span) * cfg->nch + cfg->channel];
+  }
+  /* Before the block, the ring holds block set i - 1 at wr - 1.*/
+  back = span - (j - i);
+  return cfg->buf[((cp->wr + cp->len - back) % cp->len) * cfg->nch +
+                  cfg->channel];
+}
+
+/* First set in [i, end) that meets the condition, end if none. */
+static size_t scan(adccap_t *cp, const adcsample_t *p, size_t i,
+                   size_t end) {
+  const adccap_config_t *cfg = cp->config;
+  const adcsample_t *s = p + cfg->channel;
+  unsigned nch = cfg->nch;
+  bool rise = (cfg->edge & ADCCAP_RISING) != 0U;
+  bool fall = (cfg->edge & ADCCAP_FALLING) != 0U;
+  int32_t level = cfg->level, hyst = cfg->hyst;
+  size_t j;
+
+  switch (cfg->trigger) {
+  case ADCCAP_LEVEL:
+    for (j = i; j < end; j++) {
+      int32_t v = s[j * nch];
+
+      if (rise ? (v >= level) : (v <= level)) {
+        break;
+      }
+    }
+    return j;
+  case ADCCAP_EDGE:
+    for (j = i; j < end; j++) {
+      int32_t v = s[j * nch];
+
+      if (v < level - hyst) {
+        cp->lowarm = true;
+      }
+      else if (v >= level && rise && cp->lowarm) {
+        cp->lowarm = false;
+        break;
+      }
+      if (v > level + hyst) {
+        cp->higharm = true;
+      }
+      else if (v <= level && fall && cp->higharm) {
+        cp->higharm = false;
+        break;
+      }
+    }
+    return j;
+  case ADCCAP_SLOPE:
+    for (j = i; j < end; j++) {
+      int32_t d = (int32_t)s[j * nch] - history(cp, p, i, j, cfg->span);
+
+      if ((rise && (d >= (int32_t)cfg->slope)) ||
+          (fall && (-d >= (int32_t)cfg->slope))) {
+        break;
+      }
+    }
+    return j;
+  case ADCCAP_WINDOW:
+    for (j = i; j < end; j++) {
+      adcsample_t v = s[j * nch];
+
+      if ((v < cfg->low) || (v > cfg->high)) {
+        break;
+      }
+    }
+    return j;
+  default:
+    return end;
+  }
+}
+
+/* Rotates the ring in place, oldest set first. */
+static void freeze(adccap_t *cp) {
+  unsigned nch = cp->config->nch;
+  adcsample_t *buf = cp->config->buf;
+
+  if (cp->wr != 0U) {
+    reverse(buf, cp->wr * nch);
+    reverse(buf + cp->wr * nch, (cp->len - cp->wr) * nch);
+    reverse(buf, cp->len * nch);
+    cp->wr = 0U;
+  }
+  cp->captures++;
+  cp->state = ADCCAP_READY;
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+void adccapObjectInit(adccap_t *cp) {
+
+  cp->config = NULL;
+  cp->state = ADCCAP_STOP;
+  cp->force = false;
+  cp->captures = 0U;
+  cp->dropped = 0U;
+}
+
+/*
+ * Starts filling the ring, the first trigger is taken once the pre-trigger
+ * sets are in.
+ */
+void adccapStart(adccap_t *cp, const adccap_config_t *config) {
+
+  osalDbgCheck((cp != NULL) && (config != NULL) && (config->buf != NULL) &&
+               (config->nch > 0U) && (config->channel < config->nch) &&
+               (config->post > 0U) && (config->edge != 0U) &&
+               (config->edge <= ADCCAP_BOTH));
+  osalDbgCheck((config->trigger != ADCCAP_LEVEL) ||
+               (config->edge != ADCCAP_BOTH));
+  osalDbgCheck((config->trigger != ADCCAP_SLOPE) ||
+               ((config->span > 0U) &&
+                (config->span < config->pre + config->post)));
+  osalDbgCheck((config->trigger != ADCCAP_WINDOW) ||
+               (config->low <= config->high));
+  osalDbgCheck((config->mode != ADCCAP_AUTO) || (config->autosets > 0U));
+
+  cp->config = config;
+  cp->len = config->pre + config->post;
+  cp->wr = 0U;
+  cp->force = false;
+  cp->trigset = 0U;
+  cp->forced = false;
+  cp->captures = 0U;
+  cp->next = 0U;
+  cp->dropped = 0U;
+  fill(cp, 0U);
+}
+
+void adccapStop(adccap_t *cp) {
+
+  cp->state = ADCCAP_STOP;
+}
+
+/*
+ * Re-arms after a single capture, or throws away the capture in progress.
+ */
+void adccapArm(adccap_t *cp) {
+
+  osalDbgCheck(cp->config != NULL);
+
+  cp->wr = 0U;
+  cp->force = false;
+  fill(cp, 0U);
+}
+
+/*
+ * Takes the next armed set as the trigger set.
+ */
+void adccapForce(adccap_t *cp) {
+
+  cp->force = true;
+}
+
+/*
+ * Feeds a stream block, returns true when a capture completed in it. The
+ * sets following the capture in the block are dropped.
+ */
+bool adccapFeed(adccap_t *cp, const adcs_block_t *bp) {
+  const adccap_config_t *cfg = cp->config;
+  const adcsample_t *p = bp->samples;
+  uint64_t base = (uint64_t)bp->seq * bp->n;
+  size_t i = 0U, n = bp->n;
+
+  if (cp->state == ADCCAP_STOP) {
+    return false;
+  }
+  cp->next = base + n;
+  if (cp->state == ADCCAP_READY) {
+    cp->dropped += n;
+    return false;
+  }
+
+  /* A gap in the stream, the ring is not contiguous any more.*/
+  if (bp->lost > 0U) {
+    fill(cp, cp->state == ADCCAP_FILL ? cp->count : 0U);
+  }
+
+  for (;;) {
+    size_t k, end;
+
+    if ((cp->state == ADCCAP_POST) && (cp->count == 0U)) {
+      freeze(cp);
+      cp->dropped += n - i;
+      return true;
+    }
+    if (i == n) {
+      return false;
+    }
+
+    switch (cp->state) {
+    case ADCCAP_FILL:
+      k = n - i;
+      if (k > cp->count) {
+        k = (size_t)cp->count;
+      }
+      ringWrite(cp, p, i, k);
+      i += k;
+      cp->count -= k;
+      if (cp->count == 0U) {
+        arm(cp);
+      }
+      break;
+    case ADCCAP_ARMED:
+      if (cp->force ||
+          ((cfg->mode == ADCCAP_AUTO) && (cp->waited >= cfg->autosets))) {
+        cp->force = false;
+        cp->forced = true;
+        k = i;
+      }
+      else {
+        end = n;
+        if ((cfg->mode == ADCCAP_AUTO) &&
+            (cfg->autosets - cp->waited < n - i)) {
+          end = i + (cfg->autosets - cp->waited);
+        }
+        k = scan(cp, p, i, end);
+        if (k == end) {
+          ringWrite(cp, p, i, end - i);
+          cp->waited += (uint32_t)(end - i);
+          i = end;
+          break;
+        }
+        cp->forced = false;
+      }
+      /* Trigger at set k, taken with the post-trigger sets.*/
+      ringWrite(cp, p, i, k + 1U - i);
+      i = k + 1U;
+      cp->trigset = base + k;
+      cp->state = ADCCAP_POST;
+      cp->count = cfg->post - 1U;
+      break;
+    case ADCCAP_POST:
+      k = n - i;
+      if (k > cp->count) {
+        k = (size_t)cp->count;
+      }
+      ringWrite(cp, p, i, k);
+      i += k;
+      cp->count -= k;
+      break;
+    default:
+      return false;
+    }
+  }
+}
+
+/*
+ * Returns the frozen capture, valid until adccapRelease().
+ */
+bool adccapGet(adccap_t *cp, adccap_capture_t *capp) {
+
+  if (cp->state != ADCCAP_READY) {
+    return false;
+  }
+  capp->samples = cp->config->buf;
+  capp->n = cp->len;
+  capp->trigger = cp->config->pre;
+  capp->set = cp->trigset;
+  capp->number = cp->captures;
+  capp->forced = cp->forced;
+  return true;
+}
+
+/*
+ * Hands the ring back. Normal and auto modes refill and re-arm once the
+ * holdoff from the last trigger is over, single mode stops.
+ */
+void adccapRelease(adccap_t *cp) {
+  const adccap_config_t *cfg = cp->config;
+  uint64_t since = cp->next - cp->trigset;
+
+  if (cp->state != ADCCAP_READY) {
+    return;
+  }
+  if (cfg->mode == ADCCAP_SINGLE) {
+    cp->state = ADCCAP_STOP;
+    return;
+  }
+  fill(cp, cfg->holdoff > since ? cfg->holdoff - since : 0U);
+}
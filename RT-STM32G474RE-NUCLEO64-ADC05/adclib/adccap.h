@@ -0,0 +1,173 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Pre-trigger capture on an adcstream, oscilloscope style. A ring of
+ * pre + post sample sets always holds the latest sets of the stream; when
+ * the trigger channel meets the trigger condition the capture goes on for
+ * post sets and the ring is frozen, rotated in place so that the capture
+ * is contiguous and in time order, pre sets before the trigger set.
+ *
+ * Trigger conditions, on one channel of the set:
+ *  - level: at or above (rising) or at or below (falling) the level;
+ *  - edge: crossing of the level, armed by the signal being more than the
+ *    hysteresis on the other side;
+ *  - slope: change over span sets of at least slope counts;
+ *  - window: sample outside [low, high], the analog watchdog condition.
+ *    It is checked on the stream, a hardware watchdog hit stops the
+ *    conversion on this ADC.
+ *
+ * Modes: normal re-arms on release, single captures once until the next
+ * adccapArm(), auto also captures when nothing triggers for autosets sets.
+ * Holdoff is the minimum distance in sets between two triggers. Sets fed
+ * while a capture is frozen are dropped, a lost stream block refills the
+ * pre-trigger part before the trigger is armed again.
+ */
+
+#ifndef __ADCCAP_H__
+#define __ADCCAP_H__
+
+#include "ch.h"
+#include "hal.h"
+
+#include "adcstream.h"
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+#define ADCCAP_RISING                   1U
+#define ADCCAP_FALLING                  2U
+#define ADCCAP_BOTH                     (ADCCAP_RISING | ADCCAP_FALLING)
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+typedef enum {
+    ADCCAP_LEVEL = 0,
+    ADCCAP_EDGE = 1,
+    ADCCAP_SLOPE = 2,
+    ADCCAP_WINDOW = 3
+} adccap_trigger_t;
+
+typedef enum {
+    ADCCAP_NORMAL = 0,
+    ADCCAP_SINGLE = 1,
+    ADCCAP_AUTO = 2
+} adccap_mode_t;
+
+typedef enum {
+    ADCCAP_STOP = 0,
+    /* Filling the pre-trigger sets or waiting the holdoff. */
+    ADCCAP_FILL = 1,
+    ADCCAP_ARMED = 2,
+    /* Taking the post-trigger sets. */
+    ADCCAP_POST = 3,
+    /* Capture frozen, until adccapRelease(). */
+    ADCCAP_READY = 4
+} adccap_state_t;
+
+typedef struct {
+    adccap_trigger_t trigger;
+    adccap_mode_t mode;
+    /* ADCCAP_RISING, ADCCAP_FALLING or both, level takes one. */
+    unsigned edge;
+    /* Channel of the set the trigger looks at. */
+    unsigned channel;
+    unsigned nch;
+    adcsample_t level;
+    adcsample_t hyst;
+    adcsample_t low;
+    adcsample_t high;
+    uint16_t slope;
+    /* Sets the slope is measured over, below pre + post. */
+    uint16_t span;
+    size_t pre;
+    /* Sets from the trigger set included, at least 1. */
+    size_t post;
+    uint32_t holdoff;
+    /* Auto mode, sets without a trigger before a forced capture. */
+    uint32_t autosets;
+    /* Ring of ADCCAP_BUF_SIZE(pre, post, nch) samples. */
+    adcsample_t *buf;
+} adccap_config_t;
+
+/*
+ * A frozen capture, n sets of nch samples with the trigger set at index
+ * trigger. The set number counts from the start of the stream, blocks
+ * included, so set times the trigger interval is the trigger time.
+ */
+typedef struct {
+    const adcsample_t *samples;
+    size_t n;
+    size_t trigger;
+    uint64_t set;
+    uint32_t number;
+    /* Auto or adccapForce() capture, no trigger condition met. */
+    bool forced;
+} adccap_capture_t;
+
+typedef struct {
+    const adccap_config_t *config;
+    adccap_state_t state;
+    size_t len;
+    /* Ring position of the next set. */
+    size_t wr;
+    /* Sets still to take in the current state. */
+    uint64_t count;
+    uint32_t waited;
+    /* Set by adccapForce(), possibly from another thread. */
+    volatile bool force;
+    /* Edge detector, below or above the hysteresis band. */
+    bool lowarm;
+    bool higharm;
+    uint64_t trigset;
+    bool forced;
+    uint32_t captures;
+    /* Next set number, and sets dropped while a capture was frozen. */
+    uint64_t next;
+    uint64_t dropped;
+} adccap_t;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+#define ADCCAP_BUF_SIZE(pre, post, nch) (((pre) + (post)) * (nch))
+
+#define adccapGetState(cp)              ((cp)->state)
+#define adccapGetCaptures(cp)           ((cp)->captures)
+#define adccapGetDropped(cp)            ((cp)->dropped)
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void adccapObjectInit(adccap_t *cp);
+  void adccapStart(adccap_t *cp, const adccap_config_t *config);
+  void adccapStop(adccap_t *cp);
+  void adccapArm(adccap_t *cp);
+  void adccapForce(adccap_t *cp);
+  bool adccapFeed(adccap_t *cp, const adcs_block_t *bp);
+  bool adccapGet(adccap_t *cp, adccap_capture_t *capp);
+  void adccapRelease(adccap_t *cp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADCCAP_H__ */
@@ -0,0 +1,163 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Integer decimation of interleaved ADC blocks. The CIC runs on the raw
+ * 12-bit samples in modulo 2^32 arithmetic, its output is scaled to Q15
+ * where full scale is 1.0. The FIR only evaluates the outputs that survive
+ * the decimation, so it costs taps / m multiply-accumulates per input
+ * sample like a polyphase bank, with Q30 products summed in 64 bits. All
+ * channels share the decimation phases, so the output stays interleaved.
+ */
+
+#include "adcdecim.h"
+#include "adcdsp.h"
+
+#include <string.h>
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static int16_t firDot(const int16_t *x, const int16_t *h, unsigned taps) {
+  int64_t acc = 0;
+  unsigned k = 0;
+
+#if ADCDSP_USE_SIMD
+  /* The delay line window moves by one sample, word loads may be unaligned.*/
+  for (; k + 1U < taps; k += 2U) {
+    uint32_t xw, hw;
+
+    memcpy(&xw, &x[k], sizeof(xw));
+    memcpy(&hw, &h[k], sizeof(hw));
+    acc = (int64_t)__SMLALD(xw, hw, (uint64_t)acc);
+  }
+#endif
+  for (; k < taps; k++) {
+    acc += (int32_t)x[k] * h[k];
+  }
+
+  acc = (acc + (1 << 14)) >> 15;
+  if (acc > INT16_MAX) {
+    return INT16_MAX;
+  }
+  if (acc < INT16_MIN) {
+    return INT16_MIN;
+  }
+  return (int16_t)acc;
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/*
+ * Returns false if the configuration is out of the compiled limits or the
+ * CIC bit growth does not fit its 32-bit registers.
+ */
+bool adcdecimInit(adcdecim_t *dp, const adcdecim_config_t *config,
+                  unsigned nch) {
+  unsigned growth = (unsigned)config->order * config->log2r;
+
+  if ((config->order > ADCDECIM_CIC_MAX_ORDER) ||
+      ((config->order == 0U) && (config->log2r != 0U)) ||
+      (ADCDECIM_INPUT_BITS + growth > 32U) ||
+      (config->m == 0U) || (config->taps == 0U) ||
+      (config->taps > ADCDECIM_FIR_MAX_TAPS) ||
+      (nch == 0U) || (nch > ADCDECIM_MAX_CHANNELS)) {
+    return false;
+  }
+
+  dp->config = config;
+  dp->nch = nch;
+  dp->shift = (int)growth + ADCDECIM_INPUT_BITS - 15;
+  adcdecimReset(dp);
+
+  return true;
+}
+
+void adcdecimReset(adcdecim_t *dp) {
+
+  dp->cicphase = 0U;
+  dp->firphase = 0U;
+  dp->pos = 0U;
+  memset(dp->ch, 0, sizeof(dp->ch));
+}
+
+/*
+ * Feeds n interleaved sample sets and writes the decimated Q15 sets to out,
+ * which must hold adcdecimOutSets(config, n) sets. Returns the number of
+ * sets written.
+ */
+size_t adcdecimProcess(adcdecim_t *dp, const adcsample_t *buf, size_t n,
+                       int16_t *out) {
+  const adcdecim_config_t *cfg = dp->config;
+  unsigned nch = dp->nch, order = cfg->order, taps = cfg->taps;
+  uint32_t r = (uint32_t)1U << cfg->log2r;
+  uint32_t cicphase = dp->cicphase;
+  uint16_t firphase = dp->firphase, pos = dp->pos;
+  size_t k = 0;
+
+  for (unsigned c = 0; c < nch; c++) {
+    adcdecim_chan_t *chp = &dp->ch[c];
+    const adcsample_t *p = buf + c;
+
+    cicphase = dp->cicphase;
+    firphase = dp->firphase;
+    pos = dp->pos;
+    k = 0;
+
+    for (size_t i = 0; i < n; i++) {
+      uint32_t v = *p;
+      int16_t q;
+
+      p += nch;
+
+      if (order > 0U) {
+        for (unsigned s = 0; s < order; s++) {
+          chp->integ[s] += v;
+          v = chp->integ[s];
+        }
+        if (++cicphase < r) {
+          continue;
+        }
+        cicphase = 0U;
+        for (unsigned s = 0; s < order; s++) {
+          uint32_t t = v;
+
+          v -= chp->comb[s];
+          chp->comb[s] = t;
+        }
+      }
+      q = (int16_t)(dp->shift >= 0 ? v >> dp->shift : v << -dp->shift);
+
+      pos = (pos == 0U) ? (uint16_t)(taps - 1U) : (uint16_t)(pos - 1U);
+      chp->delay[pos] = q;
+      chp->delay[pos + taps] = q;
+      if (++firphase < cfg->m) {
+        continue;
+      }
+      firphase = 0U;
+
+      out[k * nch + c] = firDot(&chp->delay[pos], cfg->coeffs, taps);
+      k++;
+    }
+  }
+
+  dp->cicphase = cicphase;
+  dp->firphase = firphase;
+  dp->pos = pos;
+
+  return k;
+}
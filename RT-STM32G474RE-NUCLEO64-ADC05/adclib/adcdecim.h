@@ -0,0 +1,114 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef __ADCDECIM_H__
+#define __ADCDECIM_H__
+
+#include "hal.h"
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Highest CIC order supported.
+ */
+#if !defined(ADCDECIM_CIC_MAX_ORDER)
+#define ADCDECIM_CIC_MAX_ORDER          5
+#endif
+
+/**
+ * @brief   Longest FIR supported, sizes the per-channel delay lines.
+ */
+#if !defined(ADCDECIM_FIR_MAX_TAPS)
+#define ADCDECIM_FIR_MAX_TAPS           64
+#endif
+
+/**
+ * @brief   Channels handled by one pipeline object.
+ */
+#if !defined(ADCDECIM_MAX_CHANNELS)
+#define ADCDECIM_MAX_CHANNELS           4
+#endif
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+/* Input samples are 12 bits wide, the CIC registers are 32 bits wide.*/
+#define ADCDECIM_INPUT_BITS             12
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/*
+ * Pipeline: CIC of the given order decimating by 2^log2r, then a Q15 FIR
+ * decimating by m. Order 0 bypasses the CIC, the FIR alone then works as a
+ * polyphase decimator with any ratio. The FIR taps should have a DC gain of
+ * 32768, see cicfir.py for compensating designs.
+ */
+typedef struct {
+    uint8_t order;
+    uint8_t log2r;
+    uint16_t m;
+    uint16_t taps;
+    const int16_t *coeffs;
+} adcdecim_config_t;
+
+typedef struct {
+    /* Modulo 2^32 arithmetic, exact while the bit growth fits.*/
+    uint32_t integ[ADCDECIM_CIC_MAX_ORDER];
+    uint32_t comb[ADCDECIM_CIC_MAX_ORDER];
+    /* Mirrored delay line, the last taps samples are contiguous.*/
+    int16_t delay[2 * ADCDECIM_FIR_MAX_TAPS];
+} adcdecim_chan_t;
+
+typedef struct {
+    const adcdecim_config_t *config;
+    unsigned nch;
+    int shift;
+    uint32_t cicphase;
+    uint16_t firphase;
+    uint16_t pos;
+    adcdecim_chan_t ch[ADCDECIM_MAX_CHANNELS];
+} adcdecim_t;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/* Overall decimation ratio. */
+#define adcdecimRatio(cfg)              (((uint32_t)1U << (cfg)->log2r) * (cfg)->m)
+
+/* Upper bound of the output sets produced from n input sets. */
+#define adcdecimOutSets(cfg, n)         ((n) / adcdecimRatio(cfg) + 1U)
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  bool adcdecimInit(adcdecim_t *dp, const adcdecim_config_t *config,
+                    unsigned nch);
+  void adcdecimReset(adcdecim_t *dp);
+  size_t adcdecimProcess(adcdecim_t *dp, const adcsample_t *buf, size_t n,
+                         int16_t *out);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADCDECIM_H__ */
@@ -0,0 +1,275 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Integer kernels for interleaved ADC blocks, sample set i of channel c is
+ * buf[i * nch + c]. The SIMD versions read two 16-bit samples per word:
+ * single channel blocks are used as they are, with an even number of
+ * channels PKHBT/PKHTB regroup two consecutive sets of a channel pair into
+ * one word per channel. Each word then costs one SMLAD for the sum, one
+ * SMLALD for the sum of squares and USUB16/SEL pairs for min and max.
+ * SMLAD and SMLALD take the halfwords as signed, so the sums are only
+ * right below 0x8000: the words of a channel are ORed together and a
+ * channel that had a sample above 15 bits is summed again by the scalar
+ * path, min and max being unsigned already. Other layouts and unaligned
+ * buffers fall back to the C reference, the results are bit-exact in all
+ * cases, 12-bit and oversampled data up to 15 bits stay on SIMD.
+ */
+
+#include "adcdsp.h"
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static inline void accSample(adcdsp_acc_t *acc, adcsample_t x) {
+
+  acc->sum += x;
+  acc->sumsq += (uint32_t)x * x;
+  if (x < acc->min) {
+    acc->min = x;
+  }
+  if (x > acc->max) {
+    acc->max = x;
+  }
+}
+
+#if ADCDSP_USE_SIMD
+
+/* Two samples of one channel per lane, merged by lanesFlush(). */
+typedef struct {
+  uint32_t sum;
+  uint64_t sumsq;
+  uint32_t mn;
+  uint32_t mx;
+  /* All the words, bits 15 and 31 tell if the signed sums are wrong. */
+  uint32_t bits;
+} lanes_t;
+
+static inline void lanesInit(lanes_t *lp) {
+
+  lp->sum = 0U;
+  lp->sumsq = 0U;
+  lp->mn = 0xFFFFFFFFU;
+  lp->mx = 0U;
+  lp->bits = 0U;
+}
+
+static inline void lanesAdd(lanes_t *lp, uint32_t x) {
+
+  lp->sum = __SMLAD(x, 0x00010001U, lp->sum);
+  lp->sumsq = __SMLALD(x, x, lp->sumsq);
+  lp->bits |= x;
+  (void)__USUB16(x, lp->mn);
+  lp->mn = __SEL(lp->mn, x);
+  (void)__USUB16(x, lp->mx);
+  lp->mx = __SEL(x, lp->mx);
+}
+
+/*
+ * Merges the lanes of the samples p[0], p[stride], ... p[(n - 1) * stride]
+ * into acc, summing them again unsigned if one was above 15 bits.
+ */
+static inline void lanesFlush(const lanes_t *lp, adcdsp_acc_t *acc,
+                              const adcsample_t *p, size_t n,
+                              unsigned stride) {
+  adcsample_t lo, hi;
+
+  if ((lp->bits & 0x80008000U) == 0U) {
+    acc->sum += lp->sum;
+    acc->sumsq += lp->sumsq;
+  }
+  else {
+    for (size_t i = 0; i < n; i++) {
+      uint32_t x = p[i * stride];
+
+      acc->sum += x;
+      acc->sumsq += x * x;
+    }
+  }
+  lo = (adcsample_t)lp->mn;
+  hi = (adcsample_t)(lp->mn >> 16);
+  if (lo < acc->min) {
+    acc->min = lo;
+  }
+  if (hi < acc->min) {
+    acc->min = hi;
+  }
+  lo = (adcsample_t)lp->mx;
+  hi = (adcsample_t)(lp->mx >> 16);
+  if (lo > acc->max) {
+    acc->max = lo;
+  }
+  if (hi > acc->max) {
+    acc->max = hi;
+  }
+}
+
+static bool simdLayout(const void *p, unsigned nch) {
+
+  return (((uintptr_t)p & 3U) == 0U) && ((nch == 1U) || ((nch & 1U) == 0U));
+}
+
+static void accumulateSimd(const adcsample_t *buf, size_t n, unsigned nch,
+                           adcdsp_acc_t *acc) {
+  const uint32_t *wp = (const uint32_t *)(const void *)buf;
+  size_t pairs = n / 2U;
+  lanes_t a, b;
+
+  if (nch == 1U) {
+    lanesInit(&a);
+    for (size_t k = 0; k < pairs; k++) {
+      lanesAdd(&a, wp[k]);
+    }
+    lanesFlush(&a, &acc[0], buf, 2U * pairs, 1U);
+  }
+  else {
+    size_t stride = nch / 2U;
+
+    for (size_t j = 0; j < stride; j++) {
+      const uint32_t *cp = wp + j;
+
+      lanesInit(&a);
+      lanesInit(&b);
+      for (size_t k = 0; k < pairs; k++) {
+        uint32_t w0 = cp[0];
+        uint32_t w1 = cp[stride];
+
+        lanesAdd(&a, __PKHBT(w0, w1, 16));
+        lanesAdd(&b, __PKHTB(w1, w0, 16));
+        cp += 2U * stride;
+      }
+      lanesFlush(&a, &acc[2U * j], buf + 2U * j, 2U * pairs, nch);
+      lanesFlush(&b, &acc[2U * j + 1U], buf + 2U * j + 1U, 2U * pairs, nch);
+    }
+  }
+
+  /* Odd number of sets, the last one goes through the scalar path.*/
+  if ((n & 1U) != 0U) {
+    for (unsigned c = 0; c < nch; c++) {
+      accSample(&acc[c], buf[(n - 1U) * nch + c]);
+    }
+  }
+}
+
+static void deinterleaveSimd(const adcsample_t *buf, size_t n, unsigned nch,
+                             adcsample_t *const out[]) {
+  const uint32_t *wp = (const uint32_t *)(const void *)buf;
+  size_t pairs = n / 2U;
+
+  if (nch == 1U) {
+    uint32_t *op = (uint32_t *)(void *)out[0];
+
+    for (size_t k = 0; k < pairs; k++) {
+      op[k] = wp[k];
+    }
+  }
+  else {
+    size_t stride = nch / 2U;
+
+    for (size_t j = 0; j < stride; j++) {
+      const uint32_t *cp = wp + j;
+      uint32_t *ap = (uint32_t *)(void *)out[2U * j];
+      uint32_t *bp = (uint32_t *)(void *)out[2U * j + 1U];
+
+      for (size_t k = 0; k < pairs; k++) {
+        uint32_t w0 = cp[0];
+        uint32_t w1 = cp[stride];
+
+        ap[k] = __PKHBT(w0, w1, 16);
+        bp[k] = __PKHTB(w1, w0, 16);
+        cp += 2U * stride;
+      }
+    }
+  }
+
+  if ((n & 1U) != 0U) {
+    for (unsigned c = 0; c < nch; c++) {
+      out[c][n - 1U] = buf[(n - 1U) * nch + c];
+    }
+  }
+}
+
+#endif /* ADCDSP_USE_SIMD */
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+void adcdspAccInit(adcdsp_acc_t *acc, unsigned nch) {
+
+  for (unsigned c = 0; c < nch; c++) {
+    acc[c].sum = 0U;
+    acc[c].sumsq = 0U;
+    acc[c].min = (adcsample_t)~0U;
+    acc[c].max = 0U;
+  }
+}
+
+/*
+ * Adds n sample sets to the per-channel sum, sum of squares, min and max.
+ * Blocks can be accumulated one after the other, sum holds 2^20 full scale
+ * 12-bit samples before wrapping.
+ */
+void adcdspAccumulate(const adcsample_t *buf, size_t n, unsigned nch,
+                      adcdsp_acc_t *acc) {
+
+#if ADCDSP_USE_SIMD
+  if (simdLayout(buf, nch)) {
+    accumulateSimd(buf, n, nch, acc);
+    return;
+  }
+#endif
+  adcdspAccumulateRef(buf, n, nch, acc);
+}
+
+/* Splits n sample sets into nch arrays of n samples each. */
+void adcdspDeinterleave(const adcsample_t *buf, size_t n, unsigned nch,
+                        adcsample_t *const out[]) {
+
+#if ADCDSP_USE_SIMD
+  if (simdLayout(buf, nch)) {
+    bool aligned = true;
+
+    for (unsigned c = 0; c < nch; c++) {
+      aligned = aligned && (((uintptr_t)out[c] & 3U) == 0U);
+    }
+    if (aligned) {
+      deinterleaveSimd(buf, n, nch, out);
+      return;
+    }
+  }
+#endif
+  adcdspDeinterleaveRef(buf, n, nch, out);
+}
+
+void adcdspAccumulateRef(const adcsample_t *buf, size_t n, unsigned nch,
+                         adcdsp_acc_t *acc) {
+
+  for (size_t i = 0; i < n; i++) {
+    for (unsigned c = 0; c < nch; c++) {
+      accSample(&acc[c], *buf++);
+    }
+  }
+}
+
+void adcdspDeinterleaveRef(const adcsample_t *buf, size_t n, unsigned nch,
+                           adcsample_t *const out[]) {
+
+  for (size_t i = 0; i < n; i++) {
+    for (unsigned c = 0; c < nch; c++) {
+      out[c][i] = *buf++;
+    }
+  }
+}
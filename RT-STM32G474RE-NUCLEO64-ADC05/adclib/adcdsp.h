@@ -0,0 +1,68 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef __ADCDSP_H__
+#define __ADCDSP_H__
+
+#include "hal.h"
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Uses the Cortex-M4 SIMD instructions when the core has them.
+ * @note    The C reference kernels are always built, for checking.
+ */
+#if !defined(ADCDSP_USE_SIMD)
+#if defined(__ARM_FEATURE_DSP)
+#define ADCDSP_USE_SIMD                 TRUE
+#else
+#define ADCDSP_USE_SIMD                 FALSE
+#endif
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/* Running per-channel figures, see adcdspAccInit(). */
+typedef struct {
+    uint32_t sum;
+    uint64_t sumsq;
+    adcsample_t min;
+    adcsample_t max;
+} adcdsp_acc_t;
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void adcdspAccInit(adcdsp_acc_t *acc, unsigned nch);
+  void adcdspAccumulate(const adcsample_t *buf, size_t n, unsigned nch,
+                        adcdsp_acc_t *acc);
+  void adcdspDeinterleave(const adcsample_t *buf, size_t n, unsigned nch,
+                          adcsample_t *const out[]);
+  void adcdspAccumulateRef(const adcsample_t *buf, size_t n, unsigned nch,
+                           adcdsp_acc_t *acc);
+  void adcdspDeinterleaveRef(const adcsample_t *buf, size_t n, unsigned nch,
+                             adcsample_t *const out[]);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADCDSP_H__ */
@@ -0,0 +1,111 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "adcerr.h"
+
+#include <string.h>
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static void recordI(adcerr_t *ep, adcerror_t err, eventflags_t flags) {
+
+  ep->cnt.lasterr = err;
+  ep->cnt.lastflags = flags;
+  ep->cnt.lasttime = chVTGetSystemTimeX();
+  chEvtBroadcastFlagsI(&ep->es, flags);
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+void adcerrObjectInit(adcerr_t *ep, ADCDriver *adcp) {
+
+  ep->adcp = adcp;
+  memset(&ep->cnt, 0, sizeof(ep->cnt));
+  chEvtObjectInit(&ep->es);
+}
+
+/* Causes of a HAL error code, watchdog events are not errors. */
+eventflags_t adcerrClassify(adcerror_t err) {
+  eventflags_t flags = 0U;
+
+  if ((err & ADC_ERR_DMAFAILURE) != 0U) {
+    flags |= ADCERR_FLAG_DMA;
+  }
+  if ((err & ADC_ERR_OVERFLOW) != 0U) {
+    flags |= ADCERR_FLAG_OVERFLOW;
+  }
+  if ((err & ~(adcerror_t)(ADC_ERR_DMAFAILURE | ADC_ERR_OVERFLOW |
+                           ADC_ERR_AWD1 | ADC_ERR_AWD2 |
+                           ADC_ERR_AWD3)) != 0U) {
+    flags |= ADCERR_FLAG_OTHER;
+  }
+  return flags;
+}
+
+/*
+ * Records a HAL error code from an error callback, returns its causes.
+ * Called from a lock zone.
+ */
+eventflags_t adcerrReportI(adcerr_t *ep, adcerror_t err) {
+  eventflags_t flags = adcerrClassify(err);
+
+  if (flags == 0U) {
+    return 0U;
+  }
+
+  ep->cnt.errors++;
+  if ((flags & ADCERR_FLAG_DMA) != 0U) {
+    ep->cnt.dma++;
+  }
+  if ((flags & ADCERR_FLAG_OVERFLOW) != 0U) {
+    ep->cnt.overflows++;
+  }
+  if ((flags & ADCERR_FLAG_OTHER) != 0U) {
+    ep->cnt.other++;
+  }
+  recordI(ep, err, flags);
+  return flags;
+}
+
+/* Records blocks lost by a slow consumer. Called from a lock zone. */
+void adcerrOverrunI(adcerr_t *ep, uint32_t blocks) {
+
+  ep->cnt.overruns += blocks;
+  recordI(ep, 0U, ADCERR_FLAG_OVERRUN);
+}
+
+/* Records a restart after an error. Called from a lock zone. */
+void adcerrRestartI(adcerr_t *ep) {
+
+  ep->cnt.restarts++;
+  chEvtBroadcastFlagsI(&ep->es, ADCERR_FLAG_RESTART);
+}
+
+void adcerrGet(adcerr_t *ep, adcerr_counters_t *cp) {
+
+  chSysLock();
+  *cp = ep->cnt;
+  chSysUnlock();
+}
+
+void adcerrReset(adcerr_t *ep) {
+
+  chSysLock();
+  memset(&ep->cnt, 0, sizeof(ep->cnt));
+  chSysUnlock();
+}
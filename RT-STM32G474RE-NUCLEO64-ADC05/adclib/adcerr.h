@@ -0,0 +1,108 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Error accounting of one ADC driver, shared by all the services using
+ * it. The error callbacks of stream, pool and watchdog report the HAL
+ * error codes, the stream also reports the blocks the DMA overwrote before
+ * they were read. Each report is classified, counted, timestamped and
+ * broadcast as event flags, so a thread can log the losses as they happen
+ * while the shell reads the totals.
+ */
+
+#ifndef __ADCERR_H__
+#define __ADCERR_H__
+
+#include "ch.h"
+#include "hal.h"
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/* Causes, also the event flags broadcast on each report. */
+/* DMA transfer error, the conversion is stopped. */
+#define ADCERR_FLAG_DMA                 ((eventflags_t)1U)
+/* ADC overrun, a result was overwritten before the DMA read it. */
+#define ADCERR_FLAG_OVERFLOW            ((eventflags_t)2U)
+/* Stream block overwritten before the consumer read it. */
+#define ADCERR_FLAG_OVERRUN             ((eventflags_t)4U)
+/* Any other error code. */
+#define ADCERR_FLAG_OTHER               ((eventflags_t)8U)
+/* The conversion was restarted after an error. */
+#define ADCERR_FLAG_RESTART             ((eventflags_t)16U)
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if !HAL_USE_ADC
+#error "ADC error accounting requires HAL_USE_ADC"
+#endif
+
+#if !CH_CFG_USE_EVENTS
+#error "ADC error accounting requires CH_CFG_USE_EVENTS"
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+typedef struct {
+    /* HAL error reports, all and by cause, a report can have more than
+       one cause. */
+    uint32_t errors;
+    uint32_t dma;
+    uint32_t overflows;
+    uint32_t other;
+    /* Stream blocks lost to overruns. */
+    uint32_t overruns;
+    uint32_t restarts;
+    /* Last report: HAL code, 0 for an overrun, causes and system time. */
+    adcerror_t lasterr;
+    eventflags_t lastflags;
+    systime_t lasttime;
+} adcerr_counters_t;
+
+typedef struct {
+    ADCDriver *adcp;
+    adcerr_counters_t cnt;
+    event_source_t es;
+} adcerr_t;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+#define adcerrGetEventSource(ep)        (&(ep)->es)
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void adcerrObjectInit(adcerr_t *ep, ADCDriver *adcp);
+  eventflags_t adcerrClassify(adcerror_t err);
+  eventflags_t adcerrReportI(adcerr_t *ep, adcerror_t err);
+  void adcerrOverrunI(adcerr_t *ep, uint32_t blocks);
+  void adcerrRestartI(adcerr_t *ep);
+  void adcerrGet(adcerr_t *ep, adcerr_counters_t *cp);
+  void adcerrReset(adcerr_t *ep);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADCERR_H__ */
@@ -0,0 +1,453 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "adcfft.h"
+#include "adcscope.h"
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+#define QUARTER                 (ADCFFT_TABLE_POINTS / 4U)
+#define SHIFT                   (15U - ADCFFT_SAMPLE_BITS)
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/* sin(2 pi i / 1024) in Q15, first quarter, 1.0 saturated. */
+static const int16_t sintab[QUARTER + 1U] = {
+  0, 201, 402, 603, 804, 1005, 1206, 1407,
+  1608, 1809, 2009, 2210, 2411, 2611, 2811, 3012,
+  3212, 3412, 3612, 3812, 4011, 4211, 4410, 4609,
+  4808, 5007, 5205, 5404, 5602, 5800, 5998, 6195,
+  6393, 6590, 6787, 6983, 7180, 7376, 7571, 7767,
+  7962, 8157, 8351, 8546, 8740, 8933, 9127, 9319,
+  9512, 9704, 9896, 10088, 10279, 10469, 10660, 10850,
+  11039, 11228, 11417, 11605, 11793, 11980, 12167, 12354,
+  12540, 12725, 12910, 13095, 13279, 13463, 13646, 13828,
+  14010, 14192, 14373, 14553, 14733, 14912, 15091, 15269,
+  15447, 15624, 15800, 15976, 16151, 16326, 16500, 16673,
+  16846, 17018, 17190, 17361, 17531, 17700, 17869, 18037,
+  18205, 18372, 18538, 18703, 18868, 19032, 19195, 19358,
+  19520, 19681, 19841, 20001, 20160, 20318, 20475, 20632,
+  20788, 20943, 21097, 21251, 21403, 21555, 21706, 21856,
+  22006, 22154, 22302, 22449, 22595, 22740, 22884, 23028,
+  23170, 23312, 23453, 23593, 23732, 23870, 24008, 24144,
+  24279, 24414, 24548, 24680, 24812, 24943, 25073, 25202,
+  25330, 25457, 25583, 25708, 25833, 25956, 26078, 26199,
+  26320, 26439, 26557, 26674, 26791, 26906, 27020, 27133,
+  27246, 27357, 27467, 27576, 27684, 27791, 27897, 28002,
+  28106, 28209, 28311, 28411, 28511, 28610, 28707, 28803,
+  28899, 28993, 29086, 29178, 29269, 29359, 29448, 29535,
+  29622, 29707, 29792, 29875, 29957, 30038, 30118, 30196,
+  30274, 30350, 30425, 30499, 30572, 30644, 30715, 30784,
+  30853, 30920, 30986, 31050, 31114, 31177, 31238, 31298,
+  31357, 31415, 31471, 31527, 31581, 31634, 31686, 31737,
+  31786, 31834, 31881, 31927, 31972, 32015, 32058, 32099,
+  32138, 32177, 32214, 32251, 32286, 32319, 32352, 32383,
+  32413, 32442, 32470, 32496, 32522, 32546, 32568, 32590,
+  32610, 32629, 32647, 32664, 32679, 32693, 32706, 32718,
+  32729, 32738, 32746, 32753, 32758, 32762, 32766, 32767,
+  32767
+};
+
+/* Flat top window terms in Q15, a0 - a1 cos + a2 cos2 - a3 cos3 + a4 cos4. */
+static const int32_t flattop[5] = {7064, 13652, 9085, 2739, 228};
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+/* sin(2 pi i / ADCFFT_TABLE_POINTS) in Q15. */
+static int32_t sinq15(uint32_t i) {
+  uint32_t r;
+
+  i &= ADCFFT_TABLE_POINTS - 1U;
+  r = i % QUARTER;
+  switch (i / QUARTER) {
+  case 0:
+    return sintab[r];
+  case 1:
+    return sintab[QUARTER - r];
+  case 2:
+    return -sintab[r];
+  default:
+    return -sintab[QUARTER - r];
+  }
+}
+
+static int32_t cosq15(uint32_t i) {
+
+  return sinq15(i + QUARTER);
+}
+
+static uint32_t isqrt32(uint32_t x) {
+  uint32_t r = 0U, bit = 1U << 30;
+
+  while (bit > x) {
+    bit >>= 2;
+  }
+  while (bit != 0U) {
+    if (x >= r + bit) {
+      x -= r + bit;
+      r = (r >> 1) + bit;
+    }
+    else {
+      r >>= 1;
+    }
+    bit >>= 2;
+  }
+  return r;
+}
+
+/* log2(x) in Q16, x > 0, one bit per squaring. */
+static int32_t log2q16(uint32_t x) {
+  int32_t e = 31, r;
+  uint32_t y;
+
+  while ((x >> e) == 0U) {
+    e--;
+  }
+  y = e >= 30 ? x >> (e - 30) : x << (30 - e);
+  r = e << 16;
+  for (int32_t b = 1 << 15; b != 0; b >>= 1) {
+    y = (uint32_t)(((uint64_t)y * y) >> 30);
+    if (y >= 0x80000000U) {
+      y >>= 1;
+      r += b;
+    }
+  }
+  return r;
+}
+
+static int16_t sat16(int32_t v) {
+
+  return (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+}
+
+static int16_t windowAt(const adcfft_t *fp, size_t i) {
+
+  return fp->win[i <= fp->n / 2U ? i : fp->n - i];
+}
+
+static void bitReverse(int16_t *x, size_t m) {
+  size_t j = 0U;
+
+  for (size_t i = 0U; i < m; i++) {
+    if (i < j) {
+      int16_t re = x[2U * i], im = x[2U * i + 1U];
+
+      x[2U * i] = x[2U * j];
+      x[2U * i + 1U] = x[2U * j + 1U];
+      x[2U * j] = re;
+      x[2U * j + 1U] = im;
+    }
+    size_t k = m >> 1;
+    while ((j & k) != 0U) {
+      j ^= k;
+      k >>= 1;
+    }
+    j |= k;
+  }
+}
+
+/*
+ * In place forward complex FFT of m = 2^log2m interleaved Q15 values,
+ * scaled by 1/m. Decimation in time on bit reversed input: in a group of
+ * 4l the quarters hold the sub-DFTs of the residues 0, 2, 1, 3 mod 4.
+ */
+static void cfft(int16_t *x, unsigned log2m) {
+  size_t m = (size_t)1U << log2m, l = 1U;
+
+  bitReverse(x, m);
+
+  if ((log2m & 1U) != 0U) {
+    for (size_t i = 0U; i < 2U * m; i += 4U) {
+      int32_t ar = x[i], ai = x[i + 1U], br = x[i + 2U], bi = x[i + 3U];
+
+      x[i] = (int16_t)((ar + br) >> 1);
+      x[i + 1U] = (int16_t)((ai + bi) >> 1);
+      x[i + 2U] = (int16_t)((ar - br) >> 1);
+      x[i + 3U] = (int16_t)((ai - bi) >> 1);
+    }
+    l = 2U;
+  }
+
+  for (; l < m; l <<= 2) {
+    uint32_t step = ADCFFT_TABLE_POINTS / (4U * l);
+
+    for (size_t k = 0U; k < l; k++) {
+      int32_t c1 = cosq15(k * step), s1 = sinq15(k * step);
+      int32_t c2 = cosq15(2U * k * step), s2 = sinq15(2U * k * step);
+      int32_t c3 = cosq15(3U * k * step), s3 = sinq15(3U * k * step);
+
+      for (size_t g = k; g < m; g += 4U * l) {
+        int16_t *p0 = &x[2U * g], *p2 = &x[2U * (g + l)];
+        int16_t *p1 = &x[2U * (g + 2U * l)], *p3 = &x[2U * (g + 3U * l)];
+        int32_t t1r, t1i, t2r, t2i, t3r, t3i, ar, ai, br, bi, sr, si, ur, ui;
+
+        /* Twiddles are exp(-j theta), (a + jb)(c - js).*/
+        t1r = (p1[0] * c1 + p1[1] * s1) >> 15;
+        t1i = (p1[1] * c1 - p1[0] * s1) >> 15;
+        t2r = (p2[0] * c2 + p2[1] * s2) >> 15;
+        t2i = (p2[1] * c2 - p2[0] * s2) >> 15;
+        t3r = (p3[0] * c3 + p3[1] * s3) >> 15;
+        t3i = (p3[1] * c3 - p3[0] * s3) >> 15;
+
+        ar = p0[0] + t2r;
+        ai = p0[1] + t2i;
+        br = p0[0] - t2r;
+        bi = p0[1] - t2i;
+        sr = t1r + t3r;
+        si = t1i + t3i;
+        ur = t1r - t3r;
+        ui = t1i - t3i;
+
+        p0[0] = (int16_t)((ar + sr) >> 2);
+        p0[1] = (int16_t)((ai + si) >> 2);
+        p1[0] = (int16_t)((ar - sr) >> 2);
+        p1[1] = (int16_t)((ai - si) >> 2);
+        /* X[k + l] = b - j u, X[k + 3l] = b + j u.*/
+        p2[0] = (int16_t)((br + ui) >> 2);
+        p2[1] = (int16_t)((bi - ur) >> 2);
+        p3[0] = (int16_t)((br - ui) >> 2);
+        p3[1] = (int16_t)((bi + ur) >> 2);
+      }
+    }
+  }
+}
+
+/*
+ * Spectrum of n reals from the n/2 points FFT of z[i] = x[2i] + j x[2i+1],
+ * scaled by one more 1/2. With A = (Z[k] + Z*[m-k]) / 2 and
+ * B = W^k (Z[k] - Z*[m-k]) / 2j: X[k] = A + B, X[m-k] = (A - B)*.
+ */
+static void realSplit(adcfft_t *fp) {
+  int16_t *x = fp->buf;
+  size_t m = fp->n / 2U;
+  uint32_t step = ADCFFT_TABLE_POINTS / fp->n;
+  int32_t a = x[0], b = x[1];
+
+  x[0] = sat16((a + b) >> 1);
+  x[1] = sat16((a - b) >> 1);
+
+  for (size_t k = 1U; k <= m / 2U; k++) {
+    int16_t *p = &x[2U * k], *q = &x[2U * (m - k)];
+    int32_t c = cosq15(k * step), s = sinq15(k * step);
+    int32_t er = p[0] + q[0], ei = p[1] - q[1];
+    int64_t fr = p[1] + q[1], fi = q[0] - p[0];
+    int32_t br = (int32_t)((fr * c + fi * s) >> 15);
+    int32_t bi = (int32_t)((fi * c - fr * s) >> 15);
+
+    p[0] = sat16((er + br) >> 2);
+    p[1] = sat16((ei + bi) >> 2);
+    q[0] = sat16((er - br) >> 2);
+    q[1] = sat16((bi - ei) >> 2);
+  }
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/* Returns false if n is not a power of two in 8..ADCFFT_MAX_POINTS. */
+bool adcfftInit(adcfft_t *fp, size_t n, adcfft_window_t window) {
+  uint32_t step, sum = 0U;
+
+  if ((n < 8U) || (n > ADCFFT_MAX_POINTS) || ((n & (n - 1U)) != 0U)) {
+    return false;
+  }
+
+  fp->n = n;
+  fp->log2n = 0U;
+  while (((size_t)1U << fp->log2n) < n) {
+    fp->log2n++;
+  }
+  fp->window = window;
+  fp->fill = 0U;
+
+  step = ADCFFT_TABLE_POINTS / n;
+  for (size_t i = 0U; i <= n / 2U; i++) {
+    int32_t w;
+
+    switch (window) {
+    case ADCFFT_WIN_HANN:
+      w = (32768 - cosq15(i * step)) >> 1;
+      break;
+    case ADCFFT_WIN_FLATTOP:
+      w = flattop[0];
+      for (uint32_t h = 1U; h < 5U; h++) {
+        int32_t t = (flattop[h] * cosq15(h * i * step)) >> 15;
+
+        w += (h & 1U) != 0U ? -t : t;
+      }
+      break;
+    default:
+      w = 32767;
+      break;
+    }
+    fp->win[i] = (int16_t)(w > 32767 ? 32767 : w);
+  }
+
+  for (size_t i = 0U; i < n; i++) {
+    sum += (uint32_t)(int32_t)windowAt(fp, i);
+  }
+  fp->cg = sum / n;
+
+  return true;
+}
+
+/*
+ * Appends channel ch of up to n interleaved sample sets to the frame,
+ * returns the sets taken. The frame is complete when adcfftIsReady().
+ */
+size_t adcfftFeed(adcfft_t *fp, const adcsample_t *buf, size_t n,
+                  unsigned nch, unsigned ch) {
+  size_t take = fp->n - fp->fill;
+
+  if (n < take) {
+    take = n;
+  }
+  for (size_t i = 0U; i < take; i++) {
+    fp->buf[fp->fill + i] = (int16_t)buf[i * nch + ch];
+  }
+  fp->fill += take;
+
+  return take;
+}
+
+/*
+ * Transforms a complete frame in place and fills the n/2 + 1 magnitudes,
+ * the next adcfftFeed() starts a new frame.
+ */
+void adcfftCompute(adcfft_t *fp) {
+  int16_t *x = fp->buf;
+  size_t n = fp->n;
+  int32_t mean;
+  uint32_t sum = 0U;
+
+  osalDbgAssert(fp->fill == n, "frame not complete");
+
+  for (size_t i = 0U; i < n; i++) {
+    sum += (uint16_t)x[i];
+  }
+  mean = (int32_t)(sum / n);
+  for (size_t i = 0U; i < n; i++) {
+    int32_t v = ((int32_t)(uint16_t)x[i] - mean) * (1 << SHIFT);
+
+    x[i] = (int16_t)((v * windowAt(fp, i)) >> 15);
+  }
+
+  cfft(x, fp->log2n - 1U);
+  realSplit(fp);
+
+  fp->mag[0] = (uint16_t)(x[0] < 0 ? -x[0] : x[0]);
+  fp->mag[n / 2U] = (uint16_t)(x[1] < 0 ? -x[1] : x[1]);
+  for (size_t k = 1U; k < n / 2U; k++) {
+    uint32_t re = (uint32_t)(x[2U * k] < 0 ? -x[2U * k] : x[2U * k]);
+    uint32_t im = (uint32_t)(x[2U * k + 1U] < 0 ? -x[2U * k + 1U] :
+                                                  x[2U * k + 1U]);
+
+    fp->mag[k] = (uint16_t)isqrt32(re * re + im * im);
+  }
+  fp->fill = 0U;
+}
+
+/*
+ * Local maxima of the magnitudes, DC and Nyquist excluded, largest first.
+ * Returns the number of peaks written, at most maxn.
+ */
+size_t adcfftPeaks(const adcfft_t *fp, adcfft_peak_t *peaks, size_t maxn) {
+  const uint16_t *m = fp->mag;
+  size_t found = 0U;
+
+  for (size_t k = 1U; k < fp->n / 2U; k++) {
+    int32_t den, delta;
+    size_t j;
+
+    if ((m[k] <= m[k - 1U]) || (m[k] < m[k + 1U]) || (m[k] == 0U)) {
+      continue;
+    }
+    for (j = found; (j > 0U) && (peaks[j - 1U].mag < m[k]); j--) {
+      if (j < maxn) {
+        peaks[j] = peaks[j - 1U];
+      }
+    }
+    if (j >= maxn) {
+      continue;
+    }
+
+    /* Vertex of the parabola through the three bins, Q8.*/
+    den = 2 * (int32_t)m[k] - m[k - 1U] - m[k + 1U];
+    delta = den != 0 ? (((int32_t)m[k + 1U] - m[k - 1U]) * 128) / den : 0;
+    peaks[j].bin = (uint32_t)((int32_t)(k << 8) + delta);
+    peaks[j].mag = m[k];
+    if (found < maxn) {
+      found++;
+    }
+  }
+  return found;
+}
+
+/* Amplitude in counts, Q8, of a tone with the given peak magnitude. */
+uint32_t adcfftAmplitude(const adcfft_t *fp, uint32_t mag) {
+
+  return (uint32_t)(((uint64_t)mag << (ADCFFT_SAMPLE_BITS + 9U)) / fp->cg);
+}
+
+/* Tenths of dB of a peak against a full scale sine, -1200 for silence. */
+int32_t adcfftDbfs(const adcfft_t *fp, uint32_t mag) {
+  uint32_t amp = adcfftAmplitude(fp, mag);
+  int32_t l2;
+
+  if (amp == 0U) {
+    return -1200;
+  }
+  l2 = log2q16(amp) - (int32_t)((ADCFFT_SAMPLE_BITS + 7U) << 16);
+  return (int32_t)(((int64_t)l2 * 60206) / (1000 << 16));
+}
+
+/*
+ * Writes the packet of the last spectrum to out, which must hold
+ * ADCFFT_PACKET_SIZE(n) bytes. Returns the packet size.
+ */
+size_t adcfftPack(const adcfft_t *fp, uint32_t seq, uint32_t rate,
+                  uint8_t *out) {
+  uint8_t *q = out;
+  uint16_t crc;
+
+  *q++ = ADCFFT_SYNC0;
+  *q++ = ADCFFT_SYNC1;
+  *q++ = (uint8_t)fp->log2n;
+  *q++ = (uint8_t)fp->window;
+  for (unsigned i = 0U; i < 4U; i++) {
+    *q++ = (uint8_t)(seq >> (8U * i));
+  }
+  for (unsigned i = 0U; i < 4U; i++) {
+    *q++ = (uint8_t)(rate >> (8U * i));
+  }
+  *q++ = (uint8_t)fp->cg;
+  *q++ = (uint8_t)(fp->cg >> 8);
+  for (size_t k = 0U; k <= fp->n / 2U; k++) {
+    *q++ = (uint8_t)fp->mag[k];
+    *q++ = (uint8_t)(fp->mag[k] >> 8);
+  }
+
+  crc = adcscopeCrc16(0xFFFFU, out + 2, (size_t)(q - out) - 2U);
+  *q++ = (uint8_t)crc;
+  *q++ = (uint8_t)(crc >> 8);
+
+  return (size_t)(q - out);
+}
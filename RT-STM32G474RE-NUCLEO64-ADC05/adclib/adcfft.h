@@ -0,0 +1,143 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Q15 real FFT of one channel of the ADC blocks, integer only and without
+ * dynamic allocation. A frame of n samples is collected across blocks by
+ * adcfftFeed(), adcfftCompute() removes the mean, applies the window and
+ * runs a radix-4 complex FFT of n/2 points, with one radix-2 stage when
+ * log2(n/2) is odd, followed by the real split. Each stage is scaled so
+ * nothing saturates, the spectrum is the DFT divided by n.
+ *
+ * Binary spectrum packet, little endian:
+ *   0xA5 0x5B | log2n u8 | window u8 | seq u32 | rate u32 | cg u16 |
+ *   mag u16 * (n/2 + 1) | crc u16
+ * The CRC is adcscopeCrc16() over everything after the sync bytes. The
+ * amplitude of a tone in counts is mag * 2^(ADCFFT_SAMPLE_BITS + 1) / cg.
+ */
+
+#ifndef __ADCFFT_H__
+#define __ADCFFT_H__
+
+#include "ch.h"
+#include "hal.h"
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/* Resolution of the twiddle table, the largest supported size. */
+#define ADCFFT_TABLE_POINTS             1024U
+
+#define ADCFFT_SYNC0                    0xA5U
+#define ADCFFT_SYNC1                    0x5BU
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Largest FFT size, sets the size of adcfft_t.
+ */
+#if !defined(ADCFFT_MAX_POINTS)
+#define ADCFFT_MAX_POINTS               1024U
+#endif
+
+/**
+ * @brief   Resolution of the samples, full scale for adcfftDbfs().
+ */
+#if !defined(ADCFFT_SAMPLE_BITS)
+#define ADCFFT_SAMPLE_BITS              12U
+#endif
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if (ADCFFT_MAX_POINTS < 8U) || (ADCFFT_MAX_POINTS > ADCFFT_TABLE_POINTS) || \
+    ((ADCFFT_MAX_POINTS & (ADCFFT_MAX_POINTS - 1U)) != 0U)
+#error "ADCFFT_MAX_POINTS must be a power of two in 8..1024"
+#endif
+
+#if (ADCFFT_SAMPLE_BITS < 8U) || (ADCFFT_SAMPLE_BITS > 15U)
+#error "ADCFFT_SAMPLE_BITS must be in 8..15"
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+typedef enum {
+    ADCFFT_WIN_RECT = 0,
+    ADCFFT_WIN_HANN = 1,
+    /* Five terms flat top, accurate amplitudes, wide peaks. */
+    ADCFFT_WIN_FLATTOP = 2
+} adcfft_window_t;
+
+typedef struct {
+    /* Bin in Q8, refined by parabolic interpolation. */
+    uint32_t bin;
+    uint16_t mag;
+} adcfft_peak_t;
+
+typedef struct {
+    size_t n;
+    unsigned log2n;
+    adcfft_window_t window;
+    /* Coherent gain of the window, Q15. */
+    uint32_t cg;
+    /* Samples collected in the current frame. */
+    size_t fill;
+    /* Periodic window, symmetric, first half. */
+    int16_t win[ADCFFT_MAX_POINTS / 2U + 1U];
+    /* Frame, then packed spectrum: X[0], X[n/2] real, X[1]... */
+    int16_t buf[ADCFFT_MAX_POINTS];
+    uint16_t mag[ADCFFT_MAX_POINTS / 2U + 1U];
+} adcfft_t;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+#define ADCFFT_PACKET_SIZE(n)           (14U + 2U * ((n) / 2U + 1U) + 2U)
+
+#define adcfftIsReady(fp)               ((fp)->fill == (fp)->n)
+#define adcfftReset(fp)                 ((fp)->fill = 0U)
+#define adcfftGetBins(fp)               ((fp)->n / 2U + 1U)
+
+/* Frequency in Hz of a Q8 bin at a sample rate. */
+#define adcfftBinHz(fp, bin, rate)                                          \
+  ((uint32_t)(((uint64_t)(bin) * (rate) / (fp)->n) >> 8))
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  bool adcfftInit(adcfft_t *fp, size_t n, adcfft_window_t window);
+  size_t adcfftFeed(adcfft_t *fp, const adcsample_t *buf, size_t n,
+                    unsigned nch, unsigned ch);
+  void adcfftCompute(adcfft_t *fp);
+  size_t adcfftPeaks(const adcfft_t *fp, adcfft_peak_t *peaks, size_t maxn);
+  uint32_t adcfftAmplitude(const adcfft_t *fp, uint32_t mag);
+  int32_t adcfftDbfs(const adcfft_t *fp, uint32_t mag);
+  size_t adcfftPack(const adcfft_t *fp, uint32_t seq, uint32_t rate,
+                    uint8_t *out);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADCFFT_H__ */
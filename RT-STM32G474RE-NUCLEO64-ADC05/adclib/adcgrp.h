@@ -0,0 +1,294 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Compile-time builder for ADCv3 conversion groups. A sequence is a list
+ * of ADCGRP_CH(channel, sample time) entries, the builder expands it into
+ * the num_channels, smpr[] and sqr[] initializers, so the group stays a
+ * constant in flash. The checks are _Static_assert at file scope: entries
+ * in range, sequence conversion time within the trigger period and the
+ * pin of a channel.
+ *
+ * Usage:
+ *   #define MY_SEQ  ADCGRP_CH(ADC_CHANNEL_IN1, ADC_SMPR_SMP_24P5), \
+ *                   ADCGRP_CH(ADC_CHANNEL_IN2, ADC_SMPR_SMP_24P5)
+ *   ADCGRP_STATIC_ASSERT_RATE(1000000U, 50U, MY_SEQ);
+ *   ADCGRP_STATIC_ASSERT_PIN(1, IN1, A, 0);
+ *
+ *   static const ADCConversionGroup mygrp = {
+ *     ADCGRP_SEQUENCE(MY_SEQ),
+ *     .cfgr = ADCGRP_TRIGGER(TIM4_TRGO),
+ *     ...
+ *   };
+ *
+ *   palSetLineMode(ADCGRP_LINE(1, IN1), PAL_MODE_INPUT_ANALOG);
+ *
+ * A channel repeated in a sequence must use the same sample time.
+ */
+
+#ifndef __ADCGRP_H__
+#define __ADCGRP_H__
+
+#include "hal.h"
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   ADC kernel clock in Hz, used by the rate checks.
+ * @note    The default matches STM32_ADC_ADC12_CLOCK_MODE set to
+ *          ADC_CCR_CKMODE_AHB_DIV4 in mcuconf.h.
+ */
+#if !defined(ADCGRP_ADCCLK)
+#define ADCGRP_ADCCLK                   (STM32_HCLK / 4U)
+#endif
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/* Maximum length of a regular sequence.*/
+#define ADCGRP_MAX_CHANNELS             16
+
+/* Padding entry of the unused sequence slots.*/
+#define ADCGRP_NONE                     0xFFFFU
+
+/* Mode bits for the cfgr field.*/
+#define ADCGRP_SOFTWARE                 0U
+#define ADCGRP_CONTINUOUS               ADC_CFGR_CONT
+
+/* ADC12 regular EXTSEL values, RM0440 table 163.*/
+#define ADCGRP_EXTSEL_TIM1_CC1          0U
+#define ADCGRP_EXTSEL_TIM1_CC2          1U
+#define ADCGRP_EXTSEL_TIM1_CC3          2U
+#define ADCGRP_EXTSEL_TIM2_CC2          3U
+#define ADCGRP_EXTSEL_TIM3_TRGO         4U
+#define ADCGRP_EXTSEL_TIM4_CC4          5U
+#define ADCGRP_EXTSEL_EXTI11            6U
+#define ADCGRP_EXTSEL_TIM8_TRGO         7U
+#define ADCGRP_EXTSEL_TIM8_TRGO2        8U
+#define ADCGRP_EXTSEL_TIM1_TRGO         9U
+#define ADCGRP_EXTSEL_TIM1_TRGO2        10U
+#define ADCGRP_EXTSEL_TIM2_TRGO         11U
+#define ADCGRP_EXTSEL_TIM4_TRGO         12U
+#define ADCGRP_EXTSEL_TIM6_TRGO         13U
+#define ADCGRP_EXTSEL_TIM15_TRGO        14U
+#define ADCGRP_EXTSEL_TIM3_CC4          15U
+
+/* ADC12 injected JEXTSEL values, RM0440 table 164.*/
+#define ADCGRP_JEXTSEL_TIM1_TRGO        0U
+#define ADCGRP_JEXTSEL_TIM1_CC4         1U
+#define ADCGRP_JEXTSEL_TIM2_TRGO        2U
+#define ADCGRP_JEXTSEL_TIM2_CC1         3U
+#define ADCGRP_JEXTSEL_TIM3_CC4         4U
+#define ADCGRP_JEXTSEL_TIM4_TRGO        5U
+#define ADCGRP_JEXTSEL_EXTI15           6U
+#define ADCGRP_JEXTSEL_TIM8_CC4         7U
+#define ADCGRP_JEXTSEL_TIM1_TRGO2       8U
+#define ADCGRP_JEXTSEL_TIM8_TRGO        9U
+#define ADCGRP_JEXTSEL_TIM8_TRGO2       10U
+#define ADCGRP_JEXTSEL_TIM3_CC3         11U
+#define ADCGRP_JEXTSEL_TIM3_TRGO        12U
+#define ADCGRP_JEXTSEL_TIM3_CC1         13U
+#define ADCGRP_JEXTSEL_TIM6_TRGO        14U
+#define ADCGRP_JEXTSEL_TIM15_TRGO       15U
+
+/*
+ * Pins of the external channels, LQFP64 package. Internal channels have
+ * no entry, so ADCGRP_LINE() does not compile for them.
+ */
+#define ADCGRP_ADC1_IN1                 A, 0
+#define ADCGRP_ADC1_IN2                 A, 1
+#define ADCGRP_ADC1_IN3                 A, 2
+#define ADCGRP_ADC1_IN4                 A, 3
+#define ADCGRP_ADC1_IN5                 B, 14
+#define ADCGRP_ADC1_IN6                 C, 0
+#define ADCGRP_ADC1_IN7                 C, 1
+#define ADCGRP_ADC1_IN8                 C, 2
+#define ADCGRP_ADC1_IN9                 C, 3
+#define ADCGRP_ADC1_IN10                F, 0
+#define ADCGRP_ADC1_IN11                B, 12
+#define ADCGRP_ADC1_IN12                B, 1
+#define ADCGRP_ADC1_IN14                B, 11
+#define ADCGRP_ADC1_IN15                B, 0
+
+#define ADCGRP_ADC2_IN1                 A, 0
+#define ADCGRP_ADC2_IN2                 A, 1
+#define ADCGRP_ADC2_IN3                 A, 6
+#define ADCGRP_ADC2_IN4                 A, 7
+#define ADCGRP_ADC2_IN5                 C, 4
+#define ADCGRP_ADC2_IN6                 C, 0
+#define ADCGRP_ADC2_IN7                 C, 1
+#define ADCGRP_ADC2_IN8                 C, 2
+#define ADCGRP_ADC2_IN9                 C, 3
+#define ADCGRP_ADC2_IN10                F, 1
+#define ADCGRP_ADC2_IN11                C, 5
+#define ADCGRP_ADC2_IN12                B, 2
+#define ADCGRP_ADC2_IN13                A, 5
+#define ADCGRP_ADC2_IN14                B, 11
+#define ADCGRP_ADC2_IN15                B, 15
+#define ADCGRP_ADC2_IN17                A, 4
+
+#define ADCGRP_ADC3_IN1                 B, 1
+#define ADCGRP_ADC3_IN5                 B, 13
+#define ADCGRP_ADC3_IN12                B, 0
+
+#define ADCGRP_ADC4_IN3                 B, 12
+#define ADCGRP_ADC4_IN4                 B, 14
+#define ADCGRP_ADC4_IN5                 B, 15
+
+#define ADCGRP_PORT_A                   0U
+#define ADCGRP_PORT_B                   1U
+#define ADCGRP_PORT_C                   2U
+#define ADCGRP_PORT_D                   3U
+#define ADCGRP_PORT_E                   4U
+#define ADCGRP_PORT_F                   5U
+#define ADCGRP_PORT_G                   6U
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/* Sequence entry, channel ADC_CHANNEL_INx and sample time ADC_SMPR_SMP_xxx.*/
+#define ADCGRP_CH(ch, smp)              ((uint32_t)(ch) | ((uint32_t)(smp) << 8))
+
+#define ADCGRP_CHN(e)                   ((uint32_t)(e) & 0xFFU)
+#define ADCGRP_SMP(e)                   (((uint32_t)(e) >> 8) & 0xFFU)
+#define ADCGRP_USED(e)                  ((uint32_t)(e) != ADCGRP_NONE)
+
+/* Conversion time of an entry in half ADC clock cycles, SMP + 12.5.*/
+#define ADCGRP_HALFCYCLES(e)                                                \
+  (!ADCGRP_USED(e) ? 0U :                                                   \
+   (ADCGRP_SMP(e) == 0U ? 5U   : ADCGRP_SMP(e) == 1U ? 13U  :               \
+    ADCGRP_SMP(e) == 2U ? 25U  : ADCGRP_SMP(e) == 3U ? 49U  :               \
+    ADCGRP_SMP(e) == 4U ? 95U  : ADCGRP_SMP(e) == 5U ? 185U :               \
+    ADCGRP_SMP(e) == 6U ? 495U : 1281U) + 25U)
+
+/* CFGR value for a rising edge hardware trigger, src is e.g. TIM4_TRGO.*/
+#define ADCGRP_TRIGGER(src)                                                 \
+  (ADC_CFGR_EXTEN_RISING | ADC_CFGR_EXTSEL_SRC(ADCGRP_EXTSEL_##src))
+
+/* JSQR trigger bits for a rising edge injected trigger, e.g. TIM6_TRGO.*/
+#define ADCGRP_JTRIGGER(src)                                                \
+  ((1U << ADC_JSQR_JEXTEN_Pos) |                                            \
+   (ADCGRP_JEXTSEL_##src << ADC_JSQR_JEXTSEL_Pos))
+
+/* PAL line of channel INx of ADC n, e.g. ADCGRP_LINE(1, IN7).*/
+#define ADCGRP_LINE(n, in)              ADCGRP_LINE_(ADCGRP_ADC##n##_##in)
+#define ADCGRP_LINE_(pin)               ADCGRP_LINE__(pin)
+#define ADCGRP_LINE__(port, pad)        PAL_LINE(GPIO##port, pad##U)
+
+#define ADCGRP_PINID(port, pad)         ((ADCGRP_PORT_##port << 4) | (pad##U))
+#define ADCGRP_PINID_(pin)              ADCGRP_PINID__(pin)
+#define ADCGRP_PINID__(port, pad)       ADCGRP_PINID(port, pad)
+
+/* Entry count, up to one more than the maximum so that it can be rejected.*/
+#define ADCGRP_NARGS(...)                                                   \
+  ADCGRP_NARGS_(__VA_ARGS__, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6,    \
+                5, 4, 3, 2, 1, 0)
+#define ADCGRP_NARGS_(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12,    \
+                      a13, a14, a15, a16, a17, n, ...) n
+
+/* Applies m(arg, e) to the 16 slots and joins the results with op.*/
+#define ADCGRP_FOLD(op, m, arg, e1, e2, e3, e4, e5, e6, e7, e8, e9, e10,    \
+                    e11, e12, e13, e14, e15, e16)                           \
+  (m(arg, e1) op m(arg, e2) op m(arg, e3) op m(arg, e4) op m(arg, e5) op    \
+   m(arg, e6) op m(arg, e7) op m(arg, e8) op m(arg, e9) op m(arg, e10) op   \
+   m(arg, e11) op m(arg, e12) op m(arg, e13) op m(arg, e14) op              \
+   m(arg, e15) op m(arg, e16))
+
+#define ADCGRP_PAD(...)                                                     \
+  __VA_ARGS__, ADCGRP_NONE, ADCGRP_NONE, ADCGRP_NONE, ADCGRP_NONE,          \
+  ADCGRP_NONE, ADCGRP_NONE, ADCGRP_NONE, ADCGRP_NONE, ADCGRP_NONE,          \
+  ADCGRP_NONE, ADCGRP_NONE, ADCGRP_NONE, ADCGRP_NONE, ADCGRP_NONE,          \
+  ADCGRP_NONE
+
+#define ADCGRP_SMPR_M(reg, e)                                               \
+  ((ADCGRP_USED(e) && (ADCGRP_CHN(e) / 10U == (reg))) ?                     \
+   ADCGRP_SMP(e) << (3U * (ADCGRP_CHN(e) % 10U)) : 0U)
+#define ADCGRP_HC_M(arg, e)             ADCGRP_HALFCYCLES(e)
+#define ADCGRP_VALID_M(arg, e)                                              \
+  (!ADCGRP_USED(e) || ((ADCGRP_CHN(e) <= 18U) && (ADCGRP_SMP(e) <= 7U)))
+#define ADCGRP_SQ(e, pos)               (ADCGRP_USED(e) ? ADCGRP_CHN(e) << (pos) : 0U)
+
+#define ADCGRP_SEQUENCE_(n, e1, e2, e3, e4, e5, e6, e7, e8, e9, e10, e11,   \
+                         e12, e13, e14, e15, e16, ...)                      \
+  .num_channels = (adc_channels_num_t)(n),                                  \
+  .smpr = {                                                                 \
+    ADCGRP_FOLD(|, ADCGRP_SMPR_M, 0U, e1, e2, e3, e4, e5, e6, e7, e8, e9,   \
+                e10, e11, e12, e13, e14, e15, e16),                         \
+    ADCGRP_FOLD(|, ADCGRP_SMPR_M, 1U, e1, e2, e3, e4, e5, e6, e7, e8, e9,   \
+                e10, e11, e12, e13, e14, e15, e16)                          \
+  },                                                                        \
+  .sqr = {                                                                  \
+    ADCGRP_SQ(e1, 6) | ADCGRP_SQ(e2, 12) | ADCGRP_SQ(e3, 18) |              \
+    ADCGRP_SQ(e4, 24),                                                      \
+    ADCGRP_SQ(e5, 0) | ADCGRP_SQ(e6, 6) | ADCGRP_SQ(e7, 12) |               \
+    ADCGRP_SQ(e8, 18) | ADCGRP_SQ(e9, 24),                                  \
+    ADCGRP_SQ(e10, 0) | ADCGRP_SQ(e11, 6) | ADCGRP_SQ(e12, 12) |            \
+    ADCGRP_SQ(e13, 18) | ADCGRP_SQ(e14, 24),                                \
+    ADCGRP_SQ(e15, 0) | ADCGRP_SQ(e16, 6)                                   \
+  }
+
+/*
+ * Designated initializers of num_channels, smpr[] and sqr[] for a list of
+ * ADCGRP_CH() entries. The driver adds the sequence length to SQR1.
+ */
+#define ADCGRP_SEQUENCE(...)                                                \
+  ADCGRP_SEQUENCE__(ADCGRP_NARGS(__VA_ARGS__), ADCGRP_PAD(__VA_ARGS__))
+#define ADCGRP_SEQUENCE__(...)          ADCGRP_SEQUENCE_(__VA_ARGS__)
+
+#define ADCGRP_SEQ_HALFCYCLES__(...)                                        \
+  ADCGRP_FOLD(+, ADCGRP_HC_M, 0U, __VA_ARGS__)
+#define ADCGRP_SEQ_HALFCYCLES_(e1, e2, e3, e4, e5, e6, e7, e8, e9, e10,     \
+                               e11, e12, e13, e14, e15, e16, ...)           \
+  ADCGRP_SEQ_HALFCYCLES__(e1, e2, e3, e4, e5, e6, e7, e8, e9, e10, e11,     \
+                          e12, e13, e14, e15, e16)
+#define ADCGRP_SEQ_HALFCYCLES_X(...)    ADCGRP_SEQ_HALFCYCLES_(__VA_ARGS__)
+
+/* Conversion time of a whole sequence in half ADC clock cycles.*/
+#define ADCGRP_SEQ_HALFCYCLES(...)                                          \
+  ADCGRP_SEQ_HALFCYCLES_X(ADCGRP_PAD(__VA_ARGS__))
+
+#define ADCGRP_SEQ_VALID_(e1, e2, e3, e4, e5, e6, e7, e8, e9, e10, e11,     \
+                          e12, e13, e14, e15, e16, ...)                     \
+  ADCGRP_FOLD(&&, ADCGRP_VALID_M, 0U, e1, e2, e3, e4, e5, e6, e7, e8, e9,   \
+              e10, e11, e12, e13, e14, e15, e16)
+#define ADCGRP_SEQ_VALID_X(...)         ADCGRP_SEQ_VALID_(__VA_ARGS__)
+
+/* Compile-time check of a sequence, at file scope.*/
+#define ADCGRP_STATIC_ASSERT_SEQ(...)                                       \
+  _Static_assert((ADCGRP_NARGS(__VA_ARGS__) <= ADCGRP_MAX_CHANNELS) &&      \
+                 ADCGRP_SEQ_VALID_X(ADCGRP_PAD(__VA_ARGS__)),               \
+                 "invalid ADC sequence")
+
+/*
+ * Compile-time check that the sequence converts within a trigger period of
+ * interval ticks of a timer clocked at timer_hz, at file scope.
+ */
+#define ADCGRP_STATIC_ASSERT_RATE(timer_hz, interval, ...)                  \
+  ADCGRP_STATIC_ASSERT_SEQ(__VA_ARGS__);                                    \
+  _Static_assert((uint64_t)ADCGRP_SEQ_HALFCYCLES(__VA_ARGS__) *             \
+                 (uint64_t)(timer_hz) <=                                    \
+                 2ULL * (uint64_t)ADCGRP_ADCCLK * (uint64_t)(interval),     \
+                 "ADC sequence longer than the trigger period")
+
+/* Compile-time check that channel INx of ADC n is on pin P<port><pad>.*/
+#define ADCGRP_STATIC_ASSERT_PIN(n, in, port, pad)                          \
+  _Static_assert(ADCGRP_PINID_(ADCGRP_ADC##n##_##in) ==                     \
+                 ADCGRP_PINID(port, pad),                                   \
+                 "ADC channel " #in " is not on P" #port #pad)
+
+#endif /* __ADCGRP_H__ */
@@ -0,0 +1,200 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * The timer update event that runs the callback is also the TRGO starting
+ * the next injected conversion, so the callback reads the rank converted
+ * by the previous trigger, finished by then. No ADC interrupt is needed,
+ * the HAL ISR clears the whole ISR register and would race with a JEOC
+ * based scheme.
+ */
+
+#include "adchk.h"
+
+#include <string.h>
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+static const uint32_t hkseq[ADCHK_NUM_CHANNELS] = {ADCHK_SEQ};
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static uint32_t jsqr(uint32_t jtrigger) {
+  static const uint8_t jsqpos[ADCHK_NUM_CHANNELS] = {
+    ADC_JSQR_JSQ1_Pos, ADC_JSQR_JSQ2_Pos, ADC_JSQR_JSQ3_Pos
+  };
+  uint32_t r = ((ADCHK_NUM_CHANNELS - 1U) << ADC_JSQR_JL_Pos) | jtrigger;
+
+  for (unsigned i = 0; i < ADCHK_NUM_CHANNELS; i++) {
+    r |= ADCGRP_CHN(hkseq[i]) << jsqpos[i];
+  }
+  return r;
+}
+
+/* Block averages of VREFINT and of the sensor go to the calibration. */
+static void publishBlock(ADCHkDriver *hp) {
+  const ADCHkConfig *config = hp->config;
+  uint32_t vref = 0U, ts = 0U;
+
+  for (size_t i = 0; i < ADCHK_BLOCK_SETS; i++) {
+    vref += hp->block[i * ADCHK_NUM_CHANNELS + ADCHK_VREFINT];
+    ts += hp->block[i * ADCHK_NUM_CHANNELS + ADCHK_TS];
+  }
+
+  if (config->calp != NULL) {
+    chSysLockFromISR();
+    adccalUpdateI(config->calp,
+                  (adcsample_t)((vref + ADCHK_BLOCK_SETS / 2U) / ADCHK_BLOCK_SETS),
+                  (adcsample_t)((ts + ADCHK_BLOCK_SETS / 2U) / ADCHK_BLOCK_SETS));
+    chSysUnlockFromISR();
+  }
+  if (config->statsp != NULL) {
+    adcstatsFeedFromISR(config->statsp, hp->block, ADCHK_BLOCK_SETS);
+  }
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+void adchkObjectInit(ADCHkDriver *hp) {
+
+  hp->state = ADCHK_STOP;
+  hp->config = NULL;
+  hp->sets = 0U;
+  memset(hp->last, 0, sizeof(hp->last));
+}
+
+/*
+ * Adds the injected mode bits and the housekeeping sample times to a
+ * regular group, the regular sequence must not use the internal channels.
+ */
+void adchkPatchGroup(ADCConversionGroup *grpp) {
+
+  grpp->cfgr |= ADC_CFGR_JQDIS | ADC_CFGR_JDISCEN;
+  for (unsigned i = 0; i < ADCHK_NUM_CHANNELS; i++) {
+    unsigned reg = ADCGRP_CHN(hkseq[i]) / 10U;
+
+    grpp->smpr[reg] |= ADCGRP_SMPR_M(reg, hkseq[i]);
+  }
+}
+
+/*
+ * Arms the injected sequence and starts the trigger timer. The regular
+ * group, patched by adchkPatchGroup(), must be running already.
+ */
+void adchkStart(ADCHkDriver *hp, const ADCHkConfig *config) {
+  ADC_TypeDef *adcm;
+
+  osalDbgCheck((hp != NULL) && (config != NULL) && (config->gptp != NULL));
+  osalDbgAssert(hp->state == ADCHK_STOP, "invalid state");
+
+  adcm = config->adcp->adcm;
+  osalDbgAssert((adcm->CFGR & (ADC_CFGR_JQDIS | ADC_CFGR_JDISCEN)) ==
+                (ADC_CFGR_JQDIS | ADC_CFGR_JDISCEN), "group not patched");
+
+  hp->config = config;
+  hp->rank = 0U;
+  hp->pending = false;
+  hp->fill = 0U;
+  hp->sets = 0U;
+
+  adcSTM32EnableVREF(config->adcp);
+  adcSTM32EnableTS(config->adcp);
+  adcSTM32EnableVBAT(config->adcp);
+
+  /* With JQDIS set JSQR is a plain register, written while JADSTART is 0.*/
+  adcm->JSQR = jsqr(config->jtrigger);
+  adcm->CR |= ADC_CR_JADSTART;
+
+  chSysLock();
+  hp->state = ADCHK_ACTIVE;
+  chSysUnlock();
+  gptStartContinuous(config->gptp, config->interval);
+}
+
+/*
+ * Stops the trigger and the injected conversions, before the regular group
+ * is stopped. The VBAT bridge is disconnected, it loads the battery.
+ */
+void adchkStop(ADCHkDriver *hp) {
+  const ADCHkConfig *config = hp->config;
+  ADC_TypeDef *adcm;
+
+  osalDbgCheck(hp != NULL);
+
+  if (hp->state != ADCHK_ACTIVE) {
+    return;
+  }
+
+  gptStopTimer(config->gptp);
+  chSysLock();
+  hp->state = ADCHK_STOP;
+  chSysUnlock();
+
+  adcm = config->adcp->adcm;
+  if ((adcm->CR & ADC_CR_JADSTART) != 0U) {
+    adcm->CR |= ADC_CR_JADSTP;
+    while ((adcm->CR & ADC_CR_JADSTP) != 0U) {
+    }
+  }
+  adcSTM32DisableVBAT(config->adcp);
+}
+
+/*
+ * To be called from the trigger timer callback, reads the rank converted
+ * at the previous trigger.
+ */
+void adchkServeTrigger(ADCHkDriver *hp) {
+  const volatile uint32_t *jdr;
+
+  if (hp->state != ADCHK_ACTIVE) {
+    return;
+  }
+  if (!hp->pending) {
+    /* First trigger, its conversion is starting now.*/
+    hp->pending = true;
+    return;
+  }
+
+  jdr = &hp->config->adcp->adcm->JDR1;
+  hp->cur[hp->rank] = (adcsample_t)jdr[hp->rank];
+  if (++hp->rank < ADCHK_NUM_CHANNELS) {
+    return;
+  }
+  hp->rank = 0U;
+
+  memcpy(&hp->block[hp->fill * ADCHK_NUM_CHANNELS], hp->cur, sizeof(hp->cur));
+  chSysLockFromISR();
+  memcpy(hp->last, hp->cur, sizeof(hp->last));
+  hp->sets++;
+  chSysUnlockFromISR();
+
+  if (++hp->fill == ADCHK_BLOCK_SETS) {
+    hp->fill = 0U;
+    publishBlock(hp);
+  }
+}
+
+/* Last complete set, indexed by ADCHK_VREFINT, ADCHK_TS and ADCHK_VBAT. */
+void adchkGet(ADCHkDriver *hp, adcsample_t *set) {
+
+  chSysLock();
+  memcpy(set, hp->last, sizeof(hp->last));
+  chSysUnlock();
+}
@@ -0,0 +1,153 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Housekeeping of ADC1 through injected conversions. A timer triggers the
+ * injected sequence VREFINT, temperature sensor, VBAT/3 in discontinuous
+ * mode, one channel per trigger, while the regular group keeps streaming
+ * by DMA: an injected conversion only delays the regular one it preempts.
+ * The results are read from the trigger timer callback, each complete set
+ * updates the calibration and every ADCHK_BLOCK_SETS sets are merged into
+ * a statistics object.
+ *
+ * The HAL has no injected API and rewrites CFGR and SMPRx at each regular
+ * start, the regular group must therefore be patched by adchkPatchGroup()
+ * and started before adchkStart(), and must not be restarted while the
+ * housekeeping runs.
+ */
+
+#ifndef __ADCHK_H__
+#define __ADCHK_H__
+
+#include "ch.h"
+#include "hal.h"
+
+#include "adcgrp.h"
+#include "adccal.h"
+#include "adcstats.h"
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/* Ranks of the injected sequence. */
+#define ADCHK_VREFINT                   0U
+#define ADCHK_TS                        1U
+#define ADCHK_VBAT                      2U
+#define ADCHK_NUM_CHANNELS              3U
+
+/* Sequence entries, sample times above the datasheet minimum of each. */
+#define ADCHK_SEQ                                                           \
+  ADCGRP_CH(ADCCAL_VREFINT_CHANNEL, ADC_SMPR_SMP_247P5),                    \
+  ADCGRP_CH(ADCCAL_TS_CHANNEL, ADC_SMPR_SMP_247P5),                         \
+  ADCGRP_CH(ADCCAL_VBAT_CHANNEL, ADC_SMPR_SMP_640P5)
+
+/* Longest injected conversion, a trigger converts a single channel. */
+#define ADCHK_SLOT_HALFCYCLES                                               \
+  ADCGRP_HALFCYCLES(ADCGRP_CH(ADCCAL_VBAT_CHANNEL, ADC_SMPR_SMP_640P5))
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Housekeeping sets per statistics block.
+ */
+#if !defined(ADCHK_BLOCK_SETS)
+#define ADCHK_BLOCK_SETS                16U
+#endif
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if !HAL_USE_ADC || !HAL_USE_GPT
+#error "ADC housekeeping requires HAL_USE_ADC and HAL_USE_GPT"
+#endif
+
+#if ADCHK_NUM_CHANNELS > ADCSTATS_MAX_CHANNELS
+#error "ADCSTATS_MAX_CHANNELS too small for the housekeeping"
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+typedef enum {
+    ADCHK_UNINIT = 0,
+    ADCHK_STOP = 1,
+    ADCHK_ACTIVE = 2
+} adchk_state_t;
+
+typedef struct {
+    ADCDriver *adcp;
+    /* Trigger timer, already started, its period in ticks and the JSQR
+       trigger bits, e.g. ADCGRP_JTRIGGER(TIM6_TRGO). */
+    GPTDriver *gptp;
+    gptcnt_t interval;
+    uint32_t jtrigger;
+    /* Optional layers fed with the results, NULL if unused. */
+    adccal_t *calp;
+    adcstats_t *statsp;
+} ADCHkConfig;
+
+typedef struct {
+    adchk_state_t state;
+    const ADCHkConfig *config;
+    /* Rank converted by the last trigger, and whether there was one. */
+    unsigned rank;
+    bool pending;
+    adcsample_t cur[ADCHK_NUM_CHANNELS];
+    /* Last complete set. */
+    adcsample_t last[ADCHK_NUM_CHANNELS];
+    adcsample_t block[ADCHK_BLOCK_SETS * ADCHK_NUM_CHANNELS];
+    size_t fill;
+    uint32_t sets;
+} ADCHkDriver;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/*
+ * True if a regular sequence of seq_halfcycles still completes within a
+ * trigger period of interval ticks at timer_hz when one housekeeping
+ * conversion preempts it.
+ */
+#define ADCHK_FITS(seq_halfcycles, timer_hz, interval)                      \
+  ((uint64_t)((seq_halfcycles) + ADCHK_SLOT_HALFCYCLES) *                   \
+   (uint64_t)(timer_hz) <=                                                  \
+   2ULL * (uint64_t)ADCGRP_ADCCLK * (uint64_t)(interval))
+
+#define adchkGetState(hp)               ((hp)->state)
+#define adchkGetSets(hp)                ((hp)->sets)
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void adchkObjectInit(ADCHkDriver *hp);
+  void adchkPatchGroup(ADCConversionGroup *grpp);
+  void adchkStart(ADCHkDriver *hp, const ADCHkConfig *config);
+  void adchkStop(ADCHkDriver *hp);
+  void adchkServeTrigger(ADCHkDriver *hp);
+  void adchkGet(ADCHkDriver *hp, adcsample_t *set);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADCHK_H__ */
@@ -0,0 +1,26 @@
+# ADC library PATH
+ADCLIBPATH = ./adclib
+
+# ADC library files.
+ADCLIBSRC = $(ADCLIBPATH)/adcstream.c \
+            $(ADCLIBPATH)/adcdsp.c \
+            $(ADCLIBPATH)/adcdecim.c \
+            $(ADCLIBPATH)/adcovs.c \
+            $(ADCLIBPATH)/adcawd.c \
+            $(ADCLIBPATH)/adcscope.c \
+            $(ADCLIBPATH)/adcstats.c \
+            $(ADCLIBPATH)/adcpool.c \
+            $(ADCLIBPATH)/adcfft.c \
+            $(ADCLIBPATH)/adccal.c \
+            $(ADCLIBPATH)/adchk.c \
+            $(ADCLIBPATH)/adctune.c \
+            $(ADCLIBPATH)/adcerr.c \
+            $(ADCLIBPATH)/adccap.c \
+            $(ADCLIBPATH)/adcscan.c \
+            $(ADCLIBPATH)/adcmix.c
+
+ADCLIBINC = $(ADCLIBPATH)
+
+# Shared variables
+ALLCSRC += $(ADCLIBSRC)
+ALLINC  += $(ADCLIBINC)
@@ -0,0 +1,393 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "adcmix.h"
+
+#include <string.h>
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+/* Lowest power of two k up to frames with k / frames at or above rate. */
+static unsigned conversions(const ADCMixConfig *config, gptcnt_t interval,
+                            unsigned frames, uint32_t rate) {
+  uint64_t freq = config->gptp->config->frequency;
+  unsigned k = 1U;
+
+  while ((k < frames) &&
+         (freq * k < (uint64_t)rate * frames * interval)) {
+    k <<= 1;
+  }
+  return k;
+}
+
+/* Entry converted by the idle ranks, the shortest sample time. */
+static uint32_t idleEntry(const ADCMixConfig *config) {
+  uint32_t e = config->channels[0].entry;
+
+  for (unsigned i = 1U; i < config->num_channels; i++) {
+    if (ADCGRP_SMP(config->channels[i].entry) < ADCGRP_SMP(e)) {
+      e = config->channels[i].entry;
+    }
+  }
+  return e;
+}
+
+static uint32_t rankEntry(const ADCMixDriver *mp, const ADCMixConfig *config,
+                          unsigned r) {
+
+  if (mp->rank[r] == ADCMIX_IDLE) {
+    return idleEntry(config);
+  }
+  return config->channels[mp->rank[r]].entry;
+}
+
+static void buildGroup(ADCMixDriver *mp, const ADCMixConfig *config) {
+  ADCConversionGroup *grpp = &mp->grp;
+  unsigned len = mp->frames * mp->width;
+
+  memset(grpp, 0, sizeof(*grpp));
+  grpp->num_channels = (adc_channels_num_t)len;
+  grpp->cfgr = config->cfgr;
+  if (mp->frames > 1U) {
+    grpp->cfgr |= ADC_CFGR_DISCEN |
+                  ((mp->width - 1U) << ADC_CFGR_DISCNUM_Pos);
+  }
+  grpp->tr1 = ADC_TR_DISABLED;
+  grpp->tr2 = ADC_TR_DISABLED;
+  grpp->tr3 = ADC_TR_DISABLED;
+  for (unsigned i = 0U; i < config->num_channels; i++) {
+    uint32_t e = config->channels[i].entry;
+    unsigned reg = ADCGRP_CHN(e) / 10U;
+
+    grpp->smpr[reg] |= ADCGRP_SMPR_M(reg, e);
+  }
+  for (unsigned r = 0U; r < len; r++) {
+    uint32_t ch = ADCGRP_CHN(rankEntry(mp, config, r));
+
+    if (r < 4U) {
+      grpp->sqr[0] |= ch << (6U * (r + 1U));
+    }
+    else {
+      grpp->sqr[1U + (r - 4U) / 5U] |= ch << (6U * ((r - 4U) % 5U));
+    }
+  }
+}
+
+/* Adds a conversion to the average in progress of a channel. */
+static inline void feed(const ADCMixDriver *mp, adcmix_chan_t *cp,
+                        adcsample_t v) {
+
+  if (cp->phase == 0U) {
+    cp->acc = 0U;
+    cp->fill = 0U;
+  }
+  cp->acc += v;
+  cp->fill++;
+  if (++cp->phase == cp->d) {
+    cp->phase = 0U;
+    if (cp->fill == cp->d) {
+      adcmix_output_t *op = &cp->out;
+
+      if (op->n == 0U) {
+        uint64_t first = cp->conv + 1U - cp->d;
+
+        op->tick = (cp->frame + first * (mp->frames / cp->k)) * mp->interval;
+      }
+      cp->buf[op->n++] = (adcsample_t)((cp->acc + cp->d / 2U) / cp->d);
+    }
+  }
+  cp->conv++;
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+void adcmixObjectInit(ADCMixDriver *mp) {
+
+  mp->state = ADCMIX_STOP;
+  mp->config = NULL;
+  mp->frames = 0U;
+  mp->width = 0U;
+  mp->halfcycles = 0U;
+  adcsObjectInit(&mp->stream);
+}
+
+/*
+ * Plans the rotation for the targets at the timer frequency, see adcmix.h.
+ * Returns false if a channel is invalid or repeated, a target is zero or
+ * above the timer frequency, or no rotation fits the sequence.
+ */
+bool adcmixPlan(ADCMixDriver *mp, const ADCMixConfig *config) {
+  unsigned order[ADCMIX_MAX_CHANNELS];
+  bool used[ADCGRP_MAX_CHANNELS] = {false};
+  unsigned nch = config->num_channels, width = 0U, len;
+  uint32_t freq = config->gptp->config->frequency, top = 0U;
+
+  mp->halfcycles = 0U;
+  if ((nch == 0U) || (nch > ADCMIX_MAX_CHANNELS)) {
+    return false;
+  }
+  for (unsigned i = 0U; i < nch; i++) {
+    uint32_t e = config->channels[i].entry;
+    unsigned j;
+
+    if ((ADCGRP_CHN(e) > 18U) || (ADCGRP_SMP(e) > 7U) ||
+        (config->channels[i].rate == 0U)) {
+      return false;
+    }
+    for (j = 0U; j < i; j++) {
+      if (ADCGRP_CHN(config->channels[j].entry) == ADCGRP_CHN(e)) {
+        return false;
+      }
+    }
+    if (config->channels[i].rate > top) {
+      top = config->channels[i].rate;
+    }
+  }
+  mp->interval = (gptcnt_t)(freq / top);
+  if (mp->interval == 0U) {
+    return false;
+  }
+
+  /* Fewest ranks per frame, the longest rotation on a tie.*/
+  mp->frames = 0U;
+  for (unsigned p = ADCGRP_MAX_CHANNELS; p >= 1U; p >>= 1) {
+    unsigned sum = 0U, w;
+
+    for (unsigned i = 0U; i < nch; i++) {
+      sum += conversions(config, mp->interval, p, config->channels[i].rate);
+    }
+    w = (sum + p - 1U) / p;
+    if ((w * p > ADCGRP_MAX_CHANNELS) ||
+        ((p > 1U) && (w > ADCMIX_MAX_FRAME_RANKS))) {
+      continue;
+    }
+    if ((mp->frames == 0U) || (w < width)) {
+      mp->frames = p;
+      width = w;
+    }
+  }
+  if (mp->frames == 0U) {
+    return false;
+  }
+  mp->width = width;
+  len = mp->frames * width;
+
+  for (unsigned i = 0U; i < nch; i++) {
+    adcmix_chan_t *cp = &mp->chan[i];
+    unsigned k;
+
+    cp->k = (uint8_t)conversions(config, mp->interval, mp->frames,
+                                 config->channels[i].rate);
+
+    /* Insertion by conversions, decreasing and stable.*/
+    for (k = i; (k > 0U) && (mp->chan[order[k - 1U]].k < cp->k); k--) {
+      order[k] = order[k - 1U];
+    }
+    order[k] = i;
+  }
+
+  /* First fit in decreasing order, with power of two periods a column
+     never fragments.*/
+  for (unsigned i = 0U; i < nch; i++) {
+    adcmix_chan_t *cp = &mp->chan[order[i]];
+    unsigned step = mp->frames / cp->k;
+    bool placed = false;
+
+    for (unsigned c = 0U; (c < width) && !placed; c++) {
+      for (unsigned f = 0U; (f < step) && !placed; f++) {
+        unsigned j;
+
+        for (j = 0U; j < cp->k; j++) {
+          if (used[(f + j * step) * width + c]) {
+            break;
+          }
+        }
+        if (j == cp->k) {
+          for (j = 0U; j < cp->k; j++) {
+            used[(f + j * step) * width + c] = true;
+          }
+          cp->frame = (uint8_t)f;
+          cp->column = (uint8_t)c;
+          placed = true;
+        }
+      }
+    }
+    if (!placed) {
+      return false;
+    }
+  }
+
+  for (unsigned r = 0U; r < len; r++) {
+    mp->rank[r] = ADCMIX_IDLE;
+  }
+  for (unsigned i = 0U; i < nch; i++) {
+    adcmix_chan_t *cp = &mp->chan[i];
+    unsigned step = mp->frames / cp->k;
+    uint64_t d, dmax;
+
+    for (unsigned j = 0U; j < cp->k; j++) {
+      mp->rank[(cp->frame + j * step) * width + cp->column] = (uint8_t)i;
+    }
+
+    /* Largest average at or above the target, the period fits 32 bits.*/
+    d = ((uint64_t)freq * cp->k) /
+        ((uint64_t)mp->frames * mp->interval * config->channels[i].rate);
+    dmax = 0xFFFFFFFFULL / ((uint64_t)step * mp->interval);
+    if (dmax > ADCMIX_MAX_AVERAGE) {
+      dmax = ADCMIX_MAX_AVERAGE;
+    }
+    cp->d = (uint32_t)(d < 1U ? 1U : d > dmax ? dmax : d);
+  }
+
+  for (unsigned f = 0U; f < mp->frames; f++) {
+    uint32_t hc = 0U;
+
+    for (unsigned c = 0U; c < width; c++) {
+      hc += ADCGRP_HALFCYCLES(rankEntry(mp, config, f * width + c));
+    }
+    if (hc > mp->halfcycles) {
+      mp->halfcycles = hc;
+    }
+  }
+  return true;
+}
+
+/*
+ * Starts the stream of the rotation, then the trigger timer. Returns false
+ * if the plan fails or the longest frame does not fit the trigger period.
+ */
+bool adcmixStart(ADCMixDriver *mp, const ADCMixConfig *config) {
+  adcsample_t *out = config->out;
+  size_t half = config->depth / 2U;
+
+  osalDbgCheck((mp != NULL) && (config != NULL) && (config->buf != NULL) &&
+               (config->out != NULL) && (config->gptp != NULL) &&
+               (config->depth >= 2U) && ((config->depth & 1U) == 0U));
+  osalDbgAssert(mp->state == ADCMIX_STOP, "invalid state");
+
+  if (!adcmixPlan(mp, config) ||
+      ((uint64_t)mp->halfcycles * config->gptp->config->frequency >
+       2ULL * ADCGRP_ADCCLK * mp->interval)) {
+    return false;
+  }
+
+  mp->config = config;
+  buildGroup(mp, config);
+  for (unsigned i = 0U; i < config->num_channels; i++) {
+    adcmix_chan_t *cp = &mp->chan[i];
+
+    cp->buf = out;
+    cp->out.samples = out;
+    cp->out.n = 0U;
+    cp->out.tick = 0U;
+    cp->out.period = adcmixGetPeriod(mp, i);
+    cp->fill = 0U;
+    cp->samples = 0U;
+    out += half * cp->k;
+  }
+
+  /* No timer in the stream, its ticks would count one trigger per set.*/
+  mp->scfg.adcp = config->adcp;
+  mp->scfg.grpp = &mp->grp;
+  mp->scfg.buf = config->buf;
+  mp->scfg.depth = config->depth;
+  mp->scfg.gptp = NULL;
+  mp->scfg.interval = 0U;
+  mp->scfg.errp = config->errp;
+  mp->scfg.restart = false;
+  adcsStart(&mp->stream, &mp->scfg);
+
+  mp->next = 0U;
+  mp->blocks = 0U;
+  mp->lost = 0U;
+  mp->torn = 0U;
+  mp->state = ADCMIX_ACTIVE;
+
+  gptStartContinuous(config->gptp, mp->interval);
+  return true;
+}
+
+void adcmixStop(ADCMixDriver *mp) {
+
+  osalDbgCheck(mp != NULL);
+
+  if (mp->state == ADCMIX_STOP) {
+    return;
+  }
+
+  gptStopTimer(mp->config->gptp);
+  adcsStop(&mp->stream);
+  mp->state = ADCMIX_STOP;
+}
+
+/*
+ * Waits for the next block and demultiplexes it into the outputs, valid
+ * until the next call. A block overwritten meanwhile is dropped and counted
+ * as lost. Returns MSG_TIMEOUT, or MSG_RESET once stopped or on an ADC
+ * error.
+ */
+msg_t adcmixReadTimeout(ADCMixDriver *mp, sysinterval_t timeout) {
+  const ADCMixConfig *config = mp->config;
+  size_t half = config->depth / 2U;
+  unsigned nch = config->num_channels, len = mp->frames * mp->width;
+
+  while (true) {
+    adcs_block_t blk;
+    msg_t msg;
+
+    msg = adcsReadTimeout(&mp->stream, &blk, timeout);
+    if (msg != MSG_OK) {
+      return msg;
+    }
+
+    for (unsigned i = 0U; i < nch; i++) {
+      adcmix_chan_t *cp = &mp->chan[i];
+
+      /* After a gap the average in progress cannot complete.*/
+      if (blk.seq != mp->next) {
+        cp->fill = 0U;
+      }
+      cp->conv = (uint64_t)blk.seq * half * cp->k;
+      cp->phase = (uint32_t)(cp->conv % cp->d);
+      cp->out.n = 0U;
+    }
+
+    for (size_t s = 0U; s < half; s++) {
+      const adcsample_t *p = blk.samples + s * len;
+
+      for (unsigned r = 0U; r < len; r++) {
+        if (mp->rank[r] != ADCMIX_IDLE) {
+          feed(mp, &mp->chan[mp->rank[r]], p[r]);
+        }
+      }
+    }
+
+    if (adcsRelease(&mp->stream, &blk)) {
+      mp->torn++;
+      continue;
+    }
+
+    for (unsigned i = 0U; i < nch; i++) {
+      mp->chan[i].samples += (uint32_t)mp->chan[i].out.n;
+    }
+    mp->lost += blk.seq - mp->next;
+    mp->next = blk.seq + 1U;
+    mp->blocks++;
+    return MSG_OK;
+  }
+}
@@ -0,0 +1,218 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Mixed-rate channels on one ADC from one timer trigger. The regular
+ * sequence runs in discontinuous mode: each trigger converts the next
+ * frame of D ranks, and the D * P ranks of the sequence are a rotation of
+ * P frames, one set of the stream. A channel takes k evenly spaced frames
+ * of a column, so it is converted at the trigger rate times k / P, and is
+ * averaged over d conversions when its target is lower still. The fast
+ * channels take every frame and come first in it, the slow ones share
+ * columns: a trigger converts D channels instead of all of them.
+ *
+ * The trigger rate is the highest target. k and P are powers of two, so
+ * the columns pack without gaps; for each P every channel gets the lowest
+ * k / P at or above its target, and the plan takes the P with the fewest
+ * ranks per frame, the largest on a tie. P = 1 is a plain sequence. d is
+ * the largest average that keeps the rate at or above the target. Ranks
+ * left over convert the channel with the shortest sample time, dropped.
+ *
+ * Each read demultiplexes a stream block into one output per channel:
+ * the samples of the block, the tick of the first and the period in
+ * trigger timer ticks, exact, a sample being taken at the trigger of its
+ * frame plus the conversions before it in the frame. An average is over
+ * the conversions from a multiple of d, a lost or torn block drops the
+ * ones in progress.
+ *
+ * The injected group is not used for the slow channels, it has no DMA and
+ * the housekeeping of adchk.h takes it on ADC1.
+ */
+
+#ifndef __ADCMIX_H__
+#define __ADCMIX_H__
+
+#include "ch.h"
+#include "hal.h"
+
+#include "adcstream.h"
+#include "adcgrp.h"
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Longest average of a slow channel, in conversions.
+ */
+#if !defined(ADCMIX_MAX_AVERAGE)
+#define ADCMIX_MAX_AVERAGE              65536U
+#endif
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+#define ADCMIX_MAX_CHANNELS             ADCGRP_MAX_CHANNELS
+
+/* Highest DISCNUM + 1. */
+#define ADCMIX_MAX_FRAME_RANKS          8U
+
+/* Rank converted and dropped. */
+#define ADCMIX_IDLE                     0xFFU
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if ADCMIX_MAX_AVERAGE > 1048576U
+#error "ADCMIX_MAX_AVERAGE overflows the sums"
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+typedef enum {
+    ADCMIX_STOP = 0,
+    ADCMIX_ACTIVE = 1
+} adcmix_state_t;
+
+typedef struct {
+    /* ADCGRP_CH(channel, sample time), a channel at most once. */
+    uint32_t entry;
+    /* Target rate in Hz. */
+    uint32_t rate;
+} adcmix_channel_t;
+
+typedef struct {
+    /* Already started. */
+    ADCDriver *adcp;
+    /* Optional error accounting, NULL if unused. */
+    adcerr_t *errp;
+    const adcmix_channel_t *channels;
+    unsigned num_channels;
+    /* Trigger timer, already started, and the trigger bits of the group,
+       e.g. ADCGRP_TRIGGER(TIM4_TRGO). */
+    GPTDriver *gptp;
+    uint32_t cfgr;
+    /* ADCMIX_BUF_SIZE(depth) samples for the ADC, depth rotations. */
+    adcsample_t *buf;
+    size_t depth;
+    /* ADCMIX_OUT_SIZE(depth) samples for the outputs. */
+    adcsample_t *out;
+} ADCMixConfig;
+
+/*
+ * Output of a channel for one block, valid until the next read. Sample i
+ * is taken at tick + i * period, the first conversion of its average.
+ */
+typedef struct {
+    const adcsample_t *samples;
+    size_t n;
+    uint64_t tick;
+    uint32_t period;
+} adcmix_output_t;
+
+typedef struct {
+    /* Frames per rotation, first frame, column and average. */
+    uint8_t k;
+    uint8_t frame;
+    uint8_t column;
+    uint32_t d;
+    /* Average in progress, d - 1 at its last conversion. */
+    uint32_t phase;
+    uint32_t fill;
+    uint32_t acc;
+    /* Conversions from the start, samples output and their buffer. */
+    uint64_t conv;
+    uint32_t samples;
+    adcsample_t *buf;
+    adcmix_output_t out;
+} adcmix_chan_t;
+
+typedef struct {
+    adcmix_state_t state;
+    const ADCMixConfig *config;
+    adcmix_chan_t chan[ADCMIX_MAX_CHANNELS];
+    /* Channel of each rank, ADCMIX_IDLE for the dropped ones. */
+    uint8_t rank[ADCGRP_MAX_CHANNELS];
+    /* Frames per rotation, ranks per frame and trigger period in ticks. */
+    unsigned frames;
+    unsigned width;
+    gptcnt_t interval;
+    /* Longest frame, in half ADC clock cycles. */
+    uint32_t halfcycles;
+    ADCConversionGroup grp;
+    ADCStreamConfig scfg;
+    ADCStreamDriver stream;
+    /* Next block, blocks read, lost and torn. */
+    uint32_t next;
+    uint32_t blocks;
+    uint32_t lost;
+    uint32_t torn;
+} ADCMixDriver;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+#define ADCMIX_BUF_SIZE(depth)          ((depth) * ADCGRP_MAX_CHANNELS)
+#define ADCMIX_OUT_SIZE(depth)          ((depth) / 2U * ADCGRP_MAX_CHANNELS)
+
+#define adcmixGetState(mp)              ((mp)->state)
+#define adcmixGetFrames(mp)             ((mp)->frames)
+#define adcmixGetWidth(mp)              ((mp)->width)
+#define adcmixGetInterval(mp)           ((mp)->interval)
+#define adcmixGetLost(mp)               ((mp)->lost)
+#define adcmixGetTorn(mp)               ((mp)->torn)
+
+/* Output of channel i of the configuration, see adcmix_output_t. */
+#define adcmixGetOutput(mp, i)          (&(mp)->chan[i].out)
+
+/* Conversions per rotation and average of channel i. */
+#define adcmixGetConversions(mp, i)     ((unsigned)(mp)->chan[i].k)
+#define adcmixGetAverage(mp, i)         ((mp)->chan[i].d)
+
+/* Samples output by channel i since the start. */
+#define adcmixGetSamples(mp, i)         ((mp)->chan[i].samples)
+
+/* Sample period of channel i in trigger timer ticks, the achieved rate
+   is the timer frequency over it. */
+#define adcmixGetPeriod(mp, i)                                              \
+  ((uint32_t)((mp)->chan[i].d * ((mp)->frames / (mp)->chan[i].k) *          \
+              (mp)->interval))
+
+/* Highest trigger rate of the plan, 0 if none. */
+#define adcmixMaxRate(mp)                                                   \
+  ((mp)->halfcycles == 0U ? 0U :                                            \
+   (uint32_t)(2ULL * ADCGRP_ADCCLK / (mp)->halfcycles))
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void adcmixObjectInit(ADCMixDriver *mp);
+  bool adcmixPlan(ADCMixDriver *mp, const ADCMixConfig *config);
+  bool adcmixStart(ADCMixDriver *mp, const ADCMixConfig *config);
+  void adcmixStop(ADCMixDriver *mp);
+  msg_t adcmixReadTimeout(ADCMixDriver *mp, sysinterval_t timeout);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADCMIX_H__ */
@@ -0,0 +1,55 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "adcovs.h"
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/* Oversampling ratio of a group, 1 when it is disabled. */
+unsigned adcovsGetRatio(const ADCConversionGroup *grpp) {
+
+  if ((grpp->cfgr2 & ADC_CFGR2_ROVSE) == 0U) {
+    return 1U;
+  }
+  return 2U << ((grpp->cfgr2 & ADC_CFGR2_OVSR_Msk) >> ADC_CFGR2_OVSR_Pos);
+}
+
+/* Significant bits of the group results. */
+unsigned adcovsGetBits(const ADCConversionGroup *grpp) {
+  unsigned shift = (grpp->cfgr2 & ADC_CFGR2_OVSS_Msk) >> ADC_CFGR2_OVSS_Pos;
+  unsigned bits = 12U;
+
+  if ((grpp->cfgr2 & ADC_CFGR2_ROVSE) == 0U) {
+    return bits;
+  }
+  for (unsigned r = adcovsGetRatio(grpp); r > 1U; r >>= 1) {
+    bits++;
+  }
+  return bits > shift ? bits - shift : 0U;
+}
+
+/*
+ * Run-time check for groups built without ADCOVS_CFGR2(): the shift must
+ * be 0..8 and the result must fit the 16-bit data register.
+ */
+bool adcovsCheckGroup(const ADCConversionGroup *grpp) {
+  unsigned shift = (grpp->cfgr2 & ADC_CFGR2_OVSS_Msk) >> ADC_CFGR2_OVSS_Pos;
+
+  if ((grpp->cfgr2 & ADC_CFGR2_ROVSE) == 0U) {
+    return true;
+  }
+  return (shift <= 8U) && (adcovsGetBits(grpp) <= 16U);
+}
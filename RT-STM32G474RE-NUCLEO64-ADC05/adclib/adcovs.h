@@ -0,0 +1,82 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * STM32G4 regular hardware oversampling. The ADC accumulates 2..256
+ * conversions of each channel, shifts the sum right by 0..8 bits and only
+ * then raises EOC, so DMA transfers and callbacks drop by the ratio. The
+ * result must fit the 16-bit data register: 12 + log2(ratio) - shift <= 16.
+ *
+ * Usage in a conversion group:
+ *   ADCOVS_STATIC_ASSERT(16, 0);
+ *   .cfgr2 = ADCOVS_CFGR2(16, 0, ADCOVS_CONTINUOUS),
+ */
+
+#ifndef __ADCOVS_H__
+#define __ADCOVS_H__
+
+#include "hal.h"
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/* All the conversions of an oversampled result follow one trigger. */
+#define ADCOVS_CONTINUOUS               0U
+/* Each conversion of an oversampled result waits for its own trigger. */
+#define ADCOVS_TRIGGERED                ADC_CFGR2_TROVS
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/* OVSR encoding of a ratio, 0xFF for ratios the hardware does not have. */
+#define ADCOVS_OVSR(ratio)                                                  \
+  ((ratio) == 2U   ? 0U : (ratio) == 4U   ? 1U : (ratio) == 8U   ? 2U :     \
+   (ratio) == 16U  ? 3U : (ratio) == 32U  ? 4U : (ratio) == 64U  ? 5U :     \
+   (ratio) == 128U ? 6U : (ratio) == 256U ? 7U : 0xFFU)
+
+/* Result width in bits for a ratio and right shift. */
+#define ADCOVS_BITS(ratio, shift)       (12U + ADCOVS_OVSR(ratio) + 1U - (shift))
+
+#define ADCOVS_VALID(ratio, shift)                                          \
+  ((ADCOVS_OVSR(ratio) != 0xFFU) && ((shift) <= 8U) &&                      \
+   (ADCOVS_BITS(ratio, shift) <= 16U))
+
+/* Compile-time check of a ratio and shift pair, at file scope. */
+#define ADCOVS_STATIC_ASSERT(ratio, shift)                                  \
+  _Static_assert(ADCOVS_VALID(ratio, shift),                                \
+                 "invalid ADC oversampling ratio/shift")
+
+/* CFGR2 value enabling regular oversampling. */
+#define ADCOVS_CFGR2(ratio, shift, mode)                                    \
+  (ADC_CFGR2_ROVSE |                                                        \
+   ((uint32_t)ADCOVS_OVSR(ratio) << ADC_CFGR2_OVSR_Pos) |                   \
+   ((uint32_t)(shift) << ADC_CFGR2_OVSS_Pos) | (mode))
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  bool adcovsCheckGroup(const ADCConversionGroup *grpp);
+  unsigned adcovsGetRatio(const ADCConversionGroup *grpp);
+  unsigned adcovsGetBits(const ADCConversionGroup *grpp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADCOVS_H__ */
@@ -0,0 +1,321 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Zero-copy ADC acquisition. The conversion runs in linear mode into a
+ * block taken from an objects FIFO, used here as the free list. The end
+ * callback restarts the conversion into the next free block and posts the
+ * filled one by pointer to the mailbox of every consumer, the block goes
+ * back to the pool when the last of them releases it. A consumer never
+ * sees a block change under it: the DMA only writes blocks nobody holds.
+ * With a trigger timer the restart happens between two triggers, so no
+ * sample set is lost as long as the callback runs within a timer period.
+ */
+
+#include "adcpool.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+/* The conversion group is embedded in the pool object. */
+static ADCPoolDriver *poolOf(ADCDriver *adcp) {
+
+  return (ADCPoolDriver *)(void *)((uint8_t *)adcp->grpp -
+                                   offsetof(ADCPoolDriver, grp));
+}
+
+/* Drops one reference, the last one gives the block back to the pool. */
+static void unrefI(ADCPoolDriver *pp, adcpool_block_t *bp) {
+
+  if (--bp->refs == (cnt_t)0) {
+    pp->inuse--;
+    chFifoReturnObjectI(&pp->fifo, bp);
+  }
+}
+
+/*
+ * Takes back the oldest block that is still queued to every consumer
+ * holding it. A block being processed is never taken, NULL if none.
+ */
+static adcpool_block_t *reclaimOldestI(ADCPoolDriver *pp) {
+  adcpool_block_t *oldest = NULL;
+
+  for (unsigned i = 0; i < pp->ncons; i++) {
+    adcpool_block_t *bp;
+    cnt_t queued = 0;
+
+    if (chMBGetUsedCountI(&pp->consumers[i]->mb) == (cnt_t)0) {
+      continue;
+    }
+    bp = (adcpool_block_t *)chMBPeekI(&pp->consumers[i]->mb);
+    if ((oldest != NULL) && ((int32_t)(bp->seq - oldest->seq) >= 0)) {
+      continue;
+    }
+
+    /* Queues are in sequence order, a queued holder has it at the head.*/
+    for (unsigned j = 0; j < pp->ncons; j++) {
+      mailbox_t *mbp = &pp->consumers[j]->mb;
+
+      if ((chMBGetUsedCountI(mbp) > (cnt_t)0) &&
+          ((adcpool_block_t *)chMBPeekI(mbp) == bp)) {
+        queued++;
+      }
+    }
+    if (queued == bp->refs) {
+      oldest = bp;
+    }
+  }
+
+  if (oldest != NULL) {
+    for (unsigned i = 0; i < pp->ncons; i++) {
+      adcpool_consumer_t *cp = pp->consumers[i];
+      msg_t msg;
+
+      if ((chMBGetUsedCountI(&cp->mb) > (cnt_t)0) &&
+          ((adcpool_block_t *)chMBPeekI(&cp->mb) == oldest)) {
+        (void) chMBFetchI(&cp->mb, &msg);
+        cp->missed++;
+      }
+    }
+    pp->inuse--;
+    pp->stats.dropoldest++;
+    if (pp->config->errp != NULL) {
+      adcerrOverrunI(pp->config->errp, 1U);
+    }
+  }
+  return oldest;
+}
+
+static void publishI(ADCPoolDriver *pp, adcpool_block_t *bp) {
+
+  bp->refs = (cnt_t)0;
+  for (unsigned i = 0; i < pp->ncons; i++) {
+    adcpool_consumer_t *cp = pp->consumers[i];
+
+    if (chMBPostI(&cp->mb, (msg_t)bp) == MSG_OK) {
+      bp->refs++;
+    }
+    else {
+      cp->missed++;
+    }
+  }
+
+  if (bp->refs == (cnt_t)0) {
+    chFifoReturnObjectI(&pp->fifo, bp);
+  }
+  else {
+    pp->inuse++;
+  }
+}
+
+/* Discards the queued blocks and wakes the consumers with MSG_RESET. */
+static void flushI(ADCPoolDriver *pp) {
+
+  for (unsigned i = 0; i < pp->ncons; i++) {
+    mailbox_t *mbp = &pp->consumers[i]->mb;
+    msg_t msg;
+
+    while (chMBFetchI(mbp, &msg) == MSG_OK) {
+      unrefI(pp, (adcpool_block_t *)msg);
+    }
+    chMBResetI(mbp);
+  }
+}
+
+static void poolcb(ADCDriver *adcp) {
+  ADCPoolDriver *pp = poolOf(adcp);
+  adcpool_block_t *bp = pp->cur, *next;
+
+  bp->seq = pp->seq++;
+  bp->ts = chSysGetRealtimeCounterX();
+  bp->n = pp->config->sets;
+
+  chSysLockFromISR();
+  pp->stats.filled++;
+  next = (adcpool_block_t *)chFifoTakeObjectI(&pp->fifo);
+  if ((next == NULL) && (pp->config->policy == ADCPOOL_DROP_OLDEST)) {
+    next = reclaimOldestI(pp);
+  }
+
+  /* Restart first, the next trigger may be close.*/
+  if (next == NULL) {
+    adcStartConversionI(adcp, &pp->grp, bp->samples, pp->config->sets);
+    pp->stats.dropnewest++;
+    for (unsigned i = 0; i < pp->ncons; i++) {
+      pp->consumers[i]->missed++;
+    }
+    if (pp->config->errp != NULL) {
+      adcerrOverrunI(pp->config->errp, 1U);
+    }
+  }
+  else {
+    adcStartConversionI(adcp, &pp->grp, next->samples, pp->config->sets);
+    pp->cur = next;
+    publishI(pp, bp);
+  }
+  chSysUnlockFromISR();
+}
+
+static void poolerrcb(ADCDriver *adcp, adcerror_t err) {
+  ADCPoolDriver *pp = poolOf(adcp);
+
+  /* The HAL has already stopped the conversion.*/
+  chSysLockFromISR();
+  pp->state = ADCPOOL_ERROR;
+  pp->stats.errors++;
+  pp->stats.lasterr = err;
+  if (pp->config->errp != NULL) {
+    (void) adcerrReportI(pp->config->errp, err);
+  }
+  flushI(pp);
+  chSysUnlockFromISR();
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+void adcpoolObjectInit(ADCPoolDriver *pp) {
+
+  pp->state = ADCPOOL_STOP;
+  pp->config = NULL;
+  pp->cur = NULL;
+  pp->seq = 0U;
+  pp->ncons = 0U;
+  pp->inuse = (cnt_t)0;
+}
+
+void adcpoolConsumerObjectInit(adcpool_consumer_t *cp) {
+
+  chMBObjectInit(&cp->mb, cp->msgs, ADCPOOL_QUEUE_DEPTH);
+  cp->received = 0U;
+  cp->missed = 0U;
+}
+
+/* Consumers are registered while the pool is stopped. */
+void adcpoolRegister(ADCPoolDriver *pp, adcpool_consumer_t *cp) {
+
+  osalDbgCheck((pp != NULL) && (cp != NULL) &&
+               (pp->ncons < ADCPOOL_MAX_CONSUMERS));
+  osalDbgAssert(pp->state == ADCPOOL_STOP, "invalid state");
+
+  pp->consumers[pp->ncons++] = cp;
+}
+
+/*
+ * The pool is rebuilt on each start, every block of the previous run must
+ * have been released.
+ */
+void adcpoolStart(ADCPoolDriver *pp, const ADCPoolConfig *config) {
+
+  osalDbgCheck((pp != NULL) && (config != NULL) && (config->objn >= 2U) &&
+               (config->sets > 0U));
+  osalDbgAssert((pp->state == ADCPOOL_STOP) || (pp->state == ADCPOOL_ERROR),
+                "invalid state");
+  osalDbgAssert(pp->inuse == (cnt_t)0, "blocks not released");
+
+  pp->config = config;
+  pp->grp = *config->grpp;
+  pp->grp.circular = false;
+  pp->grp.end_cb = poolcb;
+  pp->grp.error_cb = poolerrcb;
+
+  chFifoObjectInit(&pp->fifo,
+                   ADCPOOL_BLOCK_SIZE(config->sets, config->grpp->num_channels),
+                   config->objn, config->objbuf, config->msgbuf);
+  for (unsigned i = 0; i < pp->ncons; i++) {
+    adcpool_consumer_t *cp = pp->consumers[i];
+
+    chMBResumeX(&cp->mb);
+    cp->received = 0U;
+    cp->missed = 0U;
+  }
+
+  pp->cur = (adcpool_block_t *)chFifoTakeObjectTimeout(&pp->fifo,
+                                                       TIME_IMMEDIATE);
+  pp->seq = 0U;
+  memset(&pp->stats, 0, sizeof(pp->stats));
+  pp->state = ADCPOOL_ACTIVE;
+
+  adcStartConversion(config->adcp, &pp->grp, pp->cur->samples, config->sets);
+  if (config->gptp != NULL) {
+    gptStartContinuous(config->gptp, config->interval);
+  }
+}
+
+/*
+ * Stops the acquisition, the queued blocks are discarded and the waiting
+ * consumers get MSG_RESET. Blocks being processed stay valid until they
+ * are released.
+ */
+void adcpoolStop(ADCPoolDriver *pp) {
+  const ADCPoolConfig *config = pp->config;
+
+  osalDbgCheck(pp != NULL);
+
+  if (pp->state == ADCPOOL_STOP) {
+    return;
+  }
+
+  if (config->gptp != NULL) {
+    gptStopTimer(config->gptp);
+  }
+  adcStopConversion(config->adcp);
+
+  chSysLock();
+  pp->state = ADCPOOL_STOP;
+  chFifoReturnObjectI(&pp->fifo, pp->cur);
+  pp->cur = NULL;
+  flushI(pp);
+  chSchRescheduleS();
+  chSysUnlock();
+}
+
+/*
+ * Waits for the next block of a consumer, which must release it with
+ * adcpoolRelease(). Returns MSG_TIMEOUT, or MSG_RESET once the pool has
+ * been stopped or has hit an ADC error.
+ */
+msg_t adcpoolFetchTimeout(ADCPoolDriver *pp, adcpool_consumer_t *cp,
+                          adcpool_block_t **bpp, sysinterval_t timeout) {
+  msg_t msg, blk;
+
+  (void)pp;
+
+  msg = chMBFetchTimeout(&cp->mb, &blk, timeout);
+  if (msg == MSG_OK) {
+    *bpp = (adcpool_block_t *)blk;
+    cp->received++;
+  }
+  return msg;
+}
+
+void adcpoolRelease(ADCPoolDriver *pp, adcpool_block_t *bp) {
+
+  chSysLock();
+  unrefI(pp, bp);
+  chSchRescheduleS();
+  chSysUnlock();
+}
+
+void adcpoolGetStats(ADCPoolDriver *pp, adcpool_stats_t *sp) {
+
+  chSysLock();
+  *sp = pp->stats;
+  chSysUnlock();
+}
@@ -0,0 +1,179 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Zero-copy ADC block pool. The DMA fills fixed-size blocks taken from an
+ * objects FIFO and each filled block is delivered by pointer to every
+ * registered consumer (logger, display, control loop...), so all of them
+ * see the same samples without a copy. A block returns to the pool when
+ * its last consumer releases it. When the DMA needs a block and none is
+ * free the policy drops either the newest or the oldest unread block, a
+ * block a consumer is processing is never touched.
+ */
+
+#ifndef __ADCPOOL_H__
+#define __ADCPOOL_H__
+
+#include "ch.h"
+#include "hal.h"
+
+#include "adcerr.h"
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Maximum number of consumers of a pool.
+ */
+#if !defined(ADCPOOL_MAX_CONSUMERS)
+#define ADCPOOL_MAX_CONSUMERS           4
+#endif
+
+/**
+ * @brief   Blocks a consumer can have queued.
+ */
+#if !defined(ADCPOOL_QUEUE_DEPTH)
+#define ADCPOOL_QUEUE_DEPTH             4
+#endif
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if !HAL_USE_ADC
+#error "ADC pool requires HAL_USE_ADC"
+#endif
+
+#if !CH_CFG_USE_OBJ_FIFOS || !CH_CFG_USE_MAILBOXES
+#error "ADC pool requires CH_CFG_USE_OBJ_FIFOS and CH_CFG_USE_MAILBOXES"
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+typedef enum {
+    ADCPOOL_UNINIT = 0,
+    ADCPOOL_STOP = 1,
+    ADCPOOL_ACTIVE = 2,
+    ADCPOOL_ERROR = 3
+} adcpool_state_t;
+
+/* What to give up when the DMA needs a block and the pool is empty. */
+typedef enum {
+    /* The block just filled is not delivered and gets filled again. */
+    ADCPOOL_DROP_NEWEST = 0,
+    /* The oldest block still queued to all its consumers is taken back,
+       falls back to the newest if a consumer is already processing it. */
+    ADCPOOL_DROP_OLDEST = 1
+} adcpool_policy_t;
+
+/*
+ * A filled block, shared read-only by the consumers it was delivered to.
+ * Samples are interleaved, n sample sets of num_channels each.
+ */
+typedef struct {
+    uint32_t seq;
+    /* Realtime counter value at the end of the block. */
+    rtcnt_t ts;
+    size_t n;
+    /* Consumers still holding the block, private. */
+    cnt_t refs;
+    adcsample_t samples[];
+} adcpool_block_t;
+
+typedef struct {
+    mailbox_t mb;
+    msg_t msgs[ADCPOOL_QUEUE_DEPTH];
+    /* Blocks delivered, and skipped because the queue was full or the
+       block was taken back by the drop oldest policy. */
+    uint32_t received;
+    uint32_t missed;
+} adcpool_consumer_t;
+
+typedef struct {
+    uint32_t filled;
+    uint32_t dropnewest;
+    uint32_t dropoldest;
+    uint32_t errors;
+    adcerror_t lasterr;
+} adcpool_stats_t;
+
+typedef struct {
+    ADCDriver *adcp;
+    /* Template group, the pool forces linear mode and its callbacks. */
+    const ADCConversionGroup *grpp;
+    /* Block storage, objn objects of ADCPOOL_BLOCK_SIZE(sets, nch) bytes,
+       and objn messages for the objects FIFO. */
+    void *objbuf;
+    msg_t *msgbuf;
+    size_t objn;
+    size_t sets;
+    adcpool_policy_t policy;
+    /* Optional trigger timer, already started, and its period in ticks. */
+    GPTDriver *gptp;
+    gptcnt_t interval;
+    /* Optional error accounting, NULL if unused. Dropped blocks are
+       reported as overruns. */
+    adcerr_t *errp;
+} ADCPoolConfig;
+
+typedef struct {
+    adcpool_state_t state;
+    const ADCPoolConfig *config;
+    ADCConversionGroup grp;
+    objects_fifo_t fifo;
+    /* Block being filled by the DMA. */
+    adcpool_block_t *cur;
+    uint32_t seq;
+    adcpool_consumer_t *consumers[ADCPOOL_MAX_CONSUMERS];
+    unsigned ncons;
+    /* Blocks delivered and not yet back in the pool. */
+    cnt_t inuse;
+    adcpool_stats_t stats;
+} ADCPoolDriver;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/* Object size of a block, rounded to the pool alignment. */
+#define ADCPOOL_BLOCK_SIZE(sets, nch)                                       \
+  MEM_ALIGN_NEXT(sizeof(adcpool_block_t) +                                  \
+                 (sets) * (nch) * sizeof(adcsample_t), PORT_NATURAL_ALIGN)
+
+#define adcpoolGetState(pp)             ((pp)->state)
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void adcpoolObjectInit(ADCPoolDriver *pp);
+  void adcpoolConsumerObjectInit(adcpool_consumer_t *cp);
+  void adcpoolRegister(ADCPoolDriver *pp, adcpool_consumer_t *cp);
+  void adcpoolStart(ADCPoolDriver *pp, const ADCPoolConfig *config);
+  void adcpoolStop(ADCPoolDriver *pp);
+  msg_t adcpoolFetchTimeout(ADCPoolDriver *pp, adcpool_consumer_t *cp,
+                            adcpool_block_t **bpp, sysinterval_t timeout);
+  void adcpoolRelease(ADCPoolDriver *pp, adcpool_block_t *bp);
+  void adcpoolGetStats(ADCPoolDriver *pp, adcpool_stats_t *sp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADCPOOL_H__ */
@@ -0,0 +1,360 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "adcscan.h"
+
+#include <string.h>
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+#define PINTAB(n, in)                                                       \
+  {(n) - 1U, ADC_CHANNEL_##in, ADCGRP_PINID_(ADCGRP_ADC##n##_##in)}
+
+/* External channels of ADC1 to ADC4, from the adcgrp.h pin table. */
+static const struct {
+  uint8_t adc;
+  uint8_t ch;
+  uint8_t pin;
+} pintab[] = {
+  PINTAB(1, IN1),  PINTAB(1, IN2),  PINTAB(1, IN3),  PINTAB(1, IN4),
+  PINTAB(1, IN5),  PINTAB(1, IN6),  PINTAB(1, IN7),  PINTAB(1, IN8),
+  PINTAB(1, IN9),  PINTAB(1, IN10), PINTAB(1, IN11), PINTAB(1, IN12),
+  PINTAB(1, IN14), PINTAB(1, IN15),
+  PINTAB(2, IN1),  PINTAB(2, IN2),  PINTAB(2, IN3),  PINTAB(2, IN4),
+  PINTAB(2, IN5),  PINTAB(2, IN6),  PINTAB(2, IN7),  PINTAB(2, IN8),
+  PINTAB(2, IN9),  PINTAB(2, IN10), PINTAB(2, IN11), PINTAB(2, IN12),
+  PINTAB(2, IN13), PINTAB(2, IN14), PINTAB(2, IN15), PINTAB(2, IN17),
+  PINTAB(3, IN1),  PINTAB(3, IN5),  PINTAB(3, IN12),
+  PINTAB(4, IN3),  PINTAB(4, IN4),  PINTAB(4, IN5)
+};
+
+#define PINTAB_SIZE                     (sizeof(pintab) / sizeof(pintab[0]))
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+/* Table entries of a pin on the ADCs of the configuration. */
+static unsigned candidates(const ADCScanConfig *config, uint8_t pin,
+                           unsigned *idx) {
+  unsigned n = 0U;
+
+  for (unsigned e = 0U; e < PINTAB_SIZE; e++) {
+    if ((pintab[e].pin == pin) && (config->adcs[pintab[e].adc] != NULL)) {
+      idx[n++] = e;
+    }
+  }
+  return n;
+}
+
+static void buildGroup(ADCConversionGroup *grpp, const ADCScanConfig *config,
+                       const ADCScanDriver *sp, const adcscan_adc_t *ap) {
+
+  memset(grpp, 0, sizeof(*grpp));
+  grpp->num_channels = (adc_channels_num_t)ap->nch;
+  grpp->cfgr = config->cfgr;
+  grpp->tr1 = ADC_TR_DISABLED;
+  grpp->tr2 = ADC_TR_DISABLED;
+  grpp->tr3 = ADC_TR_DISABLED;
+  for (unsigned r = 0U; r < ap->nch; r++) {
+    uint32_t ch = sp->chof[ap->pos[r]];
+
+    grpp->smpr[ch / 10U] |= config->smp << (3U * (ch % 10U));
+    if (r < 4U) {
+      grpp->sqr[0] |= ch << (6U * (r + 1U));
+    }
+    else {
+      grpp->sqr[1U + (r - 4U) / 5U] |= ch << (6U * ((r - 4U) % 5U));
+    }
+  }
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+void adcscanObjectInit(ADCScanDriver *sp) {
+
+  sp->state = ADCSCAN_STOP;
+  sp->config = NULL;
+  sp->nadc = 0U;
+  sp->halfcycles = 0U;
+  for (unsigned u = 0U; u < ADCSCAN_NUM_ADCS; u++) {
+    sp->adc[u].nch = 0U;
+    adcsObjectInit(&sp->adc[u].stream);
+  }
+}
+
+/*
+ * Spreads the pins over the ADCs, the pins with fewer ADCs first, each on
+ * the least loaded of its ADCs, then moves pins off the longest sequences
+ * while that makes them shorter. Returns false if a pin is on none of the
+ * ADCs, is repeated or if a sequence would be too long.
+ */
+bool adcscanAssign(ADCScanDriver *sp, const ADCScanConfig *config) {
+  unsigned load[ADCSCAN_NUM_ADCS] = {0U};
+  unsigned order[ADCSCAN_MAX_PINS], ncand[ADCSCAN_MAX_PINS];
+  unsigned idx[PINTAB_SIZE];
+  unsigned np = config->num_pins, maxload = 0U;
+  bool moved;
+
+  sp->halfcycles = 0U;
+  if ((np == 0U) || (np > ADCSCAN_MAX_PINS)) {
+    return false;
+  }
+  for (unsigned j = 0U; j < np; j++) {
+    unsigned k;
+
+    for (k = 0U; k < j; k++) {
+      if (config->pins[k] == config->pins[j]) {
+        return false;
+      }
+    }
+    ncand[j] = candidates(config, config->pins[j], idx);
+    if (ncand[j] == 0U) {
+      return false;
+    }
+
+    /* Insertion by number of candidates, stable.*/
+    for (k = j; (k > 0U) && (ncand[order[k - 1U]] > ncand[j]); k--) {
+      order[k] = order[k - 1U];
+    }
+    order[k] = j;
+  }
+
+  for (unsigned i = 0U; i < np; i++) {
+    unsigned j = order[i], best = 0U;
+    unsigned n = candidates(config, config->pins[j], idx);
+
+    for (unsigned c = 1U; c < n; c++) {
+      if (load[pintab[idx[c]].adc] < load[pintab[idx[best]].adc]) {
+        best = c;
+      }
+    }
+    sp->adcof[j] = pintab[idx[best]].adc;
+    sp->chof[j] = pintab[idx[best]].ch;
+    load[sp->adcof[j]]++;
+  }
+
+  /* Each move lowers the sum of the squared loads, so it ends.*/
+  do {
+    moved = false;
+    for (unsigned j = 0U; j < np; j++) {
+      unsigned u = sp->adcof[j];
+      unsigned n = candidates(config, config->pins[j], idx);
+
+      for (unsigned c = 0U; c < n; c++) {
+        unsigned v = pintab[idx[c]].adc;
+
+        if (load[v] + 1U < load[u]) {
+          load[u]--;
+          load[v]++;
+          sp->adcof[j] = (uint8_t)v;
+          sp->chof[j] = pintab[idx[c]].ch;
+          moved = true;
+          break;
+        }
+      }
+    }
+  } while (moved);
+
+  /* Ranks in pin order.*/
+  sp->nadc = 0U;
+  for (unsigned u = 0U; u < ADCSCAN_NUM_ADCS; u++) {
+    sp->adc[u].adcp = config->adcs[u];
+    sp->adc[u].nch = 0U;
+    if (load[u] > maxload) {
+      maxload = load[u];
+    }
+    if (load[u] > 0U) {
+      sp->nadc++;
+    }
+  }
+  if (maxload > ADCGRP_MAX_CHANNELS) {
+    return false;
+  }
+  for (unsigned j = 0U; j < np; j++) {
+    adcscan_adc_t *ap = &sp->adc[sp->adcof[j]];
+
+    ap->pos[ap->nch++] = (uint8_t)j;
+  }
+  sp->halfcycles = maxload *
+                   ADCGRP_HALFCYCLES(ADCGRP_CH(ADC_CHANNEL_IN1, config->smp));
+
+  return true;
+}
+
+/*
+ * Starts one stream per ADC in use, then the trigger timer so that the
+ * first trigger reaches all of them. Returns false if the assignment fails
+ * or the longest sequence does not fit the trigger period.
+ */
+bool adcscanStart(ADCScanDriver *sp, const ADCScanConfig *config) {
+  adcsample_t *buf = config->buf;
+
+  osalDbgCheck((sp != NULL) && (config != NULL) && (config->buf != NULL) &&
+               (config->frame != NULL) && (config->gptp != NULL) &&
+               (config->depth >= 2U) && ((config->depth & 1U) == 0U));
+  osalDbgAssert(sp->state == ADCSCAN_STOP, "invalid state");
+
+  if (!adcscanAssign(sp, config) ||
+      ((uint64_t)sp->halfcycles * config->gptp->config->frequency >
+       2ULL * ADCGRP_ADCCLK * config->interval)) {
+    return false;
+  }
+
+  sp->config = config;
+  for (unsigned u = 0U; u < ADCSCAN_NUM_ADCS; u++) {
+    adcscan_adc_t *ap = &sp->adc[u];
+
+    if (ap->nch == 0U) {
+      continue;
+    }
+    buildGroup(&ap->grp, config, sp, ap);
+
+    /* No timer in the streams, the scan starts it once for all. A restart
+       after an overflow would break the alignment with the other ADCs.*/
+    ap->scfg.adcp = ap->adcp;
+    ap->scfg.grpp = &ap->grp;
+    ap->scfg.buf = buf;
+    ap->scfg.depth = config->depth;
+    ap->scfg.gptp = NULL;
+    ap->scfg.interval = 0U;
+    ap->scfg.errp = config->errp[u];
+    ap->scfg.restart = false;
+    buf += config->depth * ap->nch;
+
+    adcsStart(&ap->stream, &ap->scfg);
+  }
+  sp->next = 0U;
+  sp->frames = 0U;
+  sp->torn = 0U;
+  sp->state = ADCSCAN_ACTIVE;
+
+  gptStartContinuous(config->gptp, config->interval);
+  return true;
+}
+
+void adcscanStop(ADCScanDriver *sp) {
+
+  osalDbgCheck(sp != NULL);
+
+  if (sp->state == ADCSCAN_STOP) {
+    return;
+  }
+
+  gptStopTimer(sp->config->gptp);
+  for (unsigned u = 0U; u < ADCSCAN_NUM_ADCS; u++) {
+    if (sp->adc[u].nch > 0U) {
+      adcsStop(&sp->adc[u].stream);
+    }
+  }
+  sp->state = ADCSCAN_STOP;
+}
+
+/*
+ * Waits for the next block present on every ADC and merges it into the
+ * frame, which stays valid until the next call. Blocks overwritten while
+ * merged are dropped and counted in the lost field of the next frame.
+ * Returns MSG_TIMEOUT, or MSG_RESET once stopped or on an ADC error.
+ */
+msg_t adcscanReadTimeout(ADCScanDriver *sp, adcs_block_t *bp,
+                         sysinterval_t timeout) {
+  const ADCScanConfig *config = sp->config;
+  adcs_block_t blk[ADCSCAN_NUM_ADCS];
+  size_t half = config->depth / 2U;
+  unsigned np = config->num_pins;
+
+  while (true) {
+    uint32_t target = 0U;
+    bool first = true, again, torn = false;
+    msg_t msg;
+
+    for (unsigned u = 0U; u < ADCSCAN_NUM_ADCS; u++) {
+      if (sp->adc[u].nch == 0U) {
+        continue;
+      }
+      msg = adcsReadTimeout(&sp->adc[u].stream, &blk[u], timeout);
+      if (msg != MSG_OK) {
+        return msg;
+      }
+      if (first || ((int32_t)(blk[u].seq - target) > 0)) {
+        target = blk[u].seq;
+      }
+      first = false;
+    }
+
+    /* An ADC can complete the next block between two reads, the ones
+       behind read again until all are on the newest.*/
+    do {
+      again = false;
+      for (unsigned u = 0U; u < ADCSCAN_NUM_ADCS; u++) {
+        if (sp->adc[u].nch == 0U) {
+          continue;
+        }
+        while ((int32_t)(blk[u].seq - target) < 0) {
+          msg = adcsReadTimeout(&sp->adc[u].stream, &blk[u], timeout);
+          if (msg != MSG_OK) {
+            return msg;
+          }
+        }
+        if (blk[u].seq != target) {
+          target = blk[u].seq;
+          again = true;
+        }
+      }
+    } while (again);
+
+    for (size_t k = 0U; k < half; k++) {
+      adcsample_t *d = config->frame + k * np;
+
+      for (unsigned u = 0U; u < ADCSCAN_NUM_ADCS; u++) {
+        const adcscan_adc_t *ap = &sp->adc[u];
+        const adcsample_t *s;
+
+        if (ap->nch == 0U) {
+          continue;
+        }
+        s = blk[u].samples + k * ap->nch;
+        for (unsigned r = 0U; r < ap->nch; r++) {
+          d[ap->pos[r]] = s[r];
+        }
+      }
+    }
+
+    for (unsigned u = 0U; u < ADCSCAN_NUM_ADCS; u++) {
+      if ((sp->adc[u].nch > 0U) &&
+          adcsRelease(&sp->adc[u].stream, &blk[u])) {
+        torn = true;
+      }
+    }
+    if (torn) {
+      sp->torn++;
+      continue;
+    }
+
+    bp->samples = config->frame;
+    bp->n = half;
+    bp->seq = target;
+    bp->ts = blk[sp->adcof[0]].ts;
+    bp->tick = (uint64_t)target * half * config->interval;
+    bp->latency = 0U;
+    bp->lost = target - sp->next;
+    sp->next = target + 1U;
+    sp->frames++;
+    return MSG_OK;
+  }
+}
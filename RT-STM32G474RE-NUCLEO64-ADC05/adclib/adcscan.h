@@ -0,0 +1,155 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Parallel scan of a list of pins over several ADCs. Each pin goes to one
+ * of the ADCs that have it as a channel, so that the longest sequence is
+ * as short as possible, and every ADC used runs its sequence as an
+ * adcstream on its own DMA. All the ADCs take the same timer trigger, so
+ * set k of every ADC is sampled at trigger k, the ranks of an ADC one
+ * conversion time apart. The reader waits for the same block on all the
+ * streams and merges the sets into one frame with the channels in the
+ * order of the pin list.
+ *
+ * The set rate is bound by the longest sequence, not by the number of
+ * pins: with the pins spread over n ADCs the aggregate rate is about n
+ * times the one of a single ADC.
+ *
+ * ADC1 to ADC4 only, the ADCv3 driver of ChibiOS 21.11 has no ADC5. The
+ * trigger is the same cfgr on every ADC, which holds for the TRGO sources:
+ * their EXTSEL values are equal on ADC12 and ADC345.
+ */
+
+#ifndef __ADCSCAN_H__
+#define __ADCSCAN_H__
+
+#include "ch.h"
+#include "hal.h"
+
+#include "adcstream.h"
+#include "adcgrp.h"
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Maximum number of pins in a scan.
+ */
+#if !defined(ADCSCAN_MAX_PINS)
+#define ADCSCAN_MAX_PINS                16
+#endif
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+#define ADCSCAN_NUM_ADCS                4U
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+typedef enum {
+    ADCSCAN_STOP = 0,
+    ADCSCAN_ACTIVE = 1
+} adcscan_state_t;
+
+typedef struct {
+    /* ADC1 to ADC4, already started, NULL for the ones not to use. */
+    ADCDriver *adcs[ADCSCAN_NUM_ADCS];
+    /* Optional error accounting of each ADC. */
+    adcerr_t *errp[ADCSCAN_NUM_ADCS];
+    /* ADCSCAN_PIN() of each input, in frame order. */
+    const uint8_t *pins;
+    unsigned num_pins;
+    /* ADC_SMPR_SMP_xxx of all the channels. */
+    uint32_t smp;
+    /* Trigger timer, already started, its period in ticks and the trigger
+       bits of the groups, e.g. ADCGRP_TRIGGER(TIM4_TRGO). */
+    GPTDriver *gptp;
+    gptcnt_t interval;
+    uint32_t cfgr;
+    /* ADCSCAN_BUF_SIZE(depth, num_pins) samples for the ADC buffers. */
+    adcsample_t *buf;
+    size_t depth;
+    /* Merged frame, depth / 2 sets of num_pins samples. */
+    adcsample_t *frame;
+} ADCScanConfig;
+
+typedef struct {
+    ADCDriver *adcp;
+    unsigned nch;
+    /* Frame position of each rank. */
+    uint8_t pos[ADCGRP_MAX_CHANNELS];
+    ADCConversionGroup grp;
+    ADCStreamConfig scfg;
+    ADCStreamDriver stream;
+} adcscan_adc_t;
+
+typedef struct {
+    adcscan_state_t state;
+    const ADCScanConfig *config;
+    adcscan_adc_t adc[ADCSCAN_NUM_ADCS];
+    /* ADC index and channel of each pin. */
+    uint8_t adcof[ADCSCAN_MAX_PINS];
+    uint8_t chof[ADCSCAN_MAX_PINS];
+    unsigned nadc;
+    /* Longest sequence, in half ADC clock cycles. */
+    uint32_t halfcycles;
+    /* Next block to merge, frames merged and torn. */
+    uint32_t next;
+    uint32_t frames;
+    uint32_t torn;
+} ADCScanDriver;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+#define ADCSCAN_PIN(port, pad)          ADCGRP_PINID(port, pad)
+
+#define ADCSCAN_BUF_SIZE(depth, num_pins) ((depth) * (num_pins))
+
+#define adcscanGetState(sp)             ((sp)->state)
+#define adcscanGetADCs(sp)              ((sp)->nadc)
+#define adcscanGetHalfcycles(sp)        ((sp)->halfcycles)
+
+/* ADC number, 1 to 4, and channel of the input at frame position i. */
+#define adcscanGetADC(sp, i)            ((unsigned)(sp)->adcof[i] + 1U)
+#define adcscanGetChannel(sp, i)        ((unsigned)(sp)->chof[i])
+
+/* Highest set rate of the last assignment, sets per second, 0 if none. */
+#define adcscanMaxRate(sp)                                                  \
+  ((sp)->halfcycles == 0U ? 0U :                                            \
+   (uint32_t)(2ULL * ADCGRP_ADCCLK / (sp)->halfcycles))
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void adcscanObjectInit(ADCScanDriver *sp);
+  bool adcscanAssign(ADCScanDriver *sp, const ADCScanConfig *config);
+  bool adcscanStart(ADCScanDriver *sp, const ADCScanConfig *config);
+  void adcscanStop(ADCScanDriver *sp);
+  msg_t adcscanReadTimeout(ADCScanDriver *sp, adcs_block_t *bp,
+                           sysinterval_t timeout);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADCSCAN_H__ */
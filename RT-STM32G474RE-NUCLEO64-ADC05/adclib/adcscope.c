@@ -0,0 +1,174 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "adcscope.h"
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/* CRC-16/CCITT polynomial 0x1021, one nibble at a time. */
+static const uint16_t crctab[16] = {
+  0x0000U, 0x1021U, 0x2042U, 0x3063U, 0x4084U, 0x50A5U, 0x60C6U, 0x70E7U,
+  0x8108U, 0x9129U, 0xA14AU, 0xB16BU, 0xC18CU, 0xD1ADU, 0xE1CEU, 0xF1EFU
+};
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static uint8_t *put16(uint8_t *p, uint16_t v) {
+
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  return p + 2;
+}
+
+static uint8_t *put32(uint8_t *p, uint32_t v) {
+
+  p = put16(p, (uint16_t)v);
+  return put16(p, (uint16_t)(v >> 16));
+}
+
+/* Bytes per second on the link for a decimation ratio. */
+static uint32_t linkLoad(const adcscope_t *sp, size_t sets, unsigned log2dec) {
+  uint32_t bytes = (uint32_t)ADCSCOPE_PACKET_SIZE(sets >> log2dec, sp->nsel);
+
+  return (uint32_t)((uint64_t)bytes * sp->rate / sets);
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/* Use 0xFFFF as initial value. */
+uint16_t adcscopeCrc16(uint16_t crc, const uint8_t *p, size_t n) {
+
+  while (n-- > 0U) {
+    uint8_t b = *p++;
+
+    crc = (uint16_t)(crc << 4) ^ crctab[(crc >> 12) ^ (b >> 4)];
+    crc = (uint16_t)(crc << 4) ^ crctab[(crc >> 12) ^ (b & 0x0FU)];
+  }
+  return crc;
+}
+
+/*
+ * Blocks carry sets sample sets of nch channels at rate Hz. The initial
+ * ratio is the smallest that fits link_bps with 10 bits per byte. Returns
+ * false if the channel mask selects no channel or channels past nch.
+ */
+bool adcscopeInit(adcscope_t *sp, unsigned nch, uint8_t chmask,
+                  uint32_t rate, size_t sets, uint32_t link_bps) {
+  unsigned k;
+
+  if ((chmask == 0U) || (nch > 8U) || ((chmask >> nch) != 0U) ||
+      (sets == 0U) || (rate == 0U)) {
+    return false;
+  }
+
+  sp->nch = nch;
+  sp->chmask = chmask;
+  sp->nsel = 0U;
+  for (unsigned c = 0; c < nch; c++) {
+    sp->nsel += (chmask >> c) & 1U;
+  }
+  sp->rate = rate;
+  sp->relax = 0U;
+  sp->packets = 0U;
+  sp->dropped = 0U;
+
+  /* The ratio must divide the block.*/
+  sp->maxlog2dec = 0U;
+  while ((sp->maxlog2dec < ADCSCOPE_MAX_LOG2DEC) &&
+         ((sets >> (sp->maxlog2dec + 1U)) << (sp->maxlog2dec + 1U)) == sets) {
+    sp->maxlog2dec++;
+  }
+
+  for (k = 0U; k < sp->maxlog2dec; k++) {
+    if (linkLoad(sp, sets, k) * 10U <= link_bps) {
+      break;
+    }
+  }
+  sp->log2dec = (uint8_t)k;
+
+  return true;
+}
+
+/*
+ * Writes the packet of a block to out, which must hold
+ * ADCSCOPE_PACKET_SIZE(bp->n, nch) bytes. Returns the packet size.
+ */
+size_t adcscopePack(adcscope_t *sp, const adcs_block_t *bp, uint8_t *out) {
+  unsigned k = sp->log2dec, nch = sp->nch;
+  size_t sets = bp->n >> k;
+  const adcsample_t *p = bp->samples;
+  uint8_t *q = out;
+  uint16_t crc;
+
+  *q++ = ADCSCOPE_SYNC0;
+  *q++ = ADCSCOPE_SYNC1;
+  *q++ = sp->chmask;
+  *q++ = (uint8_t)k;
+  q = put32(q, bp->seq);
+  q = put32(q, sp->rate >> k);
+  q = put16(q, (uint16_t)sets);
+
+  for (size_t i = 0; i < sets; i++) {
+    for (unsigned c = 0; c < nch; c++) {
+      uint32_t sum = 0U;
+
+      if (((sp->chmask >> c) & 1U) == 0U) {
+        continue;
+      }
+      for (size_t j = 0; j < ((size_t)1U << k); j++) {
+        sum += p[j * nch + c];
+      }
+      q = put16(q, (uint16_t)((sum + ((1U << k) >> 1)) >> k));
+    }
+    p += nch << k;
+  }
+
+  crc = adcscopeCrc16(0xFFFFU, out + 2, (size_t)(q - out) - 2U);
+  q = put16(q, crc);
+  sp->packets++;
+
+  return (size_t)(q - out);
+}
+
+/*
+ * Called after each packet write with the blocks lost before it and the
+ * realtime counter cycles the write took against the block period.
+ */
+void adcscopeAdapt(adcscope_t *sp, uint32_t lost, rtcnt_t busy,
+                   rtcnt_t period) {
+
+  sp->dropped += lost;
+  if (lost > 0U) {
+    sp->relax = 0U;
+    if (sp->log2dec < sp->maxlog2dec) {
+      sp->log2dec++;
+    }
+    return;
+  }
+
+  if ((uint64_t)busy * 100U >= (uint64_t)period * ADCSCOPE_RELAX_LOAD) {
+    sp->relax = 0U;
+    return;
+  }
+  if ((++sp->relax >= ADCSCOPE_RELAX_PACKETS) && (sp->log2dec > 0U)) {
+    sp->log2dec--;
+    sp->relax = 0U;
+  }
+}
@@ -0,0 +1,119 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Binary framing of ADC stream blocks for a host "scope". One packet per
+ * block, all fields little-endian:
+ *
+ *   offset  size  field
+ *   0       2     sync, 0xA5 0x5A
+ *   2       1     channel mask, bit i selects channel i of the sequence
+ *   3       1     log2 of the decimation ratio
+ *   4       4     block sequence number, gaps are dropped blocks
+ *   8       4     output sample set rate in Hz
+ *   12      2     sample sets in the payload
+ *   14      ...   payload, interleaved uint16 samples of the selected channels
+ *   ...     2     CRC-16/CCITT-FALSE of everything after the sync
+ *
+ * Decimation averages 2^log2dec sample sets. The ratio adapts to the link:
+ * it goes up when blocks are dropped and down again once the writes keep
+ * taking less than ADCSCOPE_RELAX_LOAD percent of the block period.
+ */
+
+#ifndef __ADCSCOPE_H__
+#define __ADCSCOPE_H__
+
+#include "adcstream.h"
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Maximum decimation ratio, as a power of two.
+ */
+#if !defined(ADCSCOPE_MAX_LOG2DEC)
+#define ADCSCOPE_MAX_LOG2DEC            8
+#endif
+
+/**
+ * @brief   Consecutive packets under the load threshold before the
+ *          decimation ratio is halved.
+ */
+#if !defined(ADCSCOPE_RELAX_PACKETS)
+#define ADCSCOPE_RELAX_PACKETS          16
+#endif
+
+/**
+ * @brief   Write time threshold, in percent of the block period.
+ */
+#if !defined(ADCSCOPE_RELAX_LOAD)
+#define ADCSCOPE_RELAX_LOAD             40
+#endif
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+#define ADCSCOPE_SYNC0                  0xA5U
+#define ADCSCOPE_SYNC1                  0x5AU
+#define ADCSCOPE_HEADER_SIZE            14U
+#define ADCSCOPE_CRC_SIZE               2U
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+typedef struct {
+    /* Channels in the stream blocks and the selected ones. */
+    unsigned nch;
+    uint8_t chmask;
+    unsigned nsel;
+    uint8_t log2dec;
+    uint8_t maxlog2dec;
+    /* Sample set rate of the stream blocks, in Hz. */
+    uint32_t rate;
+    unsigned relax;
+    uint32_t packets;
+    uint32_t dropped;
+} adcscope_t;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/* Packet size for blocks of sets sample sets with nch channels selected. */
+#define ADCSCOPE_PACKET_SIZE(sets, nch)                                     \
+  (ADCSCOPE_HEADER_SIZE + (sets) * (nch) * sizeof(uint16_t) + ADCSCOPE_CRC_SIZE)
+
+#define adcscopeGetLog2Dec(sp)          ((sp)->log2dec)
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  uint16_t adcscopeCrc16(uint16_t crc, const uint8_t *p, size_t n);
+  bool adcscopeInit(adcscope_t *sp, unsigned nch, uint8_t chmask,
+                    uint32_t rate, size_t sets, uint32_t link_bps);
+  size_t adcscopePack(adcscope_t *sp, const adcs_block_t *bp, uint8_t *out);
+  void adcscopeAdapt(adcscope_t *sp, uint32_t lost, rtcnt_t busy,
+                     rtcnt_t period);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADCSCOPE_H__ */
@@ -0,0 +1,254 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "adcstats.h"
+
+#include <string.h>
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static uint32_t isqrt64(uint64_t x) {
+  uint64_t r = 0U, bit = (uint64_t)1U << 62;
+
+  while (bit > x) {
+    bit >>= 2;
+  }
+  while (bit != 0U) {
+    if (x >= r + bit) {
+      x -= r + bit;
+      r = (r >> 1) + bit;
+    }
+    else {
+      r >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)r;
+}
+
+/* Q8 of d / n without overflowing d << 8. */
+static uint64_t divq8(uint64_t d, uint64_t n) {
+
+  return ((d / n) << 8) + ((d % n) << 8) / n;
+}
+
+/* Population variance in Q8 from exact sums of n samples. */
+static uint32_t sumsVar(uint64_t n, uint64_t s, uint64_t q) {
+
+  return (uint32_t)(divq8(q * n - s * s, n) / n);
+}
+
+static void fillResult(adcstats_result_t *rp, uint32_t var) {
+  uint64_t ms;
+
+  rp->var = var;
+  rp->stddev = isqrt64((uint64_t)var << 8);
+  ms = ((uint64_t)var << 8) + (((uint64_t)rp->mean * rp->mean) >> 16);
+  rp->rms = isqrt64(ms);
+}
+
+static void updateChannel(adcstats_t *sp, adcstats_chan_t *cp,
+                          const adcdsp_acc_t *ap, uint32_t n) {
+  uint32_t mb = (uint32_t)(((uint64_t)ap->sum << 16) / n);
+  uint32_t vb = sumsVar(n, ap->sum, ap->sumsq);
+  int64_t delta;
+  unsigned w = sp->wpos, k = sp->log2alpha;
+
+  /* Running, Chan et al. merge of the block into the totals.*/
+  if (cp->n == 0U) {
+    cp->mean = mb;
+    cp->m2 = (uint64_t)vb * n;
+    cp->min = ap->min;
+    cp->max = ap->max;
+  }
+  else {
+    uint64_t total = cp->n + n;
+    uint64_t frac = (cp->n << 16) / total;
+    uint64_t d2;
+
+    delta = (int64_t)mb - (int64_t)cp->mean;
+    d2 = (uint64_t)(delta * delta) >> 24;
+    cp->mean = (uint32_t)((int64_t)cp->mean + delta * (int64_t)n / (int64_t)total);
+    cp->m2 += (uint64_t)vb * n + ((d2 * frac) >> 16) * n;
+    cp->min = ap->min < cp->min ? ap->min : cp->min;
+    cp->max = ap->max > cp->max ? ap->max : cp->max;
+  }
+  cp->n += n;
+
+  /* Exponential, var = (1 - a) * (var + a * delta^2) + a * vb.*/
+  if (sp->blocks == 0U) {
+    cp->emean = mb;
+    cp->evar = vb;
+  }
+  else {
+    uint64_t d2;
+
+    delta = (int64_t)mb - (int64_t)cp->emean;
+    d2 = (uint64_t)(delta * delta) >> 24;
+    cp->emean = (uint32_t)((int64_t)cp->emean + delta / ((int64_t)1 << k));
+    cp->evar = (uint32_t)(cp->evar - (cp->evar >> k) + (vb >> k) +
+                          ((d2 * (((uint64_t)1U << k) - 1U)) >> (2U * k)));
+  }
+
+  /* Window, the slot of the oldest block is replaced.*/
+  cp->wn += n - cp->slotn[w];
+  cp->ws += (uint64_t)ap->sum - cp->slots[w];
+  cp->wq += ap->sumsq - cp->slotq[w];
+  cp->slotn[w] = n;
+  cp->slots[w] = ap->sum;
+  cp->slotq[w] = ap->sumsq;
+  cp->slotmin[w] = ap->min;
+  cp->slotmax[w] = ap->max;
+
+  /* Peak hold.*/
+  if ((sp->blocks == 0U) || (ap->max >= cp->peakhi) ||
+      ((sp->hold != 0U) && (--cp->holdhi == 0U))) {
+    cp->peakhi = ap->max;
+    cp->holdhi = sp->hold;
+  }
+  if ((sp->blocks == 0U) || (ap->min <= cp->peaklo) ||
+      ((sp->hold != 0U) && (--cp->holdlo == 0U))) {
+    cp->peaklo = ap->min;
+    cp->holdlo = sp->hold;
+  }
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/*
+ * The exponential variant weighs each block 2^-log2alpha, the peak hold
+ * releases an extreme after hold blocks, 0 holds it until a reset.
+ */
+void adcstatsInit(adcstats_t *sp, unsigned nch, unsigned log2alpha,
+                  uint32_t hold) {
+
+  osalDbgCheck((nch >= 1U) && (nch <= ADCSTATS_MAX_CHANNELS) &&
+               (log2alpha < 16U));
+
+  sp->nch = nch;
+  sp->log2alpha = log2alpha;
+  sp->hold = hold;
+  adcstatsReset(sp);
+}
+
+void adcstatsReset(adcstats_t *sp) {
+
+  sp->blocks = 0U;
+  sp->wpos = 0U;
+  memset(sp->ch, 0, sizeof(sp->ch));
+}
+
+/*
+ * Merges a block already reduced by adcdspAccumulate(), n sample sets.
+ * Called from a lock zone.
+ */
+void adcstatsUpdateI(adcstats_t *sp, const adcdsp_acc_t *acc, size_t n) {
+
+  osalDbgCheck((n > 0U) && (n <= ADCSTATS_MAX_BLOCK_SETS));
+
+  for (unsigned c = 0; c < sp->nch; c++) {
+    updateChannel(sp, &sp->ch[c], &acc[c], (uint32_t)n);
+  }
+  sp->wpos = (sp->wpos + 1U) % ADCSTATS_WINDOW_BLOCKS;
+  sp->blocks++;
+}
+
+/* Feeds n interleaved sample sets from thread context. */
+void adcstatsFeed(adcstats_t *sp, const adcsample_t *buf, size_t n) {
+  adcdsp_acc_t acc[ADCSTATS_MAX_CHANNELS];
+
+  adcdspAccInit(acc, sp->nch);
+  adcdspAccumulate(buf, n, sp->nch, acc);
+
+  chSysLock();
+  adcstatsUpdateI(sp, acc, n);
+  chSysUnlock();
+}
+
+/* Feeds n interleaved sample sets from an ADC callback. */
+void adcstatsFeedFromISR(adcstats_t *sp, const adcsample_t *buf, size_t n) {
+  adcdsp_acc_t acc[ADCSTATS_MAX_CHANNELS];
+
+  adcdspAccInit(acc, sp->nch);
+  adcdspAccumulate(buf, n, sp->nch, acc);
+
+  chSysLockFromISR();
+  adcstatsUpdateI(sp, acc, n);
+  chSysUnlockFromISR();
+}
+
+/*
+ * Snapshot of one variant for channel ch, safe while the feeding goes on.
+ * All fields are zero before the first block.
+ */
+void adcstatsGet(adcstats_t *sp, unsigned ch, adcstats_kind_t kind,
+                 adcstats_result_t *rp) {
+  adcstats_chan_t c;
+  uint32_t blocks;
+
+  osalDbgCheck(ch < sp->nch);
+
+  chSysLock();
+  c = sp->ch[ch];
+  blocks = sp->blocks;
+  chSysUnlock();
+
+  memset(rp, 0, sizeof(*rp));
+  if (blocks == 0U) {
+    return;
+  }
+
+  switch (kind) {
+  case ADCSTATS_WINDOW:
+    rp->n = c.wn;
+    rp->mean = (uint32_t)((c.ws << 16) / c.wn);
+    rp->min = c.slotmin[0];
+    rp->max = c.slotmax[0];
+    for (unsigned i = 1; i < ADCSTATS_WINDOW_BLOCKS && i < blocks; i++) {
+      rp->min = c.slotmin[i] < rp->min ? c.slotmin[i] : rp->min;
+      rp->max = c.slotmax[i] > rp->max ? c.slotmax[i] : rp->max;
+    }
+    fillResult(rp, sumsVar(c.wn, c.ws, c.wq));
+    break;
+  case ADCSTATS_EXP:
+    rp->n = blocks;
+    rp->mean = c.emean;
+    rp->min = c.peaklo;
+    rp->max = c.peakhi;
+    fillResult(rp, c.evar);
+    break;
+  default:
+    rp->n = c.n;
+    rp->mean = c.mean;
+    rp->min = c.min;
+    rp->max = c.max;
+    fillResult(rp, (uint32_t)(c.m2 / c.n));
+    break;
+  }
+}
+
+void adcstatsGetPeak(adcstats_t *sp, unsigned ch, adcsample_t *lo,
+                     adcsample_t *hi) {
+
+  osalDbgCheck(ch < sp->nch);
+
+  chSysLock();
+  *lo = sp->ch[ch].peaklo;
+  *hi = sp->ch[ch].peakhi;
+  chSysUnlock();
+}
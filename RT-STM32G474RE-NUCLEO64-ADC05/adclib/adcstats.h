@@ -0,0 +1,152 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Streaming per-channel statistics of interleaved ADC blocks. The samples
+ * only go through the adcdsp accumulator, every update after that is per
+ * block, so the cost per sample is the accumulator one:
+ *  - running: Welford/Chan merge of the blocks in fixed point, since the
+ *    last reset;
+ *  - window: exact sums over the last ADCSTATS_WINDOW_BLOCKS blocks;
+ *  - exponential: mean and variance decayed by 2^-log2alpha per block;
+ *  - peak hold: extremes held for a number of blocks, 0 holds until reset.
+ * Means are Q16 and variances Q8 in counts, RMS and deviations Q8.
+ */
+
+#ifndef __ADCSTATS_H__
+#define __ADCSTATS_H__
+
+#include "ch.h"
+#include "hal.h"
+
+#include "adcdsp.h"
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Maximum number of channels per block.
+ */
+#if !defined(ADCSTATS_MAX_CHANNELS)
+#define ADCSTATS_MAX_CHANNELS           4
+#endif
+
+/**
+ * @brief   Blocks in the sliding window.
+ */
+#if !defined(ADCSTATS_WINDOW_BLOCKS)
+#define ADCSTATS_WINDOW_BLOCKS          16
+#endif
+
+/**
+ * @brief   Maximum sample sets per block, keeps the window sums in 64 bits.
+ */
+#if !defined(ADCSTATS_MAX_BLOCK_SETS)
+#define ADCSTATS_MAX_BLOCK_SETS         4096
+#endif
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if ADCSTATS_WINDOW_BLOCKS * ADCSTATS_MAX_BLOCK_SETS > 65536
+#error "ADCSTATS window too long"
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+typedef enum {
+    ADCSTATS_RUNNING = 0,
+    ADCSTATS_WINDOW = 1,
+    ADCSTATS_EXP = 2
+} adcstats_kind_t;
+
+typedef struct {
+    /* Samples behind the figures, for the exponential variant the blocks.
+       The exponential min and max are the peak hold values. */
+    uint64_t n;
+    uint32_t mean;
+    uint32_t var;
+    uint32_t stddev;
+    uint32_t rms;
+    adcsample_t min;
+    adcsample_t max;
+} adcstats_result_t;
+
+typedef struct {
+    /* Running. */
+    uint64_t n;
+    uint32_t mean;
+    uint64_t m2;
+    adcsample_t min;
+    adcsample_t max;
+    /* Exponential. */
+    uint32_t emean;
+    uint32_t evar;
+    /* Window, totals and per block slots. */
+    uint32_t wn;
+    uint64_t ws;
+    uint64_t wq;
+    uint32_t slotn[ADCSTATS_WINDOW_BLOCKS];
+    uint32_t slots[ADCSTATS_WINDOW_BLOCKS];
+    uint64_t slotq[ADCSTATS_WINDOW_BLOCKS];
+    adcsample_t slotmin[ADCSTATS_WINDOW_BLOCKS];
+    adcsample_t slotmax[ADCSTATS_WINDOW_BLOCKS];
+    /* Peak hold. */
+    adcsample_t peaklo;
+    adcsample_t peakhi;
+    uint32_t holdlo;
+    uint32_t holdhi;
+} adcstats_chan_t;
+
+typedef struct {
+    unsigned nch;
+    unsigned log2alpha;
+    uint32_t hold;
+    uint32_t blocks;
+    unsigned wpos;
+    adcstats_chan_t ch[ADCSTATS_MAX_CHANNELS];
+} adcstats_t;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+#define adcstatsGetBlocks(sp)           ((sp)->blocks)
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void adcstatsInit(adcstats_t *sp, unsigned nch, unsigned log2alpha,
+                    uint32_t hold);
+  void adcstatsReset(adcstats_t *sp);
+  void adcstatsUpdateI(adcstats_t *sp, const adcdsp_acc_t *acc, size_t n);
+  void adcstatsFeed(adcstats_t *sp, const adcsample_t *buf, size_t n);
+  void adcstatsFeedFromISR(adcstats_t *sp, const adcsample_t *buf, size_t n);
+  void adcstatsGet(adcstats_t *sp, unsigned ch, adcstats_kind_t kind,
+                   adcstats_result_t *rp);
+  void adcstatsGetPeak(adcstats_t *sp, unsigned ch, adcsample_t *lo,
+                       adcsample_t *hi);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADCSTATS_H__ */
@@ -0,0 +1,236 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Gapless ADC acquisition. The conversion runs in circular mode and the
+ * half/full callbacks only publish a sequence number: the ISR is the single
+ * writer of head, the consumer the single writer of tail, so the hand-off
+ * needs no lock. The consumer sleeps on a thread reference while the queue
+ * is empty and always gets the newest block, older unread blocks are
+ * already being overwritten by the DMA and are reported as lost.
+ * With a trigger timer each sample set takes one timer period, so the tick
+ * of a block follows exactly from its sequence number, and the timer
+ * counter read in the callback is the latency from the last trigger.
+ */
+
+#include "adcstream.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+/* The conversion group is embedded in the stream object. */
+static ADCStreamDriver *streamOf(ADCDriver *adcp) {
+
+  return (ADCStreamDriver *)(void *)((uint8_t *)adcp->grpp -
+                                     offsetof(ADCStreamDriver, grp));
+}
+
+static void streamcb(ADCDriver *adcp) {
+  ADCStreamDriver *asp = streamOf(adcp);
+  uint32_t seq = asp->head, over = 0U;
+
+  /* Even blocks are first halves, resynchronize on a missed interrupt.*/
+  if ((seq & 1U) != (adcIsBufferComplete(adcp) ? 1U : 0U)) {
+    seq++;
+    over++;
+  }
+
+  /* The previous block is still unread and the DMA is now overwriting it.*/
+  if (seq != asp->tail) {
+    over++;
+  }
+  asp->stats.overruns += over;
+
+  asp->ts[seq & 1U] = chSysGetRealtimeCounterX();
+  if (asp->config->gptp != NULL) {
+    asp->lat[seq & 1U] = gptGetCounterX(asp->config->gptp);
+  }
+  asp->head = seq + 1U;
+  asp->stats.blocks++;
+  if ((seq & 1U) == 0U) {
+    asp->stats.half++;
+  }
+  else {
+    asp->stats.full++;
+  }
+
+  chSysLockFromISR();
+  if ((over > 0U) && (asp->config->errp != NULL)) {
+    adcerrOverrunI(asp->config->errp, over);
+  }
+  chThdResumeI(&asp->trp, MSG_OK);
+  chSysUnlockFromISR();
+}
+
+static void streamerrcb(ADCDriver *adcp, adcerror_t err) {
+  ADCStreamDriver *asp = streamOf(adcp);
+  const ADCStreamConfig *config = asp->config;
+
+  asp->stats.errors++;
+  if ((err & ADC_ERR_DMAFAILURE) != 0U) {
+    asp->stats.dmaerrors++;
+  }
+  if ((err & ADC_ERR_OVERFLOW) != 0U) {
+    asp->stats.overflows++;
+  }
+  asp->stats.lasterr = err;
+
+  chSysLockFromISR();
+  if (config->errp != NULL) {
+    (void) adcerrReportI(config->errp, err);
+  }
+
+  /* The HAL has already stopped the conversion. After an overflow alone
+     it can go on, the DMA starts again from the first half.*/
+  if (config->restart && (err == ADC_ERR_OVERFLOW)) {
+    adcStartConversionI(adcp, &asp->grp, config->buf, config->depth);
+    asp->head = (asp->head + 1U) & ~1U;
+    asp->stats.restarts++;
+    if (config->errp != NULL) {
+      adcerrRestartI(config->errp);
+    }
+  }
+  else {
+    asp->state = ADCS_ERROR;
+    chThdResumeI(&asp->trp, MSG_RESET);
+  }
+  chSysUnlockFromISR();
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+void adcsObjectInit(ADCStreamDriver *asp) {
+
+  asp->state = ADCS_STOP;
+  asp->config = NULL;
+  asp->head = 0U;
+  asp->tail = 0U;
+  asp->trp = NULL;
+}
+
+void adcsStart(ADCStreamDriver *asp, const ADCStreamConfig *config) {
+
+  osalDbgCheck((asp != NULL) && (config != NULL) &&
+               (config->depth >= 2U) && ((config->depth & 1U) == 0U));
+  osalDbgAssert((asp->state == ADCS_STOP) || (asp->state == ADCS_ERROR),
+                "invalid state");
+
+  asp->config = config;
+  asp->grp = *config->grpp;
+  asp->grp.circular = true;
+  asp->grp.end_cb = streamcb;
+  asp->grp.error_cb = streamerrcb;
+
+  asp->head = 0U;
+  asp->tail = 0U;
+  asp->lat[0] = 0U;
+  asp->lat[1] = 0U;
+  memset(&asp->stats, 0, sizeof(asp->stats));
+  asp->state = ADCS_ACTIVE;
+
+  adcStartConversion(config->adcp, &asp->grp, config->buf, config->depth);
+  if (config->gptp != NULL) {
+    gptStartContinuous(config->gptp, config->interval);
+  }
+}
+
+void adcsStop(ADCStreamDriver *asp) {
+  const ADCStreamConfig *config = asp->config;
+
+  osalDbgCheck(asp != NULL);
+
+  if (asp->state == ADCS_STOP) {
+    return;
+  }
+
+  if (config->gptp != NULL) {
+    gptStopTimer(config->gptp);
+  }
+  adcStopConversion(config->adcp);
+
+  chSysLock();
+  asp->state = ADCS_STOP;
+  chThdResumeS(&asp->trp, MSG_RESET);
+  chSchRescheduleS();
+  chSysUnlock();
+}
+
+/*
+ * Waits for the next block. Returns MSG_TIMEOUT, or MSG_RESET once the
+ * stream has been stopped or has hit an ADC error.
+ */
+msg_t adcsReadTimeout(ADCStreamDriver *asp, adcs_block_t *bp,
+                      sysinterval_t timeout) {
+  const ADCStreamConfig *config = asp->config;
+  size_t half = config->depth / 2U;
+  uint32_t head, seq;
+
+  head = asp->head;
+  if (head == asp->tail) {
+    chSysLock();
+    while ((head = asp->head) == asp->tail) {
+      msg_t msg;
+
+      if (asp->state != ADCS_ACTIVE) {
+        chSysUnlock();
+        return MSG_RESET;
+      }
+      msg = chThdSuspendTimeoutS(&asp->trp, timeout);
+      if (msg != MSG_OK) {
+        chSysUnlock();
+        return msg;
+      }
+    }
+    chSysUnlock();
+  }
+
+  seq = head - 1U;
+  bp->lost = seq - asp->tail;
+  bp->seq = seq;
+  bp->n = half;
+  bp->samples = config->buf + (seq & 1U) * half * config->grpp->num_channels;
+  bp->ts = asp->ts[seq & 1U];
+  bp->latency = asp->lat[seq & 1U];
+  bp->tick = (config->gptp != NULL) ?
+             (uint64_t)seq * half * config->interval : 0U;
+  asp->tail = head;
+
+  return MSG_OK;
+}
+
+/*
+ * Ends the processing of a block. Returns true if the DMA started to
+ * overwrite it meanwhile, the consumer took longer than a half buffer.
+ */
+bool adcsRelease(ADCStreamDriver *asp, const adcs_block_t *bp) {
+
+  if (asp->head - bp->seq >= 2U) {
+    asp->stats.late++;
+    return true;
+  }
+  return false;
+}
+
+void adcsGetStats(ADCStreamDriver *asp, adcs_stats_t *sp) {
+
+  chSysLock();
+  *sp = asp->stats;
+  chSysUnlock();
+}
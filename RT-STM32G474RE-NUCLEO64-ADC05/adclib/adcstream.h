@@ -0,0 +1,140 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef __ADCSTREAM_H__
+#define __ADCSTREAM_H__
+
+#include "ch.h"
+#include "hal.h"
+
+#include "adcerr.h"
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if !HAL_USE_ADC
+#error "ADC stream requires HAL_USE_ADC"
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+typedef enum {
+    ADCS_UNINIT = 0,
+    ADCS_STOP = 1,
+    ADCS_ACTIVE = 2,
+    ADCS_ERROR = 3
+} adcs_state_t;
+
+/*
+ * One completed half of the circular buffer. Samples are interleaved,
+ * n sample sets of num_channels each. The block stays valid until the next
+ * half completes, adcsRelease() tells whether that happened too early.
+ */
+typedef struct {
+    adcsample_t *samples;
+    size_t n;
+    uint32_t seq;
+    /* Realtime counter value at the end of the block. */
+    rtcnt_t ts;
+    /* Trigger timer ticks from the start to the first set of the block,
+       exact, 0 without a trigger timer. */
+    uint64_t tick;
+    /* Trigger timer ticks from the last trigger of the block to its
+       callback. */
+    gptcnt_t latency;
+    /* Blocks dropped between the previous read and this one. */
+    uint32_t lost;
+} adcs_block_t;
+
+typedef struct {
+    /* Completed blocks, first and second halves. */
+    uint32_t blocks;
+    uint32_t half;
+    uint32_t full;
+    /* Blocks overwritten before being read, and read but released late. */
+    uint32_t overruns;
+    uint32_t late;
+    /* ADC errors, all and by cause. */
+    uint32_t errors;
+    uint32_t dmaerrors;
+    uint32_t overflows;
+    adcerror_t lasterr;
+    /* Conversions restarted after an overflow. */
+    uint32_t restarts;
+} adcs_stats_t;
+
+typedef struct {
+    ADCDriver *adcp;
+    /* Template group, the stream forces circular mode and its callbacks. */
+    const ADCConversionGroup *grpp;
+    /* Circular buffer, depth sample sets, depth must be even. */
+    adcsample_t *buf;
+    size_t depth;
+    /* Optional trigger timer, already started, and its period in ticks. */
+    GPTDriver *gptp;
+    gptcnt_t interval;
+    /* Optional error accounting, NULL if unused. */
+    adcerr_t *errp;
+    /* Restart the conversion after an ADC overflow instead of ending the
+       stream, the tick of the blocks is no longer exact afterwards. */
+    bool restart;
+} ADCStreamConfig;
+
+typedef struct {
+    adcs_state_t state;
+    const ADCStreamConfig *config;
+    ADCConversionGroup grp;
+    /* Written by the ISR only: sequence number of the next block. */
+    volatile uint32_t head;
+    /* Written by the consumer only: next sequence number to read. */
+    uint32_t tail;
+    rtcnt_t ts[2];
+    gptcnt_t lat[2];
+    thread_reference_t trp;
+    adcs_stats_t stats;
+} ADCStreamDriver;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+#define adcsRead(asp, bp)               adcsReadTimeout(asp, bp, TIME_INFINITE)
+
+#define adcsGetState(asp)               ((asp)->state)
+
+/* Frequency of the block tick field, the trigger timer clock. */
+#define adcsGetTickFrequency(asp)       ((asp)->config->gptp->config->frequency)
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void adcsObjectInit(ADCStreamDriver *asp);
+  void adcsStart(ADCStreamDriver *asp, const ADCStreamConfig *config);
+  void adcsStop(ADCStreamDriver *asp);
+  msg_t adcsReadTimeout(ADCStreamDriver *asp, adcs_block_t *bp,
+                        sysinterval_t timeout);
+  bool adcsRelease(ADCStreamDriver *asp, const adcs_block_t *bp);
+  void adcsGetStats(ADCStreamDriver *asp, adcs_stats_t *sp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADCSTREAM_H__ */
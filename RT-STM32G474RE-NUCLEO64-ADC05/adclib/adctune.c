@@ -0,0 +1,180 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "adctune.h"
+#include "adcstats.h"
+
+#include <string.h>
+
+#if ADCTUNE_SETS > ADCSTATS_MAX_BLOCK_SETS
+#error "ADCTUNE_SETS above ADCSTATS_MAX_BLOCK_SETS"
+#endif
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+static const char *const smpnames[ADCTUNE_NUM_SMP] = {
+  "ADC_SMPR_SMP_2P5",   "ADC_SMPR_SMP_6P5",   "ADC_SMPR_SMP_12P5",
+  "ADC_SMPR_SMP_24P5",  "ADC_SMPR_SMP_47P5",  "ADC_SMPR_SMP_92P5",
+  "ADC_SMPR_SMP_247P5", "ADC_SMPR_SMP_640P5"
+};
+
+/* Sweep buffers, the tuning runs from one thread at a time. */
+CC_ALIGN_DATA(4) static adcsample_t tunebuf[2U * ADCTUNE_SETS];
+static adcstats_t tunestats;
+static ADCConversionGroup tunegrp;
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static void setSmp(ADCConversionGroup *grpp, unsigned ch, unsigned smp) {
+  unsigned reg = ch / 10U, pos = 3U * (ch % 10U);
+
+  grpp->smpr[reg] = (grpp->smpr[reg] & ~(7U << pos)) | ((uint32_t)smp << pos);
+}
+
+static unsigned getSmp(const ADCConversionGroup *grpp, unsigned ch) {
+
+  return (grpp->smpr[ch / 10U] >> (3U * (ch % 10U))) & 7U;
+}
+
+/* Continuous sequence aggressor at the reference time, then ch at smp. */
+static void buildGroup(unsigned ch, unsigned aggressor, unsigned smp) {
+
+  memset(&tunegrp, 0, sizeof(tunegrp));
+  tunegrp.circular = false;
+  tunegrp.cfgr = ADCGRP_CONTINUOUS;
+  tunegrp.tr1 = ADC_TR_DISABLED;
+  tunegrp.tr2 = ADC_TR_DISABLED;
+  tunegrp.tr3 = ADC_TR_DISABLED;
+  if (aggressor == ADCTUNE_NO_CHANNEL) {
+    tunegrp.num_channels = 1U;
+    tunegrp.sqr[0] = (uint32_t)ch << 6;
+  }
+  else {
+    tunegrp.num_channels = 2U;
+    tunegrp.sqr[0] = ((uint32_t)aggressor << 6) | ((uint32_t)ch << 12);
+    setSmp(&tunegrp, aggressor, ADCTUNE_REF_SMP);
+  }
+  setSmp(&tunegrp, ch, smp);
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/*
+ * Sweeps the sample times of ch converted after aggressor, or alone with
+ * ADCTUNE_NO_CHANNEL. The caller owns the ADC and no conversion is running.
+ */
+msg_t adctuneChannel(ADCDriver *adcp, const adctune_config_t *config,
+                     unsigned ch, unsigned aggressor,
+                     adctune_result_t *rp) {
+  unsigned nch = aggressor == ADCTUNE_NO_CHANNEL ? 1U : 2U;
+  uint32_t refmean;
+
+  osalDbgCheck((adcp != NULL) && (config != NULL) && (rp != NULL) &&
+               (ch <= ADCTUNE_MAX_CHANNEL) && (ch != aggressor) &&
+               ((aggressor <= ADCTUNE_MAX_CHANNEL) ||
+                (aggressor == ADCTUNE_NO_CHANNEL)));
+
+  rp->channel = (uint8_t)ch;
+  rp->aggressor = (uint8_t)aggressor;
+
+  for (unsigned smp = 0U; smp < ADCTUNE_NUM_SMP; smp++) {
+    adcstats_result_t r;
+    msg_t msg;
+
+    buildGroup(ch, aggressor, smp);
+    msg = adcConvert(adcp, &tunegrp, tunebuf, ADCTUNE_SETS);
+    if (msg != MSG_OK) {
+      return msg;
+    }
+    adcstatsInit(&tunestats, nch, 0U, 0U);
+    adcstatsFeed(&tunestats, tunebuf, ADCTUNE_SETS);
+    adcstatsGet(&tunestats, nch - 1U, ADCSTATS_RUNNING, &r);
+    rp->mean[smp] = r.mean;
+    rp->stddev[smp] = r.stddev;
+  }
+
+  /* Fastest setting with all the longer ones within the tolerances.*/
+  refmean = rp->mean[ADCTUNE_REF_SMP];
+  rp->smp = ADCTUNE_REF_SMP;
+  for (unsigned smp = 0U; smp < ADCTUNE_NUM_SMP; smp++) {
+    rp->err[smp] = ((int32_t)rp->mean[smp] - (int32_t)refmean) / 256;
+  }
+  for (int smp = (int)ADCTUNE_REF_SMP - 1; smp >= 0; smp--) {
+    uint32_t aerr = rp->err[smp] < 0 ? (uint32_t)-rp->err[smp] :
+                                       (uint32_t)rp->err[smp];
+
+    if ((aerr > config->maxerr) ||
+        (rp->stddev[smp] > rp->stddev[ADCTUNE_REF_SMP] + config->maxnoise)) {
+      break;
+    }
+    rp->smp = (uint8_t)smp;
+  }
+  return MSG_OK;
+}
+
+void adctuneTableInit(adctune_table_t *tp) {
+
+  tp->tuned = 0U;
+  memset(tp->smp, 0, sizeof(tp->smp));
+}
+
+void adctuneStore(adctune_table_t *tp, const adctune_result_t *rp) {
+
+  tp->smp[rp->channel] = rp->smp;
+  tp->tuned |= 1U << rp->channel;
+}
+
+/* Rewrites the sample times of the tuned channels in a group. */
+void adctuneApply(const adctune_table_t *tp, ADCConversionGroup *grpp) {
+
+  for (unsigned ch = 0U; ch <= ADCTUNE_MAX_CHANNEL; ch++) {
+    if ((tp->tuned & (1U << ch)) != 0U) {
+      setSmp(grpp, ch, tp->smp[ch]);
+    }
+  }
+}
+
+/* Channel at a rank of the regular sequence, from 0. */
+unsigned adctuneGetChannel(const ADCConversionGroup *grpp, unsigned rank) {
+
+  if (rank < 4U) {
+    return (grpp->sqr[0] >> (6U * (rank + 1U))) & 0x1FU;
+  }
+  rank -= 4U;
+  return (grpp->sqr[1U + rank / 5U] >> (6U * (rank % 5U))) & 0x1FU;
+}
+
+/* Conversion time of the whole regular sequence, in half ADC cycles. */
+uint32_t adctuneGroupHalfcycles(const ADCConversionGroup *grpp) {
+  uint32_t hc = 0U;
+
+  for (unsigned i = 0U; i < grpp->num_channels; i++) {
+    unsigned ch = adctuneGetChannel(grpp, i);
+
+    hc += ADCGRP_HALFCYCLES(ADCGRP_CH(ch, getSmp(grpp, ch)));
+  }
+  return hc;
+}
+
+/* Name of a sample time as used in the adcgrp sequences. */
+const char *adctuneSmpName(unsigned smp) {
+
+  return smp < ADCTUNE_NUM_SMP ? smpnames[smp] : "?";
+}
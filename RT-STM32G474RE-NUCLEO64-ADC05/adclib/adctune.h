@@ -0,0 +1,122 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Sample time tuning. A channel is converted ADCTUNE_SETS times at each
+ * of the eight sample times, right after an aggressor channel sampled at
+ * the longest one, so the sampling capacitor starts from the aggressor
+ * voltage as it does in a real sequence. The mean at 640.5 cycles is the
+ * reference: the settling error of a setting is its mean minus the
+ * reference, the noise its standard deviation. The recommendation is the
+ * fastest setting that, with all the longer ones, stays within the
+ * tolerances. Results go to a table that patches the sample times of a
+ * conversion group built by adcgrp.
+ */
+
+#ifndef __ADCTUNE_H__
+#define __ADCTUNE_H__
+
+#include "ch.h"
+#include "hal.h"
+
+#include "adcgrp.h"
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+#define ADCTUNE_NUM_SMP                 8U
+#define ADCTUNE_REF_SMP                 ADC_SMPR_SMP_640P5
+#define ADCTUNE_MAX_CHANNEL             18U
+
+/* Aggressor value for a channel converted alone. */
+#define ADCTUNE_NO_CHANNEL              0xFFU
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Conversions per sample time.
+ */
+#if !defined(ADCTUNE_SETS)
+#define ADCTUNE_SETS                    256U
+#endif
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if !HAL_USE_ADC
+#error "ADC tuning requires HAL_USE_ADC"
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+typedef struct {
+    /* Largest settling error and extra standard deviation over the
+       reference accepted, Q8 counts. */
+    uint32_t maxerr;
+    uint32_t maxnoise;
+} adctune_config_t;
+
+typedef struct {
+    uint8_t channel;
+    uint8_t aggressor;
+    /* Per sample time: mean Q16, standard deviation Q8, and mean minus
+       the reference mean Q8, all in counts. */
+    uint32_t mean[ADCTUNE_NUM_SMP];
+    uint32_t stddev[ADCTUNE_NUM_SMP];
+    int32_t err[ADCTUNE_NUM_SMP];
+    /* Recommended ADC_SMPR_SMP_xxx. */
+    uint8_t smp;
+} adctune_result_t;
+
+/* Tuned sample time of each channel, for adctuneApply(). */
+typedef struct {
+    uint32_t tuned;
+    uint8_t smp[ADCTUNE_MAX_CHANNEL + 1U];
+} adctune_table_t;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/* Highest trigger rate of a sequence of halfcycles, in Hz. */
+#define ADCTUNE_MAX_RATE(halfcycles)                                        \
+  ((uint32_t)(2ULL * ADCGRP_ADCCLK / (halfcycles)))
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  msg_t adctuneChannel(ADCDriver *adcp, const adctune_config_t *config,
+                       unsigned ch, unsigned aggressor,
+                       adctune_result_t *rp);
+  void adctuneTableInit(adctune_table_t *tp);
+  void adctuneStore(adctune_table_t *tp, const adctune_result_t *rp);
+  void adctuneApply(const adctune_table_t *tp, ADCConversionGroup *grpp);
+  unsigned adctuneGetChannel(const ADCConversionGroup *grpp, unsigned rank);
+  uint32_t adctuneGroupHalfcycles(const ADCConversionGroup *grpp);
+  const char *adctuneSmpName(unsigned smp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADCTUNE_H__ */
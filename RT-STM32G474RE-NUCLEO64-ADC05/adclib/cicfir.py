@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""
+Compensating FIR design for the adcdecim CIC + FIR pipeline.
+
+Designs a linear-phase low-pass FIR that runs after a CIC decimator of the
+given order and ratio. In the passband it flattens the CIC droop, above the
+output Nyquist frequency it rejects, and its DC gain is exactly 1.0. The taps
+are printed as a Q15 C table for adcdecim_config_t.
+
+Example:
+  cicfir.py --order 3 --log2r 4 --m 4 --taps 48 --name cic3r16m4
+"""
+
+import argparse
+import math
+
+
+def cic_response(f, order, r):
+    """CIC gain normalized to 1 at DC, f in cycles per CIC output sample."""
+    if f == 0.0:
+        return 1.0
+    num = math.sin(math.pi * f)
+    den = r * math.sin(math.pi * f / r)
+    return abs(num / den) ** order
+
+
+def design(order, r, m, taps, passband, grid=2048):
+    fp = passband * 0.5 / m
+    fs = 0.5 / m
+    desired = []
+    for k in range(grid + 1):
+        f = 0.5 * k / grid
+        if f <= fp:
+            d = 1.0 / cic_response(f, order, r) if order > 0 else 1.0
+        elif f < fs:
+            d0 = 1.0 / cic_response(fp, order, r) if order > 0 else 1.0
+            d = d0 * (fs - f) / (fs - fp)
+        else:
+            d = 0.0
+        desired.append(d)
+
+    # Frequency sampling of the zero-phase response, Blackman window
+    mid = (taps - 1) / 2.0
+    h = []
+    for n in range(taps):
+        t = n - mid
+        acc = 0.0
+        for k, d in enumerate(desired):
+            w = 0.5 if k in (0, grid) else 1.0
+            acc += w * d * math.cos(2.0 * math.pi * (0.5 * k / grid) * t)
+        acc /= grid
+        win = (0.42 - 0.5 * math.cos(2.0 * math.pi * n / (taps - 1)) +
+               0.08 * math.cos(4.0 * math.pi * n / (taps - 1)))
+        h.append(acc * win)
+
+    dc = sum(h)
+    h = [v / dc for v in h]
+
+    # Q15 rounding, the centre taps absorb the residue so the DC gain is exact
+    q = [int(round(v * 32768.0)) for v in h]
+    res = 32768 - sum(q)
+    if taps % 2:
+        q[taps // 2] += res
+    else:
+        q[taps // 2 - 1] += res // 2
+        q[taps // 2] += res - res // 2
+    return q
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('--order', type=int, default=3, help='CIC order, 0 for none')
+    ap.add_argument('--log2r', type=int, default=4, help='CIC ratio as power of two')
+    ap.add_argument('--m', type=int, default=4, help='FIR decimation ratio')
+    ap.add_argument('--taps', type=int, default=48, help='FIR length')
+    ap.add_argument('--passband', type=float, default=0.8,
+                    help='passband edge as a fraction of the output Nyquist')
+    ap.add_argument('--name', default='fir', help='C table name suffix')
+    args = ap.parse_args()
+
+    q = design(args.order, 1 << args.log2r, args.m, args.taps, args.passband)
+
+    print('/* cicfir.py --order %d --log2r %d --m %d --taps %d --passband %g */' %
+          (args.order, args.log2r, args.m, args.taps, args.passband))
+    print('static const int16_t %s_taps[%d] = {' % (args.name, args.taps))
+    for i in range(0, len(q), 8):
+        print('  ' + ', '.join('%6d' % v for v in q[i:i + 8]) + ',')
+    print('};')
+
+
+if __name__ == '__main__':
+    main()
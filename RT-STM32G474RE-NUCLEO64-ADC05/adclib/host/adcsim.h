@@ -0,0 +1,89 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Host ADC simulator. Each started driver has a thread standing for the
+ * DMA and the ADC interrupt: it writes the sample sets of the running
+ * group into its buffer and calls the callbacks with the same state
+ * transitions as the ADCv3 LLD, half and full in circular mode, full and
+ * stop in linear mode, stop and error_cb on an injected error.
+ *
+ * Set rate: a group with EXTEN set converts at the rate of the timer its
+ * EXTSEL selects (ADC12 table of adcgrp.h), only while that GPT runs in
+ * continuous mode, a discontinuous group one subgroup per update. A
+ * software or continuous group converts at the rate its sample times give
+ * at ADCGRP_ADCCLK, oversampling included.
+ *
+ * Sample values are per channel: dc + amp * sin(2 pi freq t) plus a step
+ * of height step toggling every period seconds plus gaussian noise, t is
+ * the set index over the set rate, so frequencies are right in both modes.
+ * A replay file replaces the generators, one set per line, one column per
+ * rank, looping at the end.
+ *
+ * Modes: ADCSIM_REALTIME fires each callback at the wall clock time the
+ * MCU would, a slow consumer loses blocks as it would there. ADCSIM_FAST
+ * fires the next callback as soon as every kernel thread is blocked, the
+ * moment an idle MCU would take the next interrupt: no block is ever
+ * lost, the run is deterministic and as fast as the pipeline allows.
+ * With several drivers running the callbacks follow a simulated clock,
+ * the earliest first, so ADCs on the same trigger stay in step.
+ * Threads polling without blocking stall the fast mode.
+ */
+
+#ifndef __ADCSIM_H__
+#define __ADCSIM_H__
+
+#include "ch.h"
+#include "hal.h"
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+typedef enum {
+    ADCSIM_REALTIME = 0,
+    ADCSIM_FAST = 1
+} adcsim_mode_t;
+
+/* Signal of one channel, counts, Hz and seconds. */
+typedef struct {
+    double dc;
+    double amp;
+    double freq;
+    double step;
+    double period;
+    double noise;
+} adcsim_source_t;
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void adcsimSetMode(adcsim_mode_t mode);
+  void adcsimSetSeed(ADCDriver *adcp, uint64_t seed);
+  void adcsimSetSource(ADCDriver *adcp, unsigned ch,
+                       const adcsim_source_t *srcp);
+  bool adcsimParseSource(const char *spec, adcsim_source_t *srcp);
+  bool adcsimLoadFile(ADCDriver *adcp, const char *path, unsigned skip);
+  void adcsimInjectError(ADCDriver *adcp, adcerror_t err);
+  uint64_t adcsimGetSets(ADCDriver *adcp);
+  double adcsimGetRate(ADCDriver *adcp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADCSIM_H__ */
@@ -0,0 +1,413 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Checks the trigger logic of adccap.c on synthetic stream blocks. Every
+ * sample is a function of its set number, so each capture can be checked
+ * set by set: trigger set and position, the pre and post sets around it
+ * in order, holdoff spacing, single and auto modes, adccapForce(), slope
+ * history across a block boundary and the refill of the pre-trigger sets
+ * after a lost block.
+ *
+ * Usage:
+ *   captest
+ *
+ * Exit status 1 on the first mismatch.
+ */
+
+#include "ch.h"
+#include "hal.h"
+
+#include "adccap.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define NCH             2U
+#define BLOCK_SETS      100U
+#define PRE             137U
+#define POST            211U
+#define MAX_BLOCKS      400U
+
+/* Trigger channel as a function of the set number, the other one counts. */
+typedef adcsample_t (*signal_t)(uint64_t set);
+
+static adcsample_t block[BLOCK_SETS * NCH];
+static adcsample_t ring[ADCCAP_BUF_SIZE(PRE, POST, NCH)];
+static const char *casename;
+static signal_t sigfn;
+static uint32_t seq;
+static unsigned checks;
+
+#define EXPECT(cond)                                                        \
+  do {                                                                      \
+    checks++;                                                               \
+    if (!(cond)) {                                                          \
+      printf("captest: %s: %s failed, line %d\n", casename, #cond,          \
+             __LINE__);                                                     \
+      return false;                                                         \
+    }                                                                       \
+  } while (false)
+
+/* Square wave of period 1000 sets, rising at 500 and falling at 1000. */
+static adcsample_t square(uint64_t set) {
+
+  return set % 1000U < 500U ? 1000U : 3000U;
+}
+
+/* Flat, with a ramp of 3 per set from set 700 of every 1000. */
+static adcsample_t ramp(uint64_t set) {
+  unsigned ph = (unsigned)(set % 1000U);
+
+  return ph < 700U ? 2000U : (adcsample_t)(2000U + (ph - 700U) * 3U);
+}
+
+/* The same ramp from set 798, its slope span crosses a block boundary. */
+static adcsample_t rampLate(uint64_t set) {
+
+  return ramp(set + 700U - 798U);
+}
+
+/* Flat inside the window but for set 3456. */
+static adcsample_t spike(uint64_t set) {
+
+  return set == 3456U ? 3900U : 2000U;
+}
+
+static void start(adccap_t *cp, const adccap_config_t *cfg, signal_t sig,
+                  const char *name) {
+
+  adccapStart(cp, cfg);
+  sigfn = sig;
+  casename = name;
+  seq = 0U;
+}
+
+/* Feeds the next block after dropping lost ones. */
+static bool feed(adccap_t *cp, uint32_t lost) {
+  adcs_block_t b;
+
+  seq += lost;
+  for (unsigned i = 0; i < BLOCK_SETS; i++) {
+    uint64_t set = (uint64_t)seq * BLOCK_SETS + i;
+
+    block[i * NCH] = sigfn(set);
+    block[i * NCH + 1U] = (adcsample_t)(set & 0xFFFFU);
+  }
+  memset(&b, 0, sizeof(b));
+  b.samples = block;
+  b.n = BLOCK_SETS;
+  b.seq = seq++;
+  b.lost = lost;
+  return adccapFeed(cp, &b);
+}
+
+/* Takes the capture completed by the last block and checks every set. */
+static bool take(adccap_t *cp, adccap_capture_t *capp) {
+
+  EXPECT(adccapGet(cp, capp));
+  EXPECT(capp->n == PRE + POST && capp->trigger == PRE);
+  EXPECT(capp->set >= PRE);
+  for (size_t i = 0; i < capp->n; i++) {
+    uint64_t set = capp->set - PRE + i;
+
+    EXPECT(capp->samples[i * NCH] == sigfn(set));
+    EXPECT(capp->samples[i * NCH + 1U] == (adcsample_t)(set & 0xFFFFU));
+  }
+  return true;
+}
+
+static bool checkEdges(adccap_t *cp, adccap_config_t *cfg) {
+  static const struct {
+    unsigned edge;
+    unsigned every;
+    unsigned at;
+    const char *name;
+  } cases[] = {
+    {ADCCAP_RISING,  1000U, 500U, "rising edge"},
+    {ADCCAP_FALLING, 1000U, 0U,   "falling edge"},
+    {ADCCAP_BOTH,    500U,  0U,   "both edges"}
+  };
+  adccap_capture_t cap;
+
+  for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+    uint64_t last = 0U;
+    unsigned got = 0U;
+
+    cfg->edge = cases[c].edge;
+    start(cp, cfg, square, cases[c].name);
+    for (unsigned k = 0; k < MAX_BLOCKS && got < 6U; k++) {
+      if (!feed(cp, 0U)) {
+        continue;
+      }
+      if (!take(cp, &cap)) {
+        return false;
+      }
+      EXPECT(cap.set % cases[c].every == cases[c].at && !cap.forced);
+      /* Every edge once the ring is full, as the next one is past POST.*/
+      EXPECT(got == 0U || cap.set - last == cases[c].every);
+      EXPECT(cap.number == got + 1U);
+      last = cap.set;
+      got++;
+      adccapRelease(cp);
+    }
+    EXPECT(got == 6U);
+  }
+  cfg->edge = ADCCAP_RISING;
+  return true;
+}
+
+static bool checkHoldoff(adccap_t *cp, adccap_config_t *cfg) {
+  adccap_capture_t cap;
+  uint64_t last = 0U;
+  unsigned got = 0U;
+
+  /* Rising edges every 1000 sets, the one after each trigger is skipped.*/
+  cfg->holdoff = 1700U;
+  start(cp, cfg, square, "holdoff");
+  for (unsigned k = 0; k < MAX_BLOCKS && got < 4U; k++) {
+    if (!feed(cp, 0U)) {
+      continue;
+    }
+    if (!take(cp, &cap)) {
+      return false;
+    }
+    EXPECT(got == 0U || cap.set - last == 2000U);
+    last = cap.set;
+    got++;
+    adccapRelease(cp);
+  }
+  EXPECT(got == 4U);
+  cfg->holdoff = 0U;
+  return true;
+}
+
+static bool checkSingle(adccap_t *cp, adccap_config_t *cfg) {
+  adccap_capture_t cap;
+  unsigned got = 0U;
+
+  cfg->mode = ADCCAP_SINGLE;
+  start(cp, cfg, square, "single");
+  for (unsigned k = 0; k < 50U; k++) {
+    if (feed(cp, 0U)) {
+      if (!take(cp, &cap)) {
+        return false;
+      }
+      EXPECT(cap.set == 500U);
+      got++;
+      adccapRelease(cp);
+    }
+  }
+  EXPECT(got == 1U && adccapGetState(cp) == ADCCAP_STOP);
+
+  /* Re-armed at block 50, the ring refills before the edge at 5500.*/
+  adccapArm(cp);
+  for (unsigned k = 0; k < 20U; k++) {
+    if (feed(cp, 0U)) {
+      if (!take(cp, &cap)) {
+        return false;
+      }
+      EXPECT(cap.set == 5500U);
+      got++;
+      adccapRelease(cp);
+    }
+  }
+  EXPECT(got == 2U);
+  cfg->mode = ADCCAP_NORMAL;
+  return true;
+}
+
+static bool checkAuto(adccap_t *cp, adccap_config_t *cfg) {
+  adccap_capture_t cap;
+  uint64_t last = 0U;
+  unsigned got = 0U;
+
+  /* The level is never crossed, every capture is forced autosets sets
+     after the ring refilled, from the block after the last capture.*/
+  cfg->mode = ADCCAP_AUTO;
+  cfg->autosets = 250U;
+  cfg->level = 3500U;
+  start(cp, cfg, square, "auto");
+  for (unsigned k = 0; k < MAX_BLOCKS && got < 8U; k++) {
+    if (!feed(cp, 0U)) {
+      continue;
+    }
+    if (!take(cp, &cap)) {
+      return false;
+    }
+    EXPECT(cap.forced);
+    if (got == 0U) {
+      EXPECT(cap.set == PRE + 250U);
+    }
+    else {
+      uint64_t refill = (last + POST + BLOCK_SETS - 1U) /
+                        BLOCK_SETS * BLOCK_SETS;
+
+      EXPECT(cap.set == refill + PRE + 250U);
+    }
+    last = cap.set;
+    got++;
+    adccapRelease(cp);
+  }
+  EXPECT(got == 8U);
+  cfg->mode = ADCCAP_NORMAL;
+  cfg->level = 2000U;
+  return true;
+}
+
+static bool checkForce(adccap_t *cp, adccap_config_t *cfg) {
+  adccap_capture_t cap;
+  bool done = false;
+
+  /* Forced on the first set fed after adccapForce(), set 300.*/
+  cfg->level = 3500U;
+  start(cp, cfg, square, "force");
+  for (unsigned k = 0; k < 3U; k++) {
+    EXPECT(!feed(cp, 0U));
+  }
+  adccapForce(cp);
+  for (unsigned k = 0; k < 3U && !done; k++) {
+    done = feed(cp, 0U);
+  }
+  EXPECT(done);
+  if (!take(cp, &cap)) {
+    return false;
+  }
+  EXPECT(cap.forced && cap.set == 300U);
+  adccapRelease(cp);
+  cfg->level = 2000U;
+  return true;
+}
+
+static bool checkLevel(adccap_t *cp, adccap_config_t *cfg) {
+  adccap_capture_t cap;
+  unsigned got = 0U;
+
+  cfg->trigger = ADCCAP_LEVEL;
+  start(cp, cfg, square, "level");
+  for (unsigned k = 0; k < 20U; k++) {
+    if (feed(cp, 0U)) {
+      if (!take(cp, &cap)) {
+        return false;
+      }
+      EXPECT(cap.samples[cap.trigger * NCH] >= cfg->level);
+      got++;
+      adccapRelease(cp);
+    }
+  }
+  EXPECT(got > 2U);
+  cfg->trigger = ADCCAP_EDGE;
+  return true;
+}
+
+static bool checkSlope(adccap_t *cp, adccap_config_t *cfg) {
+  static const struct {
+    signal_t sig;
+    unsigned at;
+    const char *name;
+  } cases[] = {
+    /* 3 per set over a span of 4 sets reaches 10 at the fourth set.*/
+    {ramp,     704U, "slope"},
+    {rampLate, 802U, "slope across blocks"}
+  };
+  adccap_capture_t cap;
+
+  cfg->trigger = ADCCAP_SLOPE;
+  cfg->span = 4U;
+  cfg->slope = 10U;
+  for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+    unsigned got = 0U;
+
+    start(cp, cfg, cases[c].sig, cases[c].name);
+    for (unsigned k = 0; k < MAX_BLOCKS && got < 5U; k++) {
+      if (feed(cp, 0U)) {
+        if (!take(cp, &cap)) {
+          return false;
+        }
+        EXPECT(cap.set == cases[c].at + 1000U * got);
+        got++;
+        adccapRelease(cp);
+      }
+    }
+    EXPECT(got == 5U);
+  }
+  cfg->trigger = ADCCAP_EDGE;
+  return true;
+}
+
+static bool checkWindow(adccap_t *cp, adccap_config_t *cfg) {
+  static const struct {
+    uint32_t lostat;
+    unsigned captures;
+    const char *name;
+  } cases[] = {
+    {0U,  1U, "window"},
+    /* The block lost before the hit leaves time to refill PRE sets.*/
+    {30U, 1U, "window, refill after a gap"},
+    /* Lost right before it, the ring is not full again at set 3456.*/
+    {33U, 0U, "window, gap too close"}
+  };
+  adccap_capture_t cap;
+
+  cfg->trigger = ADCCAP_WINDOW;
+  cfg->low = 1000U;
+  cfg->high = 3000U;
+  for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+    unsigned got = 0U;
+
+    start(cp, cfg, spike, cases[c].name);
+    for (unsigned k = 0; k < 60U; k++) {
+      if (feed(cp, k == cases[c].lostat && k > 0U ? 1U : 0U)) {
+        if (!take(cp, &cap)) {
+          return false;
+        }
+        EXPECT(cap.set == 3456U);
+        got++;
+        adccapRelease(cp);
+      }
+    }
+    EXPECT(got == cases[c].captures);
+  }
+  cfg->trigger = ADCCAP_EDGE;
+  return true;
+}
+
+int main(void) {
+  static bool (*const suite[])(adccap_t *, adccap_config_t *) = {
+    checkEdges, checkHoldoff, checkSingle, checkAuto, checkForce,
+    checkLevel, checkSlope, checkWindow
+  };
+  adccap_config_t cfg = {
+    .trigger  = ADCCAP_EDGE,
+    .mode     = ADCCAP_NORMAL,
+    .edge     = ADCCAP_RISING,
+    .channel  = 0U,
+    .nch      = NCH,
+    .level    = 2000U,
+    .hyst     = 100U,
+    .pre      = PRE,
+    .post     = POST,
+    .buf      = ring
+  };
+  adccap_t cap;
+
+  adccapObjectInit(&cap);
+  for (size_t i = 0; i < sizeof(suite) / sizeof(suite[0]); i++) {
+    if (!suite[i](&cap, &cfg)) {
+      return 1;
+    }
+  }
+  printf("captest: %u checks, captures as expected\n", checks);
+  return 0;
+}
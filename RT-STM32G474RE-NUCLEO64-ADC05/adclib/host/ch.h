@@ -0,0 +1,281 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Host build of the ChibiOS/RT subset used by adclib, over POSIX threads.
+ * One global mutex stands for the interrupt mask: chSysLock() takes it and
+ * the simulated ISRs run holding it, so a lock zone excludes the callbacks
+ * as it does on the MCU. Blocked threads wait on one condition variable
+ * and are woken explicitly, which also tells the simulator when every
+ * thread is blocked, the moment an idle MCU would take the next interrupt.
+ * Priorities are ignored, the working areas are unused.
+ */
+
+#ifndef __CH_H__
+#define __CH_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+/*===========================================================================*/
+/* Kernel settings.                                                          */
+/*===========================================================================*/
+
+#define TRUE                            1
+#define FALSE                           0
+
+#define CH_CFG_ST_FREQUENCY             10000
+#define CH_CFG_USE_SEMAPHORES           FALSE
+#define CH_CFG_USE_MUTEXES              TRUE
+#define CH_CFG_USE_EVENTS               TRUE
+#define CH_CFG_USE_MAILBOXES            TRUE
+#define CH_CFG_USE_OBJ_FIFOS            TRUE
+#define CH_CFG_USE_WAITEXIT             TRUE
+
+#define PORT_NATURAL_ALIGN              sizeof(void *)
+
+/*===========================================================================*/
+/* Kernel types.                                                             */
+/*===========================================================================*/
+
+/* Wide enough for the pointers posted to mailboxes on a 64 bits host. */
+typedef intptr_t msg_t;
+typedef uint32_t systime_t;
+typedef uint32_t sysinterval_t;
+typedef uint32_t rtcnt_t;
+typedef int32_t cnt_t;
+typedef uint32_t tprio_t;
+typedef uint32_t eventmask_t;
+typedef uint32_t eventflags_t;
+typedef uint64_t stkalign_t;
+typedef void (*tfunc_t)(void *p);
+
+typedef struct ch_thread thread_t;
+typedef thread_t *thread_reference_t;
+
+/* Threads blocked on an object, woken in order. */
+typedef struct {
+    thread_t *head;
+} ch_waitq_t;
+
+struct ch_thread {
+    pthread_t tid;
+    const char *name;
+    tfunc_t fn;
+    void *arg;
+    /* Blocked in a kernel wait, cleared by the waker. */
+    bool blocked;
+    msg_t rdymsg;
+    thread_t *qnext;
+    eventmask_t epending;
+    eventmask_t ewmask;
+    bool terminate;
+    bool done;
+    msg_t exitcode;
+    ch_waitq_t waiting;
+};
+
+typedef struct {
+    pthread_mutex_t pm;
+} mutex_t;
+
+typedef struct event_listener {
+    struct event_listener *next;
+    thread_t *listener;
+    eventmask_t events;
+    eventflags_t flags;
+    eventflags_t wflags;
+} event_listener_t;
+
+typedef struct {
+    event_listener_t *next;
+} event_source_t;
+
+typedef struct {
+    msg_t *buffer;
+    msg_t *top;
+    msg_t *wrptr;
+    msg_t *rdptr;
+    size_t cnt;
+    bool reset;
+    ch_waitq_t qw;
+} mailbox_t;
+
+/* Free objects kept in a mailbox of pointers. */
+typedef struct {
+    mailbox_t free;
+    size_t objsize;
+} objects_fifo_t;
+
+/*===========================================================================*/
+/* Kernel constants and macros.                                              */
+/*===========================================================================*/
+
+#define MSG_OK                          ((msg_t)0)
+#define MSG_TIMEOUT                     ((msg_t)-1)
+#define MSG_RESET                       ((msg_t)-2)
+
+#define TIME_IMMEDIATE                  ((sysinterval_t)0)
+#define TIME_INFINITE                   ((sysinterval_t)-1)
+
+#define LOWPRIO                         ((tprio_t)1)
+#define NORMALPRIO                      ((tprio_t)128)
+#define HIGHPRIO                        ((tprio_t)255)
+
+#define ALL_EVENTS                      ((eventmask_t)-1)
+#define EVENT_MASK(eid)                 ((eventmask_t)1 << (eventmask_t)(eid))
+
+#define TIME_S2I(s)                                                         \
+  ((sysinterval_t)((uint64_t)(s) * CH_CFG_ST_FREQUENCY))
+#define TIME_MS2I(ms)                                                       \
+  ((sysinterval_t)(((uint64_t)(ms) * CH_CFG_ST_FREQUENCY + 999U) / 1000U))
+#define TIME_US2I(us)                                                       \
+  ((sysinterval_t)(((uint64_t)(us) * CH_CFG_ST_FREQUENCY + 999999U) /       \
+                   1000000U))
+#define TIME_I2S(i)                     ((uint32_t)((i) / CH_CFG_ST_FREQUENCY))
+#define TIME_I2MS(i)                                                        \
+  ((uint32_t)((uint64_t)(i) * 1000U / CH_CFG_ST_FREQUENCY))
+#define TIME_I2US(i)                                                        \
+  ((uint32_t)((uint64_t)(i) * 1000000U / CH_CFG_ST_FREQUENCY))
+
+#define chTimeDiffX(start, end)         ((sysinterval_t)((end) - (start)))
+#define chTimeAddX(t, i)                ((systime_t)((t) + (i)))
+#define chVTGetSystemTime()             chVTGetSystemTimeX()
+#define chVTTimeElapsedSinceX(start)                                        \
+  chTimeDiffX((start), chVTGetSystemTimeX())
+
+/* Realtime counter ticks to microseconds, the host counter is in ns. */
+#define RTC2US(freq, n)                                                     \
+  ((uint32_t)(((uint64_t)(n) * 1000000U + (freq) - 1U) / (freq)))
+
+#define THD_WORKING_AREA(s, n)          stkalign_t s[(n) / sizeof(stkalign_t)]
+#define THD_FUNCTION(tname, arg)        void tname(void *arg)
+
+#define CC_ALIGN_DATA(n)                __attribute__((aligned(n)))
+
+#define MEM_ALIGN_NEXT(p, a)                                                \
+  (((size_t)(p) + (size_t)(a) - 1U) & ~((size_t)(a) - 1U))
+
+#define chDbgCheck(c)                                                       \
+  do {                                                                      \
+    if (!(c)) {                                                             \
+      chSysHalt(__func__);                                                  \
+    }                                                                       \
+  } while (false)
+
+#define chDbgAssert(c, r)                                                   \
+  do {                                                                      \
+    if (!(c)) {                                                             \
+      chSysHalt(r);                                                         \
+    }                                                                       \
+  } while (false)
+
+#define osalDbgCheck(c)                 chDbgCheck(c)
+#define osalDbgAssert(c, r)             chDbgAssert(c, r)
+#define osalSysLock()                   chSysLock()
+#define osalSysUnlock()                 chSysUnlock()
+#define osalSysLockFromISR()            chSysLockFromISR()
+#define osalSysUnlockFromISR()          chSysUnlockFromISR()
+
+#define chSchRescheduleS()
+
+#define chMBGetUsedCountI(mbp)          ((cnt_t)(mbp)->cnt)
+#define chMBGetFreeCountI(mbp)                                              \
+  ((cnt_t)((size_t)((mbp)->top - (mbp)->buffer) - (mbp)->cnt))
+#define chMBPeekI(mbp)                  (*(mbp)->rdptr)
+#define chMBResumeX(mbp)                ((mbp)->reset = false)
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  /* System. */
+  void chSysInit(void);
+  void chSysHalt(const char *reason);
+  void chSysLock(void);
+  void chSysUnlock(void);
+  void chSysLockFromISR(void);
+  void chSysUnlockFromISR(void);
+  rtcnt_t chSysGetRealtimeCounterX(void);
+  systime_t chVTGetSystemTimeX(void);
+  /* Threads. */
+  thread_t *chThdCreateStatic(void *wsp, size_t size, tprio_t prio,
+                              tfunc_t pf, void *arg);
+  thread_t *chThdGetSelfX(void);
+  void chRegSetThreadName(const char *name);
+  void chThdExit(msg_t msg);
+  msg_t chThdWait(thread_t *tp);
+  void chThdTerminate(thread_t *tp);
+  bool chThdShouldTerminateX(void);
+  void chThdSleep(sysinterval_t time);
+  void chThdSleepMilliseconds(uint32_t ms);
+  void chThdSleepMicroseconds(uint32_t us);
+  void chThdSleepSeconds(uint32_t s);
+  msg_t chThdSuspendTimeoutS(thread_reference_t *trp, sysinterval_t timeout);
+  msg_t chThdSuspendS(thread_reference_t *trp);
+  void chThdResumeI(thread_reference_t *trp, msg_t msg);
+  void chThdResumeS(thread_reference_t *trp, msg_t msg);
+  void chThdResume(thread_reference_t *trp, msg_t msg);
+  /* Mutexes. */
+  void chMtxObjectInit(mutex_t *mp);
+  void chMtxLock(mutex_t *mp);
+  bool chMtxTryLock(mutex_t *mp);
+  void chMtxUnlock(mutex_t *mp);
+  /* Events. */
+  void chEvtObjectInit(event_source_t *esp);
+  void chEvtRegisterMaskWithFlags(event_source_t *esp, event_listener_t *elp,
+                                  eventmask_t events, eventflags_t wflags);
+  void chEvtRegisterMask(event_source_t *esp, event_listener_t *elp,
+                         eventmask_t events);
+  void chEvtUnregister(event_source_t *esp, event_listener_t *elp);
+  void chEvtSignalI(thread_t *tp, eventmask_t events);
+  void chEvtBroadcastFlagsI(event_source_t *esp, eventflags_t flags);
+  void chEvtBroadcastFlags(event_source_t *esp, eventflags_t flags);
+  eventflags_t chEvtGetAndClearFlagsI(event_listener_t *elp);
+  eventflags_t chEvtGetAndClearFlags(event_listener_t *elp);
+  eventmask_t chEvtWaitAnyTimeout(eventmask_t events, sysinterval_t timeout);
+  /* Mailboxes. */
+  void chMBObjectInit(mailbox_t *mbp, msg_t *buf, size_t n);
+  void chMBResetI(mailbox_t *mbp);
+  void chMBReset(mailbox_t *mbp);
+  msg_t chMBPostI(mailbox_t *mbp, msg_t msg);
+  msg_t chMBPostTimeout(mailbox_t *mbp, msg_t msg, sysinterval_t timeout);
+  msg_t chMBFetchI(mailbox_t *mbp, msg_t *msgp);
+  msg_t chMBFetchTimeout(mailbox_t *mbp, msg_t *msgp, sysinterval_t timeout);
+  /* Objects FIFOs, the free list only. */
+  void chFifoObjectInit(objects_fifo_t *ofp, size_t objsize, size_t objn,
+                        void *objbuf, msg_t *msgbuf);
+  void *chFifoTakeObjectI(objects_fifo_t *ofp);
+  void *chFifoTakeObjectTimeout(objects_fifo_t *ofp, sysinterval_t timeout);
+  void chFifoReturnObjectI(objects_fifo_t *ofp, void *objp);
+  void chFifoReturnObject(objects_fifo_t *ofp, void *objp);
+  /* Host port, for the simulated interrupt sources. */
+  uint64_t chHostNow(void);
+  void chHostEnterISR(void);
+  void chHostLeaveISR(void);
+  bool chHostIsIdleS(void);
+  void chHostWaitS(uint64_t until);
+  void chHostNotifyS(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CH_H__ */
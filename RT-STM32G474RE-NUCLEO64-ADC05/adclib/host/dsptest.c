@@ -0,0 +1,177 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Checks the SIMD kernels of adcdsp.c against the C reference on the host,
+ * adcdsp.c being built with ADCDSP_USE_SIMD over hostsimd.h. Each case
+ * accumulates and deinterleaves two blocks of random sets through both
+ * paths and compares every figure and sample. The data cover 12-bit
+ * samples, the full 16-bit range including 0x8000..0xFFFF, blocks with a
+ * single sample above 15 bits and the extremes 0x0000, 0x7FFF, 0x8000 and
+ * 0xFFFF, for 1 to 8 channels, odd set counts and unaligned buffers.
+ *
+ * Usage:
+ *   dsptest [-s seed] [-i iterations]
+ *
+ * Exit status 1 on the first mismatch.
+ */
+
+#include "ch.h"
+#include "hal.h"
+
+#include "adcdsp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if !ADCDSP_USE_SIMD
+#error "dsptest needs ADCDSP_USE_SIMD"
+#endif
+
+#define MAX_CHANNELS    8U
+#define MAX_SETS        257U
+
+typedef enum {
+  DATA_12BIT,
+  DATA_FULL,
+  DATA_ONE_HIGH,
+  DATA_EXTREMES,
+  DATA_KINDS
+} data_t;
+
+static const char *const datanames[DATA_KINDS] = {
+  "12-bit", "full range", "one above 15 bits", "extremes"
+};
+
+/* One spare sample in front for the unaligned cases. */
+static adcsample_t buf[1U + MAX_SETS * MAX_CHANNELS];
+static adcsample_t outs[MAX_CHANNELS][1U + MAX_SETS];
+static adcsample_t outr[MAX_CHANNELS][MAX_SETS];
+
+static void fill(adcsample_t *p, size_t len, data_t kind) {
+  static const adcsample_t extremes[] = { 0x0000U, 0x7FFFU, 0x8000U, 0xFFFFU };
+
+  for (size_t i = 0; i < len; i++) {
+    switch (kind) {
+    case DATA_12BIT:
+      p[i] = (adcsample_t)(rand() & 0xFFF);
+      break;
+    case DATA_FULL:
+    case DATA_ONE_HIGH:
+      p[i] = (adcsample_t)(rand() & 0xFFFF);
+      break;
+    default:
+      p[i] = extremes[rand() & 3];
+      break;
+    }
+  }
+  if (kind == DATA_ONE_HIGH) {
+    for (size_t i = 0; i < len; i++) {
+      p[i] &= 0x7FFFU;
+    }
+    p[(size_t)rand() % len] |= 0x8000U;
+  }
+}
+
+static bool accEqual(const adcdsp_acc_t *a, const adcdsp_acc_t *b) {
+
+  return a->sum == b->sum && a->sumsq == b->sumsq &&
+         a->min == b->min && a->max == b->max;
+}
+
+static bool check(unsigned nch, size_t n, unsigned offset, data_t kind) {
+  adcdsp_acc_t accs[MAX_CHANNELS], accr[MAX_CHANNELS];
+  adcsample_t *const outsp[MAX_CHANNELS] = {
+    outs[0] + offset, outs[1] + offset, outs[2] + offset, outs[3] + offset,
+    outs[4] + offset, outs[5] + offset, outs[6] + offset, outs[7] + offset
+  };
+  adcsample_t *const outrp[MAX_CHANNELS] = {
+    outr[0], outr[1], outr[2], outr[3], outr[4], outr[5], outr[6], outr[7]
+  };
+  adcsample_t *p = buf + offset;
+
+  adcdspAccInit(accs, nch);
+  adcdspAccInit(accr, nch);
+
+  /* Two blocks, the second one adds to the figures of the first.*/
+  for (unsigned blk = 0; blk < 2U; blk++) {
+    fill(p, n * nch, kind);
+    adcdspAccumulate(p, n, nch, accs);
+    adcdspAccumulateRef(p, n, nch, accr);
+    for (unsigned c = 0; c < nch; c++) {
+      if (!accEqual(&accs[c], &accr[c])) {
+        printf("dsptest: %s, %u channels, %zu sets, offset %u, block %u: "
+               "channel %u sum %u/%u sumsq %llu/%llu min %u/%u max %u/%u\n",
+               datanames[kind], nch, n, offset, blk, c,
+               accs[c].sum, accr[c].sum,
+               (unsigned long long)accs[c].sumsq,
+               (unsigned long long)accr[c].sumsq,
+               accs[c].min, accr[c].min, accs[c].max, accr[c].max);
+        return false;
+      }
+    }
+
+    adcdspDeinterleave(p, n, nch, outsp);
+    adcdspDeinterleaveRef(p, n, nch, outrp);
+    for (unsigned c = 0; c < nch; c++) {
+      if (memcmp(outsp[c], outrp[c], n * sizeof(adcsample_t)) != 0) {
+        printf("dsptest: %s, %u channels, %zu sets, offset %u, block %u: "
+               "channel %u deinterleaved samples differ\n",
+               datanames[kind], nch, n, offset, blk, c);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  static const size_t sets[] = { 1U, 2U, 3U, 16U, 63U, 64U, MAX_SETS };
+  unsigned seed = 1U, iterations = 20U, cases = 0U;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:i:")) != -1) {
+    switch (opt) {
+    case 's':
+      seed = (unsigned)strtoul(optarg, NULL, 0);
+      break;
+    case 'i':
+      iterations = (unsigned)strtoul(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "usage: dsptest [-s seed] [-i iterations]\n");
+      return 2;
+    }
+  }
+  srand(seed);
+
+  for (unsigned it = 0; it < iterations; it++) {
+    for (unsigned kind = 0; kind < DATA_KINDS; kind++) {
+      for (unsigned nch = 1; nch <= MAX_CHANNELS; nch++) {
+        for (size_t i = 0; i < sizeof(sets) / sizeof(sets[0]); i++) {
+          for (unsigned offset = 0; offset < 2U; offset++) {
+            if (!check(nch, sets[i], offset, (data_t)kind)) {
+              return 1;
+            }
+            cases++;
+          }
+        }
+      }
+    }
+  }
+  printf("dsptest: %u cases, SIMD and reference kernels agree\n", cases);
+  return 0;
+}
@@ -0,0 +1,317 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Host build of the ChibiOS/HAL ADCv3 and GPT interfaces for the STM32G474.
+ * Types, register bits and state machine are those of the MCU driver, the
+ * conversions come from the simulator in hostsim.c, see adcsim.h. Only the
+ * regular group is simulated, the injected and watchdog registers exist
+ * but do nothing.
+ */
+
+#ifndef __HAL_H__
+#define __HAL_H__
+
+#include "ch.h"
+/* The CMSIS SIMD intrinsics, for ADCDSP_USE_SIMD builds. */
+#include "hostsimd.h"
+
+/*===========================================================================*/
+/* HAL settings.                                                             */
+/*===========================================================================*/
+
+#define HAL_USE_ADC                     TRUE
+#define HAL_USE_GPT                     TRUE
+#define ADC_USE_WAIT                    TRUE
+#define ADC_USE_MUTUAL_EXCLUSION        TRUE
+#define STM32_ADC_DUAL_MODE             FALSE
+
+#define STM32_HCLK                      170000000U
+/* Realtime counter frequency, the host counter counts nanoseconds. */
+#define STM32_SYSCLK                    1000000000U
+
+/*===========================================================================*/
+/* ADC registers, RM0440.                                                    */
+/*===========================================================================*/
+
+typedef struct {
+    volatile uint32_t ISR;
+    volatile uint32_t IER;
+    volatile uint32_t CR;
+    volatile uint32_t CFGR;
+    volatile uint32_t CFGR2;
+    volatile uint32_t SMPR1;
+    volatile uint32_t SMPR2;
+    uint32_t RESERVED1;
+    volatile uint32_t TR1;
+    volatile uint32_t TR2;
+    volatile uint32_t TR3;
+    uint32_t RESERVED2;
+    volatile uint32_t SQR1;
+    volatile uint32_t SQR2;
+    volatile uint32_t SQR3;
+    volatile uint32_t SQR4;
+    volatile uint32_t DR;
+    uint32_t RESERVED3[2];
+    volatile uint32_t JSQR;
+    uint32_t RESERVED4[4];
+    volatile uint32_t OFR1;
+    volatile uint32_t OFR2;
+    volatile uint32_t OFR3;
+    volatile uint32_t OFR4;
+    uint32_t RESERVED5[4];
+    volatile uint32_t JDR1;
+    volatile uint32_t JDR2;
+    volatile uint32_t JDR3;
+    volatile uint32_t JDR4;
+    uint32_t RESERVED6[4];
+    volatile uint32_t AWD2CR;
+    volatile uint32_t AWD3CR;
+    uint32_t RESERVED7[2];
+    volatile uint32_t DIFSEL;
+    volatile uint32_t CALFACT;
+} ADC_TypeDef;
+
+#define ADC_CR_JADSTART                 (1U << 3)
+#define ADC_CR_JADSTP                   (1U << 5)
+
+#define ADC_CFGR_EXTSEL_Pos             5U
+#define ADC_CFGR_EXTSEL_Msk             (31U << ADC_CFGR_EXTSEL_Pos)
+#define ADC_CFGR_EXTEN_Msk              (3U << 10)
+#define ADC_CFGR_CONT                   (1U << 13)
+#define ADC_CFGR_DISCEN                 (1U << 16)
+#define ADC_CFGR_DISCNUM_Pos            17U
+#define ADC_CFGR_DISCNUM_Msk            (7U << ADC_CFGR_DISCNUM_Pos)
+#define ADC_CFGR_JDISCEN                (1U << 20)
+#define ADC_CFGR_AWD1SGL                (1U << 22)
+#define ADC_CFGR_AWD1EN                 (1U << 23)
+#define ADC_CFGR_AWD1CH_Pos             26U
+#define ADC_CFGR_JQDIS                  (1U << 31)
+
+#define ADC_CFGR2_ROVSE                 (1U << 0)
+#define ADC_CFGR2_OVSR_Pos              2U
+#define ADC_CFGR2_OVSR_Msk              (7U << ADC_CFGR2_OVSR_Pos)
+#define ADC_CFGR2_OVSS_Pos              5U
+#define ADC_CFGR2_OVSS_Msk              (15U << ADC_CFGR2_OVSS_Pos)
+#define ADC_CFGR2_TROVS                 (1U << 9)
+#define ADC_CFGR2_ROVSM                 (1U << 10)
+
+#define ADC_JSQR_JL_Pos                 0U
+#define ADC_JSQR_JEXTSEL_Pos            2U
+#define ADC_JSQR_JEXTEN_Pos             7U
+#define ADC_JSQR_JSQ1_Pos               9U
+#define ADC_JSQR_JSQ2_Pos               15U
+#define ADC_JSQR_JSQ3_Pos               21U
+#define ADC_JSQR_JSQ4_Pos               27U
+
+/*===========================================================================*/
+/* ADC driver constants, as in the ADCv3 LLD.                                */
+/*===========================================================================*/
+
+#define ADC_CFGR_EXTEN_RISING           (1U << 10)
+#define ADC_CFGR_EXTSEL_SRC(n)          ((uint32_t)(n) << ADC_CFGR_EXTSEL_Pos)
+#define ADC_CFGR_AWD1CH_MASK            (31U << ADC_CFGR_AWD1CH_Pos)
+#define ADC_CFGR_AWD1CH_N(n)            ((uint32_t)(n) << ADC_CFGR_AWD1CH_Pos)
+#define ADC_CFGR2_OVSR_MASK             ADC_CFGR2_OVSR_Msk
+#define ADC_CFGR2_OVSS_MASK             ADC_CFGR2_OVSS_Msk
+#define ADC_CFGR2_OVSR_N(n)             ((uint32_t)(n) << ADC_CFGR2_OVSR_Pos)
+#define ADC_CFGR2_OVSS_N(n)             ((uint32_t)(n) << ADC_CFGR2_OVSS_Pos)
+
+#define ADC_TR(low, high)               (((uint32_t)(high) << 16U) |        \
+                                         (uint32_t)(low))
+#define ADC_TR_DISABLED                 ADC_TR(0U, 0x0FFFU)
+
+#define ADC_SMPR_SMP_2P5                0U
+#define ADC_SMPR_SMP_6P5                1U
+#define ADC_SMPR_SMP_12P5               2U
+#define ADC_SMPR_SMP_24P5               3U
+#define ADC_SMPR_SMP_47P5               4U
+#define ADC_SMPR_SMP_92P5               5U
+#define ADC_SMPR_SMP_247P5              6U
+#define ADC_SMPR_SMP_640P5              7U
+
+#define ADC_SQR1_NUM_CH(n)              ((uint32_t)(n) - 1U)
+
+#define ADC_CHANNEL_IN0                 0U
+#define ADC_CHANNEL_IN1                 1U
+#define ADC_CHANNEL_IN2                 2U
+#define ADC_CHANNEL_IN3                 3U
+#define ADC_CHANNEL_IN4                 4U
+#define ADC_CHANNEL_IN5                 5U
+#define ADC_CHANNEL_IN6                 6U
+#define ADC_CHANNEL_IN7                 7U
+#define ADC_CHANNEL_IN8                 8U
+#define ADC_CHANNEL_IN9                 9U
+#define ADC_CHANNEL_IN10                10U
+#define ADC_CHANNEL_IN11                11U
+#define ADC_CHANNEL_IN12                12U
+#define ADC_CHANNEL_IN13                13U
+#define ADC_CHANNEL_IN14                14U
+#define ADC_CHANNEL_IN15                15U
+#define ADC_CHANNEL_IN16                16U
+#define ADC_CHANNEL_IN17                17U
+#define ADC_CHANNEL_IN18                18U
+
+#define ADC_ERR_DMAFAILURE              1U
+#define ADC_ERR_OVERFLOW                2U
+#define ADC_ERR_AWD1                    4U
+#define ADC_ERR_AWD2                    8U
+#define ADC_ERR_AWD3                    16U
+
+#define ADC_MAX_CHANNELS                19U
+
+/*===========================================================================*/
+/* ADC driver types.                                                         */
+/*===========================================================================*/
+
+typedef uint16_t adcsample_t;
+typedef uint16_t adc_channels_num_t;
+typedef uint32_t adcerror_t;
+
+typedef enum {
+    ADC_UNINIT = 0,
+    ADC_STOP = 1,
+    ADC_READY = 2,
+    ADC_ACTIVE = 3,
+    ADC_COMPLETE = 4,
+    ADC_ERROR = 5
+} adcstate_t;
+
+typedef struct hal_adc_driver ADCDriver;
+
+typedef void (*adccallback_t)(ADCDriver *adcp);
+typedef void (*adcerrorcallback_t)(ADCDriver *adcp, adcerror_t err);
+
+typedef struct {
+    bool circular;
+    adc_channels_num_t num_channels;
+    adccallback_t end_cb;
+    adcerrorcallback_t error_cb;
+    uint32_t cfgr;
+    uint32_t cfgr2;
+    uint32_t tr1;
+    uint32_t tr2;
+    uint32_t tr3;
+    uint32_t awd2cr;
+    uint32_t awd3cr;
+    uint32_t smpr[2];
+    uint32_t sqr[4];
+} ADCConversionGroup;
+
+typedef struct {
+    uint32_t difsel;
+} ADCConfig;
+
+struct hal_adc_driver {
+    adcstate_t state;
+    const ADCConfig *config;
+    adcsample_t *samples;
+    size_t depth;
+    const ADCConversionGroup *grpp;
+    thread_reference_t thread;
+    mutex_t mutex;
+    ADC_TypeDef *adcm;
+    /* Simulator state, see hostsim.c. */
+    struct adcsim *sim;
+};
+
+/*===========================================================================*/
+/* GPT driver.                                                               */
+/*===========================================================================*/
+
+#define TIM_CR2_MMS_1                   (1U << 5)
+
+typedef uint32_t gptcnt_t;
+typedef uint32_t gptfreq_t;
+
+typedef enum {
+    GPT_UNINIT = 0,
+    GPT_STOP = 1,
+    GPT_READY = 2,
+    GPT_CONTINUOUS = 3,
+    GPT_ONESHOT = 4
+} gptstate_t;
+
+typedef struct hal_gpt_driver GPTDriver;
+
+typedef void (*gptcallback_t)(GPTDriver *gptp);
+
+typedef struct {
+    gptfreq_t frequency;
+    /* Not called on the host, the timer only paces the ADC triggers. */
+    gptcallback_t callback;
+    uint32_t cr2;
+    uint32_t dier;
+} GPTConfig;
+
+struct hal_gpt_driver {
+    gptstate_t state;
+    const GPTConfig *config;
+    gptcnt_t interval;
+    /* Realtime counter at the last start or interval change, and the
+       simulated clock of the fast mode. */
+    rtcnt_t origin;
+    double simorigin;
+};
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+#define adcIsBufferComplete(adcp)       ((bool)((adcp)->state == ADC_COMPLETE))
+
+#define adcSTM32EnableVREF(adcp)        ((void)(adcp))
+#define adcSTM32DisableVREF(adcp)       ((void)(adcp))
+#define adcSTM32EnableTS(adcp)          ((void)(adcp))
+#define adcSTM32DisableTS(adcp)         ((void)(adcp))
+#define adcSTM32EnableVBAT(adcp)        ((void)(adcp))
+#define adcSTM32DisableVBAT(adcp)       ((void)(adcp))
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+extern ADCDriver ADCD1, ADCD2, ADCD3, ADCD4, ADCD5;
+extern GPTDriver GPTD1, GPTD2, GPTD3, GPTD4, GPTD5, GPTD6, GPTD7, GPTD8,
+                 GPTD15;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void halInit(void);
+  void adcStart(ADCDriver *adcp, const ADCConfig *config);
+  void adcStop(ADCDriver *adcp);
+  void adcStartConversion(ADCDriver *adcp, const ADCConversionGroup *grpp,
+                          adcsample_t *samples, size_t depth);
+  void adcStartConversionI(ADCDriver *adcp, const ADCConversionGroup *grpp,
+                           adcsample_t *samples, size_t depth);
+  void adcStopConversion(ADCDriver *adcp);
+  void adcStopConversionI(ADCDriver *adcp);
+  msg_t adcConvert(ADCDriver *adcp, const ADCConversionGroup *grpp,
+                   adcsample_t *samples, size_t depth);
+  void adcAcquireBus(ADCDriver *adcp);
+  void adcReleaseBus(ADCDriver *adcp);
+  void gptStart(GPTDriver *gptp, const GPTConfig *config);
+  void gptStop(GPTDriver *gptp);
+  void gptStartContinuous(GPTDriver *gptp, gptcnt_t interval);
+  void gptStartContinuousI(GPTDriver *gptp, gptcnt_t interval);
+  void gptChangeInterval(GPTDriver *gptp, gptcnt_t interval);
+  void gptStopTimer(GPTDriver *gptp);
+  void gptStopTimerI(GPTDriver *gptp);
+  gptcnt_t gptGetCounterX(GPTDriver *gptp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HAL_H__ */
@@ -0,0 +1,667 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Kernel subset over POSIX threads, see ch.h. Every wait goes through
+ * waitS(): the thread is marked blocked and only a waker, or its own
+ * timeout, clears the mark, so the running count is exact at any time the
+ * lock is free.
+ */
+
+#include "ch.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+
+/*===========================================================================*/
+/* Module local variables.                                                   */
+/*===========================================================================*/
+
+/* The interrupt mask. */
+static pthread_mutex_t ch_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ch_cond;
+
+/* Kernel threads not blocked in a kernel wait. */
+static unsigned ch_running;
+
+static thread_t ch_main;
+static __thread thread_t *ch_self;
+static __thread bool ch_isr;
+
+static uint64_t ch_epoch;
+
+/*===========================================================================*/
+/* Module local functions.                                                   */
+/*===========================================================================*/
+
+static uint64_t monotonic(void) {
+  struct timespec ts;
+
+  (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+static struct timespec timespecOf(uint64_t until) {
+  struct timespec ts;
+
+  until += ch_epoch;
+  ts.tv_sec = (time_t)(until / 1000000000U);
+  ts.tv_nsec = (long)(until % 1000000000U);
+  return ts;
+}
+
+/* Deadline of a timeout in chHostNow() time, 0 for TIME_INFINITE. */
+static uint64_t deadlineOf(sysinterval_t timeout) {
+
+  if (timeout == TIME_INFINITE) {
+    return 0U;
+  }
+  return chHostNow() + (uint64_t)timeout * (1000000000U / CH_CFG_ST_FREQUENCY);
+}
+
+/* Readies a blocked thread. */
+static void wakeI(thread_t *tp, msg_t msg) {
+
+  tp->rdymsg = msg;
+  tp->blocked = false;
+  ch_running++;
+  pthread_cond_broadcast(&ch_cond);
+}
+
+/*
+ * Blocks the current thread until woken or until the deadline, 0 for none.
+ * Returns the message of the waker or MSG_TIMEOUT.
+ */
+static msg_t waitS(uint64_t until) {
+  thread_t *tp = chThdGetSelfX();
+  struct timespec ts = timespecOf(until);
+
+  tp->blocked = true;
+  ch_running--;
+  /* The simulator may be waiting for all threads to block.*/
+  pthread_cond_broadcast(&ch_cond);
+  while (tp->blocked) {
+    if (until == 0U) {
+      (void) pthread_cond_wait(&ch_cond, &ch_lock);
+    }
+    else if ((pthread_cond_timedwait(&ch_cond, &ch_lock, &ts) == ETIMEDOUT) &&
+             tp->blocked) {
+      tp->blocked = false;
+      ch_running++;
+      return MSG_TIMEOUT;
+    }
+  }
+  return tp->rdymsg;
+}
+
+static void queueInsert(ch_waitq_t *qp, thread_t *tp) {
+  thread_t **pp = &qp->head;
+
+  while (*pp != NULL) {
+    pp = &(*pp)->qnext;
+  }
+  tp->qnext = NULL;
+  *pp = tp;
+}
+
+static void queueRemove(ch_waitq_t *qp, thread_t *tp) {
+  thread_t **pp = &qp->head;
+
+  while (*pp != NULL) {
+    if (*pp == tp) {
+      *pp = tp->qnext;
+      return;
+    }
+    pp = &(*pp)->qnext;
+  }
+}
+
+static msg_t queueWaitS(ch_waitq_t *qp, uint64_t until) {
+  msg_t msg;
+
+  queueInsert(qp, chThdGetSelfX());
+  msg = waitS(until);
+  if (msg == MSG_TIMEOUT) {
+    queueRemove(qp, chThdGetSelfX());
+  }
+  return msg;
+}
+
+/* Waiters re-check their condition, so all of them are woken. */
+static void queueWakeAllI(ch_waitq_t *qp, msg_t msg) {
+
+  while (qp->head != NULL) {
+    thread_t *tp = qp->head;
+
+    qp->head = tp->qnext;
+    wakeI(tp, msg);
+  }
+}
+
+static void *trampoline(void *p) {
+  thread_t *tp = p;
+
+  ch_self = tp;
+  tp->fn(tp->arg);
+  chThdExit(MSG_OK);
+  return NULL;
+}
+
+/*===========================================================================*/
+/* System.                                                                   */
+/*===========================================================================*/
+
+void chSysInit(void) {
+  pthread_condattr_t attr;
+
+  (void) pthread_condattr_init(&attr);
+  (void) pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  (void) pthread_cond_init(&ch_cond, &attr);
+  ch_epoch = monotonic();
+
+  ch_main.name = "main";
+  ch_main.tid = pthread_self();
+  ch_self = &ch_main;
+  ch_running = 1U;
+}
+
+void chSysHalt(const char *reason) {
+
+  fprintf(stderr, "chSysHalt: %s\n", reason);
+  abort();
+}
+
+void chSysLock(void) {
+
+  (void) pthread_mutex_lock(&ch_lock);
+}
+
+void chSysUnlock(void) {
+
+  (void) pthread_mutex_unlock(&ch_lock);
+}
+
+/* The simulated ISRs already hold the lock. */
+void chSysLockFromISR(void) {
+
+  if (!ch_isr) {
+    (void) pthread_mutex_lock(&ch_lock);
+  }
+}
+
+void chSysUnlockFromISR(void) {
+
+  if (!ch_isr) {
+    (void) pthread_mutex_unlock(&ch_lock);
+  }
+}
+
+rtcnt_t chSysGetRealtimeCounterX(void) {
+
+  return (rtcnt_t)chHostNow();
+}
+
+systime_t chVTGetSystemTimeX(void) {
+
+  return (systime_t)(chHostNow() / (1000000000U / CH_CFG_ST_FREQUENCY));
+}
+
+/*===========================================================================*/
+/* Threads.                                                                  */
+/*===========================================================================*/
+
+thread_t *chThdCreateStatic(void *wsp, size_t size, tprio_t prio,
+                            tfunc_t pf, void *arg) {
+  thread_t *tp = calloc(1U, sizeof(thread_t));
+
+  (void)wsp;
+  (void)size;
+  (void)prio;
+  chDbgCheck((tp != NULL) && (pf != NULL));
+
+  tp->fn = pf;
+  tp->arg = arg;
+  chSysLock();
+  ch_running++;
+  chSysUnlock();
+  if (pthread_create(&tp->tid, NULL, trampoline, tp) != 0) {
+    chSysHalt("pthread_create");
+  }
+  return tp;
+}
+
+thread_t *chThdGetSelfX(void) {
+
+  chDbgAssert(ch_self != NULL, "not a kernel thread");
+  return ch_self;
+}
+
+void chRegSetThreadName(const char *name) {
+
+  chThdGetSelfX()->name = name;
+}
+
+void chThdExit(msg_t msg) {
+  thread_t *tp = chThdGetSelfX();
+
+  chSysLock();
+  tp->exitcode = msg;
+  tp->done = true;
+  ch_running--;
+  queueWakeAllI(&tp->waiting, MSG_OK);
+  pthread_cond_broadcast(&ch_cond);
+  chSysUnlock();
+  pthread_exit(NULL);
+}
+
+/* Also releases the thread object, the thread must be waited once. */
+msg_t chThdWait(thread_t *tp) {
+  msg_t msg;
+
+  chSysLock();
+  while (!tp->done) {
+    (void) queueWaitS(&tp->waiting, 0U);
+  }
+  msg = tp->exitcode;
+  chSysUnlock();
+  (void) pthread_join(tp->tid, NULL);
+  free(tp);
+  return msg;
+}
+
+void chThdTerminate(thread_t *tp) {
+
+  chSysLock();
+  tp->terminate = true;
+  chSysUnlock();
+}
+
+bool chThdShouldTerminateX(void) {
+
+  return chThdGetSelfX()->terminate;
+}
+
+void chThdSleep(sysinterval_t time) {
+
+  if (time == TIME_IMMEDIATE) {
+    (void) sched_yield();
+    return;
+  }
+  chSysLock();
+  (void) waitS(deadlineOf(time));
+  chSysUnlock();
+}
+
+void chThdSleepMilliseconds(uint32_t ms) {
+
+  chThdSleep(TIME_MS2I(ms));
+}
+
+void chThdSleepMicroseconds(uint32_t us) {
+
+  chThdSleep(TIME_US2I(us));
+}
+
+void chThdSleepSeconds(uint32_t s) {
+
+  chThdSleep(TIME_S2I(s));
+}
+
+msg_t chThdSuspendTimeoutS(thread_reference_t *trp, sysinterval_t timeout) {
+  thread_t *tp = chThdGetSelfX();
+  msg_t msg;
+
+  chDbgAssert(*trp == NULL, "not NULL");
+  if (timeout == TIME_IMMEDIATE) {
+    return MSG_TIMEOUT;
+  }
+  *trp = tp;
+  msg = waitS(deadlineOf(timeout));
+  if (*trp == tp) {
+    *trp = NULL;
+  }
+  return msg;
+}
+
+msg_t chThdSuspendS(thread_reference_t *trp) {
+
+  return chThdSuspendTimeoutS(trp, TIME_INFINITE);
+}
+
+void chThdResumeI(thread_reference_t *trp, msg_t msg) {
+
+  if (*trp != NULL) {
+    thread_t *tp = *trp;
+
+    *trp = NULL;
+    wakeI(tp, msg);
+  }
+}
+
+void chThdResumeS(thread_reference_t *trp, msg_t msg) {
+
+  chThdResumeI(trp, msg);
+}
+
+void chThdResume(thread_reference_t *trp, msg_t msg) {
+
+  chSysLock();
+  chThdResumeI(trp, msg);
+  chSysUnlock();
+}
+
+/*===========================================================================*/
+/* Mutexes.                                                                  */
+/*===========================================================================*/
+
+void chMtxObjectInit(mutex_t *mp) {
+
+  (void) pthread_mutex_init(&mp->pm, NULL);
+}
+
+void chMtxLock(mutex_t *mp) {
+
+  (void) pthread_mutex_lock(&mp->pm);
+}
+
+bool chMtxTryLock(mutex_t *mp) {
+
+  return pthread_mutex_trylock(&mp->pm) == 0;
+}
+
+void chMtxUnlock(mutex_t *mp) {
+
+  (void) pthread_mutex_unlock(&mp->pm);
+}
+
+/*===========================================================================*/
+/* Events.                                                                   */
+/*===========================================================================*/
+
+void chEvtObjectInit(event_source_t *esp) {
+
+  esp->next = NULL;
+}
+
+void chEvtRegisterMaskWithFlags(event_source_t *esp, event_listener_t *elp,
+                                eventmask_t events, eventflags_t wflags) {
+
+  chSysLock();
+  elp->next = esp->next;
+  esp->next = elp;
+  elp->listener = chThdGetSelfX();
+  elp->events = events;
+  elp->flags = 0U;
+  elp->wflags = wflags;
+  chSysUnlock();
+}
+
+void chEvtRegisterMask(event_source_t *esp, event_listener_t *elp,
+                       eventmask_t events) {
+
+  chEvtRegisterMaskWithFlags(esp, elp, events, (eventflags_t)-1);
+}
+
+void chEvtUnregister(event_source_t *esp, event_listener_t *elp) {
+  event_listener_t **pp = &esp->next;
+
+  chSysLock();
+  while (*pp != NULL) {
+    if (*pp == elp) {
+      *pp = elp->next;
+      break;
+    }
+    pp = &(*pp)->next;
+  }
+  chSysUnlock();
+}
+
+void chEvtSignalI(thread_t *tp, eventmask_t events) {
+
+  tp->epending |= events;
+  if (tp->blocked && ((tp->epending & tp->ewmask) != 0U)) {
+    wakeI(tp, MSG_OK);
+  }
+}
+
+void chEvtBroadcastFlagsI(event_source_t *esp, eventflags_t flags) {
+
+  for (event_listener_t *elp = esp->next; elp != NULL; elp = elp->next) {
+    elp->flags |= flags;
+    if ((flags == 0U) || ((flags & elp->wflags) != 0U)) {
+      chEvtSignalI(elp->listener, elp->events);
+    }
+  }
+}
+
+void chEvtBroadcastFlags(event_source_t *esp, eventflags_t flags) {
+
+  chSysLock();
+  chEvtBroadcastFlagsI(esp, flags);
+  chSysUnlock();
+}
+
+eventflags_t chEvtGetAndClearFlagsI(event_listener_t *elp) {
+  eventflags_t flags = elp->flags;
+
+  elp->flags = 0U;
+  return flags;
+}
+
+eventflags_t chEvtGetAndClearFlags(event_listener_t *elp) {
+  eventflags_t flags;
+
+  chSysLock();
+  flags = chEvtGetAndClearFlagsI(elp);
+  chSysUnlock();
+  return flags;
+}
+
+eventmask_t chEvtWaitAnyTimeout(eventmask_t events, sysinterval_t timeout) {
+  thread_t *tp = chThdGetSelfX();
+  eventmask_t m;
+
+  chSysLock();
+  m = tp->epending & events;
+  if ((m == 0U) && (timeout != TIME_IMMEDIATE)) {
+    tp->ewmask = events;
+    (void) waitS(deadlineOf(timeout));
+    tp->ewmask = 0U;
+    m = tp->epending & events;
+  }
+  tp->epending &= ~m;
+  chSysUnlock();
+  return m;
+}
+
+/*===========================================================================*/
+/* Mailboxes.                                                                */
+/*===========================================================================*/
+
+void chMBObjectInit(mailbox_t *mbp, msg_t *buf, size_t n) {
+
+  chDbgCheck((mbp != NULL) && (buf != NULL) && (n > 0U));
+
+  mbp->buffer = buf;
+  mbp->top = buf + n;
+  mbp->wrptr = buf;
+  mbp->rdptr = buf;
+  mbp->cnt = 0U;
+  mbp->reset = false;
+  mbp->qw.head = NULL;
+}
+
+void chMBResetI(mailbox_t *mbp) {
+
+  mbp->wrptr = mbp->buffer;
+  mbp->rdptr = mbp->buffer;
+  mbp->cnt = 0U;
+  mbp->reset = true;
+  queueWakeAllI(&mbp->qw, MSG_RESET);
+}
+
+void chMBReset(mailbox_t *mbp) {
+
+  chSysLock();
+  chMBResetI(mbp);
+  chSysUnlock();
+}
+
+msg_t chMBPostI(mailbox_t *mbp, msg_t msg) {
+
+  if (mbp->reset) {
+    return MSG_RESET;
+  }
+  if (mbp->cnt == (size_t)(mbp->top - mbp->buffer)) {
+    return MSG_TIMEOUT;
+  }
+  *mbp->wrptr++ = msg;
+  if (mbp->wrptr >= mbp->top) {
+    mbp->wrptr = mbp->buffer;
+  }
+  mbp->cnt++;
+  queueWakeAllI(&mbp->qw, MSG_OK);
+  return MSG_OK;
+}
+
+msg_t chMBPostTimeout(mailbox_t *mbp, msg_t msg, sysinterval_t timeout) {
+  uint64_t until = deadlineOf(timeout);
+  msg_t rdymsg;
+
+  chSysLock();
+  while (((rdymsg = chMBPostI(mbp, msg)) == MSG_TIMEOUT) &&
+         (timeout != TIME_IMMEDIATE) &&
+         (queueWaitS(&mbp->qw, until) != MSG_TIMEOUT)) {
+  }
+  chSysUnlock();
+  return rdymsg;
+}
+
+msg_t chMBFetchI(mailbox_t *mbp, msg_t *msgp) {
+
+  if (mbp->reset) {
+    return MSG_RESET;
+  }
+  if (mbp->cnt == 0U) {
+    return MSG_TIMEOUT;
+  }
+  *msgp = *mbp->rdptr++;
+  if (mbp->rdptr >= mbp->top) {
+    mbp->rdptr = mbp->buffer;
+  }
+  mbp->cnt--;
+  queueWakeAllI(&mbp->qw, MSG_OK);
+  return MSG_OK;
+}
+
+msg_t chMBFetchTimeout(mailbox_t *mbp, msg_t *msgp, sysinterval_t timeout) {
+  uint64_t until = deadlineOf(timeout);
+  msg_t rdymsg;
+
+  chSysLock();
+  while (((rdymsg = chMBFetchI(mbp, msgp)) == MSG_TIMEOUT) &&
+         (timeout != TIME_IMMEDIATE) &&
+         (queueWaitS(&mbp->qw, until) != MSG_TIMEOUT)) {
+  }
+  chSysUnlock();
+  return rdymsg;
+}
+
+/*===========================================================================*/
+/* Objects FIFOs.                                                            */
+/*===========================================================================*/
+
+void chFifoObjectInit(objects_fifo_t *ofp, size_t objsize, size_t objn,
+                      void *objbuf, msg_t *msgbuf) {
+
+  ofp->objsize = objsize;
+  chMBObjectInit(&ofp->free, msgbuf, objn);
+  for (size_t i = 0U; i < objn; i++) {
+    (void) chMBPostI(&ofp->free, (msg_t)((uint8_t *)objbuf + i * objsize));
+  }
+}
+
+void *chFifoTakeObjectI(objects_fifo_t *ofp) {
+  msg_t msg;
+
+  return chMBFetchI(&ofp->free, &msg) == MSG_OK ? (void *)msg : NULL;
+}
+
+void *chFifoTakeObjectTimeout(objects_fifo_t *ofp, sysinterval_t timeout) {
+  msg_t msg;
+
+  return chMBFetchTimeout(&ofp->free, &msg, timeout) == MSG_OK ?
+         (void *)msg : NULL;
+}
+
+void chFifoReturnObjectI(objects_fifo_t *ofp, void *objp) {
+
+  (void) chMBPostI(&ofp->free, (msg_t)objp);
+}
+
+void chFifoReturnObject(objects_fifo_t *ofp, void *objp) {
+
+  chSysLock();
+  chFifoReturnObjectI(ofp, objp);
+  chSysUnlock();
+}
+
+/*===========================================================================*/
+/* Host port.                                                                */
+/*===========================================================================*/
+
+/* Nanoseconds since chSysInit(). */
+uint64_t chHostNow(void) {
+
+  return monotonic() - ch_epoch;
+}
+
+/* Marks the calling thread as running an ISR, the lock is held. */
+void chHostEnterISR(void) {
+
+  ch_isr = true;
+}
+
+void chHostLeaveISR(void) {
+
+  ch_isr = false;
+}
+
+/* True when every kernel thread is blocked, an idle MCU. */
+bool chHostIsIdleS(void) {
+
+  return ch_running == 0U;
+}
+
+/*
+ * Waits for a kernel state change, or until a chHostNow() time, 0 for
+ * none. For the simulator threads, which are not kernel threads.
+ */
+void chHostWaitS(uint64_t until) {
+
+  if (until == 0U) {
+    (void) pthread_cond_wait(&ch_cond, &ch_lock);
+  }
+  else {
+    struct timespec ts = timespecOf(until);
+
+    (void) pthread_cond_timedwait(&ch_cond, &ch_lock, &ts);
+  }
+}
+
+void chHostNotifyS(void) {
+
+  pthread_cond_broadcast(&ch_cond);
+}
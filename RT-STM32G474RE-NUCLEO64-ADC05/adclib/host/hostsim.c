@@ -0,0 +1,890 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * ADC and GPT drivers of the host build, see adcsim.h. The simulator
+ * thread of a driver writes the sets up to the next half or full buffer
+ * without the lock, as the DMA does, then runs the ISR code with the lock
+ * held. A stop or restart of the conversion meanwhile discards the chunk.
+ * The ISR code is the one of hal_adc.h and of the ADCv3 LLD.
+ */
+
+#include "hal.h"
+#include "adcsim.h"
+#include "adcgrp.h"
+
+#include <math.h>
+#include <string.h>
+
+#define ADCSIM_NUM_ADC                  5U
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+struct adcsim {
+    ADCDriver *adcp;
+    pthread_t tid;
+    bool started;
+    /* Bumped by each start and stop of a conversion. */
+    uint32_t gen;
+    /* Sets written in the current pass over the buffer. */
+    size_t pos;
+    uint64_t sets;
+    /* Set rate in Hz, 0 while waiting for a trigger, -1 to re-anchor. */
+    double rate;
+    /* Pacing origin, set count and time, wall clock in the realtime mode
+       and simulated clock in the fast mode. */
+    uint64_t anchorsets;
+    uint64_t anchorns;
+    double anchorsim;
+    /* Simulated clock at the last conversion start. */
+    double startsim;
+    /* Signal time of the next set, seconds. */
+    double t;
+    adcerror_t inject;
+    uint64_t rng;
+    adcsim_source_t src[ADC_MAX_CHANNELS];
+    /* Replay file, rows of cols samples. */
+    uint16_t *file;
+    size_t rows;
+    unsigned cols;
+    size_t row;
+    ADC_TypeDef regs;
+};
+
+static struct adcsim sims[ADCSIM_NUM_ADC];
+static adcsim_mode_t simmode = ADCSIM_REALTIME;
+
+/* Fast mode, simulated time of the last callback in seconds. */
+static double simclock;
+
+ADCDriver ADCD1, ADCD2, ADCD3, ADCD4, ADCD5;
+GPTDriver GPTD1, GPTD2, GPTD3, GPTD4, GPTD5, GPTD6, GPTD7, GPTD8, GPTD15;
+
+static ADCDriver *const adcs[ADCSIM_NUM_ADC] = {
+  &ADCD1, &ADCD2, &ADCD3, &ADCD4, &ADCD5
+};
+
+static GPTDriver *const gpts[] = {
+  &GPTD1, &GPTD2, &GPTD3, &GPTD4, &GPTD5, &GPTD6, &GPTD7, &GPTD8, &GPTD15
+};
+
+/* Regular triggers of ADC1 and ADC2 on a timer update. */
+static const struct {
+  uint32_t extsel;
+  GPTDriver *gptp;
+} triggers[] = {
+  {ADCGRP_EXTSEL_TIM1_TRGO,  &GPTD1},
+  {ADCGRP_EXTSEL_TIM2_TRGO,  &GPTD2},
+  {ADCGRP_EXTSEL_TIM3_TRGO,  &GPTD3},
+  {ADCGRP_EXTSEL_TIM4_TRGO,  &GPTD4},
+  {ADCGRP_EXTSEL_TIM6_TRGO,  &GPTD6},
+  {ADCGRP_EXTSEL_TIM8_TRGO,  &GPTD8},
+  {ADCGRP_EXTSEL_TIM15_TRGO, &GPTD15}
+};
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+/* xorshift64*, then Box-Muller. */
+static double uniform(struct adcsim *sp) {
+
+  sp->rng ^= sp->rng >> 12;
+  sp->rng ^= sp->rng << 25;
+  sp->rng ^= sp->rng >> 27;
+  return ((double)((sp->rng * 0x2545F4914F6CDD1DULL) >> 11) + 0.5) *
+         (1.0 / 9007199254740992.0);
+}
+
+static double gauss(struct adcsim *sp) {
+
+  return sqrt(-2.0 * log(uniform(sp))) * cos(2.0 * M_PI * uniform(sp));
+}
+
+static unsigned rankChannel(const ADCConversionGroup *grpp, unsigned rank) {
+
+  if (rank < 4U) {
+    return (grpp->sqr[0] >> (6U * (rank + 1U))) & 0x1FU;
+  }
+  rank -= 4U;
+  return (grpp->sqr[1U + rank / 5U] >> (6U * (rank % 5U))) & 0x1FU;
+}
+
+static unsigned channelSmp(const ADCConversionGroup *grpp, unsigned ch) {
+
+  return (grpp->smpr[ch / 10U] >> (3U * (ch % 10U))) & 7U;
+}
+
+static unsigned ovsRatio(const ADCConversionGroup *grpp) {
+
+  if ((grpp->cfgr2 & ADC_CFGR2_ROVSE) == 0U) {
+    return 1U;
+  }
+  return 2U << ((grpp->cfgr2 & ADC_CFGR2_OVSR_Msk) >> ADC_CFGR2_OVSR_Pos);
+}
+
+/* Ranks per trigger, DISCNUM + 1 in discontinuous mode. */
+static unsigned discRanks(const ADCConversionGroup *grpp) {
+
+  if ((grpp->cfgr & ADC_CFGR_DISCEN) == 0U) {
+    return grpp->num_channels;
+  }
+  return ((grpp->cfgr & ADC_CFGR_DISCNUM_Msk) >> ADC_CFGR_DISCNUM_Pos) + 1U;
+}
+
+/* Triggers per set. */
+static unsigned discFrames(const ADCConversionGroup *grpp) {
+
+  return (grpp->num_channels + discRanks(grpp) - 1U) / discRanks(grpp);
+}
+
+/* Running timer of a triggered group, NULL if none. */
+static GPTDriver *groupTimer(const ADCConversionGroup *grpp) {
+  uint32_t extsel = (grpp->cfgr & ADC_CFGR_EXTSEL_Msk) >> ADC_CFGR_EXTSEL_Pos;
+
+  for (size_t i = 0U; i < sizeof(triggers) / sizeof(triggers[0]); i++) {
+    GPTDriver *gptp = triggers[i].gptp;
+
+    if ((triggers[i].extsel == extsel) && (gptp->state == GPT_CONTINUOUS)) {
+      return gptp;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Set rate of the running group. Without CONT a software group converts
+ * one set per start, as the hardware does.
+ */
+static double groupRate(struct adcsim *sp, const ADCConversionGroup *grpp) {
+  uint32_t hc = 0U;
+
+  if ((grpp->cfgr & ADC_CFGR_EXTEN_Msk) != 0U) {
+    GPTDriver *gptp = groupTimer(grpp);
+    double rate;
+
+    if (gptp == NULL) {
+      return 0.0;
+    }
+    rate = (double)gptp->config->frequency / gptp->interval /
+           discFrames(grpp);
+
+    /* Triggered oversampling, one trigger per conversion.*/
+    if ((grpp->cfgr2 & ADC_CFGR2_TROVS) != 0U) {
+      rate /= ovsRatio(grpp);
+    }
+    return rate;
+  }
+
+  if (((grpp->cfgr & ADC_CFGR_CONT) == 0U) && (sp->pos > 0U)) {
+    return 0.0;
+  }
+  for (unsigned i = 0U; i < grpp->num_channels; i++) {
+    unsigned ch = rankChannel(grpp, i);
+
+    hc += ADCGRP_HALFCYCLES(ADCGRP_CH(ch, channelSmp(grpp, ch)));
+  }
+  return 2.0 * ADCGRP_ADCCLK / ((double)hc * ovsRatio(grpp));
+}
+
+static uint16_t conversion(struct adcsim *sp, const adcsim_source_t *srcp,
+                           double t) {
+  double v = srcp->dc;
+
+  if (srcp->amp != 0.0) {
+    v += srcp->amp * sin(2.0 * M_PI * srcp->freq * t);
+  }
+  if ((srcp->period > 0.0) && (((uint64_t)(t / srcp->period) & 1U) != 0U)) {
+    v += srcp->step;
+  }
+  if (srcp->noise > 0.0) {
+    v += srcp->noise * gauss(sp);
+  }
+  v = floor(v + 0.5);
+  return v < 0.0 ? 0U : v > 4095.0 ? 4095U : (uint16_t)v;
+}
+
+/* Converts n sets of a group into dst, without the lock. */
+static void convert(struct adcsim *sp, const ADCConversionGroup *grpp,
+                    const adcsim_source_t *src, adcsample_t *dst, size_t n,
+                    double rate) {
+  unsigned ratio = ovsRatio(grpp);
+  unsigned shift = (ratio > 1U) ?
+                   (grpp->cfgr2 & ADC_CFGR2_OVSS_Msk) >> ADC_CFGR2_OVSS_Pos :
+                   0U;
+  unsigned frames = discFrames(grpp), per = discRanks(grpp);
+
+  for (size_t i = 0U; i < n; i++) {
+    for (unsigned r = 0U; r < grpp->num_channels; r++) {
+      /* A discontinuous set spans several triggers.*/
+      double t = sp->t + (double)(r / per) / (rate * frames);
+      uint32_t acc = 0U;
+
+      if (sp->file != NULL) {
+        acc = (uint32_t)sp->file[sp->row * sp->cols + r % sp->cols] * ratio;
+      }
+      else {
+        const adcsim_source_t *srcp = &src[rankChannel(grpp, r)];
+
+        for (unsigned k = 0U; k < ratio; k++) {
+          acc += conversion(sp, srcp, t);
+        }
+      }
+      acc >>= shift;
+      *dst++ = (adcsample_t)(acc > 0xFFFFU ? 0xFFFFU : acc);
+    }
+    sp->t += 1.0 / rate;
+    if (sp->file != NULL) {
+      sp->row = (sp->row + 1U) % sp->rows;
+    }
+  }
+}
+
+static void lldStopConversion(struct adcsim *sp) {
+
+  sp->gen++;
+  sp->pos = 0U;
+}
+
+/* _adc_isr_half_code(). */
+static void isrHalfCode(ADCDriver *adcp) {
+
+  if (adcp->grpp->end_cb != NULL) {
+    adcp->grpp->end_cb(adcp);
+  }
+}
+
+/* _adc_isr_full_code(). */
+static void isrFullCode(ADCDriver *adcp) {
+
+  if (adcp->grpp->circular) {
+    if (adcp->grpp->end_cb != NULL) {
+      adcp->state = ADC_COMPLETE;
+      adcp->grpp->end_cb(adcp);
+      if (adcp->state == ADC_COMPLETE) {
+        adcp->state = ADC_ACTIVE;
+      }
+    }
+    return;
+  }
+
+  lldStopConversion(adcp->sim);
+  if (adcp->grpp->end_cb != NULL) {
+    adcp->state = ADC_COMPLETE;
+    adcp->grpp->end_cb(adcp);
+    if (adcp->state == ADC_COMPLETE) {
+      adcp->state = ADC_READY;
+      adcp->grpp = NULL;
+    }
+  }
+  else {
+    adcp->state = ADC_READY;
+    adcp->grpp = NULL;
+  }
+  chThdResumeI(&adcp->thread, MSG_OK);
+}
+
+/* _adc_isr_error_code(). */
+static void isrErrorCode(ADCDriver *adcp, adcerror_t err) {
+
+  lldStopConversion(adcp->sim);
+  if (adcp->grpp->error_cb != NULL) {
+    adcp->state = ADC_ERROR;
+    adcp->grpp->error_cb(adcp, err);
+    if (adcp->state == ADC_ERROR) {
+      adcp->state = ADC_READY;
+      adcp->grpp = NULL;
+    }
+  }
+  else {
+    adcp->state = ADC_READY;
+    adcp->grpp = NULL;
+  }
+  chThdResumeI(&adcp->thread, MSG_TIMEOUT);
+}
+
+/* Sets to the next callback, a single one for a software group without
+   CONT. */
+static size_t toBoundary(ADCDriver *adcp) {
+  size_t pos = adcp->sim->pos;
+
+  if ((adcp->grpp->cfgr & (ADC_CFGR_EXTEN_Msk | ADC_CFGR_CONT)) == 0U) {
+    return 1U;
+  }
+  if (adcp->grpp->circular && (adcp->depth > 1U) && (pos < adcp->depth / 2U)) {
+    return adcp->depth / 2U - pos;
+  }
+  return adcp->depth - pos;
+}
+
+/*
+ * Fast mode origin of a new rate: the conversion start or, triggered, the
+ * first timer update from it. Drivers started before a common timer get
+ * the same origin whenever their threads notice the change.
+ */
+static double simAnchor(struct adcsim *sp, const ADCConversionGroup *grpp,
+                        double rate) {
+  GPTDriver *gptp;
+
+  if ((grpp->cfgr & ADC_CFGR_EXTEN_Msk) == 0U) {
+    return sp->startsim;
+  }
+  gptp = groupTimer(grpp);
+  if (gptp->simorigin >= sp->startsim) {
+    return gptp->simorigin;
+  }
+  return gptp->simorigin + ceil((sp->startsim - gptp->simorigin) * rate) /
+                           rate;
+}
+
+/* Simulated time of the next callback, infinite if none is due. */
+static double simDue(struct adcsim *sp) {
+
+  if ((sp->adcp->state != ADC_ACTIVE) || (sp->rate <= 0.0)) {
+    return INFINITY;
+  }
+  return sp->anchorsim + (double)(sp->sets + toBoundary(sp->adcp) -
+                                  sp->anchorsets) / sp->rate;
+}
+
+/*
+ * Fast mode, true if no other driver has an earlier callback due, so that
+ * the drivers on the same trigger stay in step as on the MCU. A driver
+ * whose thread has not seen its new rate yet counts as due now.
+ */
+static bool simEarliest(struct adcsim *sp) {
+  double due = simDue(sp);
+
+  for (unsigned i = 0U; i < ADCSIM_NUM_ADC; i++) {
+    ADCDriver *adcp = sims[i].adcp;
+    double other = simDue(&sims[i]);
+
+    if ((&sims[i] != sp) && (adcp->state == ADC_ACTIVE) &&
+        (groupRate(&sims[i], adcp->grpp) != sims[i].rate)) {
+      return false;
+    }
+
+    if ((other < due) || ((other == due) && (&sims[i] < sp))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void *simThread(void *p) {
+  struct adcsim *sp = p;
+  ADCDriver *adcp = sp->adcp;
+
+  chSysLock();
+  for (;;) {
+    adcsim_source_t src[ADC_MAX_CHANNELS];
+    const ADCConversionGroup *grpp;
+    adcsample_t *dst;
+    uint32_t gen;
+    double rate;
+    size_t n;
+
+    if (adcp->state != ADC_ACTIVE) {
+      chHostWaitS(0U);
+      continue;
+    }
+    grpp = adcp->grpp;
+
+    if (sp->inject != 0U) {
+      adcerror_t err = sp->inject;
+
+      sp->inject = 0U;
+      chHostEnterISR();
+      isrErrorCode(adcp, err);
+      chHostLeaveISR();
+      continue;
+    }
+
+    rate = groupRate(sp, grpp);
+    if (rate != sp->rate) {
+      sp->rate = rate;
+      sp->anchorsets = sp->sets;
+      sp->anchorns = chHostNow();
+      if (rate > 0.0) {
+        sp->anchorsim = simAnchor(sp, grpp, rate);
+      }
+      /* The other drivers may be waiting for this one.*/
+      chHostNotifyS();
+    }
+    if (rate <= 0.0) {
+      chHostWaitS(0U);
+      continue;
+    }
+
+    n = toBoundary(adcp);
+    if (simmode == ADCSIM_FAST) {
+      if (!chHostIsIdleS() || !simEarliest(sp)) {
+        chHostWaitS(0U);
+        continue;
+      }
+      if (simDue(sp) > simclock) {
+        simclock = simDue(sp);
+      }
+    }
+    else {
+      uint64_t due = sp->anchorns +
+                     (uint64_t)((double)(sp->sets + n - sp->anchorsets) *
+                                1e9 / rate);
+
+      if (chHostNow() < due) {
+        chHostWaitS(due);
+        continue;
+      }
+    }
+
+    gen = sp->gen;
+    dst = adcp->samples + sp->pos * grpp->num_channels;
+    memcpy(src, sp->src, sizeof(src));
+    chSysUnlock();
+    convert(sp, grpp, src, dst, n, rate);
+    chSysLock();
+    if (gen != sp->gen) {
+      continue;
+    }
+
+    sp->regs.DR = dst[n * grpp->num_channels - 1U];
+    sp->pos += n;
+    sp->sets += n;
+    chHostEnterISR();
+    if (sp->pos == adcp->depth) {
+      sp->pos = 0U;
+      isrFullCode(adcp);
+    }
+    else if (grpp->circular && (sp->pos == adcp->depth / 2U)) {
+      isrHalfCode(adcp);
+    }
+    chHostLeaveISR();
+    chHostNotifyS();
+  }
+  return NULL;
+}
+
+static void gptNotifyI(GPTDriver *gptp) {
+
+  gptp->origin = chSysGetRealtimeCounterX();
+  gptp->simorigin = simclock;
+  chHostNotifyS();
+}
+
+/*===========================================================================*/
+/* HAL exported functions.                                                   */
+/*===========================================================================*/
+
+void halInit(void) {
+
+  for (unsigned i = 0U; i < ADCSIM_NUM_ADC; i++) {
+    ADCDriver *adcp = adcs[i];
+    struct adcsim *sp = &sims[i];
+
+    memset(sp, 0, sizeof(*sp));
+    sp->adcp = adcp;
+    sp->rng = 0x9E3779B97F4A7C15ULL ^ (i + 1U);
+    /* Mid-scale inputs, and the typical internal channels of ADC1.*/
+    for (unsigned ch = 0U; ch < ADC_MAX_CHANNELS; ch++) {
+      sp->src[ch].dc = 2048.0;
+      sp->src[ch].noise = 1.0;
+    }
+    sp->src[16].dc = 950.0;
+    sp->src[17].dc = 1240.0;
+    sp->src[18].dc = 1500.0;
+
+    adcp->state = ADC_STOP;
+    adcp->config = NULL;
+    adcp->samples = NULL;
+    adcp->depth = 0U;
+    adcp->grpp = NULL;
+    adcp->thread = NULL;
+    chMtxObjectInit(&adcp->mutex);
+    adcp->adcm = &sp->regs;
+    adcp->sim = sp;
+  }
+  for (size_t i = 0U; i < sizeof(gpts) / sizeof(gpts[0]); i++) {
+    gpts[i]->state = GPT_STOP;
+    gpts[i]->config = NULL;
+  }
+}
+
+void adcStart(ADCDriver *adcp, const ADCConfig *config) {
+  struct adcsim *sp = adcp->sim;
+
+  chSysLock();
+  osalDbgAssert((adcp->state == ADC_STOP) || (adcp->state == ADC_READY),
+                "invalid state");
+  adcp->config = config;
+  adcp->state = ADC_READY;
+  if (!sp->started) {
+    sp->started = true;
+    if (pthread_create(&sp->tid, NULL, simThread, sp) != 0) {
+      chSysHalt("pthread_create");
+    }
+  }
+  chSysUnlock();
+}
+
+void adcStop(ADCDriver *adcp) {
+
+  chSysLock();
+  osalDbgAssert((adcp->state == ADC_STOP) || (adcp->state == ADC_READY),
+                "invalid state");
+  adcp->state = ADC_STOP;
+  chSysUnlock();
+}
+
+void adcStartConversion(ADCDriver *adcp, const ADCConversionGroup *grpp,
+                        adcsample_t *samples, size_t depth) {
+
+  chSysLock();
+  adcStartConversionI(adcp, grpp, samples, depth);
+  chSysUnlock();
+}
+
+void adcStartConversionI(ADCDriver *adcp, const ADCConversionGroup *grpp,
+                         adcsample_t *samples, size_t depth) {
+  struct adcsim *sp = adcp->sim;
+
+  osalDbgCheck((adcp != NULL) && (grpp != NULL) && (samples != NULL) &&
+               (grpp->num_channels > 0U) && (depth > 0U) &&
+               ((depth == 1U) || ((depth & 1U) == 0U)));
+  osalDbgAssert((adcp->state == ADC_READY) ||
+                (adcp->state == ADC_COMPLETE) ||
+                (adcp->state == ADC_ERROR),
+                "not ready");
+
+  adcp->samples = samples;
+  adcp->depth = depth;
+  adcp->grpp = grpp;
+  adcp->state = ADC_ACTIVE;
+
+  /* Registers as the LLD writes them.*/
+  sp->regs.CFGR = grpp->cfgr;
+  sp->regs.CFGR2 = grpp->cfgr2;
+  sp->regs.SMPR1 = grpp->smpr[0];
+  sp->regs.SMPR2 = grpp->smpr[1];
+  sp->regs.TR1 = grpp->tr1;
+  sp->regs.TR2 = grpp->tr2;
+  sp->regs.TR3 = grpp->tr3;
+  sp->regs.AWD2CR = grpp->awd2cr;
+  sp->regs.AWD3CR = grpp->awd3cr;
+  sp->regs.SQR1 = grpp->sqr[0] | ADC_SQR1_NUM_CH(grpp->num_channels);
+  sp->regs.SQR2 = grpp->sqr[1];
+  sp->regs.SQR3 = grpp->sqr[2];
+  sp->regs.SQR4 = grpp->sqr[3];
+
+  sp->gen++;
+  sp->pos = 0U;
+  sp->rate = -1.0;
+  sp->startsim = simclock;
+  chHostNotifyS();
+}
+
+void adcStopConversion(ADCDriver *adcp) {
+
+  chSysLock();
+  adcStopConversionI(adcp);
+  chSysUnlock();
+}
+
+void adcStopConversionI(ADCDriver *adcp) {
+
+  osalDbgCheck(adcp != NULL);
+  osalDbgAssert((adcp->state == ADC_READY) ||
+                (adcp->state == ADC_ACTIVE) ||
+                (adcp->state == ADC_COMPLETE),
+                "invalid state");
+
+  if (adcp->state != ADC_READY) {
+    lldStopConversion(adcp->sim);
+    adcp->grpp = NULL;
+    adcp->state = ADC_READY;
+    chThdResumeI(&adcp->thread, MSG_RESET);
+  }
+}
+
+msg_t adcConvert(ADCDriver *adcp, const ADCConversionGroup *grpp,
+                 adcsample_t *samples, size_t depth) {
+  msg_t msg;
+
+  chSysLock();
+  osalDbgAssert(adcp->thread == NULL, "already waiting");
+  adcStartConversionI(adcp, grpp, samples, depth);
+  msg = chThdSuspendS(&adcp->thread);
+  chSysUnlock();
+  return msg;
+}
+
+void adcAcquireBus(ADCDriver *adcp) {
+
+  chMtxLock(&adcp->mutex);
+}
+
+void adcReleaseBus(ADCDriver *adcp) {
+
+  chMtxUnlock(&adcp->mutex);
+}
+
+void gptStart(GPTDriver *gptp, const GPTConfig *config) {
+
+  chSysLock();
+  osalDbgAssert((gptp->state == GPT_STOP) || (gptp->state == GPT_READY),
+                "invalid state");
+  gptp->config = config;
+  gptp->state = GPT_READY;
+  chSysUnlock();
+}
+
+void gptStop(GPTDriver *gptp) {
+
+  chSysLock();
+  osalDbgAssert((gptp->state == GPT_STOP) || (gptp->state == GPT_READY),
+                "invalid state");
+  gptp->state = GPT_STOP;
+  chSysUnlock();
+}
+
+void gptStartContinuous(GPTDriver *gptp, gptcnt_t interval) {
+
+  chSysLock();
+  gptStartContinuousI(gptp, interval);
+  chSysUnlock();
+}
+
+void gptStartContinuousI(GPTDriver *gptp, gptcnt_t interval) {
+
+  osalDbgCheck(interval > 0U);
+  osalDbgAssert(gptp->state == GPT_READY, "invalid state");
+  gptp->interval = interval;
+  gptp->state = GPT_CONTINUOUS;
+  gptNotifyI(gptp);
+}
+
+void gptChangeInterval(GPTDriver *gptp, gptcnt_t interval) {
+
+  chSysLock();
+  osalDbgAssert(gptp->state == GPT_CONTINUOUS, "invalid state");
+  gptp->interval = interval;
+  gptNotifyI(gptp);
+  chSysUnlock();
+}
+
+void gptStopTimer(GPTDriver *gptp) {
+
+  chSysLock();
+  gptStopTimerI(gptp);
+  chSysUnlock();
+}
+
+void gptStopTimerI(GPTDriver *gptp) {
+
+  osalDbgAssert((gptp->state == GPT_READY) ||
+                (gptp->state == GPT_CONTINUOUS) ||
+                (gptp->state == GPT_ONESHOT),
+                "invalid state");
+  gptp->state = GPT_READY;
+  chHostNotifyS();
+}
+
+/* Ticks since the last update, from the wall clock, 0 in fast mode. */
+gptcnt_t gptGetCounterX(GPTDriver *gptp) {
+  uint64_t ticks;
+
+  if ((simmode == ADCSIM_FAST) || (gptp->state != GPT_CONTINUOUS)) {
+    return 0U;
+  }
+  ticks = (uint64_t)(rtcnt_t)(chSysGetRealtimeCounterX() - gptp->origin) *
+          gptp->config->frequency / STM32_SYSCLK;
+  return (gptcnt_t)(ticks % gptp->interval);
+}
+
+/*===========================================================================*/
+/* Simulator exported functions.                                             */
+/*===========================================================================*/
+
+void adcsimSetMode(adcsim_mode_t mode) {
+
+  chSysLock();
+  simmode = mode;
+  chHostNotifyS();
+  chSysUnlock();
+}
+
+void adcsimSetSeed(ADCDriver *adcp, uint64_t seed) {
+
+  chSysLock();
+  adcp->sim->rng = seed != 0U ? seed : 1U;
+  chSysUnlock();
+}
+
+void adcsimSetSource(ADCDriver *adcp, unsigned ch,
+                     const adcsim_source_t *srcp) {
+
+  osalDbgCheck(ch < ADC_MAX_CHANNELS);
+
+  chSysLock();
+  adcp->sim->src[ch] = *srcp;
+  chSysUnlock();
+}
+
+/*
+ * Updates a source from "key=value,..." with the keys dc, amp, freq,
+ * step, period and noise. Returns false on a malformed spec.
+ */
+bool adcsimParseSource(const char *spec, adcsim_source_t *srcp) {
+  static const struct {
+    const char *key;
+    size_t offset;
+  } keys[] = {
+    {"dc",     offsetof(adcsim_source_t, dc)},
+    {"amp",    offsetof(adcsim_source_t, amp)},
+    {"freq",   offsetof(adcsim_source_t, freq)},
+    {"step",   offsetof(adcsim_source_t, step)},
+    {"period", offsetof(adcsim_source_t, period)},
+    {"noise",  offsetof(adcsim_source_t, noise)}
+  };
+
+  while (*spec != '\0') {
+    const char *eq = strchr(spec, '=');
+    size_t i, len;
+    char *end;
+    double v;
+
+    if (eq == NULL) {
+      return false;
+    }
+    len = (size_t)(eq - spec);
+    for (i = 0U; i < sizeof(keys) / sizeof(keys[0]); i++) {
+      if ((strlen(keys[i].key) == len) &&
+          (strncmp(keys[i].key, spec, len) == 0)) {
+        break;
+      }
+    }
+    if (i == sizeof(keys) / sizeof(keys[0])) {
+      return false;
+    }
+    v = strtod(eq + 1, &end);
+    if ((end == eq + 1) || ((*end != ',') && (*end != '\0'))) {
+      return false;
+    }
+    *(double *)(void *)((uint8_t *)srcp + keys[i].offset) = v;
+    spec = (*end == ',') ? end + 1 : end;
+  }
+  return true;
+}
+
+/*
+ * Loads a replay file: text, one set per line, values separated by
+ * commas, blanks or semicolons, the first skip columns ignored. Lines not
+ * starting with a number, like the header of a scope.py CSV, are skipped.
+ */
+bool adcsimLoadFile(ADCDriver *adcp, const char *path, unsigned skip) {
+  struct adcsim *sp = adcp->sim;
+  FILE *f = fopen(path, "r");
+  uint16_t *data = NULL;
+  size_t count = 0U, cap = 0U;
+  unsigned cols = 0U;
+  char line[1024];
+
+  if (f == NULL) {
+    return false;
+  }
+
+  while (fgets(line, sizeof(line), f) != NULL) {
+    const char *s = line + strspn(line, " \t");
+    unsigned col = 0U, n = 0U;
+
+    if ((*s == '\0') || (strchr("0123456789+-.", *s) == NULL)) {
+      continue;
+    }
+    while ((cols == 0U) || (n < cols)) {
+      char *end;
+      double v = strtod(s, &end);
+
+      if (end == s) {
+        break;
+      }
+      if (col++ >= skip) {
+        if (count == cap) {
+          uint16_t *p;
+
+          cap = (cap != 0U) ? 2U * cap : 4096U;
+          p = realloc(data, cap * sizeof(uint16_t));
+          if (p == NULL) {
+            break;
+          }
+          data = p;
+        }
+        v = floor(v + 0.5);
+        data[count++] = v < 0.0 ? 0U : v > 65535.0 ? 65535U : (uint16_t)v;
+        n++;
+      }
+      s = end + strspn(end, " \t,;");
+    }
+    if (cols == 0U) {
+      cols = n;
+    }
+    if ((n == 0U) || (n != cols)) {
+      /* Short or truncated last line.*/
+      count -= n;
+      break;
+    }
+  }
+  fclose(f);
+
+  if (count == 0U) {
+    free(data);
+    return false;
+  }
+
+  chSysLock();
+  free(sp->file);
+  sp->file = data;
+  sp->rows = count / cols;
+  sp->cols = cols;
+  sp->row = 0U;
+  chSysUnlock();
+  return true;
+}
+
+/* Raises an ADC error at the next step of the running conversion. */
+void adcsimInjectError(ADCDriver *adcp, adcerror_t err) {
+
+  chSysLock();
+  adcp->sim->inject |= err;
+  chHostNotifyS();
+  chSysUnlock();
+}
+
+uint64_t adcsimGetSets(ADCDriver *adcp) {
+  uint64_t sets;
+
+  chSysLock();
+  sets = adcp->sim->sets;
+  chSysUnlock();
+  return sets;
+}
+
+double adcsimGetRate(ADCDriver *adcp) {
+  double rate;
+
+  chSysLock();
+  rate = adcp->sim->rate > 0.0 ? adcp->sim->rate : 0.0;
+  chSysUnlock();
+  return rate;
+}
@@ -0,0 +1,77 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Host versions of the CMSIS Cortex-M4 SIMD intrinsics used by the ADC
+ * library, with the semantics of the Armv7-M ARM, so that the SIMD kernels
+ * can be built with ADCDSP_USE_SIMD and checked against the C reference.
+ * The APSR.GE flags set by __USUB16 and read by __SEL are per thread.
+ */
+
+#ifndef __HOSTSIMD_H__
+#define __HOSTSIMD_H__
+
+#include <stdint.h>
+
+static inline uint32_t *simdGE(void) {
+  static __thread uint32_t ge;
+
+  return &ge;
+}
+
+static inline int32_t simdLo(uint32_t x) {
+
+  return (int16_t)(x & 0xFFFFU);
+}
+
+static inline int32_t simdHi(uint32_t x) {
+
+  return (int16_t)(x >> 16);
+}
+
+static inline uint32_t __SMLAD(uint32_t x, uint32_t y, uint32_t acc) {
+
+  return acc + (uint32_t)(simdLo(x) * simdLo(y)) +
+               (uint32_t)(simdHi(x) * simdHi(y));
+}
+
+static inline uint64_t __SMLALD(uint32_t x, uint32_t y, uint64_t acc) {
+
+  return acc + (uint64_t)((int64_t)simdLo(x) * simdLo(y) +
+                          (int64_t)simdHi(x) * simdHi(y));
+}
+
+/* GE[1:0] for the low halfword, GE[3:2] for the high one. */
+static inline uint32_t __USUB16(uint32_t x, uint32_t y) {
+  uint32_t lo = (x & 0xFFFFU) - (y & 0xFFFFU);
+  uint32_t hi = (x >> 16) - (y >> 16);
+
+  *simdGE() = ((x & 0xFFFFU) >= (y & 0xFFFFU) ? 0x3U : 0U) |
+              ((x >> 16) >= (y >> 16) ? 0xCU : 0U);
+  return (lo & 0xFFFFU) | (hi << 16);
+}
+
+static inline uint32_t __SEL(uint32_t x, uint32_t y) {
+  uint32_t ge = *simdGE();
+
+  return ((ge & 0x1U) != 0U ? x & 0xFFFFU : y & 0xFFFFU) |
+         ((ge & 0x4U) != 0U ? x & 0xFFFF0000U : y & 0xFFFF0000U);
+}
+
+#define __PKHBT(x, y, sh)                                                   \
+  (((uint32_t)(x) & 0xFFFFU) | (((uint32_t)(y) << (sh)) & 0xFFFF0000U))
+#define __PKHTB(x, y, sh)                                                   \
+  (((uint32_t)(x) & 0xFFFF0000U) | (((uint32_t)(y) >> (sh)) & 0xFFFFU))
+
+#endif /* __HOSTSIMD_H__ */
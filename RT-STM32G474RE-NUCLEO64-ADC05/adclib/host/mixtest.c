@@ -0,0 +1,320 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Checks adcmix.c on the simulated ADC1. Random channel sets are planned
+ * first: each channel must hold its share of ranks, evenly spaced in one
+ * column of the rotation, and reach its target rate unless its average
+ * is at ADCMIX_MAX_AVERAGE; a repeated channel must give no plan. Then
+ * the ADC05 "mix" example runs and every output sample is checked against
+ * its timestamp, with no gap between the ticks of consecutive blocks: a
+ * 1 kHz sine on the first channel, square waves on the others, their
+ * averages of d conversions computed exactly as adcmix.c rounds them.
+ *
+ * Usage:
+ *   mixtest [-s seed] [-i plans] [-b blocks]
+ *
+ * Exit status 1 on the first mismatch.
+ */
+
+#include "ch.h"
+#include "hal.h"
+
+#include "adcsim.h"
+#include "adcmix.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define DEPTH           128U
+#define TIMER_HZ        1000000U
+#define SMP             ADC_SMPR_SMP_24P5
+/* Rounding of the sine conversions. */
+#define MAX_ERROR       1.0
+
+static const GPTConfig gptcfg = {
+  .frequency    = TIMER_HZ,
+  .callback     = NULL,
+  .cr2          = 0U,
+  .dier         = 0U
+};
+
+/* The "mix IN1:40000 IN2:40000 IN6:100 ... IN12:10" of the example. */
+static const adcmix_channel_t chans[] = {
+  {ADCGRP_CH(ADC_CHANNEL_IN1, ADC_SMPR_SMP_6P5), 40000U},
+  {ADCGRP_CH(ADC_CHANNEL_IN2, ADC_SMPR_SMP_6P5), 40000U},
+  {ADCGRP_CH(ADC_CHANNEL_IN6, SMP), 100U},
+  {ADCGRP_CH(ADC_CHANNEL_IN7, SMP), 100U},
+  {ADCGRP_CH(ADC_CHANNEL_IN8, SMP), 100U},
+  {ADCGRP_CH(ADC_CHANNEL_IN9, SMP), 100U},
+  {ADCGRP_CH(ADC_CHANNEL_IN10, SMP), 100U},
+  {ADCGRP_CH(ADC_CHANNEL_IN11, SMP), 100U},
+  {ADCGRP_CH(ADC_CHANNEL_IN12, ADC_SMPR_SMP_247P5), 10U}
+};
+
+#define NUM_CHANNELS    (sizeof(chans) / sizeof(chans[0]))
+#define SINE_CH         0U
+#define SINE_HZ         1000.0
+#define LEVEL(i)        (300U + 400U * (i))
+#define STEP            200U
+/* Square wave half periods in seconds, irrational so no edge falls on a
+   trigger. */
+#define HALF(i)         (0.0137 * M_SQRT2 * ((i) + 1U))
+
+static adcsample_t buf[ADCMIX_BUF_SIZE(DEPTH)];
+static adcsample_t out[ADCMIX_OUT_SIZE(DEPTH)];
+static ADCMixDriver MIX1;
+
+static ADCMixConfig mixcfg = {
+  .adcp         = &ADCD1,
+  .errp         = NULL,
+  .channels     = chans,
+  .num_channels = NUM_CHANNELS,
+  .gptp         = &GPTD4,
+  .cfgr         = ADCGRP_TRIGGER(TIM4_TRGO),
+  .buf          = buf,
+  .depth        = DEPTH,
+  .out          = out
+};
+
+static double sine(double t) {
+
+  return floor(2048.0 + 1000.0 * sin(2.0 * M_PI * SINE_HZ * t) + 0.5);
+}
+
+static uint32_t square(unsigned i, double t) {
+
+  return LEVEL(i) + (((uint64_t)(t / HALF(i)) & 1U) != 0U ? STEP : 0U);
+}
+
+/* Checks the ranks and rates of the last plan. */
+static bool checkPlan(const ADCMixDriver *mp, const ADCMixConfig *cfg) {
+  unsigned count[ADCMIX_MAX_CHANNELS] = {0};
+  unsigned len = mp->frames * mp->width;
+
+  if (len == 0U || len > ADCGRP_MAX_CHANNELS ||
+      (mp->frames > 1U && mp->width > ADCMIX_MAX_FRAME_RANKS)) {
+    printf("mixtest: %u frames of %u ranks\n", mp->frames, mp->width);
+    return false;
+  }
+  for (unsigned r = 0; r < len; r++) {
+    if (mp->rank[r] != ADCMIX_IDLE) {
+      count[mp->rank[r]]++;
+    }
+  }
+  for (unsigned i = 0; i < cfg->num_channels; i++) {
+    const adcmix_chan_t *cp = &mp->chan[i];
+    unsigned step = mp->frames / cp->k;
+    double rate = (double)TIMER_HZ / adcmixGetPeriod(mp, i);
+
+    if (count[i] != cp->k || step * cp->k != mp->frames) {
+      printf("mixtest: IN%u has %u ranks, not %u of %u frames\n",
+             ADCGRP_CHN(cfg->channels[i].entry), count[i], cp->k,
+             mp->frames);
+      return false;
+    }
+    for (unsigned j = 0; j < cp->k; j++) {
+      if (mp->rank[(cp->frame + j * step) * mp->width + cp->column] != i) {
+        printf("mixtest: IN%u rank %u of %u off its column\n",
+               ADCGRP_CHN(cfg->channels[i].entry), j, cp->k);
+        return false;
+      }
+    }
+    if (rate < cfg->channels[i].rate * 0.999999 &&
+        cp->d < ADCMIX_MAX_AVERAGE) {
+      printf("mixtest: IN%u at %.3f Hz for %u Hz\n",
+             ADCGRP_CHN(cfg->channels[i].entry), rate,
+             cfg->channels[i].rate);
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool checkPlans(unsigned plans) {
+  adcmix_channel_t cc[ADCMIX_MAX_CHANNELS];
+  ADCMixConfig cfg = mixcfg;
+
+  cfg.channels = cc;
+  for (unsigned it = 0; it < plans; it++) {
+    cfg.num_channels = 1U + (unsigned)rand() % ADCMIX_MAX_CHANNELS;
+    for (unsigned i = 0; i < cfg.num_channels; i++) {
+      cc[i].entry = ADCGRP_CH(i + 1U, (unsigned)rand() % 8U);
+      cc[i].rate = 1U + (unsigned)rand() %
+                        (rand() % 3 == 0 ? 100000U : 1000U);
+    }
+    if (!adcmixPlan(&MIX1, &cfg)) {
+      printf("mixtest: plan %u of %u channels failed\n", it,
+             cfg.num_channels);
+      return false;
+    }
+    if (!checkPlan(&MIX1, &cfg)) {
+      return false;
+    }
+  }
+
+  cc[1].entry = cc[0].entry;
+  cfg.num_channels = 2U;
+  if (adcmixPlan(&MIX1, &cfg)) {
+    printf("mixtest: plan with a repeated channel\n");
+    return false;
+  }
+  printf("mixtest: %u random plans checked\n", plans);
+  return true;
+}
+
+/* Checks the outputs of the last block, next holds the expected ticks. */
+static bool checkBlock(uint64_t *next, double *maxerr) {
+
+  for (unsigned i = 0; i < NUM_CHANNELS; i++) {
+    const adcmix_output_t *op = adcmixGetOutput(&MIX1, i);
+    const adcmix_chan_t *cp = &MIX1.chan[i];
+    double step = (double)(MIX1.frames / cp->k) * MIX1.interval / TIMER_HZ;
+
+    if (op->n == 0U) {
+      continue;
+    }
+    if (op->period != adcmixGetPeriod(&MIX1, i) ||
+        (next[i] != 0U && op->tick != next[i])) {
+      printf("mixtest: IN%u block %u tick %llu, not %llu\n",
+             ADCGRP_CHN(chans[i].entry), MIX1.blocks,
+             (unsigned long long)op->tick, (unsigned long long)next[i]);
+      return false;
+    }
+    next[i] = op->tick + op->n * (uint64_t)op->period;
+
+    for (size_t s = 0; s < op->n; s++) {
+      double t = (double)(op->tick + s * (uint64_t)op->period) / TIMER_HZ;
+      double expect, err;
+
+      if (i == SINE_CH) {
+        expect = sine(t);
+      }
+      else {
+        /* Rounded mean of d conversions, one every frames / k frames.*/
+        uint32_t sum = 0U;
+
+        for (unsigned q = 0; q < cp->d; q++) {
+          sum += square(i, t + q * step);
+        }
+        expect = (sum + cp->d / 2U) / cp->d;
+      }
+      err = fabs(op->samples[s] - expect);
+      if (err > (i == SINE_CH ? MAX_ERROR : 0.0)) {
+        printf("mixtest: IN%u block %u sample %zu is %u, not %.2f\n",
+               ADCGRP_CHN(chans[i].entry), MIX1.blocks, s,
+               op->samples[s], expect);
+        return false;
+      }
+      if (err > *maxerr) {
+        *maxerr = err;
+      }
+    }
+  }
+  return true;
+}
+
+static bool checkRun(unsigned blocks) {
+  uint64_t next[NUM_CHANNELS] = {0};
+  double maxerr = 0.0, secs;
+
+  for (unsigned i = 0; i < NUM_CHANNELS; i++) {
+    adcsim_source_t src = {
+      .dc       = LEVEL(i),
+      .step     = STEP,
+      .period   = HALF(i)
+    };
+
+    if (i == SINE_CH) {
+      src = (adcsim_source_t){.dc = 2048.0, .amp = 1000.0, .freq = SINE_HZ};
+    }
+    adcsimSetSource(&ADCD1, ADCGRP_CHN(chans[i].entry), &src);
+  }
+
+  if (!adcmixStart(&MIX1, &mixcfg)) {
+    printf("mixtest: adcmixStart() failed\n");
+    return false;
+  }
+  for (unsigned b = 0; b < blocks; b++) {
+    if (adcmixReadTimeout(&MIX1, TIME_MS2I(500)) != MSG_OK) {
+      printf("mixtest: read failed at block %u\n", b);
+      adcmixStop(&MIX1);
+      return false;
+    }
+    if (!checkBlock(next, &maxerr)) {
+      adcmixStop(&MIX1);
+      return false;
+    }
+  }
+  adcmixStop(&MIX1);
+  if (adcmixGetLost(&MIX1) != 0U || adcmixGetTorn(&MIX1) != 0U) {
+    printf("mixtest: %u blocks lost, %u torn\n", adcmixGetLost(&MIX1),
+           adcmixGetTorn(&MIX1));
+    return false;
+  }
+
+  /* Samples over the time of the blocks read, against the plan rates.*/
+  secs = (double)blocks * (DEPTH / 2U) * MIX1.frames * MIX1.interval /
+         TIMER_HZ;
+  for (unsigned i = 0; i < NUM_CHANNELS; i++) {
+    double rate = (double)TIMER_HZ / adcmixGetPeriod(&MIX1, i);
+    double measured = adcmixGetSamples(&MIX1, i) / secs;
+
+    if (fabs(measured - rate) > rate * 0.01 + 1.0 / secs) {
+      printf("mixtest: IN%u measured %.3f Hz, planned %.3f Hz\n",
+             ADCGRP_CHN(chans[i].entry), measured, rate);
+      return false;
+    }
+  }
+  printf("mixtest: %u blocks, %.2f s checked, sine error %.2f LSB\n",
+         blocks, secs, maxerr);
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  unsigned seed = 1U, plans = 100000U, blocks = 4000U;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:i:b:")) != -1) {
+    switch (opt) {
+    case 's':
+      seed = (unsigned)strtoul(optarg, NULL, 0);
+      break;
+    case 'i':
+      plans = (unsigned)strtoul(optarg, NULL, 0);
+      break;
+    case 'b':
+      blocks = (unsigned)strtoul(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "usage: mixtest [-s seed] [-i plans] [-b blocks]\n");
+      return 2;
+    }
+  }
+  srand(seed);
+
+  halInit();
+  chSysInit();
+  adcsimSetMode(ADCSIM_FAST);
+  gptStart(&GPTD4, &gptcfg);
+  adcStart(&ADCD1, NULL);
+  adcmixObjectInit(&MIX1);
+
+  if (!checkPlans(plans) || !checkRun(blocks)) {
+    return 1;
+  }
+  return 0;
+}
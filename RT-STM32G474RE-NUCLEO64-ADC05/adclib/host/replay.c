@@ -0,0 +1,387 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Host replay of the ADC05 stream pipeline. The stream of ADCS1 runs on
+ * the simulated ADC1, triggered by GPT4 as on the board, and a consumer
+ * thread runs the library stages on each block: running statistics,
+ * CIC/FIR decimation and the spectrum of the first channel. The report
+ * gives the cost of each stage per sample set and the throughput ceiling
+ * of the pipeline on this machine.
+ *
+ * Usage:
+ *   replay [-r rate_hz] [-n sets] [-d depth] [-t] [-s seed]
+ *          [-c ch:key=value,...] [-f file[:skip]] [-p peak_hz]
+ *          [-o blocks] [-R]
+ *
+ *   -r  trigger rate, default 20000 Hz
+ *   -n  sample sets to process, default 1000000
+ *   -d  stream buffer depth in sets, default 512
+ *   -t  wall clock rate instead of as fast as possible
+ *   -s  noise generator seed
+ *   -c  signal of channel ch, keys dc amp freq step period noise, e.g.
+ *       -c 1:amp=1000,freq=1000 -c 2:step=500,period=0.01
+ *   -f  replay file instead of the generators, e.g. a scope.py capture
+ *       with -f capture.csv:1 to skip its time column
+ *   -p  expected spectrum peak of the first channel, exit status 1 when
+ *       the peak is more than two bins away
+ *   -o  inject an ADC overflow after that many blocks
+ *   -R  restart the stream after an overflow
+ *
+ * Exit status 2 when the stream ends on an error.
+ */
+
+#include "ch.h"
+#include "hal.h"
+
+#include "adcsim.h"
+#include "adcgrp.h"
+#include "adcstream.h"
+#include "adcstats.h"
+#include "adcdecim.h"
+#include "adcfft.h"
+#include "adcerr.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define RP_NUM_CHANNELS         2
+#define RP_MAX_DEPTH            8192U
+#define RP_FFT_POINTS           1024U
+#define RP_STATS_LOG2ALPHA      4U
+
+/*
+ * GPT4 configuration, the trigger of the stream as in main.c.
+ */
+static const GPTConfig gpt4cfg = {
+  .frequency    =  1000000U,
+  .callback     =  NULL,
+  .cr2          =  TIM_CR2_MMS_1,   /* MMS = 010 = TRGO on Update Event.    */
+  .dier         =  0U
+};
+
+#define RP_SEQ          ADCGRP_CH(ADC_CHANNEL_IN1, ADC_SMPR_SMP_24P5),  \
+                        ADCGRP_CH(ADC_CHANNEL_IN2, ADC_SMPR_SMP_24P5)
+
+_Static_assert(ADCGRP_NARGS(RP_SEQ) == RP_NUM_CHANNELS,
+               "replay sequence length");
+
+static const ADCConversionGroup streamcfg = {
+  .circular     = true,
+  ADCGRP_SEQUENCE(RP_SEQ),
+  .end_cb       = NULL,
+  .error_cb     = NULL,
+  .cfgr         = ADCGRP_TRIGGER(TIM4_TRGO),
+  .cfgr2        = 0U,
+  .tr1          = ADC_TR_DISABLED,
+  .tr2          = ADC_TR_DISABLED,
+  .tr3          = ADC_TR_DISABLED,
+  .awd2cr       = 0U,
+  .awd3cr       = 0U
+};
+
+static adcsample_t samples[RP_NUM_CHANNELS * RP_MAX_DEPTH];
+
+static ADCStreamDriver ADCS1;
+static adcerr_t ERR1;
+
+static ADCStreamConfig adcs1cfg = {
+  .adcp         = &ADCD1,
+  .grpp         = &streamcfg,
+  .buf          = samples,
+  .depth        = 512U,
+  .gptp         = &GPTD4,
+  .interval     = 50U,                      /* 20 kHz */
+  .errp         = &ERR1,
+  .restart      = false
+};
+
+/*===========================================================================*/
+/* Pipeline.                                                                 */
+/*===========================================================================*/
+
+/* cicfir.py --order 3 --log2r 4 --m 4 --taps 48 --passband 0.8 */
+static const int16_t cic3r16m4_taps[48] = {
+       0,      0,      1,      5,     10,      9,     -6,    -39,
+     -75,    -81,    -20,    120,    286,    366,    230,   -177,
+    -745,  -1178,  -1083,   -156,   1626,   3909,   6045,   7337,
+    7337,   6045,   3909,   1626,   -156,  -1083,  -1178,   -745,
+    -177,    230,    366,    286,    120,    -20,    -81,    -75,
+     -39,     -6,      9,     10,      5,      1,      0,      0,
+};
+
+static const adcdecim_config_t decimcfg = {
+  .order        = 3U,
+  .log2r        = 4U,
+  .m            = 4U,
+  .taps         = 48U,
+  .coeffs       = cic3r16m4_taps
+};
+
+typedef enum {
+  STAGE_STATS = 0,
+  STAGE_DECIM = 1,
+  STAGE_FFT = 2,
+  STAGE_NUM = 3
+} stage_t;
+
+static const char *const stagenames[STAGE_NUM] = {"stats", "decim", "fft"};
+
+static adcstats_t STATS1;
+static adcdecim_t decim;
+static int16_t decimated[RP_NUM_CHANNELS * (RP_MAX_DEPTH / 2U / 64U + 1U)];
+static adcfft_t FFT1;
+
+static struct {
+  uint64_t target;
+  uint64_t sets;
+  uint32_t blocks;
+  uint32_t lost;
+  uint32_t late;
+  uint32_t frames;
+  uint32_t inject;
+  uint64_t ns[STAGE_NUM];
+  adcfft_peak_t peak;
+} run;
+
+static THD_WORKING_AREA(waConsumer, 2048);
+static THD_FUNCTION(Consumer, arg) {
+
+  (void)arg;
+  chRegSetThreadName("consumer");
+
+  while (run.sets < run.target) {
+    adcs_block_t blk;
+    rtcnt_t t0, t1, t2, t3;
+    size_t done = 0U;
+
+    if (adcsReadTimeout(&ADCS1, &blk, TIME_S2I(1)) != MSG_OK) {
+      break;
+    }
+    run.blocks++;
+    if (blk.lost > 0U) {
+      run.lost += blk.lost;
+      adcfftReset(&FFT1);
+    }
+    if ((run.inject > 0U) && (run.blocks == run.inject)) {
+      adcsimInjectError(&ADCD1, ADC_ERR_OVERFLOW);
+    }
+
+    t0 = chSysGetRealtimeCounterX();
+    adcstatsFeed(&STATS1, blk.samples, blk.n);
+    t1 = chSysGetRealtimeCounterX();
+    (void) adcdecimProcess(&decim, blk.samples, blk.n, decimated);
+    t2 = chSysGetRealtimeCounterX();
+    while (done < blk.n) {
+      done += adcfftFeed(&FFT1, blk.samples + done * RP_NUM_CHANNELS,
+                         blk.n - done, RP_NUM_CHANNELS, 0U);
+      if (!adcfftIsReady(&FFT1)) {
+        break;
+      }
+      adcfftCompute(&FFT1);
+      (void) adcfftPeaks(&FFT1, &run.peak, 1U);
+      run.frames++;
+    }
+    t3 = chSysGetRealtimeCounterX();
+
+    run.ns[STAGE_STATS] += (rtcnt_t)(t1 - t0);
+    run.ns[STAGE_DECIM] += (rtcnt_t)(t2 - t1);
+    run.ns[STAGE_FFT] += (rtcnt_t)(t3 - t2);
+    if (adcsRelease(&ADCS1, &blk)) {
+      run.late++;
+    }
+    run.sets += blk.n;
+  }
+}
+
+/*===========================================================================*/
+/* Report.                                                                   */
+/*===========================================================================*/
+
+static void print_report(adcsim_mode_t mode, uint32_t rate, uint64_t wallns) {
+  adcs_stats_t stats;
+  adcerr_counters_t errs;
+  uint64_t total = 0U;
+  double sets = run.sets > 0U ? (double)run.sets : 1.0;
+
+  adcsGetStats(&ADCS1, &stats);
+  adcerrGet(&ERR1, &errs);
+
+  printf("mode %s, rate %u Hz, %u channels, depth %u\n",
+         mode == ADCSIM_FAST ? "fast" : "realtime", rate, RP_NUM_CHANNELS,
+         (unsigned)adcs1cfg.depth);
+  printf("sets %llu in %.3f s: %.0f sets/s, %.1fx realtime\n",
+         (unsigned long long)run.sets, wallns / 1e9,
+         run.sets * 1e9 / (double)(wallns > 0U ? wallns : 1U),
+         run.sets * 1e9 / (double)(wallns > 0U ? wallns : 1U) / rate);
+  printf("blocks %u, lost %u, late %u, overruns %u, errors %u, restarts %u\n",
+         run.blocks, run.lost, run.late, errs.overruns, errs.errors,
+         errs.restarts);
+
+  printf("stage     ns/set\n");
+  for (unsigned i = 0U; i < STAGE_NUM; i++) {
+    printf("%-8s %7.1f\n", stagenames[i], run.ns[i] / sets);
+    total += run.ns[i];
+  }
+  printf("%-8s %7.1f  ceiling %.0f sets/s\n", "total", total / sets,
+         total > 0U ? sets * 1e9 / (double)total : 0.0);
+
+  for (unsigned c = 0U; c < RP_NUM_CHANNELS; c++) {
+    adcstats_result_t r;
+
+    adcstatsGet(&STATS1, c, ADCSTATS_RUNNING, &r);
+    printf("ch%u mean %.2f sd %.2f min %u max %u\n", c, r.mean / 65536.0,
+           r.stddev / 256.0, r.min, r.max);
+  }
+  if (run.frames > 0U) {
+    printf("fft ch0 frames %u peak %u Hz\n", run.frames,
+           (unsigned)adcfftBinHz(&FFT1, run.peak.bin, rate));
+  }
+  (void)stats;
+}
+
+/*===========================================================================*/
+/* Application entry point.                                                  */
+/*===========================================================================*/
+
+static void usage(void) {
+
+  fprintf(stderr, "Usage: replay [-r rate_hz] [-n sets] [-d depth] [-t] "
+                  "[-s seed]\n"
+                  "              [-c ch:key=value,...] [-f file[:skip]] "
+                  "[-p peak_hz]\n"
+                  "              [-o blocks] [-R]\n");
+  exit(2);
+}
+
+int main(int argc, char *argv[]) {
+  adcsim_mode_t mode = ADCSIM_FAST;
+  uint32_t rate = 20000U, peakhz = 0U;
+  const char *file = NULL;
+  adcs_stats_t stats;
+  thread_t *tp;
+  uint64_t t0;
+  int opt;
+
+  halInit();
+  chSysInit();
+
+  run.target = 1000000U;
+  while ((opt = getopt(argc, argv, "r:n:d:ts:c:f:p:o:R")) != -1) {
+    switch (opt) {
+    case 'r':
+      rate = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    case 'n':
+      run.target = strtoull(optarg, NULL, 0);
+      break;
+    case 'd':
+      adcs1cfg.depth = strtoul(optarg, NULL, 0);
+      break;
+    case 't':
+      mode = ADCSIM_REALTIME;
+      break;
+    case 's':
+      adcsimSetSeed(&ADCD1, strtoull(optarg, NULL, 0));
+      break;
+    case 'c': {
+      char *end;
+      unsigned long ch = strtoul(optarg, &end, 0);
+      adcsim_source_t src = {.dc = 2048.0, .noise = 1.0};
+
+      if ((*end != ':') || (ch >= ADC_MAX_CHANNELS) ||
+          !adcsimParseSource(end + 1, &src)) {
+        usage();
+      }
+      adcsimSetSource(&ADCD1, (unsigned)ch, &src);
+      break;
+    }
+    case 'f':
+      file = optarg;
+      break;
+    case 'p':
+      peakhz = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    case 'o':
+      run.inject = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    case 'R':
+      adcs1cfg.restart = true;
+      break;
+    default:
+      usage();
+    }
+  }
+
+  if ((rate == 0U) || (rate > gpt4cfg.frequency) ||
+      (rate > 2U * ADCGRP_ADCCLK / ADCGRP_SEQ_HALFCYCLES(RP_SEQ)) ||
+      (adcs1cfg.depth < 2U) || (adcs1cfg.depth > RP_MAX_DEPTH) ||
+      ((adcs1cfg.depth & 1U) != 0U)) {
+    usage();
+  }
+  if (file != NULL) {
+    char path[512];
+    char *colon;
+    unsigned skip = 0U;
+
+    snprintf(path, sizeof(path), "%s", file);
+    colon = strrchr(path, ':');
+    if (colon != NULL) {
+      *colon = '\0';
+      skip = (unsigned)strtoul(colon + 1, NULL, 0);
+    }
+    if (!adcsimLoadFile(&ADCD1, path, skip)) {
+      fprintf(stderr, "replay: cannot load %s\n", path);
+      return 2;
+    }
+  }
+
+  adcsimSetMode(mode);
+  adcerrObjectInit(&ERR1, &ADCD1);
+  adcsObjectInit(&ADCS1);
+  adcstatsInit(&STATS1, RP_NUM_CHANNELS, RP_STATS_LOG2ALPHA, 0U);
+  (void) adcdecimInit(&decim, &decimcfg, RP_NUM_CHANNELS);
+  (void) adcfftInit(&FFT1, RP_FFT_POINTS, ADCFFT_WIN_HANN);
+
+  gptStart(&GPTD4, &gpt4cfg);
+  adcStart(&ADCD1, NULL);
+  adcs1cfg.interval = (gptcnt_t)(gpt4cfg.frequency / rate);
+  rate = gpt4cfg.frequency / adcs1cfg.interval;
+
+  t0 = chHostNow();
+  adcsStart(&ADCS1, &adcs1cfg);
+  tp = chThdCreateStatic(waConsumer, sizeof(waConsumer), NORMALPRIO + 1,
+                         Consumer, NULL);
+  (void) chThdWait(tp);
+  adcsGetStats(&ADCS1, &stats);
+  adcsStop(&ADCS1);
+
+  print_report(mode, rate, chHostNow() - t0);
+
+  if (run.sets < run.target) {
+    return 2;
+  }
+  if (peakhz > 0U) {
+    uint32_t hz = adcfftBinHz(&FFT1, run.peak.bin, rate);
+    uint32_t tol = 2U * rate / RP_FFT_POINTS;
+
+    if ((run.frames == 0U) || (hz + tol < peakhz) || (hz > peakhz + tol)) {
+      fprintf(stderr, "replay: peak %u Hz, expected %u Hz\n", hz, peakhz);
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,196 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Checks the frame merging of adcscan.c on the simulated ADCs. Eight pins
+ * spread over the four ADCs carry the same square wave on different
+ * levels, so the value of every sample follows from its set number: a
+ * frame merged from blocks of different ADCs, a wrong tick or a wrong
+ * lost count shows as a mismatch. Read in step nothing may be lost or
+ * torn; with -s the reader stalls to lose blocks, and may tear some, and
+ * every frame it still gets is checked the same way.
+ *
+ * Usage:
+ *   scantest [-b blocks] [-s frames]
+ *
+ *   -b  frames to read, default 2000
+ *   -s  stall the reader 20 ms every that many frames
+ *
+ * Exit status 1 on the first mismatch.
+ */
+
+#include "ch.h"
+#include "hal.h"
+
+#include "adcsim.h"
+#include "adcscan.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define NUM_PINS        8U
+#define DEPTH           128U
+#define INTERVAL        10U
+#define LEVEL(j)        (500U + 300U * (j))
+#define STEP            1000U
+/* Square wave half period in sets, irrational so no edge falls on a set. */
+#define HALF_SETS       (37.0 * M_SQRT2)
+
+static const GPTConfig gptcfg = {
+  .frequency    = 1000000U,
+  .callback     = NULL,
+  .cr2          = 0U,
+  .dier         = 0U
+};
+
+static const uint8_t pins[NUM_PINS] = {
+  ADCSCAN_PIN(A, 0),  ADCSCAN_PIN(A, 1),  ADCSCAN_PIN(B, 0),
+  ADCSCAN_PIN(B, 1),  ADCSCAN_PIN(B, 12), ADCSCAN_PIN(B, 14),
+  ADCSCAN_PIN(C, 0),  ADCSCAN_PIN(C, 1)
+};
+
+static ADCDriver *const adcs[ADCSCAN_NUM_ADCS] = {
+  &ADCD1, &ADCD2, &ADCD3, &ADCD4
+};
+
+static adcsample_t buf[ADCSCAN_BUF_SIZE(DEPTH, NUM_PINS)];
+static adcsample_t frame[DEPTH / 2U * NUM_PINS];
+static ADCScanDriver SCAN1;
+
+static const ADCScanConfig scancfg = {
+  .adcs         = {&ADCD1, &ADCD2, &ADCD3, &ADCD4},
+  .pins         = pins,
+  .num_pins     = NUM_PINS,
+  .smp          = ADC_SMPR_SMP_24P5,
+  .gptp         = &GPTD4,
+  .interval     = INTERVAL,
+  .cfgr         = ADCGRP_TRIGGER(TIM4_TRGO),
+  .buf          = buf,
+  .depth        = DEPTH,
+  .frame        = frame
+};
+
+/* Checks a frame against its sequence number, next is the expected one. */
+static bool checkFrame(const char *run, const adcs_block_t *bp,
+                       uint32_t next) {
+  uint64_t set = (uint64_t)bp->seq * (DEPTH / 2U);
+
+  if (bp->n != DEPTH / 2U || bp->seq != next + bp->lost ||
+      bp->tick != set * INTERVAL) {
+    printf("scantest: %s: frame %u after %u, %u lost, %zu sets, tick %llu\n",
+           run, bp->seq, next, bp->lost, bp->n, (unsigned long long)bp->tick);
+    return false;
+  }
+  for (size_t k = 0; k < bp->n; k++, set++) {
+    unsigned high = (unsigned)((double)set / HALF_SETS) & 1U;
+
+    for (unsigned j = 0; j < NUM_PINS; j++) {
+      adcsample_t v = bp->samples[k * NUM_PINS + j];
+
+      if (v != LEVEL(j) + high * STEP) {
+        printf("scantest: %s: frame %u set %zu pin %u (ADC%u IN%u) is %u, "
+               "not %u\n", run, bp->seq, k, j, adcscanGetADC(&SCAN1, j),
+               adcscanGetChannel(&SCAN1, j), v, LEVEL(j) + high * STEP);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/* Reads blocks frames, stalling every stall frames when not 0. */
+static bool run(unsigned blocks, unsigned stall) {
+  const char *name = stall == 0U ? "in step" : "stalled";
+  uint32_t next = 0U, lost = 0U;
+
+  if (!adcscanStart(&SCAN1, &scancfg)) {
+    printf("scantest: %s: adcscanStart() failed\n", name);
+    return false;
+  }
+  for (unsigned i = 0; i < blocks; i++) {
+    adcs_block_t blk;
+
+    if (adcscanReadTimeout(&SCAN1, &blk, TIME_MS2I(500)) != MSG_OK) {
+      printf("scantest: %s: read failed at frame %u\n", name, i);
+      adcscanStop(&SCAN1);
+      return false;
+    }
+    if (!checkFrame(name, &blk, next)) {
+      adcscanStop(&SCAN1);
+      return false;
+    }
+    next = blk.seq + 1U;
+    lost += blk.lost;
+    if (stall != 0U && i % stall == stall - 1U) {
+      chThdSleepMilliseconds(20);
+    }
+  }
+  adcscanStop(&SCAN1);
+
+  printf("scantest: %s: %u frames checked, %u lost, %u torn\n", name,
+         blocks, lost, SCAN1.torn);
+  if (stall == 0U ? lost != 0U || SCAN1.torn != 0U : lost == 0U) {
+    printf("scantest: %s: %s lost frames\n", name,
+           stall == 0U ? "unexpected" : "no");
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  unsigned blocks = 2000U, stall = 0U;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "b:s:")) != -1) {
+    switch (opt) {
+    case 'b':
+      blocks = (unsigned)strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      stall = (unsigned)strtoul(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "usage: scantest [-b blocks] [-s frames]\n");
+      return 2;
+    }
+  }
+
+  halInit();
+  chSysInit();
+  adcsimSetMode(ADCSIM_FAST);
+  gptStart(&GPTD4, &gptcfg);
+  for (unsigned u = 0; u < ADCSCAN_NUM_ADCS; u++) {
+    adcStart(adcs[u], NULL);
+  }
+
+  adcscanObjectInit(&SCAN1);
+  if (!adcscanAssign(&SCAN1, &scancfg) || adcscanGetADCs(&SCAN1) < 2U) {
+    printf("scantest: pins not spread over the ADCs\n");
+    return 1;
+  }
+  for (unsigned j = 0; j < NUM_PINS; j++) {
+    adcsim_source_t src = {
+      .dc       = LEVEL(j),
+      .step     = STEP,
+      .period   = HALF_SETS * INTERVAL / gptcfg.frequency
+    };
+
+    adcsimSetSource(adcs[adcscanGetADC(&SCAN1, j) - 1U],
+                    adcscanGetChannel(&SCAN1, j), &src);
+  }
+
+  return run(blocks, stall) ? 0 : 1;
+}
@@ -0,0 +1,259 @@
+#!/usr/bin/env python3
+"""
+Host receiver for the ADC05 "scope" shell command.
+
+Starts the scope stream on the serial port, decodes the adcscope packets
+(see adcscope.h) and writes the samples to a CSV file, or to a NumPy .npy
+file when the output name ends in .npy. Each row holds the time in seconds
+followed by the selected channels in counts. At the end it reports packets,
+CRC errors and the blocks dropped by the target, from the sequence gaps.
+
+With --spectrum it runs "spectrum bin" instead and decodes the adcfft
+packets (see adcfft.h): each row holds the frame start time followed by
+the amplitude in counts of every bin, the first row the bin frequencies.
+
+Examples:
+  scope.py --port /dev/ttyACM0 --seconds 10 --out capture.csv
+  scope.py --port COM5 --mask 1 --rate 50000 --raw capture.bin --out ch1.npy
+  scope.py --input capture.bin --out capture.csv
+  scope.py --port /dev/ttyACM0 --spectrum 1024 --out spectra.npy
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+SYNC = b'\xa5\x5a'
+HEADER = struct.Struct('<BBIIH')    # chmask, log2dec, seq, rate, sets
+HEADER_SIZE = 2 + HEADER.size
+CRC_SIZE = 2
+
+SPEC_SYNC = b'\xa5\x5b'
+SPEC_HEADER = struct.Struct('<BBIIH')   # log2n, window, seq, rate, cg
+SPEC_HEADER_SIZE = 2 + SPEC_HEADER.size
+SAMPLE_BITS = 12
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE, as adcscopeCrc16()."""
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+class Decoder:
+    def __init__(self):
+        self.buf = bytearray()
+        self.packets = 0
+        self.crc_errors = 0
+        self.dropped = 0
+        self.skipped = 0
+        self.ratio_changes = 0
+        self.last_seq = None
+        self.last_log2dec = None
+        self.chmask = None
+
+    def feed(self, data):
+        """Yields (seq, rate, rows) for each valid packet in data."""
+        self.buf += data
+        while True:
+            i = self.buf.find(SYNC)
+            if i < 0:
+                keep = 1 if self.buf.endswith(SYNC[:1]) else 0
+                self.skipped += len(self.buf) - keep
+                del self.buf[:len(self.buf) - keep]
+                return
+            self.skipped += i
+            del self.buf[:i]
+            if len(self.buf) < HEADER_SIZE:
+                return
+            chmask, log2dec, seq, rate, sets = HEADER.unpack_from(self.buf, 2)
+            nsel = bin(chmask).count('1')
+            size = HEADER_SIZE + 2 * sets * nsel + CRC_SIZE
+            if len(self.buf) < size:
+                return
+            crc, = struct.unpack_from('<H', self.buf, size - CRC_SIZE)
+            if nsel == 0 or crc16(self.buf[2:size - CRC_SIZE]) != crc:
+                # Not a packet after all, resync past this sync word.
+                self.crc_errors += 1
+                del self.buf[:1]
+                continue
+            payload = struct.unpack_from('<%dH' % (sets * nsel), self.buf,
+                                         HEADER_SIZE)
+            del self.buf[:size]
+            yield self.accept(chmask, log2dec, seq, rate, sets, nsel, payload)
+
+    def accept(self, chmask, log2dec, seq, rate, sets, nsel, payload):
+        if self.last_seq is not None and seq > self.last_seq:
+            self.dropped += seq - self.last_seq - 1
+        if self.last_log2dec is not None and log2dec != self.last_log2dec:
+            self.ratio_changes += 1
+        self.last_seq = seq
+        self.last_log2dec = log2dec
+        self.chmask = chmask
+        self.packets += 1
+        # Every block spans the same time, sets << log2dec input sets.
+        t0 = seq * sets / rate
+        rows = [(t0 + j / rate,) + payload[j * nsel:(j + 1) * nsel]
+                for j in range(sets)]
+        return seq, rate, rows
+
+
+class SpectrumDecoder:
+    def __init__(self):
+        self.buf = bytearray()
+        self.packets = 0
+        self.crc_errors = 0
+        self.dropped = 0
+        self.skipped = 0
+        self.last_seq = None
+        self.n = None
+        self.rate = None
+
+    def feed(self, data):
+        """Yields (seq, rate, [(seq, amplitudes)]) for each valid packet."""
+        self.buf += data
+        while True:
+            i = self.buf.find(SPEC_SYNC)
+            if i < 0:
+                keep = 1 if self.buf.endswith(SPEC_SYNC[:1]) else 0
+                self.skipped += len(self.buf) - keep
+                del self.buf[:len(self.buf) - keep]
+                return
+            self.skipped += i
+            del self.buf[:i]
+            if len(self.buf) < SPEC_HEADER_SIZE:
+                return
+            log2n, _, seq, rate, cg = SPEC_HEADER.unpack_from(self.buf, 2)
+            bins = (1 << log2n) // 2 + 1 if log2n <= 10 else 0
+            size = SPEC_HEADER_SIZE + 2 * bins + CRC_SIZE
+            if len(self.buf) < size:
+                return
+            crc, = struct.unpack_from('<H', self.buf, size - CRC_SIZE)
+            if bins == 0 or cg == 0 or \
+                    crc16(self.buf[2:size - CRC_SIZE]) != crc:
+                self.crc_errors += 1
+                del self.buf[:1]
+                continue
+            mags = struct.unpack_from('<%dH' % bins, self.buf,
+                                      SPEC_HEADER_SIZE)
+            del self.buf[:size]
+            if self.last_seq is not None and seq > self.last_seq:
+                self.dropped += seq - self.last_seq - 1
+            self.last_seq = seq
+            self.n = 1 << log2n
+            self.rate = rate
+            self.packets += 1
+            scale = (1 << (SAMPLE_BITS + 1)) / cg
+            # One row per packet, as Decoder yields a list of rows.
+            yield seq, rate, [(seq, [m * scale for m in mags])]
+
+
+def write_spectra(path, frames, n, rate):
+    bins = n // 2 + 1
+    freqs = [k * rate / n for k in range(bins)]
+    rows = [[0.0] + freqs] + [[seq * n / rate] + amps
+                              for seq, amps in frames]
+    if path.endswith('.npy'):
+        import numpy as np
+        np.save(path, np.array(rows, dtype=np.float64))
+    else:
+        with open(path, 'w') as f:
+            for r in rows:
+                f.write(','.join('%.3f' % v for v in r) + '\n')
+
+
+def channel_names(chmask):
+    return ['ch%d' % (c + 1) for c in range(8) if chmask >> c & 1]
+
+
+def write_output(path, rows, chmask):
+    names = ['time'] + channel_names(chmask or 0)
+    if path.endswith('.npy'):
+        import numpy as np
+        np.save(path, np.array(rows, dtype=np.float64).reshape(-1, len(names)))
+    else:
+        with open(path, 'w') as f:
+            f.write(','.join(names) + '\n')
+            for r in rows:
+                f.write('%.6f,' % r[0] + ','.join(str(v) for v in r[1:]) + '\n')
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('--port', help='serial port of the Nucleo virtual COM')
+    ap.add_argument('--baud', type=int, default=38400)
+    ap.add_argument('--mask', type=int, default=3, help='channel mask')
+    ap.add_argument('--rate', type=int, default=20000, help='ADC rate in Hz')
+    ap.add_argument('--seconds', type=float, default=5.0)
+    ap.add_argument('--input', help='decode a raw capture instead of a port')
+    ap.add_argument('--raw', help='also save the received bytes')
+    ap.add_argument('--spectrum', type=int, metavar='POINTS',
+                    help='decode FFT spectra of this size instead')
+    ap.add_argument('--out', default='scope.csv', help='.csv or .npy file')
+    args = ap.parse_args()
+
+    if not args.port and not args.input:
+        ap.error('one of --port or --input is required')
+
+    dec = SpectrumDecoder() if args.spectrum else Decoder()
+    rows = []
+    raw = open(args.raw, 'wb') if args.raw else None
+
+    if args.input:
+        with open(args.input, 'rb') as f:
+            for _, _, r in dec.feed(f.read()):
+                rows += r
+    else:
+        import serial
+        with serial.Serial(args.port, args.baud, timeout=0.1) as port:
+            if args.spectrum:
+                port.write(b'\r\nspectrum bin %d %d\r\n' %
+                           (args.spectrum, args.rate))
+            else:
+                port.write(b'\r\nscope %d %d\r\n' % (args.mask, args.rate))
+            end = time.monotonic() + args.seconds
+            while time.monotonic() < end:
+                data = port.read(4096)
+                if raw:
+                    raw.write(data)
+                for _, _, r in dec.feed(data):
+                    rows += r
+            # Any byte stops the stream, then drain the summary line.
+            port.write(b'\r')
+            time.sleep(0.5)
+            tail = port.read(4096)
+            if raw:
+                raw.write(tail)
+            for _, _, r in dec.feed(tail):
+                rows += r
+            key = b'frames' if args.spectrum else b'packets'
+            summary = tail[tail.rfind(key):].split(b'\n')[0].strip()
+            if summary:
+                print('target: %s' % summary.decode(errors='replace'))
+
+    if raw:
+        raw.close()
+
+    if args.spectrum:
+        if dec.packets > 0:
+            write_spectra(args.out, rows, dec.n, dec.rate)
+        print('spectra %d dropped frames %d crc errors %d skipped bytes %d' %
+              (dec.packets, dec.dropped, dec.crc_errors, dec.skipped))
+        return 0 if dec.packets > 0 else 1
+
+    write_output(args.out, rows, dec.chmask)
+    print('packets %d sets %d dropped blocks %d crc errors %d '
+          'ratio changes %d skipped bytes %d' %
+          (dec.packets, len(rows), dec.dropped, dec.crc_errors,
+           dec.ratio_changes, dec.skipped))
+    return 0 if dec.packets > 0 else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,2219 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * [ADC05] Using ADC Peripherals - Example 05
+ * Gapless timer-triggered acquisition through the ADC stream library, the
+ * blocks are processed in thread context from the shell.
+ */
+
+#include "ch.h"
+#include "hal.h"
+
+#include "shellconf.h"
+
+#include "shell.h"
+#include "chprintf.h"
+
+#include "adcstream.h"
+#include "adcdsp.h"
+#include "adcdecim.h"
+#include "adcovs.h"
+#include "adcawd.h"
+#include "adcgrp.h"
+#include "adcscope.h"
+#include "adcstats.h"
+#include "adcpool.h"
+#include "adcfft.h"
+#include "adccal.h"
+#include "adchk.h"
+#include "adctune.h"
+#include "adcerr.h"
+#include "adccap.h"
+#include "adcscan.h"
+#include "adcmix.h"
+
+#include <stdlib.h> /* atoi */
+#include <string.h> /* memcmp, strcmp, strncmp */
+
+#define ADC_GRP_NUM_CHANNELS   2
+#define ADC_GRP_BUF_DEPTH      512
+#define VOLTAGE_RES            ((float)3.3/4096)
+
+CC_ALIGN_DATA(4) static adcsample_t samples[ADC_GRP_NUM_CHANNELS * ADC_GRP_BUF_DEPTH];
+
+static ADCStreamDriver ADCS1;
+
+/* Background statistics monitor, it owns ADCS1 while it runs. */
+static thread_t *monitortp = NULL;
+
+/* Calibration service, its periodic measurement needs ADC1 idle. */
+static adccal_t CAL1;
+
+/* Errors and sample losses of all the ADC1 services. */
+static adcerr_t ERR1;
+
+/*
+ * Takes ADC1 for a command, released by adc_done(). The monitor keeps it
+ * between "stats start" and "stats stop".
+ */
+static bool adc_busy(BaseSequentialStream *chp) {
+
+  if (monitortp != NULL) {
+    chprintf(chp, "ADC1 in use by the monitor, run: stats stop\n\r");
+    return true;
+  }
+  adcAcquireBus(&ADCD1);
+  return false;
+}
+
+static void adc_done(void) {
+
+  adcReleaseBus(&ADCD1);
+}
+
+/*
+ * GPT4 configuration. This timer is used as trigger for the ADC.
+ */
+const GPTConfig gpt4cfg = {
+  .frequency    =  1000000U,
+  .callback     =  NULL,
+  .cr2          =  TIM_CR2_MMS_1,   /* MMS = 010 = TRGO on Update Event.    */
+  .dier         =  0U
+};
+
+/*
+ * TIM4 counts 16 bits, below RATE_MIN_HZ the trigger interval does not
+ * fit gptcnt_t. Checks a rate_hz argument against RATE_MIN_HZ..max and,
+ * like adc_busy(), prints why and returns true when it is rejected.
+ */
+#define RATE_MIN_HZ     (gpt4cfg.frequency / 0xFFFFU + 1U)
+
+static bool rate_bad(BaseSequentialStream *chp, uint32_t rate, uint32_t max) {
+
+  if (rate < RATE_MIN_HZ || rate > max) {
+    chprintf(chp, "rate_hz must be %u..%u\n\r", RATE_MIN_HZ, max);
+    return true;
+  }
+  return false;
+}
+
+/* Trigger interval of a rate accepted by rate_bad(). */
+static gptcnt_t rate_interval(uint32_t rate) {
+
+  return (gptcnt_t)(gpt4cfg.frequency / rate);
+}
+
+/*
+ * ADC conversion group, callbacks and circular mode are set by the stream.
+ * The sequence must fit the fastest rate accepted by the stream command.
+ */
+#define STREAM_SEQ      ADCGRP_CH(ADC_CHANNEL_IN1, ADC_SMPR_SMP_24P5),  \
+                        ADCGRP_CH(ADC_CHANNEL_IN2, ADC_SMPR_SMP_24P5)
+#define STREAM_MAX_HZ   100000U
+
+ADCGRP_STATIC_ASSERT_RATE(1000000U, 1000000U / STREAM_MAX_HZ, STREAM_SEQ);
+ADCGRP_STATIC_ASSERT_PIN(1, IN1, A, 0);
+ADCGRP_STATIC_ASSERT_PIN(1, IN2, A, 1);
+_Static_assert(ADCGRP_NARGS(STREAM_SEQ) == ADC_GRP_NUM_CHANNELS,
+               "stream sequence length");
+
+static const ADCConversionGroup streamcfg = {
+  .circular     = true,
+  ADCGRP_SEQUENCE(STREAM_SEQ),
+  .end_cb       = NULL,
+  .error_cb     = NULL,
+  .cfgr         = ADCGRP_TRIGGER(TIM4_TRGO),
+  .cfgr2        = 0U,
+  .tr1          = ADC_TR_DISABLED,
+  .tr2          = ADC_TR_DISABLED,
+  .tr3          = ADC_TR_DISABLED,
+  .awd2cr       = 0U,
+  .awd3cr       = 0U
+};
+
+/* Stream group patched in main() for the injected housekeeping.*/
+static ADCConversionGroup streamgrp;
+
+static ADCStreamConfig adcs1cfg = {
+  .adcp         = &ADCD1,
+  .grpp         = &streamgrp,
+  .buf          = samples,
+  .depth        = ADC_GRP_BUF_DEPTH,
+  .gptp         = &GPTD4,
+  .interval     = 50U,                      /* 20 kHz */
+  .errp         = &ERR1,
+  .restart      = false
+};
+
+/*
+ * Housekeeping of VREFINT, temperature and VBAT by injected conversions
+ * triggered by TIM6, one channel per trigger, while ADCS1 streams. It only
+ * runs if a regular period fits the sequence plus one injected conversion,
+ * a preempted regular set is sampled up to that conversion late.
+ */
+#define HK_TIMER_HZ            10000U
+#define HK_INTERVAL            33U          /* 303 Hz, 101 sets/s */
+#define HK_LOG2ALPHA           2U
+
+static ADCHkDriver HK1;
+static adcstats_t HKSTATS;
+
+static void hkcb(GPTDriver *gptp) {
+
+  (void)gptp;
+  adchkServeTrigger(&HK1);
+}
+
+/*
+ * GPT6 configuration. This timer is used as injected trigger for the ADC.
+ */
+const GPTConfig gpt6cfg = {
+  .frequency    =  HK_TIMER_HZ,
+  .callback     =  hkcb,
+  .cr2          =  TIM_CR2_MMS_1,   /* MMS = 010 = TRGO on Update Event.    */
+  .dier         =  0U
+};
+
+static const ADCHkConfig hkcfg = {
+  .adcp         = &ADCD1,
+  .gptp         = &GPTD6,
+  .interval     = HK_INTERVAL,
+  .jtrigger     = ADCGRP_JTRIGGER(TIM6_TRGO),
+  .calp         = &CAL1,
+  .statsp       = &HKSTATS
+};
+
+/* Starts the housekeeping on the running stream if the rate leaves room,
+   timed on streamgrp as "tune apply" may have lengthened its sampling.*/
+static void hk_start(BaseSequentialStream *chp) {
+
+  if (!ADCHK_FITS(adctuneGroupHalfcycles(&streamgrp), gpt4cfg.frequency,
+                  adcs1cfg.interval)) {
+    chprintf(chp, "Housekeeping off, no room for an injected conversion\n\r");
+    return;
+  }
+  adcstatsInit(&HKSTATS, ADCHK_NUM_CHANNELS, HK_LOG2ALPHA, 0U);
+  adchkStart(&HK1, &hkcfg);
+}
+
+static void print_hk(BaseSequentialStream *chp) {
+  adcsample_t hk[ADCHK_NUM_CHANNELS];
+  int32_t temp;
+
+  if (adchkGetState(&HK1) != ADCHK_ACTIVE) {
+    return;
+  }
+  adchkGet(&HK1, hk);
+  temp = adccalToCentidegrees(&CAL1, hk[ADCHK_TS]);
+  chprintf(chp, "hk sets %u VDDA %u mV temperature %s%d.%02d C VBAT %u mV\n\r",
+           adchkGetSets(&HK1), adccalGetVdda(&CAL1), temp < 0 ? "-" : "",
+           (temp < 0 ? -temp : temp) / 100, (temp < 0 ? -temp : temp) % 100,
+           3U * adccalToMillivolts(&CAL1, hk[ADCHK_VBAT]));
+}
+
+
+/* Streams for num_seconds at rate_hz and prints the per-second figures */
+static void cmd_stream(BaseSequentialStream *chp, int argc, char *argv[]) {
+  adcdsp_acc_t acc[ADC_GRP_NUM_CHANNELS];
+  uint32_t sets, lost, maxlat, jitter;
+  uint64_t prevtick = 0U;
+  rtcnt_t prevts = 0U;
+  bool first = true;
+  adcs_stats_t stats;
+  systime_t start;
+  uint32_t rate;
+  int seconds;
+
+  if (argc < 1 || argc > 2) {
+    chprintf(chp, "Usage: stream num_seconds [rate_hz]\n\r");
+    return;
+  }
+
+  seconds = atoi(argv[0]);
+  rate = argc == 2 ? (uint32_t)atoi(argv[1]) : 0U;
+  if (argc == 2 && rate_bad(chp, rate, STREAM_MAX_HZ)) {
+    return;
+  }
+  if (adc_busy(chp)) {
+    return;
+  }
+  if (argc == 2) {
+    adcs1cfg.interval = rate_interval(rate);
+  }
+
+  chprintf(chp, "Streaming at %u Hz...\n\r",
+           (unsigned)(gpt4cfg.frequency / adcs1cfg.interval));
+  adcsStart(&ADCS1, &adcs1cfg);
+  hk_start(chp);
+
+  while (seconds-- > 0) {
+    start = chVTGetSystemTime();
+    sets = 0U;
+    lost = 0U;
+    maxlat = 0U;
+    jitter = 0U;
+    adcdspAccInit(acc, ADC_GRP_NUM_CHANNELS);
+
+    while (chVTTimeElapsedSinceX(start) < TIME_S2I(1)) {
+      adcs_block_t blk;
+
+      if (adcsReadTimeout(&ADCS1, &blk, TIME_MS2I(100)) != MSG_OK) {
+        break;
+      }
+      adcdspAccumulate(blk.samples, blk.n, ADC_GRP_NUM_CHANNELS, acc);
+      sets += blk.n;
+      lost += blk.lost;
+      maxlat = blk.latency > maxlat ? blk.latency : maxlat;
+
+      /* Callback time against the exact trigger time, in cycles.*/
+      if (!first) {
+        int32_t d = (int32_t)((blk.ts - prevts) -
+                              (uint32_t)(blk.tick - prevtick) *
+                              (STM32_SYSCLK / gpt4cfg.frequency));
+        uint32_t ad = d < 0 ? (uint32_t)-d : (uint32_t)d;
+
+        jitter = ad > jitter ? ad : jitter;
+      }
+      prevtick = blk.tick;
+      prevts = blk.ts;
+      first = false;
+      adcsRelease(&ADCS1, &blk);
+    }
+
+    adcsGetStats(&ADCS1, &stats);
+    chprintf(chp, "sets %u lost %u overruns %u late %u errors %u\n\r",
+             sets, lost, stats.overruns, stats.late, stats.errors);
+    chprintf(chp, "half %u full %u dma %u overflow %u restarts %u\n\r",
+             stats.half, stats.full, stats.dmaerrors, stats.overflows,
+             stats.restarts);
+    chprintf(chp, "latency max %u us, callback jitter %u cycles\n\r",
+             maxlat * 1000000U / gpt4cfg.frequency, jitter);
+    print_hk(chp);
+    if (sets > 0U) {
+      for (unsigned c = 0; c < ADC_GRP_NUM_CHANNELS; c++) {
+        chprintf(chp, "CH%u mean %u (%u mV) min %u max %u\n\r", c + 1U,
+                 acc[c].sum / sets,
+                 adccalToMillivolts(&CAL1, acc[c].sum / sets),
+                 acc[c].min, acc[c].max);
+      }
+    }
+    if (adcsGetState(&ADCS1) != ADCS_ACTIVE) {
+      chprintf(chp, "ADC error %u\n\r", (unsigned)stats.lasterr);
+      break;
+    }
+  }
+
+  adchkStop(&HK1);
+  adcsStop(&ADCS1);
+  adc_done();
+}
+
+
+/*
+ * Synthetic 12-bit block for the kernel benchmark, shaped like one half of
+ * the stream buffer.
+ */
+#define BENCH_SAMPLES          (ADC_GRP_NUM_CHANNELS * ADC_GRP_BUF_DEPTH / 2)
+#define BENCH_MAX_CHANNELS     4
+
+CC_ALIGN_DATA(4) static adcsample_t bench[BENCH_SAMPLES];
+CC_ALIGN_DATA(4) static adcsample_t split[2][BENCH_MAX_CHANNELS][BENCH_SAMPLES];
+
+/* The per-sample float loop of the previous examples, used as baseline */
+static void float_avg(const adcsample_t *buf, size_t n, unsigned nch,
+                      volatile float *converted) {
+  for (unsigned c = 0; c < nch; c++) {
+    converted[c] = 0.0f;
+  }
+  for (size_t i = 0; i < n * nch; i++) {
+    converted[i % nch] += (float) buf[i] * VOLTAGE_RES;
+  }
+}
+
+/* Checks the SIMD kernels against the C reference and prints their cost */
+static void cmd_dsp(BaseSequentialStream *chp, int argc, char *argv[]) {
+  static const unsigned layouts[] = {1U, 2U, 4U};
+  uint32_t seed = 0x1337U;
+  bool pass = true;
+
+  (void) argv;
+
+  if (argc != 0) {
+    chprintf(chp, "Usage: dsp\n\r");
+    return;
+  }
+
+  for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+    seed = seed * 1664525U + 1013904223U;
+    bench[i] = (adcsample_t)(seed >> 20);
+  }
+
+  chprintf(chp, "cycles per block of %u samples\n\r", BENCH_SAMPLES);
+  chprintf(chp, "nch    float   acc ref  acc simd   split ref  split simd\n\r");
+
+  for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+    unsigned nch = layouts[l];
+    size_t n = BENCH_SAMPLES / nch;
+    adcdsp_acc_t ref[BENCH_MAX_CHANNELS], simd[BENCH_MAX_CHANNELS];
+    adcsample_t *refout[BENCH_MAX_CHANNELS], *simdout[BENCH_MAX_CHANNELS];
+    volatile float converted[BENCH_MAX_CHANNELS];
+    rtcnt_t t[6];
+
+    for (unsigned c = 0; c < nch; c++) {
+      refout[c] = split[0][c];
+      simdout[c] = split[1][c];
+    }
+    adcdspAccInit(ref, nch);
+    adcdspAccInit(simd, nch);
+
+    t[0] = chSysGetRealtimeCounterX();
+    float_avg(bench, n, nch, converted);
+    t[1] = chSysGetRealtimeCounterX();
+    adcdspAccumulateRef(bench, n, nch, ref);
+    t[2] = chSysGetRealtimeCounterX();
+    adcdspAccumulate(bench, n, nch, simd);
+    t[3] = chSysGetRealtimeCounterX();
+    adcdspDeinterleaveRef(bench, n, nch, refout);
+    t[4] = chSysGetRealtimeCounterX();
+    adcdspDeinterleave(bench, n, nch, simdout);
+    t[5] = chSysGetRealtimeCounterX();
+
+    chprintf(chp, "%3u %8u %9u %9u %11u %11u\n\r", nch,
+             t[1] - t[0], t[2] - t[1], t[3] - t[2], t[4] - t[3], t[5] - t[4]);
+
+    for (unsigned c = 0; c < nch; c++) {
+      if (ref[c].sum != simd[c].sum || ref[c].sumsq != simd[c].sumsq ||
+          ref[c].min != simd[c].min || ref[c].max != simd[c].max) {
+        pass = false;
+      }
+      if (memcmp(split[0][c], split[1][c], n * sizeof(adcsample_t)) != 0) {
+        pass = false;
+      }
+    }
+  }
+
+  chprintf(chp, "SIMD kernels %s\n\r", pass ? "match the reference" : "MISMATCH");
+}
+
+
+/*
+ * CIC order 3 decimating by 16, then a 48 taps compensating FIR decimating
+ * by 4: 64x overall, flat up to 0.4 of the output Nyquist frequency.
+ */
+/* cicfir.py --order 3 --log2r 4 --m 4 --taps 48 --passband 0.8 */
+static const int16_t cic3r16m4_taps[48] = {
+       0,      0,      1,      5,     10,      9,     -6,    -39,
+     -75,    -81,    -20,    120,    286,    366,    230,   -177,
+    -745,  -1178,  -1083,   -156,   1626,   3909,   6045,   7337,
+    7337,   6045,   3909,   1626,   -156,  -1083,  -1178,   -745,
+    -177,    230,    366,    286,    120,    -20,    -81,    -75,
+     -39,     -6,      9,     10,      5,      1,      0,      0,
+};
+
+static const adcdecim_config_t decimcfg = {
+  .order        = 3U,
+  .log2r        = 4U,
+  .m            = 4U,
+  .taps         = 48U,
+  .coeffs       = cic3r16m4_taps
+};
+
+static adcdecim_t decim;
+static int16_t decimated[BENCH_MAX_CHANNELS * (BENCH_SAMPLES / 64 + 1)];
+
+/* Runs the decimation pipeline on synthetic blocks and prints its cost */
+static void cmd_decim(BaseSequentialStream *chp, int argc, char *argv[]) {
+  uint32_t rate = 1000000U, cycles = 0U, outs = 0U;
+  size_t n = BENCH_SAMPLES / ADC_GRP_NUM_CHANNELS;
+  uint32_t seed = 0x7331U;
+
+  if (argc > 1) {
+    chprintf(chp, "Usage: decim [adc_rate_hz]\n\r");
+    return;
+  }
+  if (argc == 1) {
+    rate = (uint32_t)atoi(argv[0]);
+  }
+
+  if (!adcdecimInit(&decim, &decimcfg, ADC_GRP_NUM_CHANNELS)) {
+    chprintf(chp, "Invalid decimation configuration\n\r");
+    return;
+  }
+
+  for (int pass = 0; pass < 16; pass++) {
+    rtcnt_t start;
+
+    for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+      seed = seed * 1664525U + 1013904223U;
+      bench[i] = (adcsample_t)(seed >> 20);
+    }
+    start = chSysGetRealtimeCounterX();
+    outs += adcdecimProcess(&decim, bench, n, decimated);
+    cycles += chSysGetRealtimeCounterX() - start;
+  }
+
+  chprintf(chp, "%u sets in, %u sets out, %u cycles per set of %u channels\n\r",
+           16U * n, outs, cycles / (16U * n), ADC_GRP_NUM_CHANNELS);
+  chprintf(chp, "CPU load at %u sets/s: %u.%02u %%\n\r", rate,
+           (unsigned)((uint64_t)cycles * rate / (16U * n) / (STM32_SYSCLK / 100U)),
+           (unsigned)((uint64_t)cycles * rate / (16U * n) / (STM32_SYSCLK / 10000U) % 100U));
+}
+
+
+/*
+ * Single channel groups for the oversampling comparison, the hardware one
+ * gets its CFGR2 from the ovs command.
+ */
+#define OVS_MAX_RATIO          256
+#define OVS_RESULTS            128
+
+#define OVS_SEQ         ADCGRP_CH(ADC_CHANNEL_IN1, ADC_SMPR_SMP_24P5)
+
+ADCGRP_STATIC_ASSERT_SEQ(OVS_SEQ);
+
+static const ADCConversionGroup rawgrp = {
+  .circular     = false,
+  ADCGRP_SEQUENCE(OVS_SEQ),
+  .end_cb       = NULL,
+  .error_cb     = NULL,
+  .cfgr         = ADCGRP_CONTINUOUS,
+  .cfgr2        = 0U,
+  .tr1          = ADC_TR_DISABLED,
+  .tr2          = ADC_TR_DISABLED,
+  .tr3          = ADC_TR_DISABLED,
+  .awd2cr       = 0U,
+  .awd3cr       = 0U
+};
+
+static ADCConversionGroup ovsgrp;
+
+CC_ALIGN_DATA(4) static adcsample_t raw[OVS_MAX_RATIO];
+static adcsample_t ovsout[OVS_RESULTS];
+static uint32_t swout[OVS_RESULTS];
+
+/* log2 for x > 0 without libm, about 4 decimal digits */
+static float log2_approx(float x) {
+  float r = 0.0f, bit = 1.0f;
+
+  while (x < 1.0f) {
+    x *= 2.0f;
+    r -= 1.0f;
+  }
+  while (x >= 2.0f) {
+    x *= 0.5f;
+    r += 1.0f;
+  }
+  for (int i = 0; i < 14; i++) {
+    x *= x;
+    bit *= 0.5f;
+    if (x >= 2.0f) {
+      x *= 0.5f;
+      r += bit;
+    }
+  }
+  return r;
+}
+
+/* Prints mean, noise and ENOB of results scaled by ratio */
+static void print_noise(BaseSequentialStream *chp, const char *name,
+                        const uint32_t *y, unsigned ratio) {
+  int64_t sum = 0, sumsq = 0;
+  float mean, var, enob;
+
+  for (int i = 0; i < OVS_RESULTS; i++) {
+    sum += y[i];
+    sumsq += (int64_t)y[i] * y[i];
+  }
+  mean = (float)sum / OVS_RESULTS / ratio;
+  var = (float)(OVS_RESULTS * sumsq - sum * sum) /
+        ((float)OVS_RESULTS * OVS_RESULTS * ratio * ratio);
+
+  /* ENOB = log2(full scale / (sigma * sqrt(12))) with sigma in 12-bit LSB,
+     the same in steps of 1/ratio LSB on the 2^12 * ratio oversampled full
+     scale, so it can pass 12 bits. No noise at all is only bounded by the
+     step itself, 12 + log2(ratio) bits.*/
+  if (var > 0.0f) {
+    enob = 12.0f - 0.5f * log2_approx(var * 12.0f);
+    chprintf(chp, "%s mean %.2f LSB, sigma^2 %.6f LSB^2, ENOB %.2f\n\r",
+             name, mean, var, enob);
+  }
+  else {
+    enob = 12.0f + log2_approx((float)ratio);
+    chprintf(chp, "%s mean %.2f LSB, no noise, ENOB above %.2f\n\r",
+             name, mean, enob);
+  }
+}
+
+/* Compares software averaging with hardware oversampling on ADC1_IN1 */
+static void cmd_ovs(BaseSequentialStream *chp, int argc, char *argv[]) {
+  unsigned ratio = 16U, log2r = 0U, shift;
+  rtcnt_t cpu = 0U, start;
+  adcdsp_acc_t acc;
+
+  if (argc > 1) {
+    chprintf(chp, "Usage: ovs [ratio]\n\r");
+    return;
+  }
+  if (argc == 1) {
+    ratio = (unsigned)atoi(argv[0]);
+  }
+  /* Checked before log2r, which would not end past 2^31.*/
+  if (ratio < 2U || ratio > OVS_MAX_RATIO || (ratio & (ratio - 1U)) != 0U) {
+    chprintf(chp, "Ratio must be a power of two, 2..%u\n\r", OVS_MAX_RATIO);
+    return;
+  }
+  while ((1U << log2r) < ratio) {
+    log2r++;
+  }
+  /* Keeps all the gained bits up to the 16-bit data register.*/
+  shift = log2r > 4U ? log2r - 4U : 0U;
+
+  ovsgrp = rawgrp;
+  ovsgrp.cfgr2 = ADCOVS_CFGR2(ratio, shift, ADCOVS_CONTINUOUS);
+  if (!ADCOVS_VALID(ratio, shift) || !adcovsCheckGroup(&ovsgrp)) {
+    chprintf(chp, "Ratio must be a power of two, 2..%u\n\r", OVS_MAX_RATIO);
+    return;
+  }
+  if (adc_busy(chp)) {
+    return;
+  }
+
+  /* Software average: ratio conversions and DMA transfers per result.*/
+  for (int i = 0; i < OVS_RESULTS; i++) {
+    adcConvert(&ADCD1, &rawgrp, raw, ratio);
+    start = chSysGetRealtimeCounterX();
+    adcdspAccInit(&acc, 1U);
+    adcdspAccumulate(raw, ratio, 1U, &acc);
+    swout[i] = acc.sum;
+    cpu += chSysGetRealtimeCounterX() - start;
+  }
+
+  /* Hardware oversampling: one DMA transfer per result.*/
+  adcConvert(&ADCD1, &ovsgrp, ovsout, OVS_RESULTS);
+  adc_done();
+
+  chprintf(chp, "%u results, ratio %u, %u-bit hardware results\n\r",
+           OVS_RESULTS, ratio, adcovsGetBits(&ovsgrp));
+  print_noise(chp, "raw", swout, ratio);
+  chprintf(chp, "  %u DMA transfers, %u CPU cycles averaging\n\r",
+           OVS_RESULTS * ratio, cpu);
+
+  for (int i = 0; i < OVS_RESULTS; i++) {
+    swout[i] = (uint32_t)ovsout[i] << shift;
+  }
+  print_noise(chp, "ovs", swout, ratio);
+  chprintf(chp, "  %u DMA transfers, 0 CPU cycles averaging\n\r",
+           OVS_RESULTS);
+}
+
+
+/*
+ * Threshold monitoring of ADC1_IN1, sampled at 1 kHz by TIM4: the CPU only
+ * runs when the input crosses the window.
+ */
+static ADCAwdDriver AWD1;
+
+/* Default window, the command arguments override it in a copy. */
+static const adcawd_window_t awdwindow = {
+  .channel      = ADC_CHANNEL_IN1,
+  .low_mv       = 1000U,
+  .high_mv      = 2000U,
+  .hyst_mv      = 100U
+};
+
+static const ADCAwdConfig awdcfg = {
+  .adcp         = &ADCD1,
+  .windows      = &awdwindow,
+  .num_windows  = 1U,
+  .smp          = ADC_SMPR_SMP_247P5,
+  .trigger      = ADCGRP_TRIGGER(TIM4_TRGO),
+  .gptp         = &GPTD4,
+  .interval     = 1000U,                    /* 1 kHz */
+  .prio         = NORMALPRIO + 1,
+  .errp         = &ERR1
+};
+
+/* Prints the window crossings of ADC1_IN1 for num_seconds */
+static void cmd_awd(BaseSequentialStream *chp, int argc, char *argv[]) {
+  adcawd_window_t window = awdwindow;
+  ADCAwdConfig cfg = awdcfg;
+  int seconds, low, high, hyst;
+  event_listener_t el;
+  systime_t start;
+  sysinterval_t duration;
+
+  if (argc < 1 || argc == 2 || argc > 4) {
+    chprintf(chp, "Usage: awd num_seconds [low_mv high_mv [hyst_mv]]\n\r");
+    return;
+  }
+  seconds = atoi(argv[0]);
+  low = argc >= 3 ? atoi(argv[1]) : (int)window.low_mv;
+  high = argc >= 3 ? atoi(argv[2]) : (int)window.high_mv;
+  hyst = argc == 4 ? atoi(argv[3]) : (int)window.hyst_mv;
+  if (seconds <= 0) {
+    chprintf(chp, "num_seconds must be at least 1\n\r");
+    return;
+  }
+  if (low < 0 || low >= high || high > ADCAWD_VDDA_MV) {
+    chprintf(chp, "Window must be 0 <= low_mv < high_mv <= %u\n\r",
+             ADCAWD_VDDA_MV);
+    return;
+  }
+  /* Past that the way back inside would be beyond the other threshold.*/
+  if (hyst < 0 || hyst >= high - low) {
+    chprintf(chp, "hyst_mv must be 0..%d\n\r", high - low - 1);
+    return;
+  }
+  window.low_mv = (uint16_t)low;
+  window.high_mv = (uint16_t)high;
+  window.hyst_mv = (uint16_t)hyst;
+  cfg.windows = &window;
+  duration = TIME_S2I(seconds);
+  if (adc_busy(chp)) {
+    return;
+  }
+
+  chEvtRegisterMaskWithFlags(adcawdGetEventSource(&AWD1), &el, EVENT_MASK(0),
+                             ADCAWD_FLAG_ENTER(0) | ADCAWD_FLAG_ABOVE(0) |
+                             ADCAWD_FLAG_BELOW(0));
+  adcawdStart(&AWD1, &cfg);
+  chprintf(chp, "Window %u..%u mV, hysteresis %u mV, starting %s\n\r",
+           window.low_mv, window.high_mv, window.hyst_mv,
+           adcawdGetZone(&AWD1, 0) == ADCAWD_INSIDE ? "inside" :
+           adcawdGetZone(&AWD1, 0) == ADCAWD_ABOVE ? "above" : "below");
+
+  start = chVTGetSystemTime();
+  while (chVTTimeElapsedSinceX(start) < duration) {
+    eventflags_t flags;
+
+    if (chEvtWaitAnyTimeout(EVENT_MASK(0), TIME_MS2I(100)) == 0U) {
+      continue;
+    }
+    flags = chEvtGetAndClearFlags(&el);
+    chprintf(chp, "%s at %u mV\n\r",
+             (flags & ADCAWD_FLAG_ENTER(0)) ? "enter" :
+             (flags & ADCAWD_FLAG_ABOVE(0)) ? "leave above" : "leave below",
+             (unsigned)adccalToMillivolts(&CAL1, adcawdGetLast(&AWD1, 0)));
+  }
+
+  adcawdStop(&AWD1);
+  adc_done();
+  chEvtUnregister(adcawdGetEventSource(&AWD1), &el);
+  chprintf(chp, "%u crossings, %u errors\n\r", AWD1.crossings, AWD1.errors);
+}
+
+
+/*
+ * Binary scope stream on the shell serial port, see adcscope.h for the
+ * packet format and adclib/scope.py for the host side. Any byte received
+ * stops it.
+ */
+#define SCOPE_LINK_BPS         SERIAL_DEFAULT_BITRATE
+
+static uint8_t scopepkt[ADCSCOPE_PACKET_SIZE(ADC_GRP_BUF_DEPTH / 2,
+                                             ADC_GRP_NUM_CHANNELS)];
+
+/* Streams the channels in chmask at rate_hz until a byte is received */
+static void cmd_scope(BaseSequentialStream *chp, int argc, char *argv[]) {
+  adcscope_t scope;
+  uint32_t chmask = (1U << ADC_GRP_NUM_CHANNELS) - 1U, rate = 20000U;
+  gptcnt_t interval;
+  uint64_t period;
+  adcs_stats_t stats;
+
+  if (argc > 2) {
+    chprintf(chp, "Usage: scope [chmask [rate_hz]]\n\r");
+    return;
+  }
+  if (argc >= 1) {
+    chmask = (uint32_t)strtoul(argv[0], NULL, 0);
+  }
+  if (argc == 2) {
+    rate = (uint32_t)atoi(argv[1]);
+  }
+  if (rate_bad(chp, rate, STREAM_MAX_HZ)) {
+    return;
+  }
+  /* The link budget of the scope is worked out at the achieved rate.*/
+  interval = rate_interval(rate);
+  rate = gpt4cfg.frequency / interval;
+  if (chmask > 0xFFU ||
+      !adcscopeInit(&scope, ADC_GRP_NUM_CHANNELS, (uint8_t)chmask, rate,
+                    ADC_GRP_BUF_DEPTH / 2, SCOPE_LINK_BPS)) {
+    chprintf(chp, "chmask must select channels 0..%u\n\r",
+             ADC_GRP_NUM_CHANNELS - 1);
+    return;
+  }
+  if (adc_busy(chp)) {
+    return;
+  }
+
+  adcs1cfg.interval = interval;
+  period = (uint64_t)(ADC_GRP_BUF_DEPTH / 2) * adcs1cfg.interval *
+           (STM32_SYSCLK / gpt4cfg.frequency);
+  if (period > UINT32_MAX) {
+    period = UINT32_MAX;
+  }
+
+  adcsStart(&ADCS1, &adcs1cfg);
+
+  while (chnGetTimeout((BaseChannel *)chp, TIME_IMMEDIATE) == Q_TIMEOUT) {
+    adcs_block_t blk;
+    uint32_t lost;
+    rtcnt_t start;
+    size_t n;
+
+    if (adcsReadTimeout(&ADCS1, &blk, TIME_MS2I(100)) != MSG_OK) {
+      break;
+    }
+    n = adcscopePack(&scope, &blk, scopepkt);
+    lost = blk.lost;
+    if (adcsRelease(&ADCS1, &blk)) {
+      /* Torn block, the host sees the sequence gap.*/
+      adcscopeAdapt(&scope, lost + 1U, 0U, (rtcnt_t)period);
+      continue;
+    }
+
+    start = chSysGetRealtimeCounterX();
+    streamWrite(chp, scopepkt, n);
+    adcscopeAdapt(&scope, lost, chSysGetRealtimeCounterX() - start,
+                  (rtcnt_t)period);
+  }
+
+  adcsStop(&ADCS1);
+  adc_done();
+  adcsGetStats(&ADCS1, &stats);
+  chprintf(chp, "\n\rpackets %u dropped %u log2dec %u errors %u\n\r",
+           scope.packets, scope.dropped, adcscopeGetLog2Dec(&scope),
+           stats.errors);
+}
+
+
+/*
+ * Continuous signal-quality monitor, fed by a background thread and queried
+ * by the stats command while the acquisition goes on. The exponential
+ * figures weigh each block 1/16, peaks are held for 64 blocks.
+ */
+#define STATS_LOG2ALPHA        4U
+#define STATS_HOLD_BLOCKS      64U
+
+static adcstats_t STATS1;
+
+static THD_WORKING_AREA(waMonitor, 512);
+static THD_FUNCTION(thdMonitor, arg) {
+
+  (void)arg;
+  chRegSetThreadName("monitor");
+
+  while (!chThdShouldTerminateX()) {
+    adcs_block_t blk;
+    msg_t msg = adcsReadTimeout(&ADCS1, &blk, TIME_MS2I(100));
+
+    if (msg == MSG_OK) {
+      adcstatsFeed(&STATS1, blk.samples, blk.n);
+      adcsRelease(&ADCS1, &blk);
+    }
+    else if (msg == MSG_RESET) {
+      break;
+    }
+  }
+}
+
+/* Prints a Q16 or Q8 value with two decimals */
+static void print_fixed(BaseSequentialStream *chp, uint32_t v, unsigned q) {
+
+  chprintf(chp, "%5u.%02u", v >> q,
+           (unsigned)(((v & ((1U << q) - 1U)) * 100U) >> q));
+}
+
+static void print_stats(BaseSequentialStream *chp, const char *name,
+                        const adcstats_result_t *rp) {
+
+  chprintf(chp, "  %-7s n %8u mean ", name, (unsigned)rp->n);
+  print_fixed(chp, rp->mean, 16);
+  chprintf(chp, " sd ");
+  print_fixed(chp, rp->stddev, 8);
+  chprintf(chp, " rms ");
+  print_fixed(chp, rp->rms, 8);
+  chprintf(chp, " min %4u max %4u\n\r", rp->min, rp->max);
+}
+
+/* Starts, stops, resets or prints the background statistics */
+static void cmd_stats(BaseSequentialStream *chp, int argc, char *argv[]) {
+  adcs_stats_t stats;
+
+  if (argc > 2) {
+    chprintf(chp, "Usage: stats [start [rate_hz] | stop | reset]\n\r");
+    return;
+  }
+
+  if (argc >= 1 && strcmp(argv[0], "start") == 0) {
+    uint32_t rate = 20000U;
+
+    if (argc == 2) {
+      rate = (uint32_t)atoi(argv[1]);
+    }
+    if (rate_bad(chp, rate, STREAM_MAX_HZ)) {
+      return;
+    }
+    if (adc_busy(chp)) {
+      return;
+    }
+    adcs1cfg.interval = rate_interval(rate);
+    adcstatsInit(&STATS1, ADC_GRP_NUM_CHANNELS, STATS_LOG2ALPHA,
+                 STATS_HOLD_BLOCKS);
+    adcsStart(&ADCS1, &adcs1cfg);
+    hk_start(chp);
+    monitortp = chThdCreateStatic(waMonitor, sizeof(waMonitor),
+                                  NORMALPRIO + 1, thdMonitor, NULL);
+    return;
+  }
+
+  if (monitortp == NULL) {
+    chprintf(chp, "Monitor not running, run: stats start\n\r");
+    return;
+  }
+
+  if (argc >= 1 && strcmp(argv[0], "stop") == 0) {
+    chThdTerminate(monitortp);
+    chThdWait(monitortp);
+    monitortp = NULL;
+    adchkStop(&HK1);
+    adcsStop(&ADCS1);
+    adc_done();
+    return;
+  }
+  if (argc >= 1 && strcmp(argv[0], "reset") == 0) {
+    chSysLock();
+    adcstatsReset(&STATS1);
+    adcstatsReset(&HKSTATS);
+    chSysUnlock();
+    return;
+  }
+  if (argc >= 1) {
+    chprintf(chp, "Usage: stats [start [rate_hz] | stop | reset]\n\r");
+    return;
+  }
+
+  adcsGetStats(&ADCS1, &stats);
+  chprintf(chp, "blocks %u overruns %u errors %u\n\r",
+           adcstatsGetBlocks(&STATS1), stats.overruns, stats.errors);
+  for (unsigned c = 0; c < ADC_GRP_NUM_CHANNELS; c++) {
+    adcstats_result_t r;
+    adcsample_t lo, hi;
+
+    chprintf(chp, "CH%u\n\r", c + 1U);
+    adcstatsGet(&STATS1, c, ADCSTATS_RUNNING, &r);
+    print_stats(chp, "running", &r);
+    adcstatsGet(&STATS1, c, ADCSTATS_WINDOW, &r);
+    print_stats(chp, "window", &r);
+    adcstatsGet(&STATS1, c, ADCSTATS_EXP, &r);
+    print_stats(chp, "exp", &r);
+    adcstatsGetPeak(&STATS1, c, &lo, &hi);
+    chprintf(chp, "  peak    %4u..%4u\n\r", lo, hi);
+  }
+  if (adchkGetState(&HK1) == ADCHK_ACTIVE) {
+    static const char *const hknames[ADCHK_NUM_CHANNELS] = {
+      "VREFINT", "TS", "VBAT/3"
+    };
+
+    print_hk(chp);
+    for (unsigned c = 0; c < ADCHK_NUM_CHANNELS; c++) {
+      adcstats_result_t r;
+
+      adcstatsGet(&HKSTATS, c, ADCSTATS_RUNNING, &r);
+      print_stats(chp, hknames[c], &r);
+    }
+  }
+}
+
+
+/*
+ * Zero-copy block pool shared by a fast control loop and a slow logger.
+ * The logger checksums each block before and after its simulated write,
+ * any difference would mean the DMA reused a block it was still holding.
+ */
+#define POOL_BLOCKS            6U
+#define POOL_SETS              128U
+#define POOL_LOG_MS            25U
+#define POOL_BLOCK_BYTES       ADCPOOL_BLOCK_SIZE(POOL_SETS, ADC_GRP_NUM_CHANNELS)
+
+CC_ALIGN_DATA(PORT_NATURAL_ALIGN) static uint8_t poolbuf[POOL_BLOCKS *
+                                                         POOL_BLOCK_BYTES];
+static msg_t poolmsgs[POOL_BLOCKS];
+
+static ADCPoolDriver POOL1;
+static adcpool_consumer_t ctrlcons, logcons;
+static volatile uint32_t ctrlmean[ADC_GRP_NUM_CHANNELS];
+static volatile uint32_t logtorn;
+
+static ADCPoolConfig pool1cfg = {
+  .adcp         = &ADCD1,
+  .grpp         = &streamcfg,
+  .objbuf       = poolbuf,
+  .msgbuf       = poolmsgs,
+  .objn         = POOL_BLOCKS,
+  .sets         = POOL_SETS,
+  .policy       = ADCPOOL_DROP_NEWEST,
+  .gptp         = &GPTD4,
+  .interval     = 50U,                      /* 20 kHz */
+  .errp         = &ERR1
+};
+
+static THD_WORKING_AREA(waCtrl, 256);
+static THD_FUNCTION(thdCtrl, arg) {
+
+  (void)arg;
+  chRegSetThreadName("ctrl");
+
+  while (true) {
+    adcdsp_acc_t acc[ADC_GRP_NUM_CHANNELS];
+    adcpool_block_t *bp;
+    msg_t msg;
+
+    msg = adcpoolFetchTimeout(&POOL1, &ctrlcons, &bp, TIME_MS2I(100));
+    if (msg == MSG_RESET) {
+      break;
+    }
+    if (msg != MSG_OK) {
+      continue;
+    }
+    adcdspAccInit(acc, ADC_GRP_NUM_CHANNELS);
+    adcdspAccumulate(bp->samples, bp->n, ADC_GRP_NUM_CHANNELS, acc);
+    adcpoolRelease(&POOL1, bp);
+    for (unsigned c = 0; c < ADC_GRP_NUM_CHANNELS; c++) {
+      ctrlmean[c] = acc[c].sum / POOL_SETS;
+    }
+  }
+}
+
+static uint32_t pool_checksum(const adcpool_block_t *bp) {
+  uint32_t sum = 0U;
+
+  for (size_t i = 0; i < bp->n * ADC_GRP_NUM_CHANNELS; i++) {
+    sum = (sum << 1 | sum >> 31) ^ bp->samples[i];
+  }
+  return sum;
+}
+
+static THD_WORKING_AREA(waLogger, 256);
+static THD_FUNCTION(thdLogger, arg) {
+
+  (void)arg;
+  chRegSetThreadName("logger");
+
+  while (true) {
+    adcpool_block_t *bp;
+    uint32_t sum;
+    msg_t msg;
+
+    msg = adcpoolFetchTimeout(&POOL1, &logcons, &bp, TIME_MS2I(100));
+    if (msg == MSG_RESET) {
+      break;
+    }
+    if (msg != MSG_OK) {
+      continue;
+    }
+    sum = pool_checksum(bp);
+    chThdSleepMilliseconds(POOL_LOG_MS);
+    if (pool_checksum(bp) != sum) {
+      logtorn++;
+    }
+    adcpoolRelease(&POOL1, bp);
+  }
+}
+
+/* Runs the pool for num_seconds with the given exhaustion policy */
+static void cmd_pool(BaseSequentialStream *chp, int argc, char *argv[]) {
+  thread_t *ctrltp, *logtp;
+  adcpool_stats_t stats;
+  int seconds;
+
+  if (argc < 1 || argc > 2 ||
+      (argc == 2 && strcmp(argv[1], "newest") != 0 &&
+       strcmp(argv[1], "oldest") != 0)) {
+    chprintf(chp, "Usage: pool num_seconds [newest|oldest]\n\r");
+    return;
+  }
+  if (adc_busy(chp)) {
+    return;
+  }
+
+  seconds = atoi(argv[0]);
+  pool1cfg.policy = (argc == 2 && strcmp(argv[1], "oldest") == 0) ?
+                    ADCPOOL_DROP_OLDEST : ADCPOOL_DROP_NEWEST;
+  logtorn = 0U;
+
+  adcpoolStart(&POOL1, &pool1cfg);
+  ctrltp = chThdCreateStatic(waCtrl, sizeof(waCtrl), NORMALPRIO + 2,
+                             thdCtrl, NULL);
+  logtp = chThdCreateStatic(waLogger, sizeof(waLogger), NORMALPRIO + 1,
+                            thdLogger, NULL);
+
+  while (seconds-- > 0) {
+    chThdSleepMilliseconds(1000);
+    adcpoolGetStats(&POOL1, &stats);
+    chprintf(chp, "filled %6u drop new %5u old %5u | ctrl %6u/%u "
+             "log %5u/%u | CH1 %4u CH2 %4u\n\r",
+             stats.filled, stats.dropnewest, stats.dropoldest,
+             ctrlcons.received, ctrlcons.missed,
+             logcons.received, logcons.missed,
+             ctrlmean[0], ctrlmean[1]);
+  }
+
+  adcpoolStop(&POOL1);
+  adc_done();
+  chThdWait(ctrltp);
+  chThdWait(logtp);
+
+  adcpoolGetStats(&POOL1, &stats);
+  chprintf(chp, "torn %u errors %u\n\r", logtorn, stats.errors);
+}
+
+
+/*
+ * Spectrum of CH1 through the Q15 real FFT. Frames span several stream
+ * blocks, a lost block discards the frame being collected. The bin mode
+ * sends adcfft packets, see adcfft.h, any byte received stops it.
+ */
+#define SPECTRUM_WINDOW        ADCFFT_WIN_HANN
+#define SPECTRUM_MAX_PEAKS     8U
+
+static adcfft_t FFT1;
+static uint8_t specpkt[ADCFFT_PACKET_SIZE(ADCFFT_MAX_POINTS)];
+static adcsample_t fftbench[ADCFFT_MAX_POINTS];
+
+static void spectrum_usage(BaseSequentialStream *chp) {
+
+  chprintf(chp, "Usage: spectrum bench [rate_hz]\n\r"
+                "       spectrum top [n [points [rate_hz]]]\n\r"
+                "       spectrum bin [points [rate_hz]]\n\r");
+}
+
+static void print_peaks(BaseSequentialStream *chp, unsigned n,
+                        uint32_t rate) {
+  adcfft_peak_t peaks[SPECTRUM_MAX_PEAKS];
+  size_t found = adcfftPeaks(&FFT1, peaks, n);
+
+  for (size_t i = 0; i < found; i++) {
+    uint32_t amp = adcfftAmplitude(&FFT1, peaks[i].mag);
+    int32_t db = adcfftDbfs(&FFT1, peaks[i].mag);
+
+    chprintf(chp, "  bin %4u.%02u %6u Hz amp %4u.%02u %s%d.%u dBFS\n\r",
+             peaks[i].bin >> 8, ((peaks[i].bin & 0xFFU) * 100U) >> 8,
+             adcfftBinHz(&FFT1, peaks[i].bin, rate),
+             amp >> 8, ((amp & 0xFFU) * 100U) >> 8,
+             db < 0 ? "-" : "", (db < 0 ? -db : db) / 10,
+             (unsigned)((db < 0 ? -db : db) % 10));
+  }
+}
+
+/* Cycles of the FFT sizes against the frame period at rate_hz */
+static void spectrum_bench(BaseSequentialStream *chp, uint32_t rate) {
+  static const size_t sizes[] = {256U, 512U, 1024U};
+  uint32_t seed = 0x1337U;
+
+  chprintf(chp, "points     feed  compute   budget  load  peak bin\n\r");
+
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    size_t n = sizes[s];
+    uint32_t budget = (uint32_t)((uint64_t)n * STM32_SYSCLK / rate);
+    adcfft_peak_t peak;
+    rtcnt_t t[3];
+
+    if (n > ADCFFT_MAX_POINTS) {
+      break;
+    }
+
+    /* Triangle of period 40 sets with noise, fundamental at n / 40.*/
+    for (size_t i = 0; i < n; i++) {
+      uint32_t ph = i % 40U;
+
+      seed = seed * 1664525U + 1013904223U;
+      fftbench[i] = (adcsample_t)(1048U + (ph < 20U ? ph : 40U - ph) * 100U +
+                                  (seed >> 29));
+    }
+
+    adcfftInit(&FFT1, n, SPECTRUM_WINDOW);
+    t[0] = chSysGetRealtimeCounterX();
+    adcfftFeed(&FFT1, fftbench, n, 1U, 0U);
+    t[1] = chSysGetRealtimeCounterX();
+    adcfftCompute(&FFT1);
+    t[2] = chSysGetRealtimeCounterX();
+
+    adcfftPeaks(&FFT1, &peak, 1U);
+    chprintf(chp, "%6u %8u %8u %8u %4u%% %4u.%02u/%u.%02u\n\r", n,
+             t[1] - t[0], t[2] - t[1], budget,
+             (unsigned)((uint64_t)(t[2] - t[0]) * 100U / budget),
+             peak.bin >> 8, ((peak.bin & 0xFFU) * 100U) >> 8,
+             (unsigned)(n / 40U), (unsigned)((n % 40U) * 100U / 40U));
+  }
+}
+
+/* Benchmarks, prints the top n peaks every second or streams spectra */
+static void cmd_spectrum(BaseSequentialStream *chp, int argc, char *argv[]) {
+  uint32_t npeaks = 5U, points = 1024U, rate = 20000U, frames = 0U, lost = 0U;
+  systime_t last;
+  bool binary;
+  int i = 1;
+
+  if (argc < 1) {
+    spectrum_usage(chp);
+    return;
+  }
+
+  if (strcmp(argv[0], "bench") == 0) {
+    if (argc > 2) {
+      spectrum_usage(chp);
+      return;
+    }
+    if (argc == 2) {
+      rate = (uint32_t)atoi(argv[1]);
+    }
+    if (rate_bad(chp, rate, STREAM_MAX_HZ)) {
+      return;
+    }
+    spectrum_bench(chp, rate);
+    return;
+  }
+
+  binary = strcmp(argv[0], "bin") == 0;
+  if ((!binary && strcmp(argv[0], "top") != 0) || argc > (binary ? 3 : 4)) {
+    spectrum_usage(chp);
+    return;
+  }
+  if (!binary && argc > i) {
+    npeaks = (uint32_t)atoi(argv[i++]);
+  }
+  if (argc > i) {
+    points = (uint32_t)atoi(argv[i++]);
+  }
+  if (argc > i) {
+    rate = (uint32_t)atoi(argv[i++]);
+  }
+  if (npeaks == 0U || npeaks > SPECTRUM_MAX_PEAKS ||
+      !adcfftInit(&FFT1, points, SPECTRUM_WINDOW)) {
+    chprintf(chp, "n must be 1..%u, points a power of two 8..%u\n\r",
+             SPECTRUM_MAX_PEAKS, ADCFFT_MAX_POINTS);
+    return;
+  }
+  if (rate_bad(chp, rate, STREAM_MAX_HZ)) {
+    return;
+  }
+  if (adc_busy(chp)) {
+    return;
+  }
+
+  adcs1cfg.interval = rate_interval(rate);
+  rate = gpt4cfg.frequency / adcs1cfg.interval;
+
+  adcsStart(&ADCS1, &adcs1cfg);
+  last = chVTGetSystemTimeX();
+
+  while (chnGetTimeout((BaseChannel *)chp, TIME_IMMEDIATE) == Q_TIMEOUT) {
+    adcs_block_t blk;
+    size_t done = 0U;
+
+    if (adcsReadTimeout(&ADCS1, &blk, TIME_MS2I(100)) != MSG_OK) {
+      break;
+    }
+    if (blk.lost > 0U) {
+      lost += blk.lost;
+      adcfftReset(&FFT1);
+    }
+
+    while (done < blk.n) {
+      done += adcfftFeed(&FFT1, blk.samples + done * ADC_GRP_NUM_CHANNELS,
+                         blk.n - done, ADC_GRP_NUM_CHANNELS, 0U);
+      if (adcsRelease(&ADCS1, &blk)) {
+        /* The DMA reached the block while copying, drop the frame.*/
+        lost++;
+        adcfftReset(&FFT1);
+        break;
+      }
+      if (!adcfftIsReady(&FFT1)) {
+        break;
+      }
+      adcfftCompute(&FFT1);
+      frames++;
+
+      if (binary) {
+        streamWrite(chp, specpkt, adcfftPack(&FFT1, frames - 1U, rate,
+                                             specpkt));
+      }
+      else if (chVTTimeElapsedSinceX(last) >= TIME_MS2I(1000)) {
+        last = chVTGetSystemTimeX();
+        chprintf(chp, "frame %u lost %u\n\r", frames, lost);
+        print_peaks(chp, npeaks, rate);
+      }
+    }
+  }
+
+  adcsStop(&ADCS1);
+  adc_done();
+  chprintf(chp, "\n\rframes %u lost blocks %u\n\r", frames, lost);
+}
+
+
+/*
+ * VDDA and temperature from VREFINT and the factory data, measured every
+ * CAL_PERIOD_MS while no command owns ADC1.
+ */
+#define CAL_PERIOD_MS          1000U
+
+static volatile uint32_t calskipped;
+
+static THD_WORKING_AREA(waCalib, 256);
+static THD_FUNCTION(thdCalib, arg) {
+
+  (void)arg;
+  chRegSetThreadName("calib");
+
+  while (true) {
+    chThdSleepMilliseconds(CAL_PERIOD_MS);
+    if (!chMtxTryLock(&ADCD1.mutex)) {
+      calskipped++;
+      continue;
+    }
+    (void) adccalMeasure(&CAL1);
+    adcReleaseBus(&ADCD1);
+  }
+}
+
+/* Prints the calibration, measures now or compares float and integer */
+static void cmd_cal(BaseSequentialStream *chp, int argc, char *argv[]) {
+  volatile uint32_t sink;
+  uint32_t seed = 0x1337U, mvsum = 0U;
+  float fsum = 0.0f;
+  int32_t temp;
+  rtcnt_t t[3];
+
+  if (argc > 1 || (argc == 1 && strcmp(argv[0], "measure") != 0)) {
+    chprintf(chp, "Usage: cal [measure]\n\r");
+    return;
+  }
+  if (argc == 1) {
+    if (adc_busy(chp)) {
+      return;
+    }
+    (void) adccalMeasure(&CAL1);
+    adc_done();
+  }
+
+  temp = adccalToCentidegrees(&CAL1, CAL1.tsraw);
+  chprintf(chp, "factory VREFINT %u TS %u/%u, CALFACT 0x%08x\n\r",
+           CAL1.vrefcal, CAL1.tscal1, CAL1.tscal2, CAL1.calfact);
+  chprintf(chp, "VREFINT %u VDDA %u mV, %u.%03u mV/count\n\r",
+           CAL1.vrefraw, adccalGetVdda(&CAL1), CAL1.mvscale >> 16,
+           (unsigned)(((CAL1.mvscale & 0xFFFFU) * 1000U) >> 16));
+  chprintf(chp, "temperature %s%d.%02d C (raw %u)\n\r", temp < 0 ? "-" : "",
+           (temp < 0 ? -temp : temp) / 100, (temp < 0 ? -temp : temp) % 100,
+           CAL1.tsraw);
+  chprintf(chp, "updates %u skipped %u\n\r", CAL1.updates, calskipped);
+
+  for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+    seed = seed * 1664525U + 1013904223U;
+    bench[i] = (adcsample_t)(seed >> 20);
+  }
+  t[0] = chSysGetRealtimeCounterX();
+  for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+    fsum += (float) bench[i] * VOLTAGE_RES;
+  }
+  t[1] = chSysGetRealtimeCounterX();
+  for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+    mvsum += adccalToMillivolts(&CAL1, bench[i]);
+  }
+  t[2] = chSysGetRealtimeCounterX();
+  sink = (uint32_t)fsum + mvsum;
+  (void)sink;
+
+  chprintf(chp, "%u conversions: float 3.3 V %u cycles, calibrated mV %u "
+           "cycles\n\r", BENCH_SAMPLES, t[1] - t[0], t[2] - t[1]);
+}
+
+
+/*
+ * Sample time tuning. Without arguments each stream channel is measured
+ * after the one preceding it in the sequence, as it is converted while
+ * streaming; "tune apply" moves the result to the stream group.
+ */
+#define TUNE_MAX_ERR           256U         /* 1 LSB settling error       */
+#define TUNE_MAX_NOISE         64U          /* 0.25 LSB extra deviation   */
+
+static adctune_table_t TUNE1;
+
+static const adctune_config_t tunecfg = {
+  .maxerr       = TUNE_MAX_ERR,
+  .maxnoise     = TUNE_MAX_NOISE
+};
+
+/* Prints a signed Q8 value with two decimals */
+static void print_q8s(BaseSequentialStream *chp, int32_t v) {
+  uint32_t a = v < 0 ? (uint32_t)-v : (uint32_t)v;
+
+  chprintf(chp, "%s%u.%02u", v < 0 ? "-" : "", a >> 8,
+           (unsigned)(((a & 0xFFU) * 100U) >> 8));
+}
+
+static bool tune_channel(BaseSequentialStream *chp, unsigned ch,
+                         unsigned aggressor) {
+  adctune_result_t r;
+
+  if (adctuneChannel(&ADCD1, &tunecfg, ch, aggressor, &r) != MSG_OK) {
+    chprintf(chp, "IN%u: ADC error\n\r", ch);
+    return false;
+  }
+
+  if (aggressor == ADCTUNE_NO_CHANNEL) {
+    chprintf(chp, "IN%u alone, %u sets per sample time\n\r", ch, ADCTUNE_SETS);
+  }
+  else {
+    chprintf(chp, "IN%u after IN%u, %u sets per sample time\n\r", ch,
+             aggressor, ADCTUNE_SETS);
+  }
+  chprintf(chp, "  smp         mean      sd     err\n\r");
+  for (unsigned smp = 0U; smp < ADCTUNE_NUM_SMP; smp++) {
+    chprintf(chp, "  %-6s", adctuneSmpName(smp) + sizeof("ADC_SMPR_SMP_") - 1U);
+    print_fixed(chp, r.mean[smp], 16);
+    print_fixed(chp, r.stddev[smp], 8);
+    chprintf(chp, "   ");
+    print_q8s(chp, r.err[smp]);
+    chprintf(chp, "%s\n\r", smp == r.smp ? "  <" : "");
+  }
+  chprintf(chp, "  recommended %s, %u Hz alone\n\r", adctuneSmpName(r.smp),
+           ADCTUNE_MAX_RATE(ADCGRP_HALFCYCLES(ADCGRP_CH(ch, r.smp))));
+  adctuneStore(&TUNE1, &r);
+  return true;
+}
+
+/* Tunes the stream channels or one channel, or applies the result */
+static void cmd_tune(BaseSequentialStream *chp, int argc, char *argv[]) {
+  unsigned nch = streamgrp.num_channels;
+  ADCConversionGroup grp;
+
+  if (argc > 2) {
+    chprintf(chp, "Usage: tune [channel [aggressor]] | tune apply\n\r");
+    return;
+  }
+
+  if (argc == 1 && strcmp(argv[0], "apply") == 0) {
+    uint32_t rate;
+
+    if (adc_busy(chp)) {
+      return;
+    }
+    grp = streamgrp;
+    adctuneApply(&TUNE1, &grp);
+    rate = ADCTUNE_MAX_RATE(adctuneGroupHalfcycles(&grp));
+    if (rate < STREAM_MAX_HZ) {
+      chprintf(chp, "Tuned sequence limited to %u Hz, below %u Hz: not "
+               "applied\n\r", rate, STREAM_MAX_HZ);
+    }
+    else {
+      streamgrp = grp;
+      chprintf(chp, "Applied, stream sequence up to %u Hz\n\r", rate);
+    }
+    adc_done();
+    return;
+  }
+
+  if (argc >= 1) {
+    unsigned ch = (unsigned)atoi(argv[0]);
+    unsigned aggressor = argc == 2 ? (unsigned)atoi(argv[1]) :
+                                     ADCTUNE_NO_CHANNEL;
+
+    if (ch > ADCTUNE_MAX_CHANNEL || ch == aggressor ||
+        (argc == 2 && aggressor > ADCTUNE_MAX_CHANNEL)) {
+      chprintf(chp, "channel and aggressor must differ, 0..%u\n\r",
+               ADCTUNE_MAX_CHANNEL);
+      return;
+    }
+    if (adc_busy(chp)) {
+      return;
+    }
+    (void) tune_channel(chp, ch, aggressor);
+    adc_done();
+    return;
+  }
+
+  if (adc_busy(chp)) {
+    return;
+  }
+  for (unsigned i = 0U; i < nch; i++) {
+    unsigned ch = adctuneGetChannel(&streamgrp, i);
+    unsigned aggressor = nch == 1U ? ADCTUNE_NO_CHANNEL :
+                         adctuneGetChannel(&streamgrp, (i + nch - 1U) % nch);
+
+    if (!tune_channel(chp, ch, aggressor)) {
+      adc_done();
+      return;
+    }
+  }
+  adc_done();
+
+  /* Snippet for the compile-time sequence.*/
+  chprintf(chp, "#define STREAM_SEQ      ");
+  for (unsigned i = 0U; i < nch; i++) {
+    unsigned ch = adctuneGetChannel(&streamgrp, i);
+
+    chprintf(chp, "%sADCGRP_CH(ADC_CHANNEL_IN%u, %s)%s\n\r",
+             i == 0U ? "" : "                        ", ch,
+             adctuneSmpName(TUNE1.smp[ch]), i + 1U < nch ? ",  \\" : "");
+  }
+  grp = streamgrp;
+  adctuneApply(&TUNE1, &grp);
+  chprintf(chp, "/* up to %u Hz */\n\r",
+           ADCTUNE_MAX_RATE(adctuneGroupHalfcycles(&grp)));
+}
+
+
+/*
+ * ADC1 error accounting. The watch mode prints every report as it is
+ * broadcast until the time is up or a key is pressed, the restart setting
+ * applies to the stream based commands.
+ */
+#define ERRORS_MAX_WATCH_S     3600
+
+static void errors_usage(BaseSequentialStream *chp) {
+
+  chprintf(chp, "Usage: errors [reset | restart on|off | watch num_seconds]\n\r");
+}
+
+static void print_causes(BaseSequentialStream *chp, eventflags_t flags) {
+
+  chprintf(chp, "%s%s%s%s%s",
+           (flags & ADCERR_FLAG_DMA) ? " dma" : "",
+           (flags & ADCERR_FLAG_OVERFLOW) ? " overflow" : "",
+           (flags & ADCERR_FLAG_OVERRUN) ? " overrun" : "",
+           (flags & ADCERR_FLAG_OTHER) ? " other" : "",
+           (flags & ADCERR_FLAG_RESTART) ? " restart" : "");
+}
+
+/* Prints, resets or watches the ADC1 error counters */
+static void cmd_errors(BaseSequentialStream *chp, int argc, char *argv[]) {
+  adcerr_counters_t cnt;
+
+  if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+    adcerrReset(&ERR1);
+    return;
+  }
+  if (argc == 2 && strcmp(argv[0], "restart") == 0) {
+    if (strcmp(argv[1], "on") != 0 && strcmp(argv[1], "off") != 0) {
+      errors_usage(chp);
+      return;
+    }
+    if (adc_busy(chp)) {
+      return;
+    }
+    adcs1cfg.restart = strcmp(argv[1], "on") == 0;
+    adc_done();
+    return;
+  }
+  if (argc == 2 && strcmp(argv[0], "watch") == 0) {
+    event_listener_t el;
+    systime_t start;
+    sysinterval_t duration;
+    int seconds = atoi(argv[1]);
+
+    if (seconds < 1 || seconds > ERRORS_MAX_WATCH_S) {
+      chprintf(chp, "num_seconds must be 1..%u\n\r", ERRORS_MAX_WATCH_S);
+      return;
+    }
+    duration = TIME_S2I(seconds);
+    start = chVTGetSystemTime();
+
+    chEvtRegisterMaskWithFlags(adcerrGetEventSource(&ERR1), &el,
+                               EVENT_MASK(0), (eventflags_t)-1);
+    while (chVTTimeElapsedSinceX(start) < duration &&
+           chnGetTimeout((BaseChannel *)chp, TIME_IMMEDIATE) == Q_TIMEOUT) {
+      eventflags_t flags;
+
+      if (chEvtWaitAnyTimeout(EVENT_MASK(0), TIME_MS2I(100)) == 0U) {
+        continue;
+      }
+      flags = chEvtGetAndClearFlags(&el);
+      adcerrGet(&ERR1, &cnt);
+      chprintf(chp, "%8u ms:", (unsigned)TIME_I2MS(chVTGetSystemTime()));
+      print_causes(chp, flags);
+      chprintf(chp, " | errors %u overruns %u restarts %u\n\r",
+               cnt.errors, cnt.overruns, cnt.restarts);
+    }
+    chEvtUnregister(adcerrGetEventSource(&ERR1), &el);
+    return;
+  }
+  if (argc != 0) {
+    errors_usage(chp);
+    return;
+  }
+
+  adcerrGet(&ERR1, &cnt);
+  chprintf(chp, "ADC1 errors %u: dma %u overflow %u other %u\n\r",
+           cnt.errors, cnt.dma, cnt.overflows, cnt.other);
+  chprintf(chp, "overruns %u blocks, restarts %u, restart on overflow %s\n\r",
+           cnt.overruns, cnt.restarts, adcs1cfg.restart ? "on" : "off");
+  if (cnt.lastflags != 0U) {
+    chprintf(chp, "last:");
+    print_causes(chp, cnt.lastflags);
+    chprintf(chp, " code 0x%x, %u ms ago\n\r", (unsigned)cnt.lasterr,
+             (unsigned)TIME_I2MS(chVTTimeElapsedSinceX(cnt.lasttime)));
+  }
+}
+
+
+/*
+ * Pre-trigger captures of the stream, see adccap.h. Captures are printed
+ * as min/max rows around the trigger or, in the bin mode, sent as adcscope
+ * packets with the capture number as sequence. A received 'f' forces a
+ * trigger, any other byte stops.
+ */
+#define CAPTURE_MAX_SETS       1024U
+#define CAPTURE_ROWS           16U
+
+static adccap_t CAP1;
+static adcsample_t capbuf[CAPTURE_MAX_SETS * ADC_GRP_NUM_CHANNELS];
+static uint8_t cappkt[ADCSCOPE_PACKET_SIZE(CAPTURE_MAX_SETS,
+                                           ADC_GRP_NUM_CHANNELS)];
+
+static void capture_usage(BaseSequentialStream *chp) {
+
+  chprintf(chp, "Usage: capture normal|single|auto "
+                "above|below|rise|fall|both|slope+|slope-|slope|window\n\r"
+                "       [ch= level= hyst= low= high= slope= span= pre= post= "
+                "holdoff= auto= rate=] [bin]\n\r"
+                "       pre, post, span, holdoff and auto in sets\n\r");
+}
+
+static bool capture_key(const char *arg, const char *key, uint32_t *vp) {
+  size_t n = strlen(key);
+
+  if (strncmp(arg, key, n) != 0 || arg[n] != '=') {
+    return false;
+  }
+  *vp = (uint32_t)strtoul(arg + n + 1, NULL, 0);
+  return true;
+}
+
+static void print_capture(BaseSequentialStream *chp,
+                          const adccap_capture_t *capp, uint32_t us) {
+  size_t rows = CAPTURE_ROWS, step = (capp->n + rows - 1U) / rows;
+
+  chprintf(chp, "capture %u at %u.%03u ms%s\n\r", capp->number,
+           us / 1000U, us % 1000U, capp->forced ? " forced" : "");
+  for (size_t r = 0; r * step < capp->n; r++) {
+    size_t first = r * step, last = first + step;
+
+    if (last > capp->n) {
+      last = capp->n;
+    }
+    chprintf(chp, "%6d", (int)first - (int)capp->trigger);
+    for (unsigned c = 0; c < ADC_GRP_NUM_CHANNELS; c++) {
+      adcsample_t lo = 0xFFFFU, hi = 0U;
+
+      for (size_t i = first; i < last; i++) {
+        adcsample_t v = capp->samples[i * ADC_GRP_NUM_CHANNELS + c];
+
+        lo = v < lo ? v : lo;
+        hi = v > hi ? v : hi;
+      }
+      chprintf(chp, " | CH%u %4u %4u", c + 1U, lo, hi);
+    }
+    chprintf(chp, "%s\n\r",
+             (capp->trigger >= first && capp->trigger < last) ? " <" : "");
+  }
+}
+
+/* Captures around a trigger until a byte is received or the single shot */
+static void cmd_capture(BaseSequentialStream *chp, int argc, char *argv[]) {
+  static const struct {
+    const char *name;
+    adccap_trigger_t trigger;
+    unsigned edge;
+  } trigs[] = {
+    {"above", ADCCAP_LEVEL, ADCCAP_RISING},
+    {"below", ADCCAP_LEVEL, ADCCAP_FALLING},
+    {"rise", ADCCAP_EDGE, ADCCAP_RISING},
+    {"fall", ADCCAP_EDGE, ADCCAP_FALLING},
+    {"both", ADCCAP_EDGE, ADCCAP_BOTH},
+    {"slope+", ADCCAP_SLOPE, ADCCAP_RISING},
+    {"slope-", ADCCAP_SLOPE, ADCCAP_FALLING},
+    {"slope", ADCCAP_SLOPE, ADCCAP_BOTH},
+    {"window", ADCCAP_WINDOW, ADCCAP_BOTH}
+  };
+  adccap_config_t cfg = {
+    .channel = 0U, .nch = ADC_GRP_NUM_CHANNELS,
+    .level = 2048U, .hyst = 16U, .low = 1024U, .high = 3072U,
+    .slope = 256U, .span = 4U, .pre = 256U, .post = 256U,
+    .holdoff = 0U, .autosets = 0U, .buf = capbuf
+  };
+  uint32_t v, rate = 20000U, torn = 0U;
+  adcscope_t scope;
+  bool binary = false, ok = true;
+  int i;
+
+  if (argc < 2) {
+    capture_usage(chp);
+    return;
+  }
+  if (strcmp(argv[0], "normal") == 0) {
+    cfg.mode = ADCCAP_NORMAL;
+  }
+  else if (strcmp(argv[0], "single") == 0) {
+    cfg.mode = ADCCAP_SINGLE;
+  }
+  else if (strcmp(argv[0], "auto") == 0) {
+    cfg.mode = ADCCAP_AUTO;
+  }
+  else {
+    capture_usage(chp);
+    return;
+  }
+  for (i = 0; i < (int)(sizeof(trigs) / sizeof(trigs[0])); i++) {
+    if (strcmp(argv[1], trigs[i].name) == 0) {
+      cfg.trigger = trigs[i].trigger;
+      cfg.edge = trigs[i].edge;
+      break;
+    }
+  }
+  if (i == (int)(sizeof(trigs) / sizeof(trigs[0]))) {
+    capture_usage(chp);
+    return;
+  }
+
+  for (i = 2; i < argc && ok; i++) {
+    if (strcmp(argv[i], "bin") == 0) {
+      binary = true;
+    }
+    else if (capture_key(argv[i], "ch", &v)) {
+      cfg.channel = v;
+    }
+    else if (capture_key(argv[i], "level", &v)) {
+      cfg.level = (adcsample_t)v;
+      ok = v < 4096U;
+    }
+    else if (capture_key(argv[i], "hyst", &v)) {
+      cfg.hyst = (adcsample_t)v;
+      ok = v < 4096U;
+    }
+    else if (capture_key(argv[i], "low", &v)) {
+      cfg.low = (adcsample_t)v;
+      ok = v < 4096U;
+    }
+    else if (capture_key(argv[i], "high", &v)) {
+      cfg.high = (adcsample_t)v;
+      ok = v < 4096U;
+    }
+    else if (capture_key(argv[i], "slope", &v)) {
+      cfg.slope = (uint16_t)v;
+      ok = v > 0U && v < 4096U;
+    }
+    else if (capture_key(argv[i], "span", &v)) {
+      cfg.span = (uint16_t)v;
+      ok = v < CAPTURE_MAX_SETS;
+    }
+    else if (capture_key(argv[i], "pre", &v)) {
+      cfg.pre = v;
+    }
+    else if (capture_key(argv[i], "post", &v)) {
+      cfg.post = v;
+    }
+    else if (capture_key(argv[i], "holdoff", &v)) {
+      cfg.holdoff = v;
+    }
+    else if (capture_key(argv[i], "auto", &v)) {
+      cfg.autosets = v;
+    }
+    else if (capture_key(argv[i], "rate", &v)) {
+      rate = v;
+    }
+    else {
+      ok = false;
+    }
+  }
+  if (!ok || cfg.channel >= ADC_GRP_NUM_CHANNELS ||
+      cfg.pre > CAPTURE_MAX_SETS || cfg.post == 0U ||
+      cfg.pre + cfg.post > CAPTURE_MAX_SETS || cfg.low > cfg.high ||
+      (cfg.trigger == ADCCAP_SLOPE &&
+       (cfg.span == 0U || cfg.span >= cfg.pre + cfg.post))) {
+    chprintf(chp, "samples 0..4095, ch 0..%u, pre + post 1..%u with post "
+             "at least 1, slope span 1..pre + post - 1\n\r",
+             ADC_GRP_NUM_CHANNELS - 1, CAPTURE_MAX_SETS);
+    return;
+  }
+  if (rate_bad(chp, rate, STREAM_MAX_HZ)) {
+    return;
+  }
+  if (adc_busy(chp)) {
+    return;
+  }
+
+  adcs1cfg.interval = rate_interval(rate);
+  rate = gpt4cfg.frequency / adcs1cfg.interval;
+  if (cfg.autosets == 0U) {
+    /* A tenth of a second without trigger.*/
+    cfg.autosets = rate / 10U + 1U;
+  }
+  (void) adcscopeInit(&scope, ADC_GRP_NUM_CHANNELS,
+                      (1U << ADC_GRP_NUM_CHANNELS) - 1U, rate,
+                      cfg.pre + cfg.post, UINT32_MAX);
+
+  adccapStart(&CAP1, &cfg);
+  adcsStart(&ADCS1, &adcs1cfg);
+
+  while (adccapGetState(&CAP1) != ADCCAP_STOP) {
+    adcs_block_t blk;
+    adccap_capture_t cap;
+    msg_t c = chnGetTimeout((BaseChannel *)chp, TIME_IMMEDIATE);
+    bool ready;
+
+    if (c == 'f') {
+      adccapForce(&CAP1);
+    }
+    else if (c != Q_TIMEOUT) {
+      break;
+    }
+    if (adcsReadTimeout(&ADCS1, &blk, TIME_MS2I(100)) != MSG_OK) {
+      break;
+    }
+    ready = adccapFeed(&CAP1, &blk);
+    if (adcsRelease(&ADCS1, &blk)) {
+      /* Overwritten while copied, the ring is not trusted any more.*/
+      torn++;
+      adccapArm(&CAP1);
+      continue;
+    }
+    if (!ready || !adccapGet(&CAP1, &cap)) {
+      continue;
+    }
+
+    if (binary) {
+      adcs_block_t view = {
+        .samples = (adcsample_t *)cap.samples, .n = cap.n, .seq = cap.number
+      };
+
+      streamWrite(chp, cappkt, adcscopePack(&scope, &view, cappkt));
+    }
+    else {
+      print_capture(chp, &cap,
+                    (uint32_t)(cap.set * adcs1cfg.interval *
+                               (1000000U / gpt4cfg.frequency)));
+    }
+    adccapRelease(&CAP1);
+  }
+
+  adcsStop(&ADCS1);
+  adccapStop(&CAP1);
+  adc_done();
+  chprintf(chp, "\n\rcaptures %u dropped sets %u torn %u\n\r",
+           adccapGetCaptures(&CAP1), (uint32_t)adccapGetDropped(&CAP1), torn);
+}
+
+
+/*
+ * Parallel scan of up to ADCSCAN_MAX_PINS pins over ADC1 to ADC4 on the
+ * GPT4 trigger, see adcscan.h. The scan takes ADC1 even when no pin lands
+ * on it, GPT4 is the stream timer. PA2 and PA3 are the shell USART.
+ */
+#define SCAN_BUF_DEPTH         128
+
+static ADCScanDriver SCAN1;
+static adcsample_t scanbuf[ADCSCAN_BUF_SIZE(SCAN_BUF_DEPTH, ADCSCAN_MAX_PINS)];
+static adcsample_t scanframe[SCAN_BUF_DEPTH / 2 * ADCSCAN_MAX_PINS];
+
+static const ioportid_t scanports[] = {
+  GPIOA, GPIOB, GPIOC, GPIOD, GPIOE, GPIOF, GPIOG
+};
+
+/* Pin id of a name like PB12, 0xFF if invalid or one of the shell pins. */
+static uint8_t scan_pin(const char *name) {
+  char *end;
+  unsigned long pad;
+  uint8_t pin;
+
+  if (name[0] != 'P' || name[1] < 'A' || name[1] > 'G') {
+    return 0xFFU;
+  }
+  pad = strtoul(name + 2, &end, 10);
+  if (end == name + 2 || *end != '\0' || pad > 15U) {
+    return 0xFFU;
+  }
+  pin = (uint8_t)(((unsigned)(name[1] - 'A') << 4) | pad);
+  if (pin == ADCSCAN_PIN(A, 2) || pin == ADCSCAN_PIN(A, 3)) {
+    return 0xFFU;
+  }
+  return pin;
+}
+
+/* Scans the pins at rate_hz and prints their means every second */
+static void cmd_scan(BaseSequentialStream *chp, int argc, char *argv[]) {
+  uint8_t pins[ADCSCAN_MAX_PINS];
+  uint32_t sums[ADCSCAN_MAX_PINS], rate, frames = 0U, lost = 0U, n = 0U;
+  ADCScanConfig cfg = {
+    .adcs         = {&ADCD1, &ADCD2, &ADCD3, &ADCD4},
+    .errp         = {&ERR1, NULL, NULL, NULL},
+    .pins         = pins,
+    .smp          = ADC_SMPR_SMP_24P5,
+    .gptp         = &GPTD4,
+    .cfgr         = ADCGRP_TRIGGER(TIM4_TRGO),
+    .buf          = scanbuf,
+    .frame        = scanframe
+  };
+  systime_t last;
+  int i;
+
+  if (argc < 2 || argc > ADCSCAN_MAX_PINS + 1) {
+    chprintf(chp, "Usage: scan rate_hz pin [pin ...], e.g. scan 10000 PA0 "
+                  "PB1 PB12\n\r");
+    return;
+  }
+  rate = (uint32_t)atoi(argv[0]);
+  for (i = 1; i < argc; i++) {
+    pins[i - 1] = scan_pin(argv[i]);
+    if (pins[i - 1] == 0xFFU) {
+      chprintf(chp, "%s is not an ADC pin, PA2 and PA3 are the shell\n\r",
+               argv[i]);
+      return;
+    }
+  }
+  cfg.num_pins = (unsigned)(argc - 1);
+
+  /* As deep as the buffers allow, even.*/
+  cfg.depth = (SCAN_BUF_DEPTH * ADCSCAN_MAX_PINS / cfg.num_pins) & ~1U;
+  if (!adcscanAssign(&SCAN1, &cfg)) {
+    chprintf(chp, "No assignment, a pin is repeated or on no ADC\n\r");
+    return;
+  }
+  if (rate_bad(chp, rate, adcscanMaxRate(&SCAN1) < gpt4cfg.frequency ?
+                         adcscanMaxRate(&SCAN1) : gpt4cfg.frequency)) {
+    return;
+  }
+  for (i = 0; i < (int)cfg.num_pins; i++) {
+    chprintf(chp, "%s ADC%u IN%u\n\r", argv[i + 1],
+             adcscanGetADC(&SCAN1, i), adcscanGetChannel(&SCAN1, i));
+    sums[i] = 0U;
+  }
+  if (adc_busy(chp)) {
+    return;
+  }
+
+  /* The pins change mode only once the ADCs are ours.*/
+  for (i = 0; i < (int)cfg.num_pins; i++) {
+    palSetLineMode(PAL_LINE(scanports[pins[i] >> 4], pins[i] & 15U),
+                   PAL_MODE_INPUT_ANALOG);
+  }
+  cfg.interval = rate_interval(rate);
+  rate = gpt4cfg.frequency / cfg.interval;
+  if (!adcscanStart(&SCAN1, &cfg)) {
+    adc_done();
+    chprintf(chp, "Sequences too long for %u Hz\n\r", rate);
+    return;
+  }
+  chprintf(chp, "%u ADCs, %u sets/s, %u samples/s, max %u sets/s\n\r",
+           adcscanGetADCs(&SCAN1), rate, rate * cfg.num_pins,
+           adcscanMaxRate(&SCAN1));
+  last = chVTGetSystemTimeX();
+
+  while (chnGetTimeout((BaseChannel *)chp, TIME_IMMEDIATE) == Q_TIMEOUT) {
+    adcs_block_t blk;
+
+    if (adcscanReadTimeout(&SCAN1, &blk, TIME_MS2I(100)) != MSG_OK) {
+      break;
+    }
+    frames++;
+    lost += blk.lost;
+
+    /* One set per frame is enough for the means.*/
+    for (i = 0; i < (int)cfg.num_pins; i++) {
+      sums[i] += blk.samples[i];
+    }
+    n++;
+
+    if (chVTTimeElapsedSinceX(last) >= TIME_MS2I(1000)) {
+      last = chVTGetSystemTimeX();
+      chprintf(chp, "frames %u lost %u |", frames, lost);
+      for (i = 0; i < (int)cfg.num_pins; i++) {
+        chprintf(chp, " %4u", sums[i] / n);
+        sums[i] = 0U;
+      }
+      chprintf(chp, "\n\r");
+      n = 0U;
+    }
+  }
+
+  adcscanStop(&SCAN1);
+  adc_done();
+  chprintf(chp, "\n\rframes %u lost blocks %u\n\r", frames, lost);
+}
+
+
+/*
+ * Mixed-rate channels of ADC1 on the GPT4 trigger, see adcmix.h. The
+ * fastest target sets the trigger, 16 Hz at least with the 16-bit TIM4.
+ */
+#define MIX_BUF_DEPTH          128
+#define MIX_SMP                ADC_SMPR_SMP_24P5
+
+static ADCMixDriver MIX1;
+static adcsample_t mixbuf[ADCMIX_BUF_SIZE(MIX_BUF_DEPTH)];
+static adcsample_t mixout[ADCMIX_OUT_SIZE(MIX_BUF_DEPTH)];
+
+#define MIXPIN(in)                                                          \
+  {ADC_CHANNEL_##in, ADCGRP_PINID_(ADCGRP_ADC1_##in)}
+
+/* External channels of ADC1 but IN3 and IN4, on the shell USART pins. */
+static const struct {
+  uint8_t ch;
+  uint8_t pin;
+} mixpins[] = {
+  MIXPIN(IN1),  MIXPIN(IN2),  MIXPIN(IN5),  MIXPIN(IN6),  MIXPIN(IN7),
+  MIXPIN(IN8),  MIXPIN(IN9),  MIXPIN(IN10), MIXPIN(IN11), MIXPIN(IN12),
+  MIXPIN(IN14), MIXPIN(IN15)
+};
+
+/* Parses INx:rate_hz, returns the mixpins index or -1. */
+static int mix_channel(const char *arg, uint32_t *ratep) {
+  char *end;
+  unsigned long ch, rate;
+
+  if (strncmp(arg, "IN", 2) != 0) {
+    return -1;
+  }
+  ch = strtoul(arg + 2, &end, 10);
+  if (end == arg + 2 || *end != ':') {
+    return -1;
+  }
+  rate = strtoul(end + 1, &end, 10);
+  if (*end != '\0' || rate == 0U) {
+    return -1;
+  }
+  for (unsigned i = 0; i < sizeof(mixpins) / sizeof(mixpins[0]); i++) {
+    if (mixpins[i].ch == ch) {
+      *ratep = (uint32_t)rate;
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+/* Runs ADC1 channels at their own rates and prints them every second */
+static void cmd_mix(BaseSequentialStream *chp, int argc, char *argv[]) {
+  adcmix_channel_t chans[ADCMIX_MAX_CHANNELS];
+  uint32_t last[ADCMIX_MAX_CHANNELS], top = 0U;
+  uint8_t pins[ADCMIX_MAX_CHANNELS];
+  ADCMixConfig cfg = {
+    .adcp         = &ADCD1,
+    .errp         = &ERR1,
+    .channels     = chans,
+    .gptp         = &GPTD4,
+    .cfgr         = ADCGRP_TRIGGER(TIM4_TRGO),
+    .buf          = mixbuf,
+    .out          = mixout
+  };
+  size_t half;
+  systime_t start;
+  int i;
+
+  if (argc < 1 || argc > ADCMIX_MAX_CHANNELS) {
+    chprintf(chp, "Usage: mix INx:rate_hz [INx:rate_hz ...], e.g. mix "
+                  "IN1:40000 IN2:40000 IN6:100 IN7:10\n\r");
+    return;
+  }
+  for (i = 0; i < argc; i++) {
+    int p = mix_channel(argv[i], &chans[i].rate);
+
+    if (p < 0) {
+      chprintf(chp, "%s is not INx:rate_hz of ADC1, IN3 and IN4 are the "
+                    "shell\n\r", argv[i]);
+      return;
+    }
+    chans[i].entry = ADCGRP_CH(mixpins[p].ch, MIX_SMP);
+    pins[i] = (uint8_t)p;
+    if (chans[i].rate > top) {
+      top = chans[i].rate;
+    }
+  }
+  cfg.num_channels = (unsigned)argc;
+
+  /* The fastest rate sets the trigger.*/
+  if (rate_bad(chp, top, gpt4cfg.frequency)) {
+    return;
+  }
+  if (!adcmixPlan(&MIX1, &cfg)) {
+    chprintf(chp, "No plan, a channel is repeated\n\r");
+    return;
+  }
+  chprintf(chp, "trigger %u Hz, max %u Hz, rotation of %u frames of %u "
+                "ranks, %u conversions per trigger instead of %u\n\r",
+           gpt4cfg.frequency / adcmixGetInterval(&MIX1),
+           adcmixMaxRate(&MIX1), adcmixGetFrames(&MIX1),
+           adcmixGetWidth(&MIX1), adcmixGetWidth(&MIX1), cfg.num_channels);
+  for (i = 0; i < argc; i++) {
+    chprintf(chp, "IN%u target %u Hz: %u/%u frames, average %u, %.3f Hz\n\r",
+             ADCGRP_CHN(chans[i].entry), chans[i].rate,
+             adcmixGetConversions(&MIX1, i), adcmixGetFrames(&MIX1),
+             adcmixGetAverage(&MIX1, i),
+             (double)gpt4cfg.frequency / adcmixGetPeriod(&MIX1, i));
+    last[i] = 0U;
+  }
+
+  /* Blocks of about 50 ms.*/
+  half = (size_t)((uint64_t)gpt4cfg.frequency / 20U /
+                  ((uint64_t)adcmixGetInterval(&MIX1) * adcmixGetFrames(&MIX1)));
+  half = half < 1U ? 1U : half > MIX_BUF_DEPTH / 2U ? MIX_BUF_DEPTH / 2U : half;
+  cfg.depth = 2U * half;
+
+  if (adc_busy(chp)) {
+    return;
+  }
+
+  /* The pins change mode only once ADC1 is ours.*/
+  for (i = 0; i < argc; i++) {
+    palSetLineMode(PAL_LINE(scanports[mixpins[pins[i]].pin >> 4],
+                            mixpins[pins[i]].pin & 15U), PAL_MODE_INPUT_ANALOG);
+  }
+  if (!adcmixStart(&MIX1, &cfg)) {
+    adc_done();
+    chprintf(chp, "Frames too long for %u Hz\n\r",
+             gpt4cfg.frequency / adcmixGetInterval(&MIX1));
+    return;
+  }
+  start = chVTGetSystemTimeX();
+
+  while (chnGetTimeout((BaseChannel *)chp, TIME_IMMEDIATE) == Q_TIMEOUT) {
+    if (adcmixReadTimeout(&MIX1, TIME_MS2I(500)) != MSG_OK) {
+      break;
+    }
+    if (chVTTimeElapsedSinceX(start) < TIME_MS2I(1000)) {
+      continue;
+    }
+    start = chVTGetSystemTimeX();
+
+    /* Samples in the last second and the latest one of each channel.*/
+    chprintf(chp, "lost %u |", adcmixGetLost(&MIX1));
+    for (i = 0; i < argc; i++) {
+      const adcmix_output_t *op = adcmixGetOutput(&MIX1, i);
+      uint32_t n = adcmixGetSamples(&MIX1, i);
+
+      chprintf(chp, " IN%u %u/s %4u", ADCGRP_CHN(chans[i].entry),
+               n - last[i], op->n > 0U ? op->samples[op->n - 1U] : 0U);
+      last[i] = n;
+    }
+    chprintf(chp, "\n\r");
+  }
+
+  adcmixStop(&MIX1);
+  adc_done();
+  chprintf(chp, "\n\rlost blocks %u torn %u\n\r", adcmixGetLost(&MIX1),
+           adcmixGetTorn(&MIX1));
+}
+
+
+static const ShellCommand commands[] = {
+  {"stream", cmd_stream},
+  {"dsp", cmd_dsp},
+  {"decim", cmd_decim},
+  {"ovs", cmd_ovs},
+  {"awd", cmd_awd},
+  {"scope", cmd_scope},
+  {"stats", cmd_stats},
+  {"pool", cmd_pool},
+  {"spectrum", cmd_spectrum},
+  {"cal", cmd_cal},
+  {"tune", cmd_tune},
+  {"errors", cmd_errors},
+  {"capture", cmd_capture},
+  {"scan", cmd_scan},
+  {"mix", cmd_mix},
+  {NULL, NULL}
+};
+
+static const ShellConfig shell_cfg1 = {
+  (BaseSequentialStream *)&SD2,
+  commands
+};
+
+#define WA_SHELL   2048
+THD_WORKING_AREA( waShell, WA_SHELL );
+
+/*
+ * Application entry point.
+ */
+int main(void) {
+
+  halInit();
+  chSysInit();
+
+  /*
+   * Initializes a SERIAL driver.
+   */
+  palSetPadMode( GPIOA, 2, PAL_MODE_ALTERNATE(7) );
+  palSetPadMode( GPIOA, 3, PAL_MODE_ALTERNATE(7) );
+
+  /*
+   * Setting as analog input:
+   *    PORTA PIN 0 -> ADC1_CH1
+   *    PORTA PIN 1 -> ADC1_CH2
+   */
+  palSetLineMode( ADCGRP_LINE(1, IN1), PAL_MODE_INPUT_ANALOG );
+  palSetLineMode( ADCGRP_LINE(1, IN2), PAL_MODE_INPUT_ANALOG );
+
+  sdStart(&SD2, NULL);
+
+  /*
+   * Starting GPT4 and GPT6 drivers, they trigger the regular and the
+   * injected conversions of the ADC.
+   * Starting the ADC1 driver through the calibration service, the start
+   * runs the ADC self-calibration.
+   */
+  gptStart(&GPTD4, &gpt4cfg);
+  gptStart(&GPTD6, &gpt6cfg);
+  adcerrObjectInit(&ERR1, &ADCD1);
+  adccalObjectInit(&CAL1);
+  adccalStart(&CAL1, &ADCD1, NULL);
+
+  /*
+   * ADC2 to ADC4 for the parallel scan, the start runs their calibration.
+   */
+  adcStart(&ADCD2, NULL);
+  adcStart(&ADCD3, NULL);
+  adcStart(&ADCD4, NULL);
+
+  adcsObjectInit(&ADCS1);
+  adchkObjectInit(&HK1);
+  streamgrp = streamcfg;
+  adchkPatchGroup(&streamgrp);
+  adctuneTableInit(&TUNE1);
+  adcawdObjectInit(&AWD1);
+  adcpoolObjectInit(&POOL1);
+  adcpoolConsumerObjectInit(&ctrlcons);
+  adcpoolConsumerObjectInit(&logcons);
+  adcpoolRegister(&POOL1, &ctrlcons);
+  adcpoolRegister(&POOL1, &logcons);
+  adccapObjectInit(&CAP1);
+  adcscanObjectInit(&SCAN1);
+  adcmixObjectInit(&MIX1);
+
+  chThdCreateStatic(waCalib, sizeof(waCalib), NORMALPRIO + 1, thdCalib, NULL);
+
+  shellInit();
+
+  /*
+   * Create Shell Thread!
+   */
+  chThdCreateStatic(waShell, sizeof(waShell), NORMALPRIO, shellThread, (void *)&shell_cfg1);
+
+  while (true) {
+    chThdSleepMilliseconds(1000);
+  }
+}
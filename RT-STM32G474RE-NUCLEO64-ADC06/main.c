@@ -0,0 +1,199 @@
+/*
+    NeaPolis Innovation Summer Campus Examples
+    Copyright (C) 2020-2023 Salvatore Dello Iacono [delloiaconos@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * [ADC06] Using ADC Peripherals - Example 06
+ * Dual ADC regular simultaneous acquisition of the joystick axes.
+ *
+ * With STM32_ADC_DUAL_MODE set in mcuconf.h ADCD1 drives ADC1 as master and
+ * ADC2 as slave. On each TIM4 trigger both ADCs sample at the same clock
+ * edge, ADC1 the X axis and ADC2 the Y axis, so the two values have no
+ * skew. The common data register packs both results in one word, a single
+ * DMA transfer per pair: ADC1 in the low half, ADC2 in the high half.
+ */
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+
+BaseSequentialStream * chp = (BaseSequentialStream *) &SD2;
+
+/*
+ * GPT4 configuration. This timer is used as trigger for the ADC.
+ */
+
+const GPTConfig gpt4cfg = {
+  .frequency    =  1000000U,
+  .callback     =  NULL,
+  .cr2          =  TIM_CR2_MMS_1,   /* MMS = 010 = TRGO on Update Event.    */
+  .dier         =  0U
+};
+
+/* Trigger period in GPT4 ticks, 10 kHz pair rate.*/
+#define ADC_TRIGGER_INTERVAL        100
+
+/*
+ * In dual mode num_channels counts the channels of both ADCs and the
+ * buffer is filled with one 32-bit word per pair.
+ */
+#define ADC_GRP_NUM_CHANNELS        2
+#define ADC_GRP_BUF_DEPTH           1000
+#define ADC_GRP_HALF_DEPTH          (ADC_GRP_BUF_DEPTH / 2)
+
+/* Unpacking of a CDR word.*/
+#define PAIR_MASTER(w)              ((adcsample_t)((w) & 0xFFFFU))
+#define PAIR_SLAVE(w)               ((adcsample_t)((w) >> 16))
+
+static uint32_t pairs[ADC_GRP_BUF_DEPTH];
+
+static uint32_t sumX, sumY, count, errors;
+
+static void adccallback(ADCDriver *adcp) {
+  const uint32_t *p = pairs;
+  uint32_t x = 0U, y = 0U;
+  int i;
+
+  palToggleLine( LINE_LED_GREEN );
+
+  if (adcIsBufferComplete(adcp)) {
+    p += ADC_GRP_HALF_DEPTH;
+  }
+
+  for( i = 0; i < ADC_GRP_HALF_DEPTH; i++ ) {
+    x += PAIR_MASTER( p[i] );
+    y += PAIR_SLAVE( p[i] );
+  }
+
+  sumX += x;
+  sumY += y;
+  count += ADC_GRP_HALF_DEPTH;
+}
+
+static void adcerrorcallback(ADCDriver *adcp, adcerror_t err) {
+  (void)adcp;
+  (void)err;
+  errors++;
+}
+
+/*
+ * Both ADCs must use the same sampling time, the sequences run in lockstep.
+ */
+const ADCConversionGroup adcgrpcfg = {
+  .circular     = true,
+  .num_channels = ADC_GRP_NUM_CHANNELS,
+  .end_cb       = adccallback,
+  .error_cb     = adcerrorcallback,
+  .cfgr         = ADC_CFGR_EXTEN_RISING |
+                  ADC_CFGR_EXTSEL_SRC(12),  /* TIM4_TRGO */
+  .cfgr2        = 0U,
+  .ccr          = ADC_CCR_DUAL_2 | ADC_CCR_DUAL_1,  /* Regular simultaneous.*/
+  .tr1          = ADC_TR_DISABLED,
+  .tr2          = ADC_TR_DISABLED,
+  .tr3          = ADC_TR_DISABLED,
+  .awd2cr       = 0U,
+  .awd3cr       = 0U,
+  .smpr         = {
+    ADC_SMPR1_SMP_AN7(ADC_SMPR_SMP_47P5),
+    0U
+  },
+  .sqr          = {
+    ADC_SQR1_SQ1_N(ADC_CHANNEL_IN7),
+    0U,
+    0U,
+    0U
+  },
+  .ssmpr        = {
+    ADC_SMPR1_SMP_AN8(ADC_SMPR_SMP_47P5),
+    0U
+  },
+  .ssqr         = {
+    ADC_SQR1_SQ1_N(ADC_CHANNEL_IN8),
+    0U,
+    0U,
+    0U
+  }
+};
+
+static THD_WORKING_AREA( waAdc, 256 );
+static THD_FUNCTION( thdAdc, arg ) {
+  (void) arg;
+
+  /*
+   * Setting as analog input:
+   *    PORTC PIN 1 -> ADC1_IN7 (joystick X)
+   *    PORTC PIN 2 -> ADC2_IN8 (joystick Y)
+   */
+  palSetPadMode( GPIOC, 1, PAL_MODE_INPUT_ANALOG );
+  palSetPadMode( GPIOC, 2, PAL_MODE_INPUT_ANALOG );
+
+  gptStart(&GPTD4, &gpt4cfg);
+  adcStart(&ADCD1, NULL);
+
+  adcStartConversion(&ADCD1, &adcgrpcfg, (adcsample_t *) pairs,
+                     ADC_GRP_BUF_DEPTH);
+  gptStartContinuous(&GPTD4, ADC_TRIGGER_INTERVAL);
+
+  while( true ) {
+    uint32_t x, y, n, e;
+
+    chThdSleepMilliseconds(1000);
+
+    /*
+     * Taking a snapshot of the accumulators, the callback runs in ISR.
+     */
+    chSysLock();
+    x = sumX;
+    y = sumY;
+    n = count;
+    e = errors;
+    sumX = sumY = count = 0U;
+    chSysUnlock();
+
+    if( n == 0U ) {
+      chprintf( chp, "No conversions, errors = %u\r\n", e );
+      continue;
+    }
+
+    chprintf( chp, "Pairs/s = %u\r\n", n );
+    chprintf( chp, "X channel = %u %%\r\n", (x / n) * 100U / 4096U );
+    chprintf( chp, "Y channel = %u %%\r\n", (y / n) * 100U / 4096U );
+    if( e != 0U ) {
+      chprintf( chp, "Errors = %u\r\n", e );
+    }
+  }
+}
+
+/*
+ * Application entry point.
+ */
+int main(void) {
+
+  halInit();
+  chSysInit();
+
+  /*
+   * Activates the serial driver 2 using the A2 and A3 pins.
+   */
+  palSetPadMode( GPIOA, 2, PAL_MODE_ALTERNATE(7) );
+  palSetPadMode( GPIOA, 3, PAL_MODE_ALTERNATE(7) );
+
+  sdStart( &SD2, NULL );
+
+  chThdCreateStatic( waAdc, sizeof( waAdc ), NORMALPRIO + 5, thdAdc, (void*) NULL );
+
+  while (true) {
+    chThdSleepMilliseconds(500);
+  }
+
+}
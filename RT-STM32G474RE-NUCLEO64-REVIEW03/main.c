@@ -44,6 +44,8 @@ int num_conversions;
 const GPTConfig gpt4cfg = {
   .frequency    =  1000000U,
   .callback     =  NULL,
+  .cr2          =  TIM_CR2_MMS_1,   /* MMS = 010 = TRGO on Update Event.    */
+  .dier         =  0U
 };
 
 static void endcallback(ADCDriver *adcp) {
@@ -52,59 +54,48 @@ static void endcallback(ADCDriver *adcp) {
   }
 }
 
+/*
+ * Fields shared by the linear and circular groups: one channel, ADC12_IN7.
+ */
+#define ADC_GRP_COMMON                                                      \
+          .num_channels = ADC_GRP_NUM_CHANNELS,                             \
+          .error_cb     = NULL,                                             \
+          .cfgr2        = 0U,                                               \
+          .tr1          = ADC_TR_DISABLED,                                  \
+          .tr2          = ADC_TR_DISABLED,                                  \
+          .tr3          = ADC_TR_DISABLED,                                  \
+          .awd2cr       = 0U,                                               \
+          .awd3cr       = 0U,                                               \
+          .smpr         = {                                                 \
+            ADC_SMPR1_SMP_AN7(ADC_SMPR_SMP_247P5),                          \
+            0U                                                              \
+          },                                                                \
+          .sqr          = {                                                 \
+            ADC_SQR1_SQ1_N(ADC_CHANNEL_IN7),                                \
+            0U,                                                             \
+            0U,                                                             \
+            0U                                                              \
+          }
+
 /*
  * ADC Linear Conversion group
  */
 static const ADCConversionGroup linearcfg = {
           .circular     = false,
-          .num_channels = ADC_GRP_NUM_CHANNELS,
           .end_cb       = NULL,
-          .error_cb     = NULL,
           .cfgr         = ADC_CFGR_CONT,
-          .cfgr2        = 0U,
-          .tr1          = ADC_TR_DISABLED,
-          .tr2          = ADC_TR_DISABLED,
-          .tr3          = ADC_TR_DISABLED,
-          .awd2cr       = 0U,
-          .awd3cr       = 0U,
-          .smpr         = {
-            ADC_SMPR1_SMP_AN7(ADC_SMPR_SMP_247P5),
-            0U
-          },
-          .sqr          = {
-            ADC_SQR1_SQ1_N(ADC_CHANNEL_IN7),
-            0U,
-            0U,
-            0U
-          }
+          ADC_GRP_COMMON
         };
 /*
- * ADC Circular Conversion group
+ * ADC Circular Conversion group, one conversion per GPT4 period. CONT must
+ * stay clear or the first trigger starts a free-running conversion.
  */
 const ADCConversionGroup circularcfg = {
           .circular     = true,
-          .num_channels = ADC_GRP_NUM_CHANNELS,
           .end_cb       = endcallback,
-          .error_cb     = NULL,
-          .cfgr         = ADC_CFGR_CONT |
-                          ADC_CFGR_EXTEN_RISING |
+          .cfgr         = ADC_CFGR_EXTEN_RISING |
                           ADC_CFGR_EXTSEL_SRC(12),  /* TIM4_TRGO */
-          .cfgr2        = 0U,
-          .tr1          = ADC_TR_DISABLED,
-          .tr2          = ADC_TR_DISABLED,
-          .tr3          = ADC_TR_DISABLED,
-          .awd2cr       = 0U,
-          .awd3cr       = 0U,
-          .smpr         = {
-            ADC_SMPR1_SMP_AN7(ADC_SMPR_SMP_247P5),
-            0U
-          },
-          .sqr          = {
-            ADC_SQR1_SQ1_N(ADC_CHANNEL_IN7),
-            0U,
-            0U,
-            0U
-          }
+          ADC_GRP_COMMON
         };
 
 
@@ -0,0 +1,9 @@
+/* Generated by fontsubset.py, do not edit. */
+#ifndef __SSD1306_FONT_11X18_NISC_H__
+#define __SSD1306_FONT_11X18_NISC_H__
+
+#include "ssd1306.h"
+
+extern const ssd1306_font_t ssd1306_font_11x18_nisc;
+
+#endif /* __SSD1306_FONT_11X18_NISC_H__ */
@@ -27,6 +27,7 @@
 #include "chprintf.h"
 
 #include "ssd1306.h"
+#include "font_subset.h"
 #include "stdio.h"
 
 #define BUFF_SIZE   20
@@ -43,6 +44,7 @@ static const SSD1306Config ssd1306cfg = {
   &I2CD1,
   &i2ccfg,
   SSD1306_SAD_0X78,
+  true,           /* First frame follows immediately, skip the clear.     */
 };
 
 static SSD1306Driver SSD1306D1;
@@ -62,7 +64,11 @@ static THD_FUNCTION(OledDisplay, arg) {
    * Start the SSD1306 Display Driver Object with
    * configuration.
    */
-  ssd1306Start(&SSD1306D1, &ssd1306cfg);
+  if (ssd1306Start(&SSD1306D1, &ssd1306cfg) != MSG_OK) {
+    /* No panel answered: the green LED stays on and nothing is drawn. */
+    palSetLine(LINE_LED_GREEN);
+    return;
+  }
 
   ssd1306FillScreen(&SSD1306D1, 0x00);
 
@@ -70,12 +76,21 @@ static THD_FUNCTION(OledDisplay, arg) {
 
     ssd1306GotoXy(&SSD1306D1, 0, 1);
     chsnprintf(buff, BUFF_SIZE, "NeaPolis");
-    ssd1306Puts(&SSD1306D1, buff, &ssd1306_font_11x18, SSD1306_COLOR_WHITE);
+    ssd1306Puts(&SSD1306D1, buff, &ssd1306_font_11x18_nisc, SSD1306_COLOR_WHITE);
 
     ssd1306GotoXy(&SSD1306D1, 0, 20);
     chsnprintf(buff, BUFF_SIZE, "Innovation");
     ssd1306Puts(&SSD1306D1, buff, &ssd1306_font_7x10, SSD1306_COLOR_BLACK);
 
+    /*
+     * Time from ssd1306Start() to the first frame on the panel. With
+     * skipclear that frame is this one, so the first pass shows 0.
+     */
+    ssd1306GotoXy(&SSD1306D1, 0, 50);
+    chsnprintf(buff, BUFF_SIZE, "Start %u us",
+               (unsigned)TIME_I2US(ssd1306GetStartupTime(&SSD1306D1)));
+    ssd1306Puts(&SSD1306D1, buff, &ssd1306_font_7x10, SSD1306_COLOR_WHITE);
+
     ssd1306UpdateScreen(&SSD1306D1);
     chThdSleepMilliseconds(500);
   }
@@ -108,7 +123,7 @@ int main(void) {
       flag = 1;
     }
 
-    if (flag == 1) {
+    if (flag == 1 && ssd1306GetState(&SSD1306D1) == SSD1306_READY) {
       ssd1306GotoXy(&SSD1306D1, 0, 36);
       chsnprintf(buff, BUFF_SIZE, "2020");
       ssd1306Puts(&SSD1306D1, buff, &ssd1306_font_7x10, SSD1306_COLOR_WHITE);
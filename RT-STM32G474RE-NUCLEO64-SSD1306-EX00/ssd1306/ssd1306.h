@@ -4,6 +4,32 @@
 
 #include "hal.h"
 
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Maximum time ssd1306Start() waits for the panel to ACK, in ms.
+ */
+#if !defined(SSD1306_START_TIMEOUT_MS)
+#define SSD1306_START_TIMEOUT_MS        100
+#endif
+
+/**
+ * @brief   Delay between two consecutive ACK polls at start-up, in ms.
+ */
+#if !defined(SSD1306_POLL_INTERVAL_MS)
+#define SSD1306_POLL_INTERVAL_MS        1
+#endif
+
+/**
+ * @brief   Enables the 4-level temporal-dithering grayscale mode.
+ * @note    Adds a second framebuffer plane to the driver object.
+ */
+#if !defined(SSD1306_USE_GRAYSCALE)
+#define SSD1306_USE_GRAYSCALE           FALSE
+#endif
+
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
@@ -12,24 +38,74 @@
 #error "SSD1306 requires HAL_USE_I2C"
 #endif
 
+#if SSD1306_USE_GRAYSCALE && !CH_CFG_USE_SEMAPHORES
+#error "SSD1306_USE_GRAYSCALE requires CH_CFG_USE_SEMAPHORES"
+#endif
+
 #define SSD1306_WIDTH                   128
 #define SSD1306_HEIGHT                  64
 #define SSD1306_WIDTH_FIXED             (SSD1306_WIDTH + 1)
+#define SSD1306_FB_STRIDE               (SSD1306_WIDTH + 4)
+#define SSD1306_FB_SIZE                 (SSD1306_FB_STRIDE * SSD1306_HEIGHT / 8)
 
 
 /*===========================================================================*/
 /* Driver data structures and types.                                         */
 /*===========================================================================*/
 
+/*
+ * Colors double as blend modes: black clears, white sets and invert
+ * toggles the pixels touched by a primitive. Each primitive touches its
+ * pixels once, so drawing it twice in invert restores the screen.
+ */
 typedef enum {
     SSD1306_COLOR_BLACK = 0x00,
-    SSD1306_COLOR_WHITE = 0x01
+    SSD1306_COLOR_WHITE = 0x01,
+    SSD1306_COLOR_INVERT = 0x02
 } ssd1306_color_t;
 
+/* Raster operations between a page area and an 8-pixel column pattern. */
+typedef enum {
+    SSD1306_ROP_COPY = 0x00,
+    SSD1306_ROP_AND = 0x01,
+    SSD1306_ROP_OR = 0x02,
+    SSD1306_ROP_XOR = 0x03
+} ssd1306_rop_t;
+
+typedef enum {
+    SSD1306_FADE_OFF = 0x00,
+    SSD1306_FADE_OUT = 0x20,
+    SSD1306_FADE_BLINK = 0x30
+} ssd1306_fade_t;
+
+typedef enum {
+    SSD1306_GRAY_BLACK = 0x00,
+    SSD1306_GRAY_DARK = 0x01,
+    SSD1306_GRAY_LIGHT = 0x02,
+    SSD1306_GRAY_WHITE = 0x03
+} ssd1306_gray_t;
+
+/*
+ * Grayscale renderer figures. Flush times are in realtime counter cycles:
+ * the achievable subframe rate is STM32_SYSCLK / flushmax and a gray frame
+ * takes three subframes. The cpu field is the part of the last flush not
+ * spent waiting for I2C transfers.
+ */
+typedef struct {
+    uint32_t subframes;
+    uint32_t missed;
+    uint8_t pages;
+    rtcnt_t flush;
+    rtcnt_t flushmax;
+    rtcnt_t cpu;
+} ssd1306_gray_stats_t;
+
 typedef struct {
     uint8_t fw;
     uint8_t fh;
     const uint16_t *dt;
+    /* Subset fonts only: ASCII 32..126 to glyph index, 0xFF if missing. */
+    const uint8_t *map;
 } ssd1306_font_t;
 
 typedef enum {
@@ -48,6 +124,8 @@ typedef struct {
     const I2CConfig *i2ccfg;
 
     ssd1306_sad_t sad;
+    /* Leave GDDRAM untouched at start-up, the first frame will overwrite it. */
+    bool skipclear;
 } SSD1306Config;
 
 #define _ssd1306_methods \
@@ -65,7 +143,13 @@ typedef struct {
     void (*drawTriFill)(void *ip, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t x3, uint16_t y3, ssd1306_color_t color); \
     void (*drawCircle)(void *ip, int16_t x0, int16_t y0, int16_t r, ssd1306_color_t color); \
     void (*drawCircleFill)(void *ip, int16_t x0, int16_t y0, int16_t r, ssd1306_color_t color); \
-    void (*setDisplay)(void *ip, uint8_t on);
+    void (*setDisplay)(void *ip, uint8_t on); \
+    void (*setInvert)(void *ip, uint8_t on); \
+    void (*setFlip)(void *ip, uint8_t hflip, uint8_t vflip); \
+    void (*setContrast)(void *ip, uint8_t level); \
+    void (*setZoom)(void *ip, uint8_t on); \
+    void (*setFade)(void *ip, ssd1306_fade_t mode, uint8_t interval); \
+    void (*rasterOp)(void *ip, uint8_t x, uint8_t page, uint8_t w, uint8_t npages, ssd1306_rop_t rop, uint8_t pattern);
 
 struct SSD1306VMT {
     _ssd1306_methods
@@ -82,7 +166,34 @@ typedef struct SSD1306Driver {
     uint8_t x;
     uint8_t y;
     uint8_t inv;
-    uint8_t fb[SSD1306_WIDTH_FIXED * SSD1306_HEIGHT / 8];
+    /* Time from ssd1306Start() to the end of the first frame upload, 0
+       until that upload is done: with skipclear it is the first update. */
+    systime_t tstart;
+    sysinterval_t startup;
+    bool startpending;
+    /* Page rows are word aligned for the raster operations. */
+    union {
+        uint32_t fbw[SSD1306_FB_SIZE / 4];
+        uint8_t fb[SSD1306_FB_SIZE];
+    };
+#if SSD1306_USE_GRAYSCALE
+    /* Low weight plane, fb is shown twice as long as gfb. */
+    union {
+        uint32_t gfbw[SSD1306_FB_SIZE / 4];
+        uint8_t gfb[SSD1306_FB_SIZE];
+    };
+    /* Pages touched since the last subframe and pages holding gray. */
+    uint8_t gdirty;
+    uint8_t gmask;
+    uint8_t gsub;
+    bool gray;
+    sysinterval_t gperiod;
+    virtual_timer_t gvt;
+    binary_semaphore_t gsem;
+    /* Held while a subframe or the final frame goes out. */
+    binary_semaphore_t glock;
+    ssd1306_gray_stats_t gstats;
+#endif
 } SSD1306Driver;
 
 /*===========================================================================*/
@@ -134,6 +245,42 @@ typedef struct SSD1306Driver {
 #define ssd1306SetDisplay(ip, on) \
     (ip)->vmt->setDisplay(ip, on)
 
+/*
+ * The following operations are executed by the controller itself: each one
+ * costs a single command transaction and leaves the framebuffer untouched.
+ */
+#define ssd1306SetInvert(ip, on) \
+    (ip)->vmt->setInvert(ip, on)
+
+/* Vertical flip is immediate, horizontal flip applies to the next update. */
+#define ssd1306SetFlip(ip, hflip, vflip) \
+    (ip)->vmt->setFlip(ip, hflip, vflip)
+
+#define ssd1306SetContrast(ip, level) \
+    (ip)->vmt->setContrast(ip, level)
+
+#define ssd1306SetZoom(ip, on) \
+    (ip)->vmt->setZoom(ip, on)
+
+/* Interval is 0..15, one step every 8 frames. */
+#define ssd1306SetFade(ip, mode, interval) \
+    (ip)->vmt->setFade(ip, mode, interval)
+
+/* Word-wide operation on w columns of npages page rows starting at x, page. */
+#define ssd1306RasterOp(ip, x, page, w, npages, rop, pattern) \
+    (ip)->vmt->rasterOp(ip, x, page, w, npages, rop, pattern)
+
+#define ssd1306GetState(ip) \
+    ((ip)->state)
+
+#define ssd1306GetStartupTime(ip) \
+    ((ip)->startup)
+
+#if SSD1306_USE_GRAYSCALE
+#define ssd1306GrayGetStats(ip) \
+    (&(ip)->gstats)
+#endif
+
 /*===========================================================================*/
 /* External declarations.                                                    */
 /*===========================================================================*/
@@ -146,8 +293,15 @@ extern const ssd1306_font_t ssd1306_font_7x10;
 extern const ssd1306_font_t ssd1306_font_11x18;
 
 void ssd1306ObjectInit(SSD1306Driver *devp);
-void ssd1306Start(SSD1306Driver *devp, const SSD1306Config *config);
+msg_t ssd1306Start(SSD1306Driver *devp, const SSD1306Config *config);
 void ssd1306Stop(SSD1306Driver *devp);
+#if SSD1306_USE_GRAYSCALE
+void ssd1306DrawPixelGray(SSD1306Driver *devp, uint8_t x, uint8_t y,
+                          ssd1306_gray_t level);
+void ssd1306GrayStart(SSD1306Driver *devp, sysinterval_t period);
+void ssd1306GrayStop(SSD1306Driver *devp);
+msg_t ssd1306GrayRender(SSD1306Driver *devp);
+#endif
 
 #ifdef __cplusplus
 }
@@ -2,7 +2,9 @@
 SSD1306PATH = ./ssd1306
 
 # RT Shell files.
-SSD1306SRC = $(SSD1306PATH)/ssd1306.c
+SSD1306SRC = $(SSD1306PATH)/ssd1306.c \
+             $(SSD1306PATH)/ssd1306_font.c \
+             $(SSD1306PATH)/ssd1306_font_7_10.c
 
 SSD1306INC = $(SSD1306PATH)
 
@@ -101,7 +101,15 @@ static THD_FUNCTION(thdOledDisplay, arg) {
 
 
 
-  ssd1306Start(&SSD1306D1, &ssd1306cfg);
+  if (ssd1306Start(&SSD1306D1, &ssd1306cfg) != MSG_OK) {
+
+    /* No panel answered: the green LED stays on and nothing is drawn. */
+
+    palSetLine(LINE_LED_GREEN);
+
+    return;
+
+  }
 
 
 
@@ -177,7 +185,9 @@ int main(void) {
 
 
 
-    if(palReadLine(LINE_BUTTON) == PAL_LOW) {
+    if(palReadLine(LINE_BUTTON) == PAL_LOW &&
+
+       ssd1306GetState(&SSD1306D1) == SSD1306_READY) {
 
       while(palReadLine(LINE_BUTTON) == PAL_LOW){
 
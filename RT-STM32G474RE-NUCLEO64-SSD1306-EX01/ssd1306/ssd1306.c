@@ -1,11 +1,18 @@
 #include <string.h>
 #include "hal.h"
 #include "ssd1306.h"
-#include "ssd1306_font.c"
-#include "ssd1306_font_7_10.c"
 
 #define ABS(x)   ((x) > 0 ? (x) : -(x))
 
+/*
+ * Framebuffer page rows are SSD1306_FB_STRIDE bytes long: three padding
+ * bytes, the I2C data control byte and 128 word-aligned data bytes. Rows
+ * are sent to the panel starting from the control byte.
+ */
+#define FB_XFER(page)       ((page) * SSD1306_FB_STRIDE + 3)
+#define FB_DATA(page)       ((page) * SSD1306_FB_STRIDE + 4)
+#define FB_ROW(fbw, page)   (&(fbw)[FB_DATA(page) / 4])
+
 /*===========================================================================*/
 /* Driver local functions.                                                   */
 /*===========================================================================*/
@@ -26,7 +33,8 @@ static msg_t wrCmd(void *ip, uint8_t cmd) {
   return ret;
 }
 
-static msg_t wrDat(void *ip, uint8_t *txbuf, uint16_t len) {
+static msg_t wrDatTimeout(void *ip, const uint8_t *txbuf, uint16_t len,
+                          sysinterval_t timeout) {
   const SSD1306Driver *drvp = (const SSD1306Driver *)ip;
   msg_t ret;
 
@@ -34,68 +42,224 @@ static msg_t wrDat(void *ip, uint8_t *txbuf, uint16_t len) {
   i2cStart(drvp->config->i2cp, drvp->config->i2ccfg);
 
   ret = i2cMasterTransmitTimeout(drvp->config->i2cp, drvp->config->sad,
-                                 txbuf, len, NULL, 0, TIME_INFINITE);
+                                 txbuf, len, NULL, 0, timeout);
 
   i2cReleaseBus(drvp->config->i2cp);
 
   return ret;
 }
 
+static msg_t wrDat(void *ip, const uint8_t *txbuf, uint16_t len) {
+  return wrDatTimeout(ip, txbuf, len, TIME_INFINITE);
+}
+
+static msg_t waitAck(void *ip) {
+  // Control byte 0x00 followed by a NOP, harmless if the panel is already on
+  static const uint8_t nop[] = { 0x00, 0xE3 };
+  systime_t start = chVTGetSystemTimeX();
+  msg_t ret;
+
+  while (true) {
+    ret = wrDatTimeout(ip, nop, sizeof(nop),
+                       TIME_MS2I(SSD1306_POLL_INTERVAL_MS + 1));
+    if (ret == MSG_OK) {
+      return MSG_OK;
+    }
+    if (chTimeDiffX(start, chVTGetSystemTimeX()) >=
+        TIME_MS2I(SSD1306_START_TIMEOUT_MS)) {
+      return MSG_TIMEOUT;
+    }
+    chThdSleepMilliseconds(SSD1306_POLL_INTERVAL_MS);
+  }
+}
+
+// Ends the start-up time at the first frame upload after ssd1306Start()
+static void startDone(SSD1306Driver *drvp) {
+
+  if (drvp->startpending) {
+    drvp->startup = chTimeDiffX(drvp->tstart, chVTGetSystemTimeX());
+    drvp->startpending = false;
+  }
+}
+
 static void updateScreen(void *ip) {
   SSD1306Driver *drvp = (SSD1306Driver *)ip;
+  // Column window 0-127, page window 0-7, as a single command stream
+  static const uint8_t window[] = { 0x00, 0x21, 0x00, 0x7F, 0x22, 0x00, 0x07 };
   uint8_t idx;
 
-  for (idx = 0; idx < 8; idx++) {
-    wrCmd(drvp, 0xB0 + idx);
-    wrCmd(drvp, 0x00);
-    wrCmd(drvp, 0x10);
+  wrDat(drvp, window, sizeof(window));
 
-    // Write multi data
-    wrDat(drvp, &drvp->fb[SSD1306_WIDTH_FIXED * idx], SSD1306_WIDTH_FIXED);
+  // Horizontal addressing: pages follow one another without re-addressing
+  for (idx = 0; idx < 8; idx++) {
+    wrDat(drvp, &drvp->fb[FB_XFER(idx)], SSD1306_WIDTH_FIXED);
   }
+  startDone(drvp);
+}
+
+static msg_t wrCmdArg(void *ip, uint8_t cmd, uint8_t arg) {
+  const uint8_t txbuf[] = { 0x00, cmd, arg };
+
+  return wrDat(ip, txbuf, sizeof(txbuf));
+}
+
+static void setInvert(void *ip, uint8_t on) {
+  SSD1306Driver *drvp = (SSD1306Driver *)ip;
+
+  // Inverse display is done by the controller, GDDRAM stays as it is
+  drvp->inv = on ? 1 : 0;
+  wrCmd(drvp, drvp->inv ? 0xA7 : 0xA6);
 }
 
 static void toggleInvert(void *ip) {
   SSD1306Driver *drvp = (SSD1306Driver *)ip;
-  uint16_t idx;
 
-  // Toggle invert
-  drvp->inv = !drvp->inv;
+  setInvert(drvp, !drvp->inv);
+}
+
+/*
+ * Span operations on columns x0..x1 of a page row: head and tail bytes
+ * are handled one by one, the aligned middle one word at a time. There is
+ * one function per operation so that no mode is checked inside the loops.
+ */
+typedef void (*spanop_t)(uint32_t *row, uint8_t x0, uint8_t x1, uint8_t pat);
+
+#define SPAN_OP(name, op)                                                   \
+static void name(uint32_t *row, uint8_t x0, uint8_t x1, uint8_t pat) {      \
+  uint8_t *b = (uint8_t *)row;                                              \
+  uint32_t w = pat * 0x01010101U;                                           \
+  uint8_t x = x0;                                                           \
+                                                                            \
+  for (; x <= x1 && (x & 3) != 0; x++) {                                    \
+    b[x] op pat;                                                            \
+  }                                                                         \
+  for (; x + 3 <= x1; x += 4) {                                             \
+    row[x / 4] op w;                                                        \
+  }                                                                         \
+  for (; x <= x1; x++) {                                                    \
+    b[x] op pat;                                                            \
+  }                                                                         \
+}
+
+SPAN_OP(spanCopy, =)
+SPAN_OP(spanAnd, &=)
+SPAN_OP(spanOr, |=)
+SPAN_OP(spanXor, ^=)
+
+// Indexed by ssd1306_rop_t
+static const spanop_t ropops[] = { spanCopy, spanAnd, spanOr, spanXor };
+
+static void applySpan(SSD1306Driver *drvp, spanop_t op, uint8_t page,
+                      uint8_t x0, uint8_t x1, uint8_t pat) {
+  op(FB_ROW(drvp->fbw, page), x0, x1, pat);
+#if SSD1306_USE_GRAYSCALE
+  op(FB_ROW(drvp->gfbw, page), x0, x1, pat);
+  drvp->gdirty |= 1 << page;
+#endif
+}
 
-  for (idx = 0; idx < sizeof(drvp->fb); idx++) {
-    if (idx % SSD1306_WIDTH_FIXED == 0) continue;
-    drvp->fb[idx] = ~drvp->fb[idx];
+/*
+ * Applies a blend mode to the clipped rectangle x0..x1, y0..y1 (inclusive)
+ * with one span per page, each span carrying the mask of the covered rows.
+ */
+static void fillArea(SSD1306Driver *drvp, ssd1306_color_t color,
+                     int16_t x0, int16_t y0, int16_t x1, int16_t y1) {
+  uint8_t page, mask;
+  int16_t top, bot;
+
+  if (x0 < 0) x0 = 0;
+  if (y0 < 0) y0 = 0;
+  if (x1 >= SSD1306_WIDTH) x1 = SSD1306_WIDTH - 1;
+  if (y1 >= SSD1306_HEIGHT) y1 = SSD1306_HEIGHT - 1;
+  if (x0 > x1 || y0 > y1) return;
+
+  for (page = y0 / 8; page <= y1 / 8; page++) {
+    top = (page * 8 > y0) ? 0 : y0 % 8;
+    bot = (page * 8 + 7 < y1) ? 7 : y1 % 8;
+    mask = (uint8_t)((0xFF << top) & (0xFF >> (7 - bot)));
+
+    switch (color) {
+    case SSD1306_COLOR_BLACK:
+      applySpan(drvp, spanAnd, page, x0, x1, (uint8_t)~mask);
+      break;
+    case SSD1306_COLOR_WHITE:
+      applySpan(drvp, spanOr, page, x0, x1, mask);
+      break;
+    default:
+      applySpan(drvp, spanXor, page, x0, x1, mask);
+      break;
+    }
   }
 }
 
+/*
+ * Single pixel operations, the blend mode is resolved once per primitive.
+ */
+typedef void (*pixelop_t)(uint8_t *fb, uint16_t idx, uint8_t mask);
+
+static void pxClear(uint8_t *fb, uint16_t idx, uint8_t mask) {
+  fb[idx] &= ~mask;
+}
+
+static void pxSet(uint8_t *fb, uint16_t idx, uint8_t mask) {
+  fb[idx] |= mask;
+}
+
+static void pxInvert(uint8_t *fb, uint16_t idx, uint8_t mask) {
+  fb[idx] ^= mask;
+}
+
+// Indexed by ssd1306_color_t
+static const pixelop_t pixelops[] = { pxClear, pxSet, pxInvert };
+
+static inline void plot(SSD1306Driver *drvp, pixelop_t op,
+                        uint16_t x, uint16_t y) {
+  uint16_t idx;
+
+  if (x >= SSD1306_WIDTH || y >= SSD1306_HEIGHT) return;
+
+  idx = FB_DATA(y / 8) + x;
+  op(drvp->fb, idx, 1 << (y % 8));
+#if SSD1306_USE_GRAYSCALE
+  op(drvp->gfb, idx, 1 << (y % 8));
+  drvp->gdirty |= 1 << (y / 8);
+#endif
+}
+
 static void fillScreen(void *ip, ssd1306_color_t color) {
   SSD1306Driver *drvp = (SSD1306Driver *)ip;
   uint8_t idx;
 
   for (idx = 0; idx < 8; idx++) {
-    drvp->fb[SSD1306_WIDTH_FIXED * idx] = 0x40;
-    memset(&drvp->fb[SSD1306_WIDTH_FIXED * idx + 1],
-           color == SSD1306_COLOR_BLACK ? 0x00 : 0xff, SSD1306_WIDTH);
+    drvp->fb[FB_XFER(idx)] = 0x40;
+#if SSD1306_USE_GRAYSCALE
+    drvp->gfb[FB_XFER(idx)] = 0x40;
+#endif
   }
+
+  fillArea(drvp, color, 0, 0, SSD1306_WIDTH - 1, SSD1306_HEIGHT - 1);
 }
 
-static void drawPixel(void *ip, uint8_t x, uint8_t y, ssd1306_color_t color) {
+static void rasterOp(void *ip, uint8_t x, uint8_t page, uint8_t w,
+                     uint8_t npages, ssd1306_rop_t rop, uint8_t pattern) {
   SSD1306Driver *drvp = (SSD1306Driver *)ip;
-  if (x > SSD1306_WIDTH || y > SSD1306_HEIGHT) return;
+  spanop_t op = ropops[rop];
+  uint8_t x1;
 
-  // Check if pixels are inverted
-  if (drvp->inv) {
-    color = (ssd1306_color_t)!color;
-  }
+  if (x >= SSD1306_WIDTH || page >= 8 || w == 0 || npages == 0) return;
 
-  // Set color
-  if (color == SSD1306_COLOR_WHITE) {
-    drvp->fb[x + (y / 8) * SSD1306_WIDTH_FIXED + 1] |= 1 << (y % 8);
-  } else {
-    drvp->fb[x + (y / 8) * SSD1306_WIDTH_FIXED + 1] &= ~(1 << (y % 8));
+  x1 = (x + w > SSD1306_WIDTH) ? SSD1306_WIDTH - 1 : x + w - 1;
+  if (page + npages > 8) npages = 8 - page;
+
+  while (npages-- > 0) {
+    applySpan(drvp, op, page++, x, x1, pattern);
   }
 }
 
+static void drawPixel(void *ip, uint8_t x, uint8_t y, ssd1306_color_t color) {
+  plot((SSD1306Driver *)ip, pixelops[color], x, y);
+}
+
 static void gotoXy(void *ip, uint8_t x, uint8_t y) {
   SSD1306Driver *drvp = (SSD1306Driver *)ip;
 
@@ -105,7 +269,10 @@ static void gotoXy(void *ip, uint8_t x, uint8_t y) {
 
 static char PUTC(void *ip, char ch, const ssd1306_font_t *font, ssd1306_color_t color) {
   SSD1306Driver *drvp = (SSD1306Driver *)ip;
-  uint32_t i, b, j;
+  // Inverted text only toggles the glyph, the background is left alone
+  pixelop_t fg = pixelops[color];
+  pixelop_t bg = color == SSD1306_COLOR_INVERT ? NULL : pixelops[!color];
+  uint32_t i, b, j, g;
 
   // Check available space in OLED
   if (drvp->x + font->fw >= SSD1306_WIDTH ||
@@ -113,14 +280,26 @@ static char PUTC(void *ip, char ch, const ssd1306_font_t *font, ssd1306_color_t
     return 0;
   }
 
+  // Look up the glyph, subset fonts go through their remap table
+  if (ch < 32 || ch > 126) {
+    return 0;
+  }
+  g = (uint32_t)(ch - 32);
+  if (font->map != NULL) {
+    if (font->map[g] == 0xFF) {
+      return 0;
+    }
+    g = font->map[g];
+  }
+
   // Go through font
   for (i = 0; i < font->fh; i++) {
-    b = font->dt[(ch - 32) * font->fh + i];
+    b = font->dt[g * font->fh + i];
     for (j = 0; j < font->fw; j++) {
       if ((b << j) & 0x8000) {
-        drawPixel(drvp, drvp->x + j, drvp->y + i, color);
-      } else {
-        drawPixel(drvp, drvp->x + j, drvp->y + i,(ssd1306_color_t)! color);
+        plot(drvp, fg, drvp->x + j, drvp->y + i);
+      } else if (bg != NULL) {
+        plot(drvp, bg, drvp->x + j, drvp->y + i);
       }
     }
   }
@@ -152,7 +331,8 @@ static char PUTS(void *ip, char *str, const ssd1306_font_t *font, ssd1306_color_
 void drawLine(void *ip, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, ssd1306_color_t color) {
 
     SSD1306Driver *drvp = (SSD1306Driver *)ip;
-    int16_t dx, dy, sx, sy, err, e2, i, tmp;
+    pixelop_t op = pixelops[color];
+    int16_t dx, dy, sx, sy, err, e2, tmp;
 
     /* Check for overflow */
     if (x0 >= SSD1306_WIDTH) {
@@ -188,9 +368,7 @@ void drawLine(void *ip, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, ssd1
         }
 
         /* Vertical line */
-        for (i = y0; i <= y1; i++) {
-            drawPixel(drvp, x0, i, color);
-        }
+        fillArea(drvp, color, x0, y0, x0, y1);
 
         /* Return from function */
         return;
@@ -210,16 +388,14 @@ void drawLine(void *ip, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, ssd1
         }
 
         /* Horizontal line */
-        for (i = x0; i <= x1; i++) {
-          drawPixel(drvp, i, y0, color);
-        }
+        fillArea(drvp, color, x0, y0, x1, y0);
 
         /* Return from function */
         return;
     }
 
     while (1) {
-        drawPixel(drvp, x0, y0, color);
+        plot(drvp, op, x0, y0);
         if (x0 == x1 && y0 == y1) {
             break;
         }
@@ -256,17 +432,22 @@ void drawRect(void *ip, uint16_t x, uint16_t y, uint16_t w, uint16_t h, ssd1306_
         h = SSD1306_HEIGHT - y;
     }
 
-    /* Draw 4 lines */
-    drawLine(drvp, x, y, x + w, y, color);         /* Top line */
-    drawLine(drvp, x, y + h, x + w, y + h, color); /* Bottom line */
-    drawLine(drvp, x, y, x, y + h, color);         /* Left line */
-    drawLine(drvp, x + w, y, x + w, y + h, color); /* Right line */
+    /* A flat rectangle is a single line, drawn once */
+    if (h == 0 || w == 0) {
+        fillArea(drvp, color, x, y, x + w, y + h);
+        return;
+    }
+
+    /* Draw 4 lines, corners belong to the horizontal ones only */
+    fillArea(drvp, color, x, y, x + w, y);             /* Top line */
+    fillArea(drvp, color, x, y + h, x + w, y + h);     /* Bottom line */
+    fillArea(drvp, color, x, y + 1, x, y + h - 1);     /* Left line */
+    fillArea(drvp, color, x + w, y + 1, x + w, y + h - 1); /* Right line */
 }
 
 void drawRectFill(void *ip, uint16_t x, uint16_t y, uint16_t w, uint16_t h, ssd1306_color_t color) {
 
     SSD1306Driver *drvp = (SSD1306Driver *)ip;
-    uint8_t i;
 
     /* Check input parameters */
     if (
@@ -285,85 +466,128 @@ void drawRectFill(void *ip, uint16_t x, uint16_t y, uint16_t w, uint16_t h, ssd1
         h = SSD1306_HEIGHT - y;
     }
 
-    /* Draw lines */
-    for (i = 0; i <= h; i++) {
-        /* Draw lines */
-        drawLine(drvp, x, y + i, x + w, y + i, color);
-    }
-}
-
-void drawTri(void *ip, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t x3, uint16_t y3, ssd1306_color_t color) {
-
-    SSD1306Driver *drvp = (SSD1306Driver *)ip;
-
-    /* Draw lines */
-    drawLine(drvp, x1, y1, x2, y2, color);
-    drawLine(drvp, x2, y2, x3, y3, color);
-    drawLine(drvp, x3, y3, x1, y1, color);
+    /* One masked span per page */
+    fillArea(drvp, color, x, y, x + w, y + h);
 }
 
-void drawTriFill(void *ip, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t x3, uint16_t y3, ssd1306_color_t color) {
-
-    SSD1306Driver *drvp = (SSD1306Driver *)ip;
+/*
+ * Span lo..hi of the edge (xa, ya)-(xb, yb) in row y, which must lie in the
+ * rows of the edge. A steep edge has one pixel per row, a shallow one the
+ * columns whose nearest row is y: each pixel of the edge falls in one row.
+ */
+static void edgeSpan(int16_t xa, int16_t ya, int16_t xb, int16_t yb,
+                     int16_t y, int16_t *lo, int16_t *hi) {
+    int32_t adx, dy, v, u0, u1;
 
-    int16_t deltax = 0, deltay = 0, x = 0, y = 0, xinc1 = 0, xinc2 = 0,
-    yinc1 = 0, yinc2 = 0, den = 0, num = 0, numadd = 0, numpixels = 0,
-    curpixel = 0;
+    if (ya > yb) {
+        int16_t t;
 
-    deltax = ABS(x2 - x1);
-    deltay = ABS(y2 - y1);
-    x = x1;
-    y = y1;
+        t = xa; xa = xb; xb = t;
+        t = ya; ya = yb; yb = t;
+    }
+    adx = ABS(xb - xa);
+    dy = yb - ya;
+    v = y - ya;
 
-    if (x2 >= x1) {
-        xinc1 = 1;
-        xinc2 = 1;
+    if (dy == 0) {
+        u0 = 0;
+        u1 = adx;
+    } else if (adx <= dy) {
+        u0 = u1 = (2 * adx * v + dy) / (2 * dy);
     } else {
-        xinc1 = -1;
-        xinc2 = -1;
+        u0 = (v == 0) ? 0 : ((2 * v - 1) * adx + 2 * dy - 1) / (2 * dy);
+        u1 = ((2 * v + 1) * adx + 2 * dy - 1) / (2 * dy) - 1;
+        if (u1 > adx) u1 = adx;
     }
 
-    if (y2 >= y1) {
-        yinc1 = 1;
-        yinc2 = 1;
+    if (xb >= xa) {
+        *lo = xa + u0;
+        *hi = xa + u1;
     } else {
-        yinc1 = -1;
-        yinc2 = -1;
+        *lo = xa - u1;
+        *hi = xa - u0;
     }
+}
 
-    if (deltax >= deltay){
-        xinc1 = 0;
-        yinc2 = 0;
-        den = deltax;
-        num = deltax / 2;
-        numadd = deltay;
-        numpixels = deltax;
-    } else {
-        xinc2 = 0;
-        yinc1 = 0;
-        den = deltay;
-        num = deltay / 2;
-        numadd = deltax;
-        numpixels = deltay;
-    }
-
-    for (curpixel = 0; curpixel <= numpixels; curpixel++) {
-        drawLine(drvp, x, y, x3, y3, color);
-
-        num += numadd;
-        if (num >= den) {
-            num -= den;
-            x += xinc1;
-            y += yinc1;
+/*
+ * Triangle as one pass of rows. The outline merges the spans of the edges
+ * crossing a row, the fill takes everything between the outer ones, so no
+ * pixel is touched twice.
+ */
+static void drawTriRows(SSD1306Driver *drvp, const int16_t *vx,
+                        const int16_t *vy, ssd1306_color_t color, bool fill) {
+    int16_t lo[3], hi[3], t, y, ymin, ymax;
+    uint8_t e, i, j, n;
+
+    ymin = ymax = vy[0];
+    for (e = 1; e < 3; e++) {
+        if (vy[e] < ymin) ymin = vy[e];
+        if (vy[e] > ymax) ymax = vy[e];
+    }
+
+    for (y = ymin; y <= ymax; y++) {
+        /* Spans of the edges crossing this row, sorted by start */
+        n = 0;
+        for (e = 0; e < 3; e++) {
+            i = (e + 1) % 3;
+            if ((y < vy[e] && y < vy[i]) || (y > vy[e] && y > vy[i])) {
+                continue;
+            }
+            edgeSpan(vx[e], vy[e], vx[i], vy[i], y, &lo[n], &hi[n]);
+            for (j = n++; j > 0 && lo[j - 1] > lo[j]; j--) {
+                t = lo[j]; lo[j] = lo[j - 1]; lo[j - 1] = t;
+                t = hi[j]; hi[j] = hi[j - 1]; hi[j - 1] = t;
+            }
+        }
+
+        if (fill) {
+            for (i = 1; i < n; i++) {
+                if (hi[i] > hi[0]) hi[0] = hi[i];
+            }
+            fillArea(drvp, color, lo[0], y, hi[0], y);
+            continue;
+        }
+
+        /* Overlapping spans, e.g. at a vertex, are merged */
+        for (i = 0; i < n; i = j) {
+            for (j = i + 1; j < n && lo[j] <= hi[i]; j++) {
+                if (hi[j] > hi[i]) hi[i] = hi[j];
+            }
+            fillArea(drvp, color, lo[i], y, hi[i], y);
         }
-        x += xinc2;
-        y += yinc2;
     }
 }
 
+static void drawTriClamped(SSD1306Driver *drvp, uint16_t x1, uint16_t y1,
+                           uint16_t x2, uint16_t y2, uint16_t x3, uint16_t y3,
+                           ssd1306_color_t color, bool fill) {
+    int16_t vx[3], vy[3];
+
+    /* Clamp the vertices to the screen, as drawLine() does */
+    vx[0] = x1 >= SSD1306_WIDTH ? SSD1306_WIDTH - 1 : x1;
+    vx[1] = x2 >= SSD1306_WIDTH ? SSD1306_WIDTH - 1 : x2;
+    vx[2] = x3 >= SSD1306_WIDTH ? SSD1306_WIDTH - 1 : x3;
+    vy[0] = y1 >= SSD1306_HEIGHT ? SSD1306_HEIGHT - 1 : y1;
+    vy[1] = y2 >= SSD1306_HEIGHT ? SSD1306_HEIGHT - 1 : y2;
+    vy[2] = y3 >= SSD1306_HEIGHT ? SSD1306_HEIGHT - 1 : y3;
+
+    drawTriRows(drvp, vx, vy, color, fill);
+}
+
+void drawTri(void *ip, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t x3, uint16_t y3, ssd1306_color_t color) {
+
+    drawTriClamped((SSD1306Driver *)ip, x1, y1, x2, y2, x3, y3, color, false);
+}
+
+void drawTriFill(void *ip, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t x3, uint16_t y3, ssd1306_color_t color) {
+
+    drawTriClamped((SSD1306Driver *)ip, x1, y1, x2, y2, x3, y3, color, true);
+}
+
 void drawCircle(void *ip, int16_t x0, int16_t y0, int16_t r, ssd1306_color_t color) {
 
     SSD1306Driver *drvp = (SSD1306Driver *)ip;
+    pixelop_t op = pixelops[color];
 
     int16_t f = 1 - r;
     int16_t ddF_x = 1;
@@ -371,10 +595,17 @@ void drawCircle(void *ip, int16_t x0, int16_t y0, int16_t r, ssd1306_color_t col
     int16_t x = 0;
     int16_t y = r;
 
-    drawPixel(drvp, x0, y0 + r, color);
-    drawPixel(drvp, x0, y0 - r, color);
-    drawPixel(drvp, x0 + r, y0, color);
-    drawPixel(drvp, x0 - r, y0, color);
+    if (r < 0) {
+        return;
+    }
+
+    plot(drvp, op, x0, y0 + r);
+    if (r == 0) {
+        return;
+    }
+    plot(drvp, op, x0, y0 - r);
+    plot(drvp, op, x0 + r, y0);
+    plot(drvp, op, x0 - r, y0);
 
     while (x < y) {
         if (f >= 0) {
@@ -386,15 +617,24 @@ void drawCircle(void *ip, int16_t x0, int16_t y0, int16_t r, ssd1306_color_t col
         ddF_x += 2;
         f += ddF_x;
 
-        drawPixel(drvp, x0 + x, y0 + y, color);
-        drawPixel(drvp, x0 - x, y0 + y, color);
-        drawPixel(drvp, x0 + x, y0 - y, color);
-        drawPixel(drvp, x0 - x, y0 - y, color);
+        /* Past the diagonal the octants mirror points already drawn */
+        if (x > y) {
+            break;
+        }
+
+        plot(drvp, op, x0 + x, y0 + y);
+        plot(drvp, op, x0 - x, y0 + y);
+        plot(drvp, op, x0 + x, y0 - y);
+        plot(drvp, op, x0 - x, y0 - y);
+
+        if (x == y) {
+            break;
+        }
 
-        drawPixel(drvp, x0 + y, y0 + x, color);
-        drawPixel(drvp, x0 - y, y0 + x, color);
-        drawPixel(drvp, x0 + y, y0 - x, color);
-        drawPixel(drvp, x0 - y, y0 - x, color);
+        plot(drvp, op, x0 + y, y0 + x);
+        plot(drvp, op, x0 - y, y0 + x);
+        plot(drvp, op, x0 + y, y0 - x);
+        plot(drvp, op, x0 - y, y0 - x);
     }
 }
 
@@ -407,12 +647,15 @@ void drawCircleFill(void *ip, int16_t x0, int16_t y0, int16_t r, ssd1306_color_t
     int16_t ddF_y = -2 * r;
     int16_t x = 0;
     int16_t y = r;
+    int16_t px = x;
+    int16_t py = y;
 
-    drawPixel(drvp, x0, y0 + r, color);
-    drawPixel(drvp, x0, y0 - r, color);
-    drawPixel(drvp, x0 + r, y0, color);
-    drawPixel(drvp, x0 - r, y0, color);
-    drawLine(drvp, x0 - r, y0, x0 + r, y0, color);
+    if (r < 0) {
+        return;
+    }
+
+    /* One span per row: the middle one, then each pair once */
+    fillArea(drvp, color, x0 - r, y0, x0 + r, y0);
 
     while (x < y) {
         if (f >= 0) {
@@ -424,11 +667,18 @@ void drawCircleFill(void *ip, int16_t x0, int16_t y0, int16_t r, ssd1306_color_t
         ddF_x += 2;
         f += ddF_x;
 
-        drawLine(drvp, x0 - x, y0 + y, x0 + x, y0 + y, color);
-        drawLine(drvp, x0 + x, y0 - y, x0 - x, y0 - y, color);
-
-        drawLine(drvp, x0 + y, y0 + x, x0 - y, y0 + x, color);
-        drawLine(drvp, x0 + y, y0 - x, x0 - y, y0 - x, color);
+        /* Rows +-x, as wide as the outline at y */
+        if (x <= y) {
+            fillArea(drvp, color, x0 - y, y0 + x, x0 + y, y0 + x);
+            fillArea(drvp, color, x0 - y, y0 - x, x0 + y, y0 - x);
+        }
+        /* Rows +-py, done when y leaves them, as wide as the last x */
+        if (y != py) {
+            fillArea(drvp, color, x0 - px, y0 + py, x0 + px, y0 + py);
+            fillArea(drvp, color, x0 - px, y0 - py, x0 + px, y0 - py);
+            py = y;
+        }
+        px = x;
     }
 }
 
@@ -438,10 +688,46 @@ static void setDisplay(void *ip, uint8_t on) {
   wrCmd(ip, 0xAE);
 }
 
+static void setFlip(void *ip, uint8_t hflip, uint8_t vflip) {
+  // Segment re-map (horizontal) and COM scan direction (vertical)
+  const uint8_t txbuf[] = { 0x00, hflip ? 0xA0 : 0xA1, vflip ? 0xC0 : 0xC8 };
+
+  wrDat(ip, txbuf, sizeof(txbuf));
+}
+
+static void setContrast(void *ip, uint8_t level) {
+  wrCmdArg(ip, 0x81, level);
+}
+
+static void setZoom(void *ip, uint8_t on) {
+  wrCmdArg(ip, 0xD6, on ? 0x01 : 0x00);
+}
+
+static void setFade(void *ip, ssd1306_fade_t mode, uint8_t interval) {
+  wrCmdArg(ip, 0x23, (uint8_t)mode | (interval & 0x0F));
+}
+
+#if SSD1306_USE_GRAYSCALE
+static void grayTick(virtual_timer_t *vtp, void *p) {
+  SSD1306Driver *drvp = (SSD1306Driver *)p;
+
+  chSysLockFromISR();
+  // A still pending signal means the previous subframe is not out yet
+  if (chBSemGetStateI(&drvp->gsem)) {
+    chBSemSignalI(&drvp->gsem);
+  } else {
+    drvp->gstats.missed++;
+  }
+  chVTSetI(vtp, drvp->gperiod, grayTick, p);
+  chSysUnlockFromISR();
+}
+#endif
+
 static const struct SSD1306VMT vmt_ssd1306 = {
   updateScreen, toggleInvert, fillScreen, drawPixel,
   gotoXy, PUTC, PUTS, drawLine, drawRect, drawRectFill,
-  drawTri, drawTriFill, drawCircle, drawCircleFill, setDisplay
+  drawTri, drawTriFill, drawCircle, drawCircleFill, setDisplay,
+  setInvert, setFlip, setContrast, setZoom, setFade, rasterOp
 };
 
 /*===========================================================================*/
@@ -455,15 +741,20 @@ void ssd1306ObjectInit(SSD1306Driver *devp) {
   devp->state = SSD1306_STOP;
 }
 
-void ssd1306Start(SSD1306Driver *devp, const SSD1306Config *config) {
-  const uint8_t cmds[] = {
+msg_t ssd1306Start(SSD1306Driver *devp, const SSD1306Config *config) {
+  // Whole init sequence sent as one command stream (control byte 0x00)
+  static const uint8_t cmds[] = {
+    0x00,   // Control byte: command stream
     0xAE,   // display off
     0x20,   // Set memory address
-    0x10,   // 0x00: horizontal addressing mode, 0x01: vertical addressing mode
-    0xB0,   // Set page start address for page addressing mode: 0 ~ 7
+    0x00,   // 0x00: horizontal addressing mode, 0x01: vertical addressing mode
+    0x21,   // Set column address window
+    0x00,
+    0x7F,
+    0x22,   // Set page address window
+    0x00,
+    0x07,
     0xC8,   // Set COM output scan direction
-    0x00,   // Set low column address
-    0x10,   // Set height column address
     0x40,   // Set start line address
     0x81,   // Set contrast control register
     0xFF,
@@ -486,7 +777,8 @@ void ssd1306Start(SSD1306Driver *devp, const SSD1306Config *config) {
     0x14,
     0xAF,   // turn on SSD1306panel
   };
-  uint8_t idx;
+  systime_t start;
+  msg_t ret;
 
   chDbgCheck((devp != NULL) && (config != NULL));
 
@@ -494,25 +786,38 @@ void ssd1306Start(SSD1306Driver *devp, const SSD1306Config *config) {
               "ssd1306Start(), invalid state");
 
   devp->config = config;
+  start = chVTGetSystemTimeX();
 
-  chThdSleepMilliseconds(100);
+  // Poll the panel instead of sleeping blindly after power-up
+  ret = waitAck(devp);
+  if (ret != MSG_OK) {
+    return ret;
+  }
 
   // OLED initialize
-  for (idx = 0; idx < sizeof(cmds); idx++) {
-    wrCmd(devp, cmds[idx]);
+  ret = wrDat(devp, cmds, sizeof(cmds));
+  if (ret != MSG_OK) {
+    return ret;
   }
 
-  // Clear screen
-  fillScreen(devp, SSD1306_COLOR_WHITE);
-
-  // Update screen
-  updateScreen(devp);
+  // Clear screen, GDDRAM upload is skipped if a frame is about to follow
+  // and the start-up time then ends with that frame
+  devp->tstart = start;
+  devp->startup = 0;
+  devp->startpending = true;
+  fillScreen(devp, SSD1306_COLOR_BLACK);
+  if (!config->skipclear) {
+    updateScreen(devp);
+  }
 
   // Set default value
   devp->x = 0;
   devp->y = 0;
+  devp->inv = 0;
 
   devp->state = SSD1306_READY;
+
+  return MSG_OK;
 }
 
 void ssd1306Stop(SSD1306Driver *devp) {
@@ -526,3 +831,139 @@ void ssd1306Stop(SSD1306Driver *devp) {
 
   devp->state = SSD1306_STOP;
 }
+
+#if SSD1306_USE_GRAYSCALE
+void ssd1306DrawPixelGray(SSD1306Driver *devp, uint8_t x, uint8_t y,
+                          ssd1306_gray_t level) {
+  uint16_t idx;
+  uint8_t mask;
+
+  if (x >= SSD1306_WIDTH || y >= SSD1306_HEIGHT) return;
+
+  idx = FB_DATA(y / 8) + x;
+  mask = 1 << (y % 8);
+
+  // High bit of the level goes to fb, low bit to gfb
+  if (level & 0x02) {
+    devp->fb[idx] |= mask;
+  } else {
+    devp->fb[idx] &= ~mask;
+  }
+  if (level & 0x01) {
+    devp->gfb[idx] |= mask;
+  } else {
+    devp->gfb[idx] &= ~mask;
+  }
+  devp->gdirty |= 1 << (y / 8);
+}
+
+void ssd1306GrayStart(SSD1306Driver *devp, sysinterval_t period) {
+  chDbgCheck((devp != NULL) && (period > 0));
+
+  chDbgAssert(devp->state == SSD1306_READY,
+              "ssd1306GrayStart(), invalid state");
+
+  chBSemObjectInit(&devp->gsem, true);
+  chBSemObjectInit(&devp->glock, false);
+  chVTObjectInit(&devp->gvt);
+  memset(&devp->gstats, 0, sizeof(devp->gstats));
+
+  devp->gperiod = period;
+  devp->gsub = 0;
+  devp->gmask = 0;
+  devp->gdirty = 0xFF;
+  devp->gray = true;
+
+  chVTSet(&devp->gvt, period, grayTick, devp);
+}
+
+void ssd1306GrayStop(SSD1306Driver *devp) {
+  chDbgCheck(devp != NULL);
+
+  if (!devp->gray) {
+    return;
+  }
+
+  chVTReset(&devp->gvt);
+
+  // After any subframe in flight, leave the panel on the fb plane alone
+  chBSemWait(&devp->glock);
+  devp->gray = false;
+  updateScreen(devp);
+  chBSemSignal(&devp->glock);
+
+  // Wake a renderer waiting for the next subframe
+  chBSemSignal(&devp->gsem);
+}
+
+msg_t ssd1306GrayRender(SSD1306Driver *devp) {
+  // Weighted subframe sequence: fb is shown twice, gfb once
+  static const uint8_t pattern[] = { 1, 0, 1 };
+  const uint8_t *plane;
+  rtcnt_t start, xfer, t;
+  uint8_t dirty, send, idx, next;
+
+  chBSemWait(&devp->gsem);
+  chBSemWait(&devp->glock);
+  if (!devp->gray) {
+    chBSemSignal(&devp->glock);
+    return MSG_RESET;
+  }
+
+  start = chSysGetRealtimeCounterX();
+
+  plane = pattern[devp->gsub] ? devp->fb : devp->gfb;
+  devp->gsub = (devp->gsub + 1) % sizeof(pattern);
+
+  chSysLock();
+  dirty = devp->gdirty;
+  devp->gdirty = 0;
+  chSysUnlock();
+
+  // Only pages that were drawn on get their gray flag re-evaluated
+  for (idx = 0; idx < 8; idx++) {
+    if (dirty & (1 << idx)) {
+      if (memcmp(&devp->fb[FB_DATA(idx)], &devp->gfb[FB_DATA(idx)],
+                 SSD1306_WIDTH) != 0) {
+        devp->gmask |= 1 << idx;
+      } else {
+        devp->gmask &= ~(1 << idx);
+      }
+    }
+  }
+
+  send = devp->gmask | dirty;
+  xfer = 0;
+  next = 0xFF;
+  devp->gstats.pages = 0;
+  for (idx = 0; idx < 8; idx++) {
+    if ((send & (1 << idx)) == 0) {
+      continue;
+    }
+
+    t = chSysGetRealtimeCounterX();
+    // Consecutive pages follow each other, re-address only on a gap
+    if (idx != next) {
+      const uint8_t window[] = { 0x00, 0x21, 0x00, 0x7F, 0x22, idx, 0x07 };
+      wrDat(devp, window, sizeof(window));
+    }
+    wrDat(devp, &plane[FB_XFER(idx)], SSD1306_WIDTH_FIXED);
+    xfer += chSysGetRealtimeCounterX() - t;
+
+    next = idx + 1;
+    devp->gstats.pages++;
+  }
+  startDone(devp);
+  chBSemSignal(&devp->glock);
+
+  t = chSysGetRealtimeCounterX() - start;
+  devp->gstats.subframes++;
+  devp->gstats.flush = t;
+  devp->gstats.cpu = t - xfer;
+  if (t > devp->gstats.flushmax) {
+    devp->gstats.flushmax = t;
+  }
+
+  return MSG_OK;
+}
+#endif
@@ -1,5 +1,7 @@
 SSDLIB_DIR = ./ssd1306
-SSDLIB_SRCS = $(SSDLIB_DIR)/ssd1306.c
+SSDLIB_SRCS = $(SSDLIB_DIR)/ssd1306.c \
+              $(SSDLIB_DIR)/ssd1306_font.c \
+              $(SSDLIB_DIR)/ssd1306_font_7_10.c
 SSDLIB_INCS = $(SSDLIB_DIR)
 
 ALLCSRC += $(SSDLIB_SRCS)
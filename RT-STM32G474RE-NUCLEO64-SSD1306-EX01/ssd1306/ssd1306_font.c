@@ -1,3 +1,6 @@
+#include "hal.h"
+#include "ssd1306.h"
+
 /* Thanks to https://stm32f4-discovery.net/2015/05/library-61-ssd1306-oled-i2c-lcd-for-stm32f4xx/ */
 static const uint16_t FONT_11x18_DATA[] = {
   0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,   // sp
@@ -98,5 +101,5 @@ static const uint16_t FONT_11x18_DATA[] = {
 };
 
 const ssd1306_font_t ssd1306_font_11x18 = {
-  11, 18, FONT_11x18_DATA
+  11, 18, FONT_11x18_DATA, NULL
 };
@@ -1,3 +1,6 @@
+#include "hal.h"
+#include "ssd1306.h"
+
 /* Thanks to https://stm32f4-discovery.net/2015/05/library-61-ssd1306-oled-i2c-lcd-for-stm32f4xx/ */
 static const uint16_t FONT_7x10_DATA[] = {
   0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,  // sp
@@ -98,5 +101,5 @@ static const uint16_t FONT_7x10_DATA[] = {
 };
 
 const ssd1306_font_t ssd1306_font_7x10 = {
-  7, 10, FONT_7x10_DATA
+  7, 10, FONT_7x10_DATA, NULL
 };
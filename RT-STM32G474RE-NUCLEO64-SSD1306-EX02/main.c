@@ -0,0 +1,177 @@
+/*
+    NeaPolis Innovation Summer Campus 2022 Examples
+    Copyright (C) 2020-2022 Domenico Rega [dodorega@gmail.com]
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+        http://www.apache.org/licenses/LICENSE-2.0
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * [SSD1306] SSD1306 OLED Grayscale Example
+ * The EX01 image in the top six pages and the four gray levels as 32 pixel
+ * wide bars in the bottom two, built with SSD1306_USE_GRAYSCALE (see the
+ * Makefile). The button cycles band, full screen bars and monochrome: the
+ * last one stops the grayscale mode and the panel keeps the fb plane.
+ * Once a second the renderer figures are printed on SD2 (38400 bps).
+ */
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "ssd1306.h"
+#include "image.c"
+
+#if !SSD1306_USE_GRAYSCALE
+#error "this example needs SSD1306_USE_GRAYSCALE, see the Makefile"
+#endif
+
+/* Subframe period, a gray frame takes three subframes. */
+#define GRAY_PERIOD                     TIME_MS2I(4)
+#define GRAY_BAND_Y                     48U
+
+typedef enum {
+  SCENE_BAND,
+  SCENE_FULL,
+  SCENE_MONO
+} scene_t;
+
+static const I2CConfig i2ccfg = {
+  // I2C_TIMINGR address offset
+  .timingr = 0x10,
+  .cr1 = 0,
+  .cr2 = 1,
+};
+
+static const SSD1306Config ssd1306cfg = {
+  &I2CD1,
+  &i2ccfg,
+  SSD1306_SAD_0X78,
+  false,
+};
+
+static SSD1306Driver SSD1306D1;
+static thread_t *rendertp;
+
+static void drawScene(SSD1306Driver *devp, bool full) {
+  uint8_t x, y;
+  int c = 0;
+
+  for (y = 0; y < SSD1306_HEIGHT; y++) {
+    for (x = 0; x < SSD1306_WIDTH; x++, c++) {
+      if (full || y >= GRAY_BAND_Y) {
+        ssd1306DrawPixelGray(devp, x, y, (ssd1306_gray_t)(x / 32U));
+      }
+      else {
+        ssd1306DrawPixelGray(devp, x, y, image_data[c] ? SSD1306_GRAY_WHITE :
+                                                         SSD1306_GRAY_BLACK);
+      }
+    }
+  }
+}
+
+static void grayStart(void) {
+
+  ssd1306GrayStart(&SSD1306D1, GRAY_PERIOD);
+  chEvtSignal(rendertp, EVENT_MASK(0));
+}
+
+/*
+ * Sends the subframes, paced by the driver timer, from ssd1306GrayStart()
+ * until ssd1306GrayStop().
+ */
+static THD_WORKING_AREA(waOledRender, 512);
+static THD_FUNCTION(OledRender, arg) {
+  (void)arg;
+
+  chRegSetThreadName("OledRender");
+
+  while (true) {
+    chEvtWaitAny(EVENT_MASK(0));
+    while (ssd1306GrayRender(&SSD1306D1) == MSG_OK) {
+    }
+  }
+}
+
+int main(void) {
+  BaseSequentialStream *chp = (BaseSequentialStream *)&SD2;
+  const ssd1306_gray_stats_t *gsp = ssd1306GrayGetStats(&SSD1306D1);
+  scene_t scene = SCENE_BAND;
+  uint32_t last = 0;
+  int tick = 0;
+
+  halInit();
+  chSysInit();
+
+  sdStart(&SD2, NULL);
+
+  /* Configuring I2C related PINs */
+  palSetLineMode(PAL_LINE(GPIOB, 8U), PAL_MODE_ALTERNATE(4) |
+                 PAL_STM32_OTYPE_OPENDRAIN | PAL_STM32_OSPEED_HIGHEST |
+                 PAL_STM32_PUPDR_PULLUP);
+  palSetLineMode(PAL_LINE(GPIOB, 9U), PAL_MODE_ALTERNATE(4) |
+                 PAL_STM32_OTYPE_OPENDRAIN | PAL_STM32_OSPEED_HIGHEST |
+                 PAL_STM32_PUPDR_PULLUP);
+
+  ssd1306ObjectInit(&SSD1306D1);
+  if (ssd1306Start(&SSD1306D1, &ssd1306cfg) != MSG_OK) {
+    /* No panel answered: report it and leave the green LED on. */
+    chprintf(chp, "SSD1306 not answering\n\r");
+    palSetLine(LINE_LED_GREEN);
+    while (true) {
+      chThdSleepMilliseconds(500);
+    }
+  }
+
+  rendertp = chThdCreateStatic(waOledRender, sizeof(waOledRender),
+                               NORMALPRIO + 1, OledRender, NULL);
+  drawScene(&SSD1306D1, false);
+  grayStart();
+
+  /*Infinite loop*/
+  while (true) {
+
+    if (palReadLine(LINE_BUTTON) == PAL_LOW) {
+      while (palReadLine(LINE_BUTTON) == PAL_LOW) {
+        chThdSleepMilliseconds(20);
+      }
+
+      scene = scene == SCENE_MONO ? SCENE_BAND : (scene_t)(scene + 1);
+      if (scene == SCENE_MONO) {
+        ssd1306GrayStop(&SSD1306D1);
+        chprintf(chp, "mono: grayscale stopped, fb on the panel\n\r");
+      }
+      else {
+        drawScene(&SSD1306D1, scene == SCENE_FULL);
+        if (scene == SCENE_BAND) {
+          grayStart();
+          last = 0;
+        }
+      }
+    }
+
+    /* Once a second: subframe rate, pages sent and flush times in us. */
+    if (++tick == 20) {
+      uint32_t n = gsp->subframes;
+
+      tick = 0;
+      if (scene != SCENE_MONO) {
+        chprintf(chp, "%s: %u subframes/s, %u missed, %u pages, "
+                 "flush %u us (max %u us), cpu %u us\n\r",
+                 scene == SCENE_FULL ? "full" : "band", n - last,
+                 gsp->missed, gsp->pages,
+                 (unsigned)RTC2US(STM32_SYSCLK, gsp->flush),
+                 (unsigned)RTC2US(STM32_SYSCLK, gsp->flushmax),
+                 (unsigned)RTC2US(STM32_SYSCLK, gsp->cpu));
+      }
+      last = n;
+    }
+
+    chThdSleepMilliseconds(50);
+  }
+}
@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""
+SSD1306 font subsetting tool.
+
+Reads one of the full ASCII font tables of the driver (ssd1306_font.c,
+ssd1306_font_7_10.c) and writes a C source and header holding only the
+requested glyphs plus a 95-entry ASCII remap table. The driver accepts the
+result like any other ssd1306_font_t.
+
+Glyphs are given explicitly with --glyphs, collected from the string
+literals of C sources with --scan, or both. Numeric printf conversions in
+scanned literals pull in the characters they can produce.
+
+Example:
+  fontsubset.py --font ssd1306/ssd1306_font.c --name ssd1306_font_11x18_nisc \
+                --glyphs "NeaPolis" --out font_subset
+"""
+
+import argparse
+import re
+import sys
+
+FIRST = 32
+LAST = 126
+
+GLYPH_RE = re.compile(r'^\s*((?:0x[0-9A-Fa-f]{4}\s*,\s*)+)\s*(?://|/\*)')
+DESC_RE = re.compile(r'ssd1306_font_t\s+\w+\s*=\s*\{\s*(\d+)\s*,\s*(\d+)\s*,')
+STRING_RE = re.compile(r'"((?:[^"\\\n]|\\.)*)"')
+CONV_RE = re.compile(r'%[-+ #0]*\d*(?:\.\d+)?[hlLzjt]*([diuxXfFeEgGcsp%])')
+
+DIGITS = '0123456789'
+CONV_GLYPHS = {
+    'd': DIGITS + '-', 'i': DIGITS + '-', 'u': DIGITS,
+    'x': DIGITS + 'abcdef', 'X': DIGITS + 'ABCDEF', 'p': DIGITS + 'abcdefx',
+    'f': DIGITS + '-.', 'F': DIGITS + '-.',
+    'e': DIGITS + '-.+e', 'E': DIGITS + '-.+E',
+    'g': DIGITS + '-.+e', 'G': DIGITS + '-.+E',
+    '%': '%',
+}
+
+
+def load_font(path):
+    glyphs = []
+    fw = fh = None
+    with open(path) as f:
+        for line in f:
+            m = GLYPH_RE.match(line)
+            if m:
+                glyphs.append([int(v, 16) for v in re.findall(r'0x[0-9A-Fa-f]{4}', m.group(1))])
+                continue
+            m = DESC_RE.search(line)
+            if m:
+                fw, fh = int(m.group(1)), int(m.group(2))
+    if fw is None:
+        # Descriptor initializer may span several lines
+        with open(path) as f:
+            m = DESC_RE.search(f.read())
+        if m:
+            fw, fh = int(m.group(1)), int(m.group(2))
+    if fw is None or len(glyphs) != LAST - FIRST + 1:
+        sys.exit('%s: not a full ASCII ssd1306 font table' % path)
+    if any(len(g) != fh for g in glyphs):
+        sys.exit('%s: glyph rows do not match the font height' % path)
+    return fw, fh, glyphs
+
+
+def scan_sources(paths):
+    found = set()
+    for path in paths:
+        with open(path) as f:
+            text = f.read()
+        for lit in STRING_RE.findall(text):
+            for conv in CONV_RE.findall(lit):
+                if conv in ('s', 'c'):
+                    sys.stderr.write('%s: "%s" prints run-time text, add its '
+                                     'glyphs with --glyphs\n' % (path, lit))
+                else:
+                    found.update(CONV_GLYPHS[conv])
+            found.update(CONV_RE.sub('', lit).encode().decode('unicode_escape'))
+    return found
+
+
+def c_char(c):
+    return {'\\': 'backslash', ' ': 'sp'}.get(c, c)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('--font', required=True, help='full font table (.c)')
+    ap.add_argument('--name', required=True, help='C name of the subset font')
+    ap.add_argument('--glyphs', default='', help='characters to keep')
+    ap.add_argument('--scan', nargs='*', default=[],
+                    help='C sources whose string literals are scanned')
+    ap.add_argument('--out', required=True, help='output path without extension')
+    args = ap.parse_args()
+
+    fw, fh, glyphs = load_font(args.font)
+
+    wanted = set(args.glyphs) | scan_sources(args.scan)
+    chars = sorted(c for c in wanted if FIRST <= ord(c) <= LAST)
+    if not chars:
+        sys.exit('no printable glyphs selected')
+
+    remap = [0xFF] * (LAST - FIRST + 1)
+    for idx, c in enumerate(chars):
+        remap[ord(c) - FIRST] = idx
+
+    name = args.name
+    guard = '__%s_H__' % name.upper()
+    base = args.out.replace('\\', '/').split('/')[-1]
+    full = 2 * fh * len(glyphs)
+    size = 2 * fh * len(chars) + len(remap)
+
+    with open(args.out + '.h', 'w') as f:
+        f.write('/* Generated by fontsubset.py, do not edit. */\n')
+        f.write('#ifndef %s\n#define %s\n\n' % (guard, guard))
+        f.write('#include "ssd1306.h"\n\n')
+        f.write('extern const ssd1306_font_t %s;\n\n' % name)
+        f.write('#endif /* %s */\n' % guard)
+
+    with open(args.out + '.c', 'w') as f:
+        f.write('/* Generated by fontsubset.py from %s, do not edit.\n' %
+                args.font.replace('\\', '/').split('/')[-1])
+        f.write(' * %d of %d glyphs, %d bytes instead of %d. */\n' %
+                (len(chars), len(glyphs), size, full))
+        f.write('#include "hal.h"\n#include "%s.h"\n\n' % base)
+        f.write('static const uint16_t %s_DATA[] = {\n' % name.upper())
+        for c in chars:
+            row = ', '.join('0x%04X' % v for v in glyphs[ord(c) - FIRST])
+            f.write('  %s,   // %s\n' % (row, c_char(c)))
+        f.write('};\n\n')
+        f.write('static const uint8_t %s_MAP[] = {\n' % name.upper())
+        for i in range(0, len(remap), 16):
+            f.write('  %s,\n' % ', '.join('0x%02X' % v for v in remap[i:i + 16]))
+        f.write('};\n\n')
+        f.write('const ssd1306_font_t %s = {\n' % name)
+        f.write('  %d, %d, %s_DATA, %s_MAP\n};\n' % (fw, fh, name.upper(), name.upper()))
+
+    print('%s: %d glyphs "%s", %d bytes (full font %d bytes)' %
+          (name, len(chars), ''.join(chars), size, full))
+
+
+if __name__ == '__main__':
+    main()
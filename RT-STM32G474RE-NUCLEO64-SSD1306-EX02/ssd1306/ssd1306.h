@@ -0,0 +1,310 @@
+
+#ifndef __SSD1306_H__
+#define __SSD1306_H__
+
+#include "hal.h"
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Maximum time ssd1306Start() waits for the panel to ACK, in ms.
+ */
+#if !defined(SSD1306_START_TIMEOUT_MS)
+#define SSD1306_START_TIMEOUT_MS        100
+#endif
+
+/**
+ * @brief   Delay between two consecutive ACK polls at start-up, in ms.
+ */
+#if !defined(SSD1306_POLL_INTERVAL_MS)
+#define SSD1306_POLL_INTERVAL_MS        1
+#endif
+
+/**
+ * @brief   Enables the 4-level temporal-dithering grayscale mode.
+ * @note    Adds a second framebuffer plane to the driver object.
+ */
+#if !defined(SSD1306_USE_GRAYSCALE)
+#define SSD1306_USE_GRAYSCALE           FALSE
+#endif
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if !HAL_USE_I2C
+#error "SSD1306 requires HAL_USE_I2C"
+#endif
+
+#if SSD1306_USE_GRAYSCALE && !CH_CFG_USE_SEMAPHORES
+#error "SSD1306_USE_GRAYSCALE requires CH_CFG_USE_SEMAPHORES"
+#endif
+
+#define SSD1306_WIDTH                   128
+#define SSD1306_HEIGHT                  64
+#define SSD1306_WIDTH_FIXED             (SSD1306_WIDTH + 1)
+#define SSD1306_FB_STRIDE               (SSD1306_WIDTH + 4)
+#define SSD1306_FB_SIZE                 (SSD1306_FB_STRIDE * SSD1306_HEIGHT / 8)
+
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/*
+ * Colors double as blend modes: black clears, white sets and invert
+ * toggles the pixels touched by a primitive. Each primitive touches its
+ * pixels once, so drawing it twice in invert restores the screen.
+ */
+typedef enum {
+    SSD1306_COLOR_BLACK = 0x00,
+    SSD1306_COLOR_WHITE = 0x01,
+    SSD1306_COLOR_INVERT = 0x02
+} ssd1306_color_t;
+
+/* Raster operations between a page area and an 8-pixel column pattern. */
+typedef enum {
+    SSD1306_ROP_COPY = 0x00,
+    SSD1306_ROP_AND = 0x01,
+    SSD1306_ROP_OR = 0x02,
+    SSD1306_ROP_XOR = 0x03
+} ssd1306_rop_t;
+
+typedef enum {
+    SSD1306_FADE_OFF = 0x00,
+    SSD1306_FADE_OUT = 0x20,
+    SSD1306_FADE_BLINK = 0x30
+} ssd1306_fade_t;
+
+typedef enum {
+    SSD1306_GRAY_BLACK = 0x00,
+    SSD1306_GRAY_DARK = 0x01,
+    SSD1306_GRAY_LIGHT = 0x02,
+    SSD1306_GRAY_WHITE = 0x03
+} ssd1306_gray_t;
+
+/*
+ * Grayscale renderer figures. Flush times are in realtime counter cycles:
+ * the achievable subframe rate is STM32_SYSCLK / flushmax and a gray frame
+ * takes three subframes. The cpu field is the part of the last flush not
+ * spent waiting for I2C transfers.
+ */
+typedef struct {
+    uint32_t subframes;
+    uint32_t missed;
+    uint8_t pages;
+    rtcnt_t flush;
+    rtcnt_t flushmax;
+    rtcnt_t cpu;
+} ssd1306_gray_stats_t;
+
+typedef struct {
+    uint8_t fw;
+    uint8_t fh;
+    const uint16_t *dt;
+    /* Subset fonts only: ASCII 32..126 to glyph index, 0xFF if missing. */
+    const uint8_t *map;
+} ssd1306_font_t;
+
+typedef enum {
+    SSD1306_SAD_0X78 = (0x78 >> 1),
+    SSD1306_SAD_0X7A = (0x7A >> 1)
+} ssd1306_sad_t;
+
+typedef enum {
+    SSD1306_UNINIT = 0,
+    SSD1306_STOP = 1,
+    SSD1306_READY = 2,
+} ssd1306_state_t;
+
+typedef struct {
+    I2CDriver *i2cp;
+    const I2CConfig *i2ccfg;
+
+    ssd1306_sad_t sad;
+    /* Leave GDDRAM untouched at start-up, the first frame will overwrite it. */
+    bool skipclear;
+} SSD1306Config;
+
+#define _ssd1306_methods \
+    void (*updateScreen)(void *ip); \
+    void (*toggleInvert)(void *ip); \
+    void (*fillScreen)(void *ip, ssd1306_color_t color); \
+    void (*drawPixel)(void *ip, uint8_t x, uint8_t y, ssd1306_color_t color); \
+    void (*gotoXy)(void *ip, uint8_t x, uint8_t y); \
+    char (*putc)(void *ip, char ch, const ssd1306_font_t *font, ssd1306_color_t color); \
+    char (*puts)(void *ip, char *str, const ssd1306_font_t *font, ssd1306_color_t color); \
+    void (*drawLine)(void *ip, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, ssd1306_color_t color); \
+    void (*drawRect)(void *ip, uint16_t x, uint16_t y, uint16_t w, uint16_t h, ssd1306_color_t color); \
+    void (*drawRectFill)(void *ip, uint16_t x, uint16_t y, uint16_t w, uint16_t h, ssd1306_color_t color); \
+    void (*drawTri)(void *ip, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t x3, uint16_t y3, ssd1306_color_t color); \
+    void (*drawTriFill)(void *ip, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t x3, uint16_t y3, ssd1306_color_t color); \
+    void (*drawCircle)(void *ip, int16_t x0, int16_t y0, int16_t r, ssd1306_color_t color); \
+    void (*drawCircleFill)(void *ip, int16_t x0, int16_t y0, int16_t r, ssd1306_color_t color); \
+    void (*setDisplay)(void *ip, uint8_t on); \
+    void (*setInvert)(void *ip, uint8_t on); \
+    void (*setFlip)(void *ip, uint8_t hflip, uint8_t vflip); \
+    void (*setContrast)(void *ip, uint8_t level); \
+    void (*setZoom)(void *ip, uint8_t on); \
+    void (*setFade)(void *ip, ssd1306_fade_t mode, uint8_t interval); \
+    void (*rasterOp)(void *ip, uint8_t x, uint8_t page, uint8_t w, uint8_t npages, ssd1306_rop_t rop, uint8_t pattern);
+
+struct SSD1306VMT {
+    _ssd1306_methods
+};
+
+#define _ssd1306_data \
+    ssd1306_state_t state; \
+    const SSD1306Config *config; \
+
+typedef struct SSD1306Driver {
+    const struct SSD1306VMT *vmt;
+    _ssd1306_data;
+
+    uint8_t x;
+    uint8_t y;
+    uint8_t inv;
+    /* Time from ssd1306Start() to the end of the first frame upload, 0
+       until that upload is done: with skipclear it is the first update. */
+    systime_t tstart;
+    sysinterval_t startup;
+    bool startpending;
+    /* Page rows are word aligned for the raster operations. */
+    union {
+        uint32_t fbw[SSD1306_FB_SIZE / 4];
+        uint8_t fb[SSD1306_FB_SIZE];
+    };
+#if SSD1306_USE_GRAYSCALE
+    /* Low weight plane, fb is shown twice as long as gfb. */
+    union {
+        uint32_t gfbw[SSD1306_FB_SIZE / 4];
+        uint8_t gfb[SSD1306_FB_SIZE];
+    };
+    /* Pages touched since the last subframe and pages holding gray. */
+    uint8_t gdirty;
+    uint8_t gmask;
+    uint8_t gsub;
+    bool gray;
+    sysinterval_t gperiod;
+    virtual_timer_t gvt;
+    binary_semaphore_t gsem;
+    /* Held while a subframe or the final frame goes out. */
+    binary_semaphore_t glock;
+    ssd1306_gray_stats_t gstats;
+#endif
+} SSD1306Driver;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+#define ssd1306UpdateScreen(ip) \
+    (ip)->vmt->updateScreen(ip)
+
+#define ssd1306ToggleInvert(ip) \
+    (ip)->vmt->toggleInvert(ip)
+
+#define ssd1306FillScreen(ip, color) \
+    (ip)->vmt->fillScreen(ip, color)
+
+#define ssd1306DrawPixel(ip, x, y, color) \
+    (ip)->vmt->drawPixel(ip, x, y, color)
+
+#define ssd1306GotoXy(ip, x, y) \
+    (ip)->vmt->gotoXy(ip, x, y)
+
+#define ssd1306Putc(ip, ch, font, color) \
+    (ip)->vmt->putc(ip, ch, font, color)
+
+#define ssd1306Puts(ip, str, font, color) \
+    (ip)->vmt->puts(ip, str, font, color)
+
+#define ssd1306DrawLine(ip, x0, y0, x1, y1, color) \
+    (ip)->vmt->drawLine(ip, x0, y0, x1, y1, color)
+
+#define ssd1306DrawRectangle(ip, x, y, w, h, color) \
+    (ip)->vmt->drawRect(ip, x, y, w, h, color)
+
+#define ssd1306DrawRectangleFill(ip, x, y, w, h, color) \
+    (ip)->vmt->drawRectFill(ip, x, y, w, h, color)
+
+#define ssd1306DrawTriangle(ip, x1, y1, x2, y2, x3, y3, color) \
+    (ip)->vmt->drawTri(ip, x1, y1, x2, y2, x3, y3, color)
+
+#define ssd1306DrawTriangleFill(ip, x1, y1, x2, y2, x3, y3, color) \
+    (ip)->vmt->drawTriFill(ip, x1, y1, x2, y2, x3, y3, color)
+
+#define ssd1306DrawCircle(ip, x0, y0, r, color) \
+    (ip)->vmt->drawCircle(ip, x0, y0, r, color)
+
+#define ssd1306DrawCircleFill(ip, x0, y0, r, color) \
+    (ip)->vmt->drawCircleFill(ip, x0, y0, r, color)
+
+#define ssd1306SetDisplay(ip, on) \
+    (ip)->vmt->setDisplay(ip, on)
+
+/*
+ * The following operations are executed by the controller itself: each one
+ * costs a single command transaction and leaves the framebuffer untouched.
+ */
+#define ssd1306SetInvert(ip, on) \
+    (ip)->vmt->setInvert(ip, on)
+
+/* Vertical flip is immediate, horizontal flip applies to the next update. */
+#define ssd1306SetFlip(ip, hflip, vflip) \
+    (ip)->vmt->setFlip(ip, hflip, vflip)
+
+#define ssd1306SetContrast(ip, level) \
+    (ip)->vmt->setContrast(ip, level)
+
+#define ssd1306SetZoom(ip, on) \
+    (ip)->vmt->setZoom(ip, on)
+
+/* Interval is 0..15, one step every 8 frames. */
+#define ssd1306SetFade(ip, mode, interval) \
+    (ip)->vmt->setFade(ip, mode, interval)
+
+/* Word-wide operation on w columns of npages page rows starting at x, page. */
+#define ssd1306RasterOp(ip, x, page, w, npages, rop, pattern) \
+    (ip)->vmt->rasterOp(ip, x, page, w, npages, rop, pattern)
+
+#define ssd1306GetState(ip) \
+    ((ip)->state)
+
+#define ssd1306GetStartupTime(ip) \
+    ((ip)->startup)
+
+#if SSD1306_USE_GRAYSCALE
+#define ssd1306GrayGetStats(ip) \
+    (&(ip)->gstats)
+#endif
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern const ssd1306_font_t ssd1306_font_7x10;
+extern const ssd1306_font_t ssd1306_font_11x18;
+
+void ssd1306ObjectInit(SSD1306Driver *devp);
+msg_t ssd1306Start(SSD1306Driver *devp, const SSD1306Config *config);
+void ssd1306Stop(SSD1306Driver *devp);
+#if SSD1306_USE_GRAYSCALE
+void ssd1306DrawPixelGray(SSD1306Driver *devp, uint8_t x, uint8_t y,
+                          ssd1306_gray_t level);
+void ssd1306GrayStart(SSD1306Driver *devp, sysinterval_t period);
+void ssd1306GrayStop(SSD1306Driver *devp);
+msg_t ssd1306GrayRender(SSD1306Driver *devp);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SSD1306_H__ */
@@ -0,0 +1,8 @@
+SSDLIB_DIR = ./ssd1306
+SSDLIB_SRCS = $(SSDLIB_DIR)/ssd1306.c \
+              $(SSDLIB_DIR)/ssd1306_font.c \
+              $(SSDLIB_DIR)/ssd1306_font_7_10.c
+SSDLIB_INCS = $(SSDLIB_DIR)
+
+ALLCSRC += $(SSDLIB_SRCS)
+ALLINC += $(SSDLIB_INCS)
\ No newline at end of file
@@ -34,6 +34,9 @@
 
 char buff[BUFF_SIZE];
 
+/* Set when no panel answered, the LED then blinks fast. */
+static volatile bool oledfail = false;
+
 /*
  * Configures PWM Drivers.
  */
@@ -84,7 +87,10 @@ static THD_FUNCTION(OledDisplay, arg) {
   chRegSetThreadName("OledDisplay");
   ssd1306ObjectInit(&SSD1306D1);
 
-  ssd1306Start(&SSD1306D1, &ssd1306cfg);
+  if (ssd1306Start(&SSD1306D1, &ssd1306cfg) != MSG_OK) {
+    oledfail = true;
+    return;
+  }
 
   ssd1306FillScreen(&SSD1306D1, 0x00);
 
@@ -124,9 +130,9 @@ static THD_FUNCTION(Thread1, arg) {
 
   while (true) {
     palClearPad(GPIOA, GPIOA_LED_GREEN);
-    chThdSleepMilliseconds(500);
+    chThdSleepMilliseconds(oledfail ? 100 : 500);
     palSetPad(GPIOA, GPIOA_LED_GREEN);
-    chThdSleepMilliseconds(500);
+    chThdSleepMilliseconds(oledfail ? 100 : 500);
   }
 }
 
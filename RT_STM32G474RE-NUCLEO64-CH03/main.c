@@ -57,23 +57,6 @@ static int32_t POT_VALUE = 0;
 /*
  * ADC Configuration.
  */
-/*
-static const ADCConversionGroup pot_adccg = {
-  FALSE,
-  (uint16_t)(ADC1_CH_NUM),
-  NULL,                 // end callback
-  NULL,                 // error callback
-  0,                    //CR1
-  ADC_CR2_SWSTART,      //CR2
-  ADC_SMPR2_SMP_AN0(ADC_SAMPLE_3),
-  0,
-  0,
-  0,
-  0,
-  0,
-  ADC_SQR3_SQ1_N(ADC_CHANNEL_IN0)
-};
-*/
 static const ADCConversionGroup adcgrpcfg1 = {
   .circular     = false,
   .num_channels = ADC1_CH_NUM,